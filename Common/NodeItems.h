@@ -0,0 +1,250 @@
+//Default Libraries
+#include<array>
+#include<vector>
+#include<memory>
+#include<cstddef>
+#include<cstdint>
+#include<optional>
+#include<iterator>
+
+#ifndef NODE_ITEMS_H
+#define NODE_ITEMS_H 1
+
+//Macros
+#define NODE_INLINE_CAPACITY 2
+
+
+/*
+* The items storage of a single node. The first few items live directly inside
+* the node, only the ones above that capacity go to the heap. Every item gets a slot
+* that doesn't move until the item itself is erased, so the slot number can be kept
+* outside as a handle. The freed slots are reused by the next insertions.
+* The overflow lives behind a single pointer, so a node without it pays only 8 bytes.
+*/
+
+
+namespace DataStructures {
+
+
+	template<typename T, size_t N = NODE_INLINE_CAPACITY>
+	class NodeItems
+	{
+
+		//Gives the slot regardless of whether it's placed inline or not
+		std::optional<T>& slot(size_t index);
+
+	protected:
+
+		//The slots inside the node
+		std::array<std::optional<T>, N> m_Inline;
+
+		//The slots that didn't fit in the node, allocated with the first of them
+		std::unique_ptr<std::vector<std::optional<T>>> m_Overflow;
+
+		//Amount of the occupied slots
+		uint32_t m_Size = 0;
+
+	public:
+
+		//Walks through the occupied slots only
+		class iterator
+		{
+			NodeItems<T, N>* m_Items = nullptr;
+			size_t m_Slot = 0;
+
+			//Moves forward to the next occupied slot
+			void skip_empty()
+			{
+				while (m_Slot < m_Items->slots() && !m_Items->occupied(m_Slot))
+				{
+					m_Slot++;
+				}
+			}
+
+		public:
+
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+			using pointer = T*;
+			using reference = T&;
+
+			iterator() {}
+			iterator(NodeItems<T, N>* items, size_t slot) : m_Items(items), m_Slot(slot) { skip_empty(); }
+
+			T& operator*() const { return m_Items->at(m_Slot); }
+			T* operator->() const { return &m_Items->at(m_Slot); }
+			iterator& operator++() { m_Slot++; skip_empty(); return *this; }
+			iterator operator++(int) { iterator previous = *this; ++(*this); return previous; }
+			bool operator==(const iterator& other) const { return m_Slot == other.m_Slot; }
+			bool operator!=(const iterator& other) const { return m_Slot != other.m_Slot; }
+
+			//The slot the iterator is pointing at
+			size_t slot() const { return m_Slot; }
+		};
+
+		/*
+		* Capacity
+		*/
+
+		size_t size();
+		size_t slots();
+		bool empty();
+		bool occupied(size_t index);
+
+		/*
+		* Element access
+		*/
+
+		T& at(size_t index);
+		iterator begin();
+		iterator end();
+
+		/*
+		* Modifiers
+		*/
+
+		size_t insert(T object);
+		bool erase(size_t index);
+		void clear();
+	};
+
+
+	/*
+	* ///////////////////////
+	* /		Definitions     /
+	* ///////////////////////
+	*/
+
+
+	template<typename T, size_t N>
+	size_t NodeItems<T, N>::size()
+	{
+		return m_Size;
+	}
+
+
+	template<typename T, size_t N>
+	size_t NodeItems<T, N>::slots()
+	{
+		return m_Overflow ? N + m_Overflow->size() : N;
+	}
+
+
+	template<typename T, size_t N>
+	bool NodeItems<T, N>::empty()
+	{
+		return m_Size == 0;
+	}
+
+
+	template<typename T, size_t N>
+	bool NodeItems<T, N>::occupied(size_t index)
+	{
+		return index < slots() && slot(index).has_value();
+	}
+
+
+	template<typename T, size_t N>
+	T& NodeItems<T, N>::at(size_t index)
+	{
+		return *slot(index);
+	}
+
+
+	template<typename T, size_t N>
+	typename NodeItems<T, N>::iterator NodeItems<T, N>::begin()
+	{
+		//Empty storage doesn't have to look through the slots at all
+		if (!m_Size)
+		{
+			return end();
+		}
+
+		return iterator(this, 0);
+	}
+
+
+	template<typename T, size_t N>
+	typename NodeItems<T, N>::iterator NodeItems<T, N>::end()
+	{
+		return iterator(this, slots());
+	}
+
+
+	template<typename T, size_t N>
+	size_t NodeItems<T, N>::insert(T object)
+	{
+		size_t index = 0;
+
+		//Looking for the first free slot, the inline ones go first
+		while (index < slots() && slot(index).has_value())
+		{
+			index++;
+		}
+
+		//Every slot is taken, so a new one is needed
+		if (index == slots())
+		{
+			if (!m_Overflow)
+			{
+				m_Overflow = std::make_unique<std::vector<std::optional<T>>>();
+			}
+
+			m_Overflow->emplace_back();
+		}
+
+		slot(index) = std::move(object);
+		m_Size++;
+
+		return index;
+	}
+
+
+	template<typename T, size_t N>
+	bool NodeItems<T, N>::erase(size_t index)
+	{
+		if (!occupied(index))
+		{
+			return false;
+		}
+
+		slot(index).reset();
+		m_Size--;
+
+		//Trailing empty overflow slots aren't needed anymore
+		while (m_Overflow && !m_Overflow->empty() && !m_Overflow->back().has_value())
+		{
+			m_Overflow->pop_back();
+		}
+
+		return true;
+	}
+
+
+	template<typename T, size_t N>
+	void NodeItems<T, N>::clear()
+	{
+		for (size_t i = 0; i < N; ++i)
+		{
+			m_Inline[i].reset();
+		}
+
+		m_Overflow.reset();
+		m_Size = 0;
+	}
+
+
+	template<typename T, size_t N>
+	std::optional<T>& NodeItems<T, N>::slot(size_t index)
+	{
+		if (index < N)
+		{
+			return m_Inline[index];
+		}
+
+		return (*m_Overflow)[index - N];
+	}
+
+}
+#endif
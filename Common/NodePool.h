@@ -0,0 +1,266 @@
+//Default Libraries
+#include<array>
+#include<vector>
+#include<memory>
+#include<utility>
+#include<cstddef>
+#include<cstdint>
+#include<new>
+
+#ifndef NODE_POOL_H
+#define NODE_POOL_H 1
+
+//Macros
+#define NODE_POOL_BLOCK_SIZE 512
+
+
+/*
+* A simple block arena used by the trees for creating their child nodes.
+* Nodes are placed inside big contiguous blocks instead of going through
+* the heap one by one, released nodes are kept on a free list for reuse,
+* and the whole arena can be emptied at once, without giving the memory back.
+* Every node is known by a 32 bit index, which is half the size of a pointer,
+* so the parents can keep all of their children in a few bytes. The blocks are
+* never moved, so the node pointers stay valid for their lifetime as well.
+* For the multi threaded builds a whole range of slots can be reserved up front, then
+* every thread constructs its nodes in its own range without touching the pool itself.
+*/
+
+
+namespace DataStructures {
+
+
+	template<typename Node>
+	class NodePool
+	{
+
+		//Properly aligned storage for a single node
+		struct Slot
+		{
+			alignas(Node) unsigned char storage[sizeof(Node)];
+			bool alive = false;
+		};
+
+		//One block of the arena
+		using Block = std::array<Slot, NODE_POOL_BLOCK_SIZE>;
+
+	protected:
+
+		//The arena itself
+		std::vector<std::unique_ptr<Block>> m_Blocks;
+
+		//Slots that have been released and can be reused
+		std::vector<uint32_t> m_FreeSlots;
+
+		//How many slots have ever been used in total, marks the end of the arena
+		size_t m_Used = 0;
+
+		//How many nodes are currently constructed
+		size_t m_Alive = 0;
+
+	public:
+
+		/*
+		* Initialisation
+		*/
+
+		NodePool();
+		NodePool(const NodePool&) = delete;
+		NodePool& operator=(const NodePool&) = delete;
+		~NodePool();
+
+		/*
+		* Capacity
+		*/
+
+		size_t size();
+		size_t capacity();
+
+		/*
+		* Element access
+		*/
+
+		Node* at(uint32_t index);
+
+		/*
+		* Modifiers
+		*/
+
+		template<typename... Args>
+		uint32_t create(Args&&... args);
+		void destroy(uint32_t index);
+		void reset();
+
+		/*
+		* Reserved ranges
+		*/
+
+		uint32_t reserve_range(size_t count);
+		template<typename... Args>
+		void create_at(uint32_t index, Args&&... args);
+		void close_range(uint32_t first, size_t count);
+	};
+
+
+	/*
+	* ///////////////////////
+	* /		Definitions     /
+	* ///////////////////////
+	*/
+
+
+	template<typename Node>
+	NodePool<Node>::NodePool()
+	{}
+
+
+	template<typename Node>
+	NodePool<Node>::~NodePool()
+	{
+		//Every node that is still alive has to be destructed properly
+		reset();
+	}
+
+
+	template<typename Node>
+	size_t NodePool<Node>::size()
+	{
+		return m_Alive;
+	}
+
+
+	template<typename Node>
+	size_t NodePool<Node>::capacity()
+	{
+		return m_Blocks.size() * NODE_POOL_BLOCK_SIZE;
+	}
+
+
+	template<typename Node>
+	Node* NodePool<Node>::at(uint32_t index)
+	{
+		return std::launder(reinterpret_cast<Node*>((*m_Blocks[index / NODE_POOL_BLOCK_SIZE])[index % NODE_POOL_BLOCK_SIZE].storage));
+	}
+
+
+	template<typename Node>
+	template<typename... Args>
+	uint32_t NodePool<Node>::create(Args&&... args)
+	{
+		uint32_t index;
+
+		//Reusing the released slots first
+		if (!m_FreeSlots.empty())
+		{
+			index = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+		else
+		{
+			//Otherwise taking the next untouched slot, allocating a new block when needed
+			if (m_Used / NODE_POOL_BLOCK_SIZE == m_Blocks.size())
+			{
+				m_Blocks.push_back(std::make_unique<Block>());
+			}
+
+			index = (uint32_t)m_Used;
+			m_Used++;
+		}
+
+		Slot& slot = (*m_Blocks[index / NODE_POOL_BLOCK_SIZE])[index % NODE_POOL_BLOCK_SIZE];
+
+		//Marking the slot before constructing, because the node can create its own children right away
+		slot.alive = true;
+		m_Alive++;
+
+		new (slot.storage) Node(std::forward<Args>(args)...);
+
+		return index;
+	}
+
+
+	template<typename Node>
+	void NodePool<Node>::destroy(uint32_t index)
+	{
+		Slot& slot = (*m_Blocks[index / NODE_POOL_BLOCK_SIZE])[index % NODE_POOL_BLOCK_SIZE];
+
+		if (!slot.alive) return;
+
+		std::launder(reinterpret_cast<Node*>(slot.storage))->~Node();
+		slot.alive = false;
+		m_FreeSlots.push_back(index);
+		m_Alive--;
+	}
+
+
+	template<typename Node>
+	void NodePool<Node>::reset()
+	{
+		//Destructing every alive node at once, the blocks are kept for the next use
+		for (size_t i = 0; i < m_Used; ++i)
+		{
+			Slot& slot = (*m_Blocks[i / NODE_POOL_BLOCK_SIZE])[i % NODE_POOL_BLOCK_SIZE];
+
+			if (slot.alive)
+			{
+				std::launder(reinterpret_cast<Node*>(slot.storage))->~Node();
+				slot.alive = false;
+			}
+		}
+
+		m_FreeSlots.clear();
+		m_Used = 0;
+		m_Alive = 0;
+	}
+
+
+	//Takes count untouched slots at once, the blocks are allocated right away, so the range can be filled from another thread
+	template<typename Node>
+	uint32_t NodePool<Node>::reserve_range(size_t count)
+	{
+		uint32_t first = (uint32_t)m_Used;
+		m_Used += count;
+
+		while (m_Blocks.size() * NODE_POOL_BLOCK_SIZE < m_Used)
+		{
+			m_Blocks.push_back(std::make_unique<Block>());
+		}
+
+		return first;
+	}
+
+
+	//Constructs a node inside of a reserved range, the counters are updated once the range is closed
+	template<typename Node>
+	template<typename... Args>
+	void NodePool<Node>::create_at(uint32_t index, Args&&... args)
+	{
+		Slot& slot = (*m_Blocks[index / NODE_POOL_BLOCK_SIZE])[index % NODE_POOL_BLOCK_SIZE];
+
+		slot.alive = true;
+
+		new (slot.storage) Node(std::forward<Args>(args)...);
+	}
+
+
+	//Counts the nodes created in the range, the slots left unused go to the free list
+	template<typename Node>
+	void NodePool<Node>::close_range(uint32_t first, size_t count)
+	{
+		for (size_t i = first; i < first + count; ++i)
+		{
+			Slot& slot = (*m_Blocks[i / NODE_POOL_BLOCK_SIZE])[i % NODE_POOL_BLOCK_SIZE];
+
+			if (slot.alive)
+			{
+				m_Alive++;
+			}
+			else
+			{
+				m_FreeSlots.push_back((uint32_t)i);
+			}
+		}
+	}
+
+}
+#endif
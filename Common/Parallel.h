@@ -0,0 +1,106 @@
+//Default Libraries
+#include<vector>
+#include<thread>
+#include<atomic>
+#include<cstddef>
+#include<algorithm>
+
+#ifndef PARALLEL_H
+#define PARALLEL_H 1
+
+//Macros
+#define PARALLEL_MINIMUM_TASK_SIZE 4096
+
+
+/*
+* The smallest possible task runner used by the multi threaded paths of the trees.
+* The work is split into independent tasks up front, and a few threads take them one
+* after another from a shared counter, so a big task on one thread doesn't hold the others.
+* The calling thread works as well, so nothing is spawned when there is only one task.
+* The threads live only as long as a single run, there is no pool kept in the background.
+*/
+
+
+namespace DataStructures {
+
+
+	namespace Parallel {
+
+
+		//The number of the threads asked for by the user, 0 leaves it to the hardware
+		inline std::atomic<size_t>& requested_workers()
+		{
+			static std::atomic<size_t> workers(0);
+			return workers;
+		}
+
+
+		//How many threads can work at once, never less than one
+		inline size_t worker_count()
+		{
+			static const size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+			size_t requested = requested_workers();
+
+			return requested ? requested : hardware;
+		}
+
+
+		//Sets the number of the threads used by the parallel builds and searches of every tree, 0 goes back to the hardware concurrency.
+		//The runs already going keep the count they started with
+		inline void set_worker_count(size_t workers)
+		{
+			requested_workers() = workers;
+		}
+
+
+		//Calls task(i) for every i below count, returns once all of them are done
+		template<typename F>
+		void run(size_t count, F&& task)
+		{
+			std::atomic<size_t> next(0);
+
+			auto work = [&]() {
+				for (size_t i = next++; i < count; i = next++)
+				{
+					task(i);
+				}
+			};
+
+			//The calling thread is one of the workers
+			size_t helpers = std::min(worker_count(), count);
+			std::vector<std::thread> threads;
+			threads.reserve(helpers > 0 ? helpers - 1 : 0);
+
+			for (size_t i = 1; i < helpers; ++i)
+			{
+				threads.emplace_back(work);
+			}
+
+			work();
+
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+
+		//Splits [0, count) into ranges of at least PARALLEL_MINIMUM_TASK_SIZE and calls task(begin, end) for each of them
+		template<typename F>
+		void run_ranges(size_t count, F&& task)
+		{
+			size_t ranges = std::max<size_t>(1, std::min(worker_count() * 4, count / PARALLEL_MINIMUM_TASK_SIZE));
+			size_t length = (count + ranges - 1) / ranges;
+
+			run(ranges, [&](size_t i) {
+				size_t begin = i * length;
+				size_t end = std::min(count, begin + length);
+
+				if (begin < end) task(begin, end);
+			});
+		}
+
+	}
+
+}
+#endif
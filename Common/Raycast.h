@@ -0,0 +1,65 @@
+//Default Libraries
+#include<utility>
+#include<algorithm>
+
+#ifndef RAYCAST_H
+#define RAYCAST_H 1
+
+
+/*
+* The slab test behind the ray casts of the trees. A ray is origin + t * direction, and a box
+* is the overlap of one slab per axis, so the part of the ray inside of the box is found by narrowing
+* the range of t axis after axis. The range starts as [0, max_distance], so the casts are segments,
+* and whatever is left of it tells where the ray enters and leaves the box.
+*/
+
+
+namespace DataStructures {
+
+
+	namespace Raycast {
+
+
+		//Narrows [enter, exit] down to the part of the ray inside of the slab of one axis, returns false once nothing is left
+		inline bool clip_slab(float origin, float direction, float minimum, float maximum, float& enter, float& exit)
+		{
+			//Parallel to the slab, the ray is either inside of it all the time or never
+			if (direction == 0.0f)
+			{
+				return origin >= minimum && origin <= maximum;
+			}
+
+			float inverse = 1.0f / direction;
+			float near = (minimum - origin) * inverse;
+			float far = (maximum - origin) * inverse;
+
+			if (near > far)
+			{
+				std::swap(near, far);
+			}
+
+			enter = std::max(enter, near);
+			exit = std::min(exit, far);
+
+			return enter <= exit;
+		}
+
+
+		//The same for the whole box, every axis at once
+		inline bool clip_box(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& minimum, const glm::vec3& maximum, float& enter, float& exit)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				if (!clip_slab(origin[i], direction[i], minimum[i], maximum[i], enter, exit))
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+	}
+
+}
+#endif
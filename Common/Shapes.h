@@ -0,0 +1,256 @@
+//Default Libraries
+#include<array>
+#include<cmath>
+#include<initializer_list>
+#include<algorithm>
+
+#ifndef SHAPES_H
+#define SHAPES_H 1
+
+
+/*
+* The regions, other than the boxes, that the trees can be searched with. Any type works as
+* a shape, as long as it answers two questions about a box: intersects(box), whether they share
+* any point, and contains(box), whether the whole box is inside. The first one prunes the subtrees,
+* the second one lets the whole subtree through without testing its items one by one.
+*/
+
+
+namespace DataStructures {
+
+
+	namespace Shapes {
+
+
+		//Both corners of the box in order, whatever way it was built
+		inline void box_corners(Collisions::AABB& box, glm::vec3& minimum, glm::vec3& maximum)
+		{
+			std::array<glm::vec3, 2> region = box.bounding_region();
+			minimum = glm::min(region[0], region[1]);
+			maximum = glm::max(region[0], region[1]);
+		}
+
+
+		//The squared distance from the point to the nearest point of the box, zero inside of it
+		inline float box_distance_squared(const glm::vec3& point, const glm::vec3& minimum, const glm::vec3& maximum)
+		{
+			glm::vec3 offset = glm::clamp(point, minimum, maximum) - point;
+			return glm::dot(offset, offset);
+		}
+
+
+		//The squared distance from the point to the segment
+		inline float segment_distance_squared(const glm::vec3& point, const glm::vec3& start, const glm::vec3& end)
+		{
+			glm::vec3 segment = end - start;
+			float length = glm::dot(segment, segment);
+			float t = length > 0.0f ? std::max(0.0f, std::min(1.0f, glm::dot(point - start, segment) / length)) : 0.0f;
+
+			glm::vec3 offset = start + segment * t - point;
+			return glm::dot(offset, offset);
+		}
+
+
+		//Bit i of the corner number picks the maximum of the axis i
+		inline glm::vec3 box_corner(const glm::vec3& minimum, const glm::vec3& maximum, int corner)
+		{
+			return glm::vec3(
+				(corner & 0x1) ? maximum.x : minimum.x,
+				(corner & 0x2) ? maximum.y : minimum.y,
+				(corner & 0x4) ? maximum.z : minimum.z);
+		}
+
+
+		struct Sphere
+		{
+			glm::vec3 center;
+			float radius;
+
+			bool intersects(Collisions::AABB& box) const
+			{
+				glm::vec3 minimum, maximum;
+				box_corners(box, minimum, maximum);
+
+				return box_distance_squared(center, minimum, maximum) <= radius * radius;
+			}
+
+			//The farthest corner has to be inside
+			bool contains(Collisions::AABB& box) const
+			{
+				glm::vec3 minimum, maximum;
+				box_corners(box, minimum, maximum);
+
+				glm::vec3 farthest = glm::max(glm::abs(center - minimum), glm::abs(maximum - center));
+				return glm::dot(farthest, farthest) <= radius * radius;
+			}
+		};
+
+
+		//Every point closer than the radius to the segment between start and end
+		struct Capsule
+		{
+			glm::vec3 start;
+			glm::vec3 end;
+			float radius;
+
+			//The distance to the box along the segment is a piecewise quadratic, with a new piece wherever the segment
+			//crosses a plane of the box, so the exact minimum is the least of the minimums of the pieces
+			bool intersects(Collisions::AABB& box) const
+			{
+				glm::vec3 minimum, maximum;
+				box_corners(box, minimum, maximum);
+
+				glm::vec3 segment = end - start;
+
+				std::array<float, 8> breaks;
+				size_t count = 0;
+				breaks[count++] = 0.0f;
+				breaks[count++] = 1.0f;
+
+				for (int i = 0; i < 3; i++)
+				{
+					if (segment[i] == 0.0f)
+					{
+						continue;
+					}
+
+					for (float plane : { minimum[i], maximum[i] })
+					{
+						float t = (plane - start[i]) / segment[i];
+
+						if (t > 0.0f && t < 1.0f) breaks[count++] = t;
+					}
+				}
+
+				std::sort(breaks.begin(), breaks.begin() + count);
+
+				float limit = radius * radius;
+
+				for (size_t piece = 0; piece + 1 < count; piece++)
+				{
+					float first = breaks[piece];
+					float last = breaks[piece + 1];
+					glm::vec3 middle = start + segment * ((first + last) * 0.5f);
+
+					//The squared distance on this piece as a * t^2 + b * t + c, only the axes outside of the box add to it
+					float a = 0.0f, b = 0.0f, c = 0.0f;
+
+					for (int i = 0; i < 3; i++)
+					{
+						float plane;
+
+						if (middle[i] < minimum[i]) plane = minimum[i];
+						else if (middle[i] > maximum[i]) plane = maximum[i];
+						else continue;
+
+						float offset = start[i] - plane;
+						a += segment[i] * segment[i];
+						b += 2.0f * segment[i] * offset;
+						c += offset * offset;
+					}
+
+					float t = a > 0.0f ? std::max(first, std::min(last, -b / (2.0f * a))) : first;
+
+					if (a * t * t + b * t + c <= limit)
+					{
+						return true;
+					}
+				}
+
+				return false;
+			}
+
+			//The capsule is convex, so it's enough that every corner is inside
+			bool contains(Collisions::AABB& box) const
+			{
+				glm::vec3 minimum, maximum;
+				box_corners(box, minimum, maximum);
+
+				for (int corner = 0; corner < 8; corner++)
+				{
+					if (segment_distance_squared(box_corner(minimum, maximum, corner), start, end) > radius * radius)
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+		};
+
+
+		//A box turned by the three perpendicular unit axes, half_extents[i] along the axes[i]
+		struct OrientedBox
+		{
+			glm::vec3 center;
+			std::array<glm::vec3, 3> axes;
+			glm::vec3 half_extents;
+
+			//The separating axis test, the boxes are apart if any of the 15 axes separates their projections
+			bool intersects(Collisions::AABB& box) const
+			{
+				glm::vec3 minimum, maximum;
+				box_corners(box, minimum, maximum);
+
+				glm::vec3 box_center = (minimum + maximum) * 0.5f;
+				glm::vec3 box_half = (maximum - minimum) * 0.5f;
+				glm::vec3 offset = center - box_center;
+
+				std::array<glm::vec3, 6> candidates = {
+					glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+					axes[0], axes[1], axes[2]
+				};
+
+				//Both of the projected radii and the distance of the centers along the axis
+				auto separates = [&](const glm::vec3& axis) {
+					float box_reach = glm::dot(box_half, glm::abs(axis));
+					float reach = half_extents.x * std::fabs(glm::dot(axes[0], axis))
+						+ half_extents.y * std::fabs(glm::dot(axes[1], axis))
+						+ half_extents.z * std::fabs(glm::dot(axes[2], axis));
+
+					return std::fabs(glm::dot(offset, axis)) > box_reach + reach;
+				};
+
+				for (const glm::vec3& axis : candidates)
+				{
+					if (separates(axis)) return false;
+				}
+
+				//The cross products of the edges, the nearly parallel ones are left to the axes above, as their rounding could separate touching boxes
+				for (int i = 0; i < 3; i++)
+				{
+					for (int j = 0; j < 3; j++)
+					{
+						glm::vec3 axis = glm::cross(candidates[i], axes[j]);
+
+						if (glm::dot(axis, axis) > 1e-6f && separates(axis)) return false;
+					}
+				}
+
+				return true;
+			}
+
+			//Every corner has to be within the half extents along every axis
+			bool contains(Collisions::AABB& box) const
+			{
+				glm::vec3 minimum, maximum;
+				box_corners(box, minimum, maximum);
+
+				for (int corner = 0; corner < 8; corner++)
+				{
+					glm::vec3 offset = box_corner(minimum, maximum, corner) - center;
+
+					for (int i = 0; i < 3; i++)
+					{
+						if (std::fabs(glm::dot(offset, axes[i])) > half_extents[i]) return false;
+					}
+				}
+
+				return true;
+			}
+		};
+
+	}
+
+}
+#endif
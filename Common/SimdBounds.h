@@ -0,0 +1,176 @@
+//Default Libraries
+#include<array>
+#include<cstddef>
+#include<algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_BOUNDS_X86 1
+#include<immintrin.h>
+#if defined(_MSC_VER)
+#include<intrin.h>
+#endif
+#endif
+
+#ifndef SIMD_BOUNDS_H
+#define SIMD_BOUNDS_H 1
+
+
+/*
+* The overlap test between a box and all of the children of one node. The children
+* aren't stored anywhere, a node only knows its center and half extents, so the box is tested
+* against the planes splitting the node instead. For every axis it's enough to know whether the box
+* reaches the lower and the upper half, which is 6 comparisons done in one SSE pass on x86.
+* The result is a bitmask, bit i set means that the child i overlaps the box. The children are
+* numbered with the x half in bit 0, the z half in bit 1 and the y half in bit 2 (set for the lower one),
+* the 4 QuadTree children are the first 4 of them. A plain scalar version is used everywhere else,
+* and the used path can be switched at runtime.
+*/
+
+
+namespace DataStructures {
+
+
+	namespace Simd {
+
+
+		//The available implementations of the overlap test
+		enum class Dispatch : unsigned char {
+			Automatic,
+			Scalar,
+			SSE
+		};
+
+
+		//The requested implementation, Automatic picks the best one supported by the CPU
+		inline Dispatch& requested_dispatch()
+		{
+			static Dispatch dispatch = Dispatch::Automatic;
+			return dispatch;
+		}
+
+
+		//Checks once, what the processor is able to run. The six comparisons fit into one SSE register,
+		//so a wider instruction set has nothing to add
+		inline Dispatch supported_dispatch()
+		{
+#if defined(SIMD_BOUNDS_X86) && defined(_MSC_VER)
+			static Dispatch supported = [] {
+				int registers[4];
+				__cpuid(registers, 1);
+
+				return (registers[3] & (1 << 25)) ? Dispatch::SSE : Dispatch::Scalar;
+			}();
+			return supported;
+#elif defined(SIMD_BOUNDS_X86)
+			static Dispatch supported = __builtin_cpu_supports("sse") ? Dispatch::SSE : Dispatch::Scalar;
+			return supported;
+#else
+			return Dispatch::Scalar;
+#endif
+		}
+
+
+		//Switches the implementation used by the trees, anything unsupported falls back to the best supported one
+		inline void set_dispatch(Dispatch dispatch)
+		{
+			requested_dispatch() = dispatch;
+		}
+
+
+		//The implementation, that is going to be used
+		inline Dispatch active_dispatch()
+		{
+			Dispatch requested = requested_dispatch();
+			Dispatch supported = supported_dispatch();
+
+			if (requested == Dispatch::Automatic || requested > supported)
+			{
+				return supported;
+			}
+
+			return requested;
+		}
+
+
+		//The reference implementation, works everywhere, bit i of the masks stands for the axis i
+		inline void split_mask_scalar(const glm::vec3& center, const glm::vec3& half, const glm::vec3& minimum, const glm::vec3& maximum, unsigned& lower, unsigned& upper)
+		{
+			lower = 0;
+			upper = 0;
+
+			for (int i = 0; i < 3; ++i)
+			{
+				if (minimum[i] <= center[i] && maximum[i] >= center[i] - half[i]) lower |= 1u << i;
+				if (maximum[i] >= center[i] && minimum[i] <= center[i] + half[i]) upper |= 1u << i;
+			}
+		}
+
+
+#if defined(SIMD_BOUNDS_X86)
+
+		//Every axis at once, the fourth lane is ignored
+		inline void split_mask_sse(const glm::vec3& center, const glm::vec3& half, const glm::vec3& minimum, const glm::vec3& maximum, unsigned& lower, unsigned& upper)
+		{
+			__m128 c = _mm_set_ps(0.0f, center.z, center.y, center.x);
+			__m128 h = _mm_set_ps(0.0f, half.z, half.y, half.x);
+			__m128 low = _mm_set_ps(0.0f, minimum.z, minimum.y, minimum.x);
+			__m128 high = _mm_set_ps(0.0f, maximum.z, maximum.y, maximum.x);
+
+			lower = (unsigned)_mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(low, c), _mm_cmpge_ps(high, _mm_sub_ps(c, h)))) & 0x7;
+			upper = (unsigned)_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(high, c), _mm_cmple_ps(low, _mm_add_ps(c, h)))) & 0x7;
+		}
+
+#endif
+
+
+		//Gives which halves of every axis the box reaches, using the currently active implementation
+		inline void split_mask(const glm::vec3& center, const glm::vec3& half, Collisions::AABB& area, unsigned& lower, unsigned& upper)
+		{
+			std::array<glm::vec3, 2> region = area.bounding_region();
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+#if defined(SIMD_BOUNDS_X86)
+			if (active_dispatch() != Dispatch::Scalar)
+			{
+				split_mask_sse(center, half, minimum, maximum, lower, upper);
+				return;
+			}
+#endif
+
+			split_mask_scalar(center, half, minimum, maximum, lower, upper);
+		}
+
+
+		//Tests the box against every octant of the node
+		inline unsigned overlap_mask_octants(const glm::vec3& center, const glm::vec3& half, Collisions::AABB& area)
+		{
+			unsigned lower, upper;
+			split_mask(center, half, area, lower, upper);
+
+			//Every axis selects the children lying in the reached halves
+			unsigned x = ((lower & 0x1) ? 0x55u : 0u) | ((upper & 0x1) ? 0xAAu : 0u);
+			unsigned y = ((upper & 0x2) ? 0x0Fu : 0u) | ((lower & 0x2) ? 0xF0u : 0u);
+			unsigned z = ((lower & 0x4) ? 0x33u : 0u) | ((upper & 0x4) ? 0xCCu : 0u);
+
+			return x & y & z;
+		}
+
+
+		//Tests the box against every QuadTree child, the children keep the whole height of the node
+		inline unsigned overlap_mask_quadrants(const glm::vec3& center, const glm::vec3& half, Collisions::AABB& area)
+		{
+			unsigned lower, upper;
+			split_mask(center, half, area, lower, upper);
+
+			unsigned x = ((lower & 0x1) ? 0x5u : 0u) | ((upper & 0x1) ? 0xAu : 0u);
+			unsigned z = ((lower & 0x4) ? 0x3u : 0u) | ((upper & 0x4) ? 0xCu : 0u);
+
+			//The box has to reach the height of the node as well
+			return ((lower | upper) & 0x2) ? x & z : 0u;
+		}
+
+	}
+
+}
+#endif
@@ -0,0 +1,670 @@
+//Default Libraries
+#include<array>
+#include<vector>
+#include<string>
+#include<fstream>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<type_traits>
+
+#if defined(_WIN32)
+#include<iterator>
+#else
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#endif
+
+//Dependencies
+#include "SimdBounds.h"
+#include "TraversalStack.h"
+#include "Torus.h"
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H 1
+
+//Macros
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_ALIGNMENT 16
+
+
+/*
+* The binary image of a whole tree, written by save() and read by load() of the trees.
+* The file is flat and holds no pointers: the header, the half extents of every depth,
+* the nodes in the breadth first order, and the records of all of the items, grouped by their nodes.
+* A node points at its children and at its records by their indices, so the file can be mapped
+* and searched in place, only the pages of the visited nodes and of the reported records are read.
+* The records are written byte by byte, so they have to be trivially copyable, and the file is meant
+* to be read on the same kind of machine that wrote it, the header tells the sizes apart.
+*/
+
+
+namespace DataStructures {
+
+	namespace Snapshot {
+
+		//The start of every file, the offsets are counted in bytes from the start of the file
+		struct Header
+		{
+			char magic[8];
+			uint32_t version;
+			uint32_t children;
+			uint32_t record_size;
+			uint32_t levels;
+			uint64_t nodes;
+			uint64_t records;
+			uint64_t extents_offset;
+			uint64_t nodes_offset;
+			uint64_t records_offset;
+
+			//The settings of the tree
+			uint64_t subdivision_depth;
+			uint64_t leaf_node_side;
+			uint64_t minimum_dimensions;
+			uint64_t max_depth;
+			uint32_t lazy_subdivision;
+			uint32_t multi_thread;
+
+			//The cells of the deepest level that the world of the tree has moved by, the nodes keep their centers
+			int64_t moved[3];
+		};
+
+		//A single node, N is the number of the children of a node in the tree
+		template<size_t N>
+		struct Node
+		{
+			float center[3];
+			uint16_t depth;
+			uint8_t active;
+			uint8_t leaf;
+
+			//Valid only for the active children, a child always comes after its parent
+			uint32_t children[N];
+
+			//The records of the node are the count ones starting from the first
+			uint64_t first;
+			uint64_t count;
+		};
+
+		//The record of the containers, the item together with its box
+		template<typename T>
+		struct Item
+		{
+			T item;
+			float minimum[3];
+			float maximum[3];
+		};
+
+		//Tells the snapshots apart from any other file
+		inline const char* magic()
+		{
+			return "SPTREE\0";
+		}
+
+		//The sections start at the aligned offsets, so that they can be read in place
+		inline uint64_t aligned(uint64_t offset)
+		{
+			return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+		}
+
+
+		/*
+		* The file mapped into the memory for reading, unmapped on the destruction.
+		* Where there's no mmap the file is read into the memory as a whole.
+		*/
+		class MappedFile
+		{
+		protected:
+
+			const char* m_Data = nullptr;
+			size_t m_Size = 0;
+
+#if defined(_WIN32)
+			std::vector<char> m_Buffer;
+#endif
+
+		public:
+
+			MappedFile() {}
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+			~MappedFile() { close(); }
+
+			bool open(const std::string& path);
+			void close();
+
+			const char* data() { return m_Data; }
+			size_t size() { return m_Size; }
+		};
+
+
+		/*
+		* The tree searched straight in the mapped file, nothing but the header is read on the opening.
+		* The searches give the same records as the search of the saved tree would give its items.
+		* Every node is checked the first time a search reaches it, a child outside of the file, or not one level below its parent,
+		* stops the search, so nothing past the map is read without walking the whole file first.
+		*/
+		template<typename R, size_t N>
+		class View
+		{
+			//The node at the index, or nullptr if the index or the node itself doesn't fit the file
+			const Node<N>* node(uint64_t index);
+
+		protected:
+
+			MappedFile m_File;
+
+			const Header* m_Header = nullptr;
+			const float* m_Extents = nullptr;
+			const Node<N>* m_Nodes = nullptr;
+			const R* m_Records = nullptr;
+
+			//The world around the saved centers of the nodes
+			Torus m_Torus;
+
+		public:
+
+			/*
+			* Initialisation
+			*/
+
+			//Maps the file and checks its header, returns false if it isn't a snapshot of this kind of tree
+			bool open(const std::string& path);
+			void close();
+
+			//Walks the whole file once, checking every node, for the callers wanting to know up front that the whole file is sound.
+			//The searches don't need it, they check the nodes they reach
+			bool validate();
+
+			/*
+			* Capacity
+			*/
+
+			bool is_open();
+			size_t size();
+			size_t nodes();
+
+			/*
+			* Element access
+			*/
+
+			const Header& header();
+			glm::vec3 half_extents(size_t depth);
+			const Node<N>& at(size_t index);
+			const R& record(size_t index);
+			Collisions::AABB aabb();
+
+			//Calls on_hit(record) for every found record, the search stops as soon as it returns false.
+			//Returns false if it was stopped, by on_hit or by a damaged node
+			template<typename F>
+			bool query(Collisions::AABB& area, F&& on_hit);
+			void query(Collisions::AABB& area, std::vector<R>& records);
+		};
+
+
+		/*
+		* Writes the whole file, the header gets everything but the settings of the tree filled in.
+		* The nodes are given in the breadth first order, write_records(file) writes the records of all of them in the same order
+		*/
+		template<typename R, size_t N, typename F>
+		bool write(const std::string& path, Header& header, const std::vector<glm::vec3>& extents, const std::vector<Node<N>>& nodes, F&& write_records);
+
+
+		/*
+		* ///////////////////////
+		* /		Definitions     /
+		* ///////////////////////
+		*/
+
+
+		inline bool MappedFile::open(const std::string& path)
+		{
+			close();
+
+#if defined(_WIN32)
+			std::ifstream file(path, std::ios::binary);
+
+			if (!file.is_open())
+			{
+				return false;
+			}
+
+			m_Buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			m_Data = m_Buffer.data();
+			m_Size = m_Buffer.size();
+
+			return true;
+#else
+			int descriptor = ::open(path.c_str(), O_RDONLY);
+
+			if (descriptor < 0)
+			{
+				return false;
+			}
+
+			struct stat status;
+
+			if (fstat(descriptor, &status) != 0 || status.st_size <= 0)
+			{
+				::close(descriptor);
+				return false;
+			}
+
+			void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+			//The mapping stays valid after the descriptor is closed
+			::close(descriptor);
+
+			if (data == MAP_FAILED)
+			{
+				return false;
+			}
+
+			m_Data = static_cast<const char*>(data);
+			m_Size = (size_t)status.st_size;
+
+			return true;
+#endif
+		}
+
+
+		inline void MappedFile::close()
+		{
+#if defined(_WIN32)
+			m_Buffer.clear();
+			m_Buffer.shrink_to_fit();
+#else
+			if (m_Data)
+			{
+				munmap(const_cast<char*>(m_Data), m_Size);
+			}
+#endif
+
+			m_Data = nullptr;
+			m_Size = 0;
+		}
+
+
+		/*////////////////////
+		* /  Initialisation  /
+		*/////////////////////
+
+
+		template<typename R, size_t N>
+		bool View<R, N>::open(const std::string& path)
+		{
+			static_assert(std::is_trivially_copyable<R>::value, "The records of the snapshot are read in place");
+
+			close();
+
+			if (!m_File.open(path) || m_File.size() < sizeof(Header))
+			{
+				close();
+				return false;
+			}
+
+			const Header* header = reinterpret_cast<const Header*>(m_File.data());
+			uint64_t size = m_File.size();
+
+			//Whether the file is a snapshot of the same version, of the same kind of tree and of the same records
+			bool valid = std::memcmp(header->magic, magic(), sizeof(header->magic)) == 0
+				&& header->version == SNAPSHOT_VERSION
+				&& header->children == N
+				&& header->record_size == sizeof(R)
+				&& header->levels > 0 && header->levels <= (uint64_t)UINT16_MAX + 1
+				&& header->nodes > 0 && header->nodes <= UINT32_MAX;
+
+			//Every section has to lie inside of the file, the sizes are checked against the overflows first
+			valid = valid
+				&& header->extents_offset % SNAPSHOT_ALIGNMENT == 0
+				&& header->nodes_offset % SNAPSHOT_ALIGNMENT == 0
+				&& header->records_offset % SNAPSHOT_ALIGNMENT == 0
+				&& header->extents_offset <= size && header->levels <= (size - header->extents_offset) / (3 * sizeof(float))
+				&& header->nodes_offset <= size && header->nodes <= (size - header->nodes_offset) / sizeof(Node<N>)
+				&& header->records_offset <= size && header->records <= (size - header->records_offset) / sizeof(R);
+
+			if (!valid || alignof(R) > SNAPSHOT_ALIGNMENT)
+			{
+				close();
+				return false;
+			}
+
+			m_Header = header;
+			m_Extents = reinterpret_cast<const float*>(m_File.data() + header->extents_offset);
+			m_Nodes = reinterpret_cast<const Node<N>*>(m_File.data() + header->nodes_offset);
+			m_Records = reinterpret_cast<const R*>(m_File.data() + header->records_offset);
+
+			//The root is the only node that is always read
+			if (!node(0) || m_Nodes[0].depth != 0)
+			{
+				close();
+				return false;
+			}
+
+			//The slots of the world are the box of the root, the cells are the nodes of the deepest level
+			const Node<N>& root = m_Nodes[0];
+			glm::vec3 center(root.center[0], root.center[1], root.center[2]);
+			glm::vec3 half = half_extents(0);
+
+			m_Torus.reset(center - half, center + half, half_extents(header->levels - 1) * 2.0f);
+			m_Torus.set_moved(glm::ivec3((int)header->moved[0], (int)header->moved[1], (int)header->moved[2]));
+
+			return true;
+		}
+
+
+		template<typename R, size_t N>
+		void View<R, N>::close()
+		{
+			m_File.close();
+
+			m_Header = nullptr;
+			m_Extents = nullptr;
+			m_Nodes = nullptr;
+			m_Records = nullptr;
+		}
+
+
+		template<typename R, size_t N>
+		bool View<R, N>::validate()
+		{
+			if (!is_open())
+			{
+				return false;
+			}
+
+			//In the breadth first order the children of every node are the next ones not taken yet
+			uint64_t next = 1;
+
+			for (uint64_t i = 0; i < m_Header->nodes; i++)
+			{
+				const Node<N>* parent = node(i);
+
+				if (!parent)
+				{
+					return false;
+				}
+
+				for (size_t c = 0; c < N; c++)
+				{
+					if (!(parent->active & (1 << c)))
+					{
+						continue;
+					}
+
+					if (parent->children[c] != next || next >= m_Header->nodes || m_Nodes[next].depth != parent->depth + 1)
+					{
+						return false;
+					}
+
+					next++;
+				}
+			}
+
+			return next == m_Header->nodes;
+		}
+
+
+		/*////////////////////
+		* /     Capacity     /
+		*/////////////////////
+
+
+		template<typename R, size_t N>
+		bool View<R, N>::is_open()
+		{
+			return m_Header != nullptr;
+		}
+
+
+		template<typename R, size_t N>
+		size_t View<R, N>::size()
+		{
+			return m_Header ? m_Header->records : 0;
+		}
+
+
+		template<typename R, size_t N>
+		size_t View<R, N>::nodes()
+		{
+			return m_Header ? m_Header->nodes : 0;
+		}
+
+
+		/*////////////////////
+		* / Element Access   /
+		*/////////////////////
+
+
+		template<typename R, size_t N>
+		const Header& View<R, N>::header()
+		{
+			return *m_Header;
+		}
+
+
+		template<typename R, size_t N>
+		glm::vec3 View<R, N>::half_extents(size_t depth)
+		{
+			const float* extent = m_Extents + depth * 3;
+
+			return glm::vec3(extent[0], extent[1], extent[2]);
+		}
+
+
+		template<typename R, size_t N>
+		const Node<N>& View<R, N>::at(size_t index)
+		{
+			return m_Nodes[index];
+		}
+
+
+		template<typename R, size_t N>
+		const R& View<R, N>::record(size_t index)
+		{
+			return m_Records[index];
+		}
+
+
+		template<typename R, size_t N>
+		Collisions::AABB View<R, N>::aabb()
+		{
+			return m_Torus.world();
+		}
+
+
+		//The same rules as in the search of the tree, the items of a node are reported when the node holds the area,
+		//or when it's a leaf reaching into it, and only the children reaching into the area are visited
+		template<typename R, size_t N>
+		template<typename F>
+		bool View<R, N>::query(Collisions::AABB& area, F&& on_hit)
+		{
+			if (!is_open())
+			{
+				return false;
+			}
+
+			//Every child is one level below its parent, so the stack never holds more than the siblings of every level
+			TraversalStack<uint64_t, N> stack(m_Header->levels);
+			stack.push(0);
+
+			while (!stack.empty())
+			{
+				uint64_t index = stack.pop();
+				const Node<N>* current = node(index);
+
+				if (!current)
+				{
+					return false;
+				}
+
+				glm::vec3 center(current->center[0], current->center[1], current->center[2]);
+				glm::vec3 half = half_extents(current->depth);
+
+				//The node goes by its place in the world, the one across the seam by the box around both of its parts
+				glm::vec3 offset;
+				bool whole = m_Torus.offset(center, half, offset);
+
+				if (current->count)
+				{
+					Collisions::AABB position = m_Torus.bounds(center, half);
+
+					if (position.contains(area) || (current->leaf && position.intersects2(area)))
+					{
+						for (uint64_t i = current->first; i < current->first + current->count; i++)
+						{
+							if (!on_hit(m_Records[i])) return false;
+						}
+					}
+				}
+
+				unsigned descend = current->active;
+
+				if (descend && whole)
+				{
+					center += offset;
+					descend &= N == 8 ? Simd::overlap_mask_octants(center, half, area) : Simd::overlap_mask_quadrants(center, half, area);
+				}
+				else if (descend)
+				{
+					//The children of the node across the seam lie apart in the world, each of them is tested by itself
+					for (size_t c = 0; c < N; c++)
+					{
+						const Node<N>* child = (descend & (1 << c)) ? node(current->children[c]) : nullptr;
+
+						//A damaged child is left in, the checks below end the search on it
+						if (child && !m_Torus.bounds(glm::vec3(child->center[0], child->center[1], child->center[2]), half_extents(child->depth)).intersects2(area))
+						{
+							descend &= ~(1u << c);
+						}
+					}
+				}
+
+				//Pushed backwards, so that the children are visited in their order, a child has to come after its parent
+				for (int c = (int)N - 1; c >= 0; c--)
+				{
+					if (!(descend & (1 << c)))
+					{
+						continue;
+					}
+
+					const Node<N>* child = current->children[c] > index ? node(current->children[c]) : nullptr;
+
+					//The damaged part of the file ends the search, the depth check keeps the pushes inside of the stack
+					if (!child || child->depth != current->depth + 1)
+					{
+						return false;
+					}
+
+					stack.push(current->children[c]);
+				}
+			}
+
+			return true;
+		}
+
+
+		template<typename R, size_t N>
+		void View<R, N>::query(Collisions::AABB& area, std::vector<R>& records)
+		{
+			auto push = [&records](const R& record) { records.push_back(record); return true; };
+
+			query(area, push);
+		}
+
+
+		/*////////////////////
+		* /      Writing     /
+		*/////////////////////
+
+
+		template<typename R, size_t N, typename F>
+		bool write(const std::string& path, Header& header, const std::vector<glm::vec3>& extents, const std::vector<Node<N>>& nodes, F&& write_records)
+		{
+			static_assert(std::is_trivially_copyable<R>::value, "The records of the snapshot are written byte by byte");
+
+			std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+			if (!file.is_open() || nodes.empty())
+			{
+				return false;
+			}
+
+			std::memcpy(header.magic, magic(), sizeof(header.magic));
+			header.version = SNAPSHOT_VERSION;
+			header.children = N;
+			header.record_size = sizeof(R);
+			header.levels = (uint32_t)extents.size();
+			header.nodes = nodes.size();
+			header.records = 0;
+
+			for (const Node<N>& node : nodes)
+			{
+				header.records += node.count;
+			}
+
+			//Every section starts at the next aligned offset
+			header.extents_offset = aligned(sizeof(Header));
+			header.nodes_offset = aligned(header.extents_offset + extents.size() * 3 * sizeof(float));
+			header.records_offset = aligned(header.nodes_offset + nodes.size() * sizeof(Node<N>));
+
+			const char padding[SNAPSHOT_ALIGNMENT] = {};
+
+			auto pad = [&file, &padding](uint64_t offset) {
+				file.write(padding, offset - (uint64_t)file.tellp());
+			};
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+
+			pad(header.extents_offset);
+
+			for (const glm::vec3& extent : extents)
+			{
+				float values[3] = { extent.x, extent.y, extent.z };
+				file.write(reinterpret_cast<const char*>(values), sizeof(values));
+			}
+
+			pad(header.nodes_offset);
+			file.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(Node<N>));
+
+			pad(header.records_offset);
+			write_records(file);
+
+			file.flush();
+
+			return file.good() && (uint64_t)file.tellp() == header.records_offset + header.records * sizeof(R);
+		}
+
+
+		/*
+		* //////////////////////////////
+		* /  Private member functions  /
+		* //////////////////////////////
+		*/
+
+
+		template<typename R, size_t N>
+		const Node<N>* View<R, N>::node(uint64_t index)
+		{
+			if (index >= m_Header->nodes)
+			{
+				return nullptr;
+			}
+
+			const Node<N>* current = m_Nodes + index;
+
+			//The depth has its extents, and the records lie inside of the file
+			if (current->depth >= m_Header->levels || current->first > m_Header->records || current->count > m_Header->records - current->first)
+			{
+				return nullptr;
+			}
+
+			return current;
+		}
+
+	}
+
+}
+#endif
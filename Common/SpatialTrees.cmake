@@ -0,0 +1,43 @@
+#Shared by the CMake lists of both trees, the first one to include it defines everything
+include_guard(GLOBAL)
+
+#The trees themselves are header only, the tests and the benchmarks are built on request
+option(SPATIAL_TREES_BUILD_TESTS "Builds the behavioural tests of the trees" OFF)
+option(SPATIAL_TREES_BUILD_BENCHMARKS "Builds the benchmarks of the trees" OFF)
+
+#The headers don't include glm, Collisions::AABB and Coordinates::Directions on their own, the host project does.
+#For the tests and the benchmarks it gives one header including all of them, and the directories that header needs
+set(SPATIAL_TREES_DEPENDENCIES "" CACHE FILEPATH "Header including glm, Collisions::AABB and Coordinates::Directions")
+set(SPATIAL_TREES_INCLUDE_DIRS "" CACHE STRING "Include directories needed by the SPATIAL_TREES_DEPENDENCIES header")
+
+if((SPATIAL_TREES_BUILD_TESTS OR SPATIAL_TREES_BUILD_BENCHMARKS) AND NOT SPATIAL_TREES_DEPENDENCIES)
+	message(FATAL_ERROR "SPATIAL_TREES_DEPENDENCIES has to name the header with the dependencies of the trees")
+endif()
+
+#One executable, the sources reach the dependencies through #include SPATIAL_TREES_DEPENDENCIES
+#The imported targets are seen only in the directory that found them, so every directory looks for the threads on its own
+function(spatial_trees_executable NAME SOURCE)
+	find_package(Threads REQUIRED)
+	add_executable(${NAME} "${SOURCE}")
+	target_compile_features(${NAME} PRIVATE cxx_std_17)
+	target_compile_definitions(${NAME} PRIVATE SPATIAL_TREES_DEPENDENCIES="${SPATIAL_TREES_DEPENDENCIES}")
+	target_include_directories(${NAME} PRIVATE ${SPATIAL_TREES_INCLUDE_DIRS})
+	target_link_libraries(${NAME} PRIVATE Threads::Threads)
+endfunction()
+
+#A test is an executable returning the number of its failed checks, run by CTest in its own build directory
+function(spatial_trees_test NAME SOURCE)
+	spatial_trees_executable(${NAME} "${SOURCE}")
+	add_test(NAME ${NAME} COMMAND ${NAME} WORKING_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}")
+endfunction()
+
+#A benchmark is an executable printing its measurements, built with the optimisations whatever the build type is
+function(spatial_trees_benchmark NAME SOURCE)
+	spatial_trees_executable(${NAME} "${SOURCE}")
+	target_compile_options(${NAME} PRIVATE $<$<NOT:$<CXX_COMPILER_ID:MSVC>>:-O2> $<$<CXX_COMPILER_ID:MSVC>:/O2>)
+endfunction()
+
+#The tests of the headers shared by both trees
+if(SPATIAL_TREES_BUILD_TESTS)
+	spatial_trees_test(CommonTests "${CMAKE_SOURCE_DIR}/Common/tests/CommonTests.cpp")
+endif()
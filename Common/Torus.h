@@ -0,0 +1,306 @@
+//Default Libraries
+#include<cmath>
+#include<array>
+#include<algorithm>
+
+#ifndef TORUS_H
+#define TORUS_H 1
+
+
+/*
+* The place of the nodes in the world, once the tree has been shifted. The nodes never move,
+* they keep the slots of the box that the tree was built in, and the world wraps around those slots:
+* the seam is the slot where the world starts, the slots from the seam on hold the first part of the world,
+* and the slots before it hold the rest, one lap further. A shift only moves the seam, so the cells
+* leaving the world on one side come back on the other side as the cells entering it.
+* A node lying across the seam has two separate places in the world, it's given the box around both of them,
+* the whole length of the world along that axis, which is never too small for a search.
+*/
+
+
+namespace DataStructures {
+
+
+	class Torus
+	{
+	protected:
+
+		//The box of the slots, and the cells of the deepest level that the seam moves by
+		glm::vec3 m_Start = glm::vec3(0.0f);
+		glm::vec3 m_Side = glm::vec3(0.0f);
+		glm::vec3 m_Cell = glm::vec3(0.0f);
+		glm::ivec3 m_Grid = glm::ivec3(1);
+
+		//How many cells the world went since the tree was built, nothing is wrapped until it moves
+		glm::ivec3 m_Moved = glm::ivec3(0);
+
+		//Both follow from the above: the slot of the seam, and how far the slots from the seam on lie from their places in the world
+		glm::vec3 m_Seam = glm::vec3(0.0f);
+		glm::vec3 m_Lap = glm::vec3(0.0f);
+
+	public:
+
+		/*
+		* Initialisation
+		*/
+
+		//The slots are the box between the corners, the world starts right there
+		void reset(const glm::vec3& minimum, const glm::vec3& maximum, const glm::vec3& cell);
+
+		/*
+		* Movement
+		*/
+
+		//Moves the world by the cells, or puts it where a saved tree had it
+		void move(const glm::ivec3& cells);
+		void set_moved(const glm::ivec3& cells);
+
+		//Whether the world has moved at all, the slots are the world itself until then
+		bool moved() const;
+		glm::ivec3 cells() const;
+
+		//The cells of the deepest level along every axis
+		glm::ivec3 grid() const;
+		glm::vec3 cell() const;
+
+		/*
+		* Mapping
+		*/
+
+		//The box of the world, the slots of the whole tree
+		Collisions::AABB world() const;
+
+		//The offset from the slots of the node to its place in the world, returns false if the node lies across the seam
+		bool offset(const glm::vec3& center, const glm::vec3& half, glm::vec3& offset) const;
+
+		//The box of the node in the world, across the seam it spans the whole world along that axis
+		Collisions::AABB bounds(const glm::vec3& center, const glm::vec3& half) const;
+
+		//The slots of the area, returns false if it isn't inside of the world, or it lies across the wrap,
+		//with its parts at the both ends of the slots
+		bool slots(Collisions::AABB& area, glm::vec3& minimum, glm::vec3& maximum) const;
+
+		//Whether the area is inside of the world, but lies across the wrap, so only the box of all of the slots holds it
+		bool across(Collisions::AABB& area) const;
+	};
+
+
+	/*
+	* ///////////////////////
+	* /		Definitions     /
+	* ///////////////////////
+	*/
+
+
+	inline void Torus::reset(const glm::vec3& minimum, const glm::vec3& maximum, const glm::vec3& cell)
+	{
+		m_Start = minimum;
+		m_Side = maximum - minimum;
+		m_Cell = cell;
+
+		for (int i = 0; i < 3; i++)
+		{
+			m_Grid[i] = m_Cell[i] > 0.0f ? std::max(1, (int)std::round(m_Side[i] / m_Cell[i])) : 1;
+		}
+
+		set_moved(glm::ivec3(0));
+	}
+
+
+	inline void Torus::move(const glm::ivec3& cells)
+	{
+		set_moved(m_Moved + cells);
+	}
+
+
+	inline void Torus::set_moved(const glm::ivec3& cells)
+	{
+		m_Moved = cells;
+
+		//The seam is where the moved cells end up on the grid, every full grid adds one lap
+		for (int i = 0; i < 3; i++)
+		{
+			int seam = ((m_Moved[i] % m_Grid[i]) + m_Grid[i]) % m_Grid[i];
+			int laps = (m_Moved[i] - seam) / m_Grid[i];
+
+			m_Seam[i] = m_Start[i] + (float)seam * m_Cell[i];
+			m_Lap[i] = (float)laps * m_Side[i];
+		}
+	}
+
+
+	inline bool Torus::moved() const
+	{
+		return m_Moved.x != 0 || m_Moved.y != 0 || m_Moved.z != 0;
+	}
+
+
+	inline glm::ivec3 Torus::cells() const
+	{
+		return m_Moved;
+	}
+
+
+	inline glm::ivec3 Torus::grid() const
+	{
+		return m_Grid;
+	}
+
+
+	inline glm::vec3 Torus::cell() const
+	{
+		return m_Cell;
+	}
+
+
+	inline Collisions::AABB Torus::world() const
+	{
+		glm::vec3 minimum = m_Seam + m_Lap;
+
+		return Collisions::AABB(minimum, minimum + m_Side);
+	}
+
+
+	inline bool Torus::offset(const glm::vec3& center, const glm::vec3& half, glm::vec3& offset) const
+	{
+		offset = glm::vec3(0.0f);
+
+		if (!moved())
+		{
+			return true;
+		}
+
+		//The bounds of the nodes and the seam lie on the grid of the cells, half of a cell keeps the rounding away
+		for (int i = 0; i < 3; i++)
+		{
+			float tolerance = m_Cell[i] * 0.5f;
+
+			if (center[i] - half[i] >= m_Seam[i] - tolerance)
+			{
+				offset[i] = m_Lap[i];
+			}
+			else if (center[i] + half[i] <= m_Seam[i] + tolerance)
+			{
+				offset[i] = m_Lap[i] + m_Side[i];
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+	inline Collisions::AABB Torus::bounds(const glm::vec3& center, const glm::vec3& half) const
+	{
+		glm::vec3 minimum = center - half;
+		glm::vec3 maximum = center + half;
+
+		if (!moved())
+		{
+			return Collisions::AABB(minimum, maximum);
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			float tolerance = m_Cell[i] * 0.5f;
+			float shift;
+
+			if (minimum[i] >= m_Seam[i] - tolerance)
+			{
+				shift = m_Lap[i];
+			}
+			else if (maximum[i] <= m_Seam[i] + tolerance)
+			{
+				shift = m_Lap[i] + m_Side[i];
+			}
+			else
+			{
+				minimum[i] = m_Seam[i] + m_Lap[i];
+				maximum[i] = minimum[i] + m_Side[i];
+				continue;
+			}
+
+			minimum[i] += shift;
+			maximum[i] += shift;
+		}
+
+		return Collisions::AABB(minimum, maximum);
+	}
+
+
+	inline bool Torus::slots(Collisions::AABB& area, glm::vec3& minimum, glm::vec3& maximum) const
+	{
+		std::array<glm::vec3, 2> region = area.bounding_region();
+		minimum = glm::min(region[0], region[1]);
+		maximum = glm::max(region[0], region[1]);
+
+		if (!moved())
+		{
+			return true;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			float first = m_Seam[i] + m_Lap[i];
+
+			if (minimum[i] < first || maximum[i] > first + m_Side[i])
+			{
+				return false;
+			}
+
+			//The world wraps where the slots start again, one lap further
+			float wrap = m_Start[i] + m_Side[i] + m_Lap[i];
+
+			if (maximum[i] <= wrap)
+			{
+				minimum[i] -= m_Lap[i];
+				maximum[i] -= m_Lap[i];
+			}
+			else if (minimum[i] >= wrap)
+			{
+				minimum[i] -= m_Lap[i] + m_Side[i];
+				maximum[i] -= m_Lap[i] + m_Side[i];
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+	inline bool Torus::across(Collisions::AABB& area) const
+	{
+		if (!moved())
+		{
+			return false;
+		}
+
+		std::array<glm::vec3, 2> region = area.bounding_region();
+		glm::vec3 minimum = glm::min(region[0], region[1]);
+		glm::vec3 maximum = glm::max(region[0], region[1]);
+		bool crossing = false;
+
+		for (int i = 0; i < 3; i++)
+		{
+			float first = m_Seam[i] + m_Lap[i];
+			float wrap = m_Start[i] + m_Side[i] + m_Lap[i];
+
+			if (minimum[i] < first || maximum[i] > first + m_Side[i])
+			{
+				return false;
+			}
+
+			crossing = crossing || (minimum[i] < wrap && maximum[i] > wrap);
+		}
+
+		return crossing;
+	}
+
+}
+#endif
@@ -0,0 +1,123 @@
+//Default Libraries
+#include<array>
+#include<memory>
+#include<cstddef>
+
+#ifndef TRAVERSAL_STACK_H
+#define TRAVERSAL_STACK_H 1
+
+//Macros
+#define TRAVERSAL_STACK_INLINE_LEVELS 12
+
+
+/*
+* The explicit stack used by the iterative traversals of the trees. A depth first walk
+* never keeps more than the remaining siblings of every node on its path, so the needed size
+* is known up front from the number of levels. For the usual depths the stack lives right inside
+* of the caller's frame, only deeper trees get a single heap allocation, made once per traversal.
+*/
+
+
+namespace DataStructures {
+
+
+	template<typename Element, size_t Children>
+	class TraversalStack
+	{
+
+		//The inline capacity
+		static constexpr size_t INLINE_CAPACITY = (Children - 1) * TRAVERSAL_STACK_INLINE_LEVELS + 1;
+
+	protected:
+
+		//The storage for the shallower trees
+		std::array<Element, INLINE_CAPACITY> m_Inline;
+
+		//The storage for the deeper ones
+		std::unique_ptr<Element[]> m_Heap;
+
+		//Whichever of the above is in use
+		Element* m_Elements;
+
+		size_t m_Size = 0;
+
+	public:
+
+		/*
+		* Initialisation
+		*/
+
+		TraversalStack(size_t Levels);
+		TraversalStack(const TraversalStack&) = delete;
+		TraversalStack& operator=(const TraversalStack&) = delete;
+
+		/*
+		* Capacity
+		*/
+
+		size_t size();
+		bool empty();
+
+		/*
+		* Modifiers
+		*/
+
+		void push(Element element);
+		Element pop();
+	};
+
+
+	/*
+	* ///////////////////////
+	* /		Definitions     /
+	* ///////////////////////
+	*/
+
+
+	template<typename Element, size_t Children>
+	TraversalStack<Element, Children>::TraversalStack(size_t Levels)
+	{
+		//Every level can leave all but one of its children waiting, the last one is the one being visited
+		size_t capacity = (Children - 1) * Levels + 1;
+
+		if (capacity <= INLINE_CAPACITY)
+		{
+			m_Elements = m_Inline.data();
+		}
+		else
+		{
+			m_Heap = std::make_unique<Element[]>(capacity);
+			m_Elements = m_Heap.get();
+		}
+	}
+
+
+	template<typename Element, size_t Children> inline
+		size_t TraversalStack<Element, Children>::size()
+	{
+		return m_Size;
+	}
+
+
+	template<typename Element, size_t Children> inline
+		bool TraversalStack<Element, Children>::empty()
+	{
+		return m_Size == 0;
+	}
+
+
+	template<typename Element, size_t Children> inline
+		void TraversalStack<Element, Children>::push(Element element)
+	{
+		m_Elements[m_Size++] = element;
+	}
+
+
+	template<typename Element, size_t Children> inline
+		Element TraversalStack<Element, Children>::pop()
+	{
+		return m_Elements[--m_Size];
+	}
+
+}
+#endif
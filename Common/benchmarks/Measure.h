@@ -0,0 +1,97 @@
+//Default Libraries
+#include<chrono>
+#include<cstdio>
+#include<random>
+
+#if defined(__linux__)
+#include<unistd.h>
+#include<sys/wait.h>
+#endif
+
+#ifndef MEASURE_H
+#define MEASURE_H 1
+
+
+/*
+* The timing shared by the benchmarks of both trees. A benchmark is a plain executable printing one line
+* per measurement, nothing is checked, the numbers are meant to be compared between the rows of a table.
+*/
+
+
+namespace Benchmarks {
+
+
+	//The time the work took in milliseconds
+	template<typename F>
+	double milliseconds(F&& work)
+	{
+		auto start = std::chrono::steady_clock::now();
+		work();
+
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+
+	//The same random numbers on every run, so the rows of a table measure the same items
+	inline float uniform(float minimum, float maximum)
+	{
+		static std::mt19937 generator(12345);
+		return std::uniform_real_distribution<float>(minimum, maximum)(generator);
+	}
+
+
+	//The memory the process holds right now, in kilobytes, zero where it can't be read
+	inline long resident_kilobytes()
+	{
+#if defined(__linux__)
+		long pages = 0, resident = 0;
+		std::FILE* file = std::fopen("/proc/self/statm", "r");
+
+		if (!file)
+		{
+			return 0;
+		}
+
+		if (std::fscanf(file, "%ld %ld", &pages, &resident) != 2)
+		{
+			resident = 0;
+		}
+
+		std::fclose(file);
+
+		return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+		return 0;
+#endif
+	}
+
+
+	//Runs the work in a process of its own where it can, so that the memory of a row isn't the memory
+	//that the rows before it have freed, and the allocator kept
+	template<typename F>
+	void isolated(F&& work)
+	{
+#if defined(__linux__)
+		std::fflush(stdout);
+		pid_t child = fork();
+
+		if (child == 0)
+		{
+			work();
+			std::fflush(stdout);
+			_exit(0);
+		}
+
+		if (child > 0)
+		{
+			int status = 0;
+			waitpid(child, &status, 0);
+			return;
+		}
+#endif
+		work();
+	}
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+//Default Libraries
+#include<cstdio>
+#include<random>
+
+#ifndef CHECK_H
+#define CHECK_H 1
+
+
+/*
+* The smallest possible test harness, shared by the tests of both trees. A failed check
+* prints its place and the condition, and main returns the number of the failed checks,
+* so CTest sees any of them as a failure of the whole executable.
+*/
+
+
+namespace Tests {
+
+
+	//The number of the failed checks so far
+	inline int& failures()
+	{
+		static int failed = 0;
+		return failed;
+	}
+
+
+	//The same random numbers on every run, so a failure can be reproduced
+	inline std::mt19937& random()
+	{
+		static std::mt19937 generator(12345);
+		return generator;
+	}
+
+
+	inline float uniform(float minimum, float maximum)
+	{
+		return std::uniform_real_distribution<float>(minimum, maximum)(random());
+	}
+
+}
+
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			Tests::failures()++; \
+		} \
+	} while (0)
+
+#endif
@@ -0,0 +1,283 @@
+//Dependencies
+#include SPATIAL_TREES_DEPENDENCIES
+#include "Check.h"
+#include "../NodePool.h"
+#include "../NodeItems.h"
+#include "../TraversalStack.h"
+#include "../SimdBounds.h"
+#include "../Parallel.h"
+#include "../Raycast.h"
+#include "../Shapes.h"
+
+//Default Libraries
+#include<set>
+#include<vector>
+#include<atomic>
+
+
+/*
+* The headers shared by both trees, each one checked against a plain reference.
+*/
+
+
+using namespace DataStructures;
+
+
+namespace {
+
+	//Counts the living nodes, to see the pool constructing and destructing them
+	struct Counted
+	{
+		static int& alive() { static int count = 0; return count; }
+
+		int value;
+
+		Counted(int Value) : value(Value) { alive()++; }
+		~Counted() { alive()--; }
+	};
+
+
+	Collisions::AABB random_box(float world, float largest)
+	{
+		glm::vec3 minimum(Tests::uniform(0.0f, world), Tests::uniform(0.0f, world), Tests::uniform(0.0f, world));
+		glm::vec3 size(Tests::uniform(0.0f, largest), Tests::uniform(0.0f, largest), Tests::uniform(0.0f, largest));
+
+		return Collisions::AABB(minimum, minimum + size);
+	}
+
+
+	void node_pool()
+	{
+		{
+			NodePool<Counted> pool;
+			std::vector<uint32_t> indices;
+
+			for (int i = 0; i < 2000; ++i)
+			{
+				indices.push_back(pool.create(i));
+			}
+
+			CHECK(pool.size() == 2000);
+			CHECK(Counted::alive() == 2000);
+			CHECK(pool.at(indices[1500])->value == 1500);
+
+			//The released slots are taken again before any new one
+			pool.destroy(indices[10]);
+			pool.destroy(indices[10]);
+			CHECK(pool.size() == 1999);
+			CHECK(pool.create(-1) == indices[10]);
+
+			//The blocks survive the reset
+			size_t capacity = pool.capacity();
+			pool.reset();
+			CHECK(pool.size() == 0);
+			CHECK(Counted::alive() == 0);
+			CHECK(pool.capacity() == capacity);
+
+			//A reserved range counts only the constructed nodes, the rest goes to the free list
+			uint32_t first = pool.reserve_range(8);
+			pool.create_at(first + 1, 1);
+			pool.create_at(first + 5, 5);
+			pool.close_range(first, 8);
+			CHECK(pool.size() == 2);
+			CHECK(pool.at(first + 5)->value == 5);
+
+			std::set<uint32_t> reused;
+
+			for (int i = 0; i < 6; ++i)
+			{
+				reused.insert(pool.create(i));
+			}
+
+			CHECK(reused.size() == 6 && *reused.begin() == first && *reused.rbegin() == first + 7);
+		}
+
+		//The pool destructs whatever is left
+		CHECK(Counted::alive() == 0);
+	}
+
+
+	void node_items()
+	{
+		NodeItems<int> items;
+		std::vector<size_t> slots;
+
+		for (int i = 0; i < 10; ++i)
+		{
+			slots.push_back(items.insert(i));
+		}
+
+		CHECK(items.size() == 10);
+
+		//The slots don't move, the freed ones are reused
+		CHECK(items.erase(slots[3]));
+		CHECK(!items.erase(slots[3]));
+		CHECK(items.at(slots[7]) == 7);
+		CHECK(items.insert(42) == slots[3]);
+
+		int sum = 0;
+
+		for (int item : items)
+		{
+			sum += item;
+		}
+
+		CHECK(sum == 45 - 3 + 42);
+
+		items.clear();
+		CHECK(items.empty() && items.begin() == items.end());
+	}
+
+
+	void traversal_stack()
+	{
+		//Inline for the shallow trees, on the heap for the deep ones, the same either way
+		for (size_t levels : { size_t(3), size_t(40) })
+		{
+			TraversalStack<size_t, 8> stack(levels);
+			size_t capacity = 7 * levels + 1;
+
+			for (size_t i = 0; i < capacity; ++i)
+			{
+				stack.push(i);
+			}
+
+			CHECK(stack.size() == capacity);
+
+			bool ordered = true;
+
+			for (size_t i = capacity; i-- > 0;)
+			{
+				ordered = ordered && stack.pop() == i;
+			}
+
+			CHECK(ordered && stack.empty());
+		}
+	}
+
+
+	//Whether the box reaches the octant, straight from the octant box
+	bool reaches_octant(const glm::vec3& center, const glm::vec3& half, Collisions::AABB& area, unsigned octant)
+	{
+		glm::vec3 minimum = center - half;
+		glm::vec3 maximum = center + half;
+
+		if (octant & 0x1) minimum.x = center.x; else maximum.x = center.x;
+		if (octant & 0x2) minimum.z = center.z; else maximum.z = center.z;
+		if (octant & 0x4) maximum.y = center.y; else minimum.y = center.y;
+
+		return Collisions::AABB(minimum, maximum).intersects2(area);
+	}
+
+
+	void overlap_masks()
+	{
+		glm::vec3 center(8.0f, 8.0f, 8.0f);
+		glm::vec3 half(8.0f, 8.0f, 8.0f);
+
+		for (Simd::Dispatch dispatch : { Simd::Dispatch::Scalar, Simd::Dispatch::SSE, Simd::Dispatch::Automatic })
+		{
+			Simd::set_dispatch(dispatch);
+
+			bool octants = true;
+			bool quadrants = true;
+
+			for (int i = 0; i < 5000; ++i)
+			{
+				Collisions::AABB area = random_box(20.0f, 6.0f);
+				unsigned expected = 0;
+
+				for (unsigned octant = 0; octant < 8; ++octant)
+				{
+					if (reaches_octant(center, half, area, octant)) expected |= 1u << octant;
+				}
+
+				octants = octants && Simd::overlap_mask_octants(center, half, area) == expected;
+
+				//The QuadTree children keep the whole height, so they are the unions of the octant pairs
+				unsigned quadrant_mask = ((expected | (expected >> 4)) & 0xF);
+				quadrants = quadrants && Simd::overlap_mask_quadrants(center, half, area) == quadrant_mask;
+			}
+
+			CHECK(octants);
+			CHECK(quadrants);
+		}
+
+		Simd::set_dispatch(Simd::Dispatch::Automatic);
+	}
+
+
+	void parallel()
+	{
+		size_t workers = Parallel::worker_count();
+
+		std::vector<std::atomic<int>> visits(10000);
+
+		Parallel::run_ranges(visits.size(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) visits[i]++;
+		});
+
+		bool once = true;
+
+		for (std::atomic<int>& visit : visits)
+		{
+			once = once && visit == 1;
+		}
+
+		CHECK(once);
+		CHECK(workers >= 1);
+	}
+
+
+	void ray_and_shapes()
+	{
+		glm::vec3 minimum(2.0f, 2.0f, 2.0f);
+		glm::vec3 maximum(4.0f, 4.0f, 4.0f);
+
+		//The range of the ray is narrowed down in place
+		float enter = 0.0f, exit = 100.0f;
+
+		CHECK(Raycast::clip_box(glm::vec3(0.0f, 3.0f, 3.0f), glm::vec3(1.0f, 0.0f, 0.0f), minimum, maximum, enter, exit));
+		CHECK(enter == 2.0f && exit == 4.0f);
+
+		enter = 0.0f;
+		exit = 100.0f;
+
+		CHECK(!Raycast::clip_box(glm::vec3(0.0f, 5.0f, 3.0f), glm::vec3(1.0f, 0.0f, 0.0f), minimum, maximum, enter, exit));
+
+		//The sphere against the boxes, compared with the distance to the nearest point of the box
+		Shapes::Sphere sphere{ glm::vec3(5.0f, 5.0f, 5.0f), 3.0f };
+		bool sphere_agrees = true;
+
+		for (int i = 0; i < 2000; ++i)
+		{
+			Collisions::AABB box = random_box(10.0f, 3.0f);
+			std::array<glm::vec3, 2> region = box.bounding_region();
+			glm::vec3 nearest = glm::clamp(sphere.center, region[0], region[1]);
+			glm::vec3 offset = nearest - sphere.center;
+
+			sphere_agrees = sphere_agrees && sphere.intersects(box) == (glm::dot(offset, offset) <= 9.0f);
+
+			if (sphere.contains(box))
+			{
+				sphere_agrees = sphere_agrees && sphere.intersects(box);
+			}
+		}
+
+		CHECK(sphere_agrees);
+	}
+
+}
+
+
+int main()
+{
+	node_pool();
+	node_items();
+	traversal_stack();
+	overlap_masks();
+	parallel();
+	ray_and_shapes();
+
+	return Tests::failures();
+}
@@ -0,0 +1,735 @@
+//Default Libraries
+#include<map>
+#include<array>
+#include<deque>
+#include<mutex>
+#include<thread>
+#include<vector>
+#include<string>
+#include<fstream>
+#include<cstdint>
+#include<cmath>
+#include<utility>
+#include<type_traits>
+#include<condition_variable>
+
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H 1
+
+
+/*
+* A file that takes the items leaving the window of a tree, and gives them back once the
+* window comes over them again. The world is cut into cubic chunks, an item belongs to the chunk
+* of the center of its box, and a chunk is always written and read whole. Only the index of the
+* chunks is kept in the memory, so the memory stays bounded by the window, however big the world is.
+* The items are written byte by byte, so T has to be trivially copyable.
+* The file is written and read ahead on a thread of its own, the owner only hands the records over
+* and takes them back. The thread and the owner use the file through the streams of their own, the lock
+* is taken only to pick the work and to publish what came of it, never around the file itself.
+* A run is written into the space taken for it under the lock, and given back only once it's read,
+* so no stream ever reads a run the other one is writing. The records that couldn't be written
+* stay in the memory, they are given back all the same, and good() tells the file failed.
+* The chunks that couldn't be read stay in the store as they were, and the load tells it.
+*/
+
+
+namespace DataStructures {
+
+
+	template<typename T>
+	class ChunkStore
+	{
+		//The position of a chunk on the grid
+		struct ChunkKey
+		{
+			int32_t x;
+			int32_t y;
+			int32_t z;
+
+			bool operator<(const ChunkKey& other) const
+			{
+				if (x != other.x) return x < other.x;
+				if (y != other.y) return y < other.y;
+				return z < other.z;
+			}
+		};
+
+		//A single item in the file, with the corners of its box
+		struct Record
+		{
+			T item;
+			float minimum[3];
+			float maximum[3];
+		};
+
+		//A run of the records in the file, counted in the records
+		struct Extent
+		{
+			uint64_t offset;
+			uint64_t count;
+		};
+
+		//The runs of a chunk in the file, the records still waiting for the file, and the box around the items of both.
+		//The serial tells a chunk from the one stored under the same key after it was loaded
+		struct Chunk
+		{
+			uint64_t serial;
+			std::vector<Extent> runs;
+			std::vector<Record> resident;
+			glm::vec3 minimum;
+			glm::vec3 maximum;
+		};
+
+		using ChunkIterator = typename std::map<ChunkKey, Chunk>::iterator;
+
+		//The chunk of the center of the box
+		ChunkKey key(Collisions::AABB& area);
+
+		//Whether the items of the chunk reach into the area
+		bool overlaps(const Chunk& chunk, const glm::vec3& minimum, const glm::vec3& maximum);
+
+		//Takes the first free run long enough for the records, or the end of the file, under the lock
+		Extent reserve(uint64_t count);
+
+		//Writes the records into the run, and appends the records of the run, through the given stream without the lock.
+		//Both return false if the file failed, the read appends nothing then
+		static bool write(std::fstream& file, const std::vector<Record>& records, const Extent& extent);
+		static bool read(std::fstream& file, const std::vector<Extent>& runs, std::vector<Record>& records);
+
+		//Gives the run back, merged with the free runs next to it, the end of the file is taken back as well
+		void release(const Extent& extent);
+
+		//The thread of the file, the writes go first, so the records leave the memory as soon as possible
+		void work();
+
+	protected:
+
+		//The stream of the thread, and the one of the owner
+		std::fstream m_File;
+		std::fstream m_Reader;
+		float m_ChunkSide;
+		uint64_t m_Serial = 0;
+
+		//The number of the records the file can hold without growing
+		uint64_t m_End = 0;
+		size_t m_Size = 0;
+		bool m_Good = true;
+
+		//Every chunk with any records, and the free runs of the file by their offsets, no two of them next to each other
+		std::map<ChunkKey, Chunk> m_Chunks;
+		std::map<uint64_t, uint64_t> m_Free;
+
+		//The chunks read ahead, still counted in the index until they're loaded
+		std::map<ChunkKey, std::vector<Record>> m_Prefetched;
+
+		//The work of the thread, the chunks to be written and the areas to be read ahead
+		std::deque<ChunkKey> m_Writes;
+		std::deque<std::array<glm::vec3, 2>> m_Reads;
+		bool m_Busy = false;
+		bool m_Stop = false;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::condition_variable m_Idle;
+		std::thread m_Worker;
+
+	public:
+
+		/*
+		* Initialisation
+		*/
+
+		//The file is created a new, anything stored in it before is gone
+		ChunkStore(const std::string& Path, float ChunkSide);
+		~ChunkStore();
+
+		/*
+		* Capacity
+		*/
+
+		bool is_open();
+		size_t size();
+		size_t chunks();
+
+		//Whether every write and read of the file went through so far
+		bool good();
+
+		//The records the file has room for, taken or free
+		uint64_t capacity();
+
+		/*
+		* Modifiers
+		*/
+
+		//Hands the items over to be written down, grouped into their chunks, the file is written on the thread of the store
+		void store(std::vector<std::pair<T, Collisions::AABB>>& items);
+
+		//Appends the items of every chunk reaching into the area, the chunks are left out of the store.
+		//Returns false if a chunk couldn't be read, it's kept in the store with its runs, only the records not written yet are appended
+		bool load(Collisions::AABB& area, std::vector<std::pair<T, Collisions::AABB>>& items);
+
+		//Starts reading the chunks reaching into the area on the background, so that the load of them doesn't wait for the file
+		void prefetch(Collisions::AABB area);
+
+		//Waits until everything handed over is written, and every read ahead is done
+		void flush();
+	};
+
+
+	/*
+	* ///////////////////////
+	* /		Definitions     /
+	* ///////////////////////
+	*/
+
+
+	template<typename T>
+	ChunkStore<T>::ChunkStore(const std::string& Path, float ChunkSide) :
+		m_File(Path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc), m_ChunkSide(ChunkSide)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "The items of the chunk store are written byte by byte");
+
+		//The file exists once the stream of the thread created it
+		if (m_File.is_open())
+		{
+			m_Reader.open(Path, std::ios::in | std::ios::binary);
+		}
+
+		m_Good = m_File.is_open() && m_Reader.is_open();
+		m_Worker = std::thread([this]() { work(); });
+	}
+
+
+	template<typename T>
+	ChunkStore<T>::~ChunkStore()
+	{
+		//The file goes away with the store, so the work left isn't done
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stop = true;
+		}
+
+		m_Wake.notify_all();
+		m_Worker.join();
+	}
+
+
+	/*////////////////////
+	* /     Capacity     /
+	*/////////////////////
+
+
+	template<typename T>
+	bool ChunkStore<T>::is_open()
+	{
+		return m_File.is_open() && m_Reader.is_open();
+	}
+
+
+	template<typename T>
+	size_t ChunkStore<T>::size()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		return m_Size;
+	}
+
+
+	template<typename T>
+	size_t ChunkStore<T>::chunks()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		return m_Chunks.size();
+	}
+
+
+	template<typename T>
+	bool ChunkStore<T>::good()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		return m_Good;
+	}
+
+
+	template<typename T>
+	uint64_t ChunkStore<T>::capacity()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		return m_End;
+	}
+
+
+	/*////////////////////
+	* /    Modifiers     /
+	*/////////////////////
+
+
+	template<typename T>
+	void ChunkStore<T>::store(std::vector<std::pair<T, Collisions::AABB>>& items)
+	{
+		if (items.empty())
+		{
+			return;
+		}
+
+		//Grouping the items, every chunk is written as one run
+		std::map<ChunkKey, std::vector<Record>> grouped;
+
+		for (std::pair<T, Collisions::AABB>& item : items)
+		{
+			std::array<glm::vec3, 2> region = item.second.bounding_region();
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+			Record record;
+			record.item = item.first;
+
+			for (int i = 0; i < 3; i++)
+			{
+				record.minimum[i] = minimum[i];
+				record.maximum[i] = maximum[i];
+			}
+
+			grouped[key(item.second)].push_back(record);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			for (std::pair<const ChunkKey, std::vector<Record>>& group : grouped)
+			{
+				std::pair<ChunkIterator, bool> found = m_Chunks.insert({ group.first, Chunk() });
+				Chunk& chunk = found.first->second;
+
+				if (found.second)
+				{
+					chunk.serial = m_Serial++;
+				}
+
+				//The box of the chunk grows by every record
+				for (size_t r = 0; r < group.second.size(); r++)
+				{
+					glm::vec3 minimum(group.second[r].minimum[0], group.second[r].minimum[1], group.second[r].minimum[2]);
+					glm::vec3 maximum(group.second[r].maximum[0], group.second[r].maximum[1], group.second[r].maximum[2]);
+					bool first = found.second && r == 0;
+
+					chunk.minimum = first ? minimum : glm::min(chunk.minimum, minimum);
+					chunk.maximum = first ? maximum : glm::max(chunk.maximum, maximum);
+				}
+
+				//A chunk waits in the queue once, however many times it's stored before it's written
+				if (chunk.resident.empty())
+				{
+					m_Writes.push_back(group.first);
+				}
+
+				chunk.resident.insert(chunk.resident.end(), group.second.begin(), group.second.end());
+				m_Size += group.second.size();
+			}
+		}
+
+		m_Wake.notify_one();
+	}
+
+
+	template<typename T>
+	bool ChunkStore<T>::load(Collisions::AABB& area, std::vector<std::pair<T, Collisions::AABB>>& items)
+	{
+		std::array<glm::vec3, 2> region = area.bounding_region();
+		glm::vec3 minimum = glm::min(region[0], region[1]);
+		glm::vec3 maximum = glm::max(region[0], region[1]);
+
+		std::vector<Record> records;
+		std::vector<std::pair<ChunkKey, Chunk>> unread;
+
+		//The chunks are taken out of the index under the lock, so the thread neither writes nor reads them ahead anymore,
+		//their runs stay taken until they're read
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			ChunkIterator chunk = m_Chunks.begin();
+
+			while (chunk != m_Chunks.end())
+			{
+				if (!overlaps(chunk->second, minimum, maximum))
+				{
+					++chunk;
+					continue;
+				}
+
+				//The records not written yet are handed over straight from the memory
+				records.insert(records.end(), chunk->second.resident.begin(), chunk->second.resident.end());
+				m_Size -= chunk->second.resident.size();
+				chunk->second.resident.clear();
+
+				typename std::map<ChunkKey, std::vector<Record>>::iterator prefetched = m_Prefetched.find(chunk->first);
+
+				if (prefetched != m_Prefetched.end())
+				{
+					//Already in the memory
+					records.insert(records.end(), prefetched->second.begin(), prefetched->second.end());
+					m_Prefetched.erase(prefetched);
+
+					for (const Extent& extent : chunk->second.runs)
+					{
+						release(extent);
+						m_Size -= extent.count;
+					}
+				}
+				else if (!chunk->second.runs.empty())
+				{
+					unread.push_back(*chunk);
+				}
+
+				m_Chunks.erase(chunk++);
+			}
+		}
+
+		//The file is read without the lock, the thread goes on with its own work meanwhile
+		std::vector<bool> read_all(unread.size());
+
+		for (size_t i = 0; i < unread.size(); i++)
+		{
+			read_all[i] = read(m_Reader, unread[i].second.runs, records);
+		}
+
+		bool good = true;
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+
+			for (size_t i = 0; i < unread.size(); i++)
+			{
+				Chunk& chunk = unread[i].second;
+
+				if (read_all[i])
+				{
+					for (const Extent& extent : chunk.runs)
+					{
+						release(extent);
+						m_Size -= extent.count;
+					}
+
+					continue;
+				}
+
+				//The chunk goes back with all of its runs, next to the records stored under its key since.
+				//It's a new chunk for the thread, a write of its records still on the way finds it gone
+				chunk.serial = m_Serial++;
+				std::pair<ChunkIterator, bool> found = m_Chunks.insert({ unread[i].first, chunk });
+
+				if (!found.second)
+				{
+					Chunk& other = found.first->second;
+					other.runs.insert(other.runs.end(), chunk.runs.begin(), chunk.runs.end());
+					other.minimum = glm::min(other.minimum, chunk.minimum);
+					other.maximum = glm::max(other.maximum, chunk.maximum);
+				}
+
+				good = false;
+				m_Good = false;
+			}
+		}
+
+		items.reserve(items.size() + records.size());
+
+		for (Record& record : records)
+		{
+			glm::vec3 lower(record.minimum[0], record.minimum[1], record.minimum[2]);
+			glm::vec3 upper(record.maximum[0], record.maximum[1], record.maximum[2]);
+
+			items.push_back({ record.item, Collisions::AABB(lower, upper) });
+		}
+
+		return good;
+	}
+
+
+	template<typename T>
+	void ChunkStore<T>::prefetch(Collisions::AABB area)
+	{
+		std::array<glm::vec3, 2> region = area.bounding_region();
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Reads.push_back({ glm::min(region[0], region[1]), glm::max(region[0], region[1]) });
+		}
+
+		m_Wake.notify_one();
+	}
+
+
+	template<typename T>
+	void ChunkStore<T>::flush()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		m_Idle.wait(lock, [this]() { return m_Writes.empty() && m_Reads.empty() && !m_Busy; });
+	}
+
+
+	/*
+	* //////////////////////////////
+	* /  Private member functions  /
+	* //////////////////////////////
+	*/
+
+
+	template<typename T>
+	typename ChunkStore<T>::ChunkKey ChunkStore<T>::key(Collisions::AABB& area)
+	{
+		std::array<glm::vec3, 2> region = area.bounding_region();
+		glm::vec3 center = (region[0] + region[1]) * 0.5f;
+
+		return {
+			(int32_t)std::floor(center.x / m_ChunkSide),
+			(int32_t)std::floor(center.y / m_ChunkSide),
+			(int32_t)std::floor(center.z / m_ChunkSide) };
+	}
+
+
+	template<typename T>
+	bool ChunkStore<T>::overlaps(const Chunk& chunk, const glm::vec3& minimum, const glm::vec3& maximum)
+	{
+		return chunk.minimum.x <= maximum.x && chunk.maximum.x >= minimum.x
+			&& chunk.minimum.y <= maximum.y && chunk.maximum.y >= minimum.y
+			&& chunk.minimum.z <= maximum.z && chunk.maximum.z >= minimum.z;
+	}
+
+
+	template<typename T>
+	typename ChunkStore<T>::Extent ChunkStore<T>::reserve(uint64_t count)
+	{
+		Extent extent = { m_End, count };
+
+		//The first free run long enough is used, what's left of it stays free
+		for (typename std::map<uint64_t, uint64_t>::iterator run = m_Free.begin(); run != m_Free.end(); ++run)
+		{
+			if (run->second >= extent.count)
+			{
+				extent.offset = run->first;
+
+				if (run->second > extent.count)
+				{
+					m_Free[run->first + extent.count] = run->second - extent.count;
+				}
+
+				m_Free.erase(run);
+				break;
+			}
+		}
+
+		if (extent.offset == m_End)
+		{
+			m_End += extent.count;
+		}
+
+		return extent;
+	}
+
+
+	template<typename T>
+	bool ChunkStore<T>::write(std::fstream& file, const std::vector<Record>& records, const Extent& extent)
+	{
+		file.seekp(extent.offset * sizeof(Record));
+		file.write(reinterpret_cast<const char*>(records.data()), extent.count * sizeof(Record));
+
+		//Flushed, so the stream of the owner finds the records once the run is published
+		file.flush();
+
+		//The stream is made usable again for the next try
+		if (!file.good())
+		{
+			file.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+
+	template<typename T>
+	bool ChunkStore<T>::read(std::fstream& file, const std::vector<Extent>& runs, std::vector<Record>& records)
+	{
+		size_t first = records.size();
+
+		for (const Extent& extent : runs)
+		{
+			size_t start = records.size();
+			records.resize(start + extent.count);
+
+			file.seekg(extent.offset * sizeof(Record));
+			file.read(reinterpret_cast<char*>(records.data() + start), extent.count * sizeof(Record));
+
+			if (!file.good())
+			{
+				file.clear();
+				records.resize(first);
+
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+
+	template<typename T>
+	void ChunkStore<T>::release(const Extent& extent)
+	{
+		uint64_t offset = extent.offset;
+		uint64_t count = extent.count;
+
+		if (!count)
+		{
+			return;
+		}
+
+		//Merging with the free run right after it, and the one right before it
+		typename std::map<uint64_t, uint64_t>::iterator next = m_Free.find(offset + count);
+
+		if (next != m_Free.end())
+		{
+			count += next->second;
+			m_Free.erase(next);
+		}
+
+		typename std::map<uint64_t, uint64_t>::iterator previous = m_Free.lower_bound(offset);
+
+		if (previous != m_Free.begin() && (--previous)->first + previous->second == offset)
+		{
+			offset = previous->first;
+			count += previous->second;
+			m_Free.erase(previous);
+		}
+
+		//The free end of the file is simply not used anymore
+		if (offset + count == m_End)
+		{
+			m_End = offset;
+			return;
+		}
+
+		m_Free[offset] = count;
+	}
+
+
+	template<typename T>
+	void ChunkStore<T>::work()
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		while (true)
+		{
+			m_Busy = false;
+			m_Idle.notify_all();
+			m_Wake.wait(lock, [this]() { return m_Stop || !m_Writes.empty() || !m_Reads.empty(); });
+
+			if (m_Stop)
+			{
+				return;
+			}
+
+			m_Busy = true;
+
+			//The writes go one chunk at a time, the records are copied out, and the run is taken for them under the lock
+			if (!m_Writes.empty())
+			{
+				ChunkKey written = m_Writes.front();
+				ChunkIterator chunk = m_Chunks.find(written);
+				m_Writes.pop_front();
+
+				//Loaded in the meantime, or written already
+				if (chunk == m_Chunks.end() || chunk->second.resident.empty())
+				{
+					continue;
+				}
+
+				uint64_t serial = chunk->second.serial;
+				std::vector<Record> records = chunk->second.resident;
+				Extent extent = reserve(records.size());
+
+				lock.unlock();
+				bool done = write(m_File, records, extent);
+				lock.lock();
+
+				chunk = m_Chunks.find(written);
+
+				//Loaded while it was written, the owner took the records from the memory, so the run isn't needed
+				if (chunk == m_Chunks.end() || chunk->second.serial != serial)
+				{
+					release(extent);
+					continue;
+				}
+
+				//What couldn't be written stays in the memory, counted in the chunk as before
+				if (!done)
+				{
+					release(extent);
+					m_Good = false;
+					continue;
+				}
+
+				//The records stored while the run was written stay, and wait for a run of their own
+				std::vector<Record>& resident = chunk->second.resident;
+				resident.erase(resident.begin(), resident.begin() + records.size());
+				chunk->second.runs.push_back(extent);
+
+				if (!resident.empty())
+				{
+					m_Writes.push_back(written);
+				}
+				else
+				{
+					resident.shrink_to_fit();
+				}
+
+				//The chunk read ahead is missing the new run, it's read again on the load
+				m_Prefetched.erase(written);
+
+				continue;
+			}
+
+			std::array<glm::vec3, 2> area = m_Reads.front();
+			m_Reads.pop_front();
+
+			std::vector<std::pair<ChunkKey, Chunk>> wanted;
+
+			for (std::pair<const ChunkKey, Chunk>& chunk : m_Chunks)
+			{
+				if (overlaps(chunk.second, area[0], area[1]) && !chunk.second.runs.empty() && !m_Prefetched.count(chunk.first))
+				{
+					wanted.push_back({ chunk.first, Chunk{ chunk.second.serial, chunk.second.runs, {}, chunk.second.minimum, chunk.second.maximum } });
+				}
+			}
+
+			//The runs are read without the lock, only this thread writes, so none of them is written over meanwhile
+			for (std::pair<ChunkKey, Chunk>& chunk : wanted)
+			{
+				if (m_Stop)
+				{
+					return;
+				}
+
+				std::vector<Record> records;
+
+				lock.unlock();
+				bool read_all = read(m_File, chunk.second.runs, records);
+				lock.lock();
+
+				ChunkIterator current = m_Chunks.find(chunk.first);
+
+				//Loaded in the meantime, and a failed read is left to the load, which tries the file again
+				if (read_all && current != m_Chunks.end() && current->second.serial == chunk.second.serial && current->second.runs.size() == chunk.second.runs.size())
+				{
+					m_Prefetched[chunk.first].swap(records);
+				}
+			}
+		}
+	}
+
+}
+#endif
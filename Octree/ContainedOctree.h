@@ -1,13 +1,26 @@
+//Default Libraries
+#include<thread>
+#include<atomic>
+#include<memory>
+
 //Dependencies
 #include "Octree.h"
+#include "LinearOctree.h"
+#include "SlotMap.h"
+#include "ChunkStore.h"
+
+//Macros
+#define SHIFT_BUILD_BATCH 16384
 
 
 /*
 * This container is meant to implement
-* the Octree in conjunction with a list
+* the Octree in conjunction with a slot map
 * This way way, the
 * Octree will not own any item, but only
-* iterators to the items, It's cheaper* 
+* handles to the items, It's cheaper* 
+* The tree itself is exchangeable, by default it's the Octree,
+* but the pointerless LinearOctree can be used as well.
 */
 
 namespace Trees {
@@ -15,8 +28,8 @@ namespace Trees {
 	template<typename T>
 	struct Location
 	{
-		typename std::list<T>* items_container = nullptr;
-		typename std::list<T>::iterator items_iterator;
+		typename DataStructures::NodeItems<T>* items_container = nullptr;
+		size_t items_slot = 0;
 		typename Collisions::AABB aabb;
 	};
 
@@ -24,27 +37,83 @@ namespace Trees {
 
 namespace DataStructures {
 
-	template<typename T>
+	template<typename T, template<typename> class Engine = Octree>
 	struct OctreeItem
 	{
 		//Item itself
 		T item;
 
-		//The location to the container inside Octree that holds the iterator to this exact element above
-		Trees::Location<typename std::list<OctreeItem<T>>::iterator> item_position;
+		//The location to the container inside Octree that holds the handle to this exact element above
+		typename Engine<SlotHandle>::Location item_position;
 	};
 
-	template<typename T>
+	//The Engine decides how the box searches (dfs, bfs and query with an area) read the tree:
+	//the Octree keeps one item per node, and refuses the insertions into a taken one. It reports the items of the nodes
+	//holding the whole area and of the leaves touching it, so an item is found by the box of its node, not its own.
+	//The LinearOctree takes any number of the items per cell, and reports exactly the ones whose boxes intersect the area.
+	//The other searches go by the boxes of the items, the pairs with either engine, the rest with the Octree only
+	template<typename T, template<typename> class Engine = Octree>
 	class ContainedOctree
 	{
 
-		using OctreeContainer = std::list<OctreeItem<T>>;
+		using OctreeContainer = SlotMap<OctreeItem<T, Engine>>;
+
+		//The containers of the other item types, for the joins between two trees
+		template<typename U, template<typename> class E>
+		friend class ContainedOctree;
+
+		//Places every item back in the tree, after its area has changed
+		void reinsert(std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//The same for only the given items, the ones taken out by a shift or inserted while it was built
+		void reinsert(std::vector<SlotHandle>& handles, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//The moved tree built on a worker thread, out of the copy of the items taken when the shift started.
+		//The worker touches nothing else, and the ready flag tells the owner when it's done.
+		//Dropping it unfinished sets the cancelled flag, so the worker stops after the batch it's on
+		struct PendingShift
+		{
+			std::unique_ptr<Engine<SlotHandle>> root;
+			std::vector<std::pair<SlotHandle, Collisions::AABB>> items;
+			std::vector<typename Engine<SlotHandle>::Location> locations;
+
+			//The items inserted after the copy was taken, they are in the current tree only
+			std::vector<SlotHandle> inserted;
+
+			std::atomic<bool> ready{ false };
+			std::atomic<bool> cancelled{ false };
+			std::thread worker;
+
+			~PendingShift()
+			{
+				cancelled.store(true, std::memory_order_relaxed);
+
+				if (worker.joinable()) worker.join();
+			}
+		};
+
+		//Takes the built tree in place of the current one, carrying over the changes made while it was built
+		void apply_shift(std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//After the tree moved from the previous area, the evicted items wholly outside of it go to the chunk store, and the chunks reaching into
+		//the part that came in are read back. Without the store, or for the items reaching into the tree that didn't fit, it's all passed on to returned_data
+		void page(Collisions::AABB previous, std::list<std::pair<T, Collisions::AABB>>& evicted, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//The parts of the area outside of the other one, at most one slab per side, none of them overlapping
+		static std::vector<Collisions::AABB> outside(Collisions::AABB& area, Collisions::AABB& other);
 
 	protected:
 
-		Octree<typename OctreeContainer::iterator> m_Root;
+		//The tree is held by the pointer, so a moved one built in the background takes its place with a single swap
+		std::unique_ptr<Engine<SlotHandle>> m_Root;
 		OctreeContainer m_Items;
 
+		//The shift being built in the background, if there is one
+		std::unique_ptr<PendingShift> m_Shift;
+
+		//Where the items leaving the tree go, owned by the user
+		ChunkStore<T>* m_Store = nullptr;
+
 	public:
 
 		/*
@@ -53,7 +122,8 @@ namespace DataStructures {
 
 		ContainedOctree();
 		ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions);
-		ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, std::list<T> Items);
+		ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision);
+		ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, std::vector<std::pair<T, Collisions::AABB>> Items);
 		~ContainedOctree();
 
 		/*
@@ -61,7 +131,7 @@ namespace DataStructures {
 		*/
 
 		size_t min_dimensions();
-		Collisions::AABB& aabb();
+		Collisions::AABB aabb();
 		void resize(Collisions::AABB area);
 
 		/*////////
@@ -72,6 +142,8 @@ namespace DataStructures {
 		size_t max_size();
 		size_t depth();
 		size_t max_depth();
+		bool multi_thread();
+		void set_multi_thread(bool MultiThread);
 		bool empty();
 
 		/*
@@ -79,16 +151,67 @@ namespace DataStructures {
 		*/
 
 		//Iterators that enable using this container in a for loop(optional)
-		typename std::list<T>::iterator begin();
-		typename std::list<T>::iterator end();
-		typename std::list<T>::iterator cbegin();
-		typename std::list<T>::iterator cend();
+		typename OctreeContainer::iterator begin();
+		typename OctreeContainer::iterator end();
+		typename OctreeContainer::iterator cbegin();
+		typename OctreeContainer::iterator cend();
 
 		//Search functions
-		void dfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items);
-		void bfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items);
+		void dfs(Collisions::AABB& area, std::list<SlotHandle>& items);
+		void bfs(Collisions::AABB& area, std::list<SlotHandle>& items);
 		bool contains(Collisions::AABB& area);
 
+		//Whether anything overlaps the area, and how many items do, without collecting them. Needs the Octree engine
+		bool any(Collisions::AABB& area);
+		size_t count(Collisions::AABB& area);
+
+		//Calls on_hit(handle, item) for every found item without allocating, the search stops as soon as it returns false
+		template<typename F>
+		bool query(Collisions::AABB& area, F&& on_hit);
+		void query(Collisions::AABB& area, std::vector<SlotHandle>& items);
+
+		//Runs the searches of all of the areas in one walk of the tree, e.g. the views of every player in one tick
+		//results[i] gets the handles found in areas[i], the buffers are reused between the calls. Needs the Octree engine
+		void query(std::vector<Collisions::AABB>& areas, std::vector<std::vector<SlotHandle>>& results);
+
+		//Calls on_hit(handle, item) for the items intersecting the shape, a sphere, a capsule, an oriented box, or anything alike
+		//Returning false stops the search. Needs the Octree engine
+		template<typename S, typename F>
+		bool query_shape(const S& shape, F&& on_hit);
+		template<typename S>
+		void query_shape(const S& shape, std::vector<SlotHandle>& items);
+
+		//Calls on_pair(first_handle, first_item, second_handle, second_item) once for every pair of the overlapping items
+		//The broad phase of the collision detection, the search stops as soon as on_pair returns false
+		template<typename F>
+		bool overlapping_pairs(F&& on_pair);
+
+		//The same pairs of handles appended to a vector, searched on all threads when the tree is multi threaded
+		void overlapping_pairs(std::vector<std::pair<SlotHandle, SlotHandle>>& pairs);
+
+		//Calls on_pair(handle, item, other_handle, other_item) once for every item overlapping an item of the other container
+		//Joins e.g. the static geometry with the dynamic actors, both of the containers have to use the Octree engine
+		template<typename U, typename F>
+		bool overlapping_pairs(ContainedOctree<U, Engine>& other, F&& on_pair);
+
+		//Calls on_hit(handle, item, distance) for the items hit by the ray origin + t * direction with t up to max_distance, the nearest ones first
+		//Visibility, bullet and line of sight checks, returning false stops the cast, e.g. on the first hit. Needs the Octree engine
+		template<typename F>
+		bool raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, F&& on_hit);
+
+		//Appends the handles of the k items nearest to the point, the nearest first, leaving out the ones farther than max_distance
+		//One search in place of growing a query box until it finds enough items. Needs the Octree engine
+		void nearest(glm::vec3 point, size_t k, std::vector<SlotHandle>& items, float max_distance = std::numeric_limits<float>::infinity());
+
+		//Calls on_visible(handle, item) for the items inside of the frustum, the planes point inwards with the distance in w
+		//Returning false stops the search. Needs the Octree engine
+		template<typename F>
+		bool cull(const std::array<glm::vec4, 6>& planes, F&& on_visible);
+
+		//Access through the handles, the stale ones are recognized
+		bool valid(SlotHandle item);
+		T* find(SlotHandle item);
+
 		//Others
 		std::vector<T> items();
 
@@ -97,14 +220,45 @@ namespace DataStructures {
 		*/
 
 		bool insert(T object, Collisions::AABB area);
-		bool remove(typename OctreeContainer::iterator& item);
+		size_t insert(std::vector<std::pair<T, Collisions::AABB>> Items);
+		bool remove(SlotHandle item);
 		void clear();
 
 		/*
 		* Space altering
 		*/
 
-		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data); //TODO
+		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//Moves by any number of the leaf nodes on every axis at once, the positive y goes up
+		void shift(glm::ivec3 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//Starts building the tree moved by the leaf offset on a worker thread, returns false if another shift is still pending.
+		//The current tree keeps answering the queries and taking the changes, until the moved one is published
+		bool shift_async(glm::ivec3 leaf_offset);
+
+		//Whether the moved tree is built, so publishing it won't wait
+		bool shift_ready();
+
+		//Puts the moved tree in place of the current one if it's ready, returns false without waiting otherwise.
+		//The changes made since the start of the shift are carried over, the items that don't fit the moved tree go to returned_data
+		bool publish_shift(std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//With the store set, the shifts write the items leaving the tree to it in place of returned_data, and read them back
+		//once the tree comes over their chunks again, reading ahead in the direction of the move. nullptr turns it off
+		void set_chunk_store(ChunkStore<T>* Store);
+
+		/*
+		* Snapshot
+		*/
+
+		//Writes the tree with the items and their boxes as the Snapshot::Item<T> records, T has to be trivially copyable.
+		//The file can also be searched in place by the Snapshot::View, without loading it. Needs the Octree engine
+		bool save(const std::string& path);
+
+		//Puts the tree and the items of the file in place of the current ones, the items get new handles.
+		//Returns false and keeps everything as it was if the file can't be read. Needs the Octree engine
+		bool load(const std::string& path);
 
 	};
 
@@ -116,29 +270,35 @@ namespace DataStructures {
 	*/
 
 
-	template<typename T>
-	ContainedOctree<T>::ContainedOctree() :
-		m_Root()
+	template<typename T, template<typename> class Engine>
+	ContainedOctree<T, Engine>::ContainedOctree() :
+		m_Root(std::make_unique<Engine<SlotHandle>>())
 	{}
 	
 
-	template<typename T>
-	ContainedOctree<T>::ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions) :
-		m_Root(BoundingBox, MaxDepth, MinimumDimensions)
+	template<typename T, template<typename> class Engine>
+	ContainedOctree<T, Engine>::ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions) :
+		m_Root(std::make_unique<Engine<SlotHandle>>(BoundingBox, MaxDepth, MinimumDimensions))
 	{}
 
 
-	template<typename T>
-	ContainedOctree<T>::ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, std::list<T> Items) :
-		m_Root(BoundingBox, MaxDepth, MinimumDimensions)
+	template<typename T, template<typename> class Engine>
+	ContainedOctree<T, Engine>::ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision) :
+		m_Root(std::make_unique<Engine<SlotHandle>>(BoundingBox, MaxDepth, MinimumDimensions, LazySubdivision))
+	{}
+
+
+	template<typename T, template<typename> class Engine>
+	ContainedOctree<T, Engine>::ContainedOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, std::vector<std::pair<T, Collisions::AABB>> Items) :
+		m_Root(std::make_unique<Engine<SlotHandle>>(BoundingBox, MaxDepth, MinimumDimensions))
 	{
-		// TODO: make a bulk insertion algorithm
+		insert(std::move(Items));
 	}
 
-	template<typename T>
-	ContainedOctree<T>::~ContainedOctree()
+	template<typename T, template<typename> class Engine>
+	ContainedOctree<T, Engine>::~ContainedOctree()
 	{
-		clear();
+		//The root gives every node back to its pool on its own, no need to rebuild the tree with clear()
 	}
 
 
@@ -146,54 +306,73 @@ namespace DataStructures {
 	* /     Capacity     /
 	*/////////////////////
 
-	template<typename T>
-	Collisions::AABB& ContainedOctree<T>::aabb()
+	template<typename T, template<typename> class Engine>
+	Collisions::AABB ContainedOctree<T, Engine>::aabb()
 	{
-		return m_Root.aabb();
+		return m_Root->aabb();
 	}
 
 
-	template<typename T>
-	size_t ContainedOctree<T>::size()
+	template<typename T, template<typename> class Engine>
+	size_t ContainedOctree<T, Engine>::size()
 	{
 		return (size_t)m_Items.size();
 	}
 
 
-	template<typename T>
-	size_t ContainedOctree<T>::max_size()
+	template<typename T, template<typename> class Engine>
+	size_t ContainedOctree<T, Engine>::max_size()
 	{
-		return m_Root.max_size();
+		return m_Root->max_size();
 	}
 
 
-	template<typename T>
-	size_t ContainedOctree<T>::min_dimensions()
+	template<typename T, template<typename> class Engine>
+	size_t ContainedOctree<T, Engine>::min_dimensions()
 	{
-		return m_Root.min_dimensions();
+		return m_Root->min_dimensions();
 	}
 
 
-	template<typename T>
-	size_t ContainedOctree<T>::max_depth()
+	template<typename T, template<typename> class Engine>
+	size_t ContainedOctree<T, Engine>::max_depth()
 	{
-		return m_Root.max_depth();
+		return m_Root->max_depth();
 	}
 
 
-	template<typename T>
-	void ContainedOctree<T>::resize(Collisions::AABB area)
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::resize(Collisions::AABB area)
 	{
-		//Cleaning the tree of the iterators
-		m_Root.resize(area);
+		//The pending shift was built for the old area
+		m_Shift.reset();
 
-		//Cleaning the list
-		m_Items.clear();
+		//Cleaning the tree of the handles
+		m_Root->resize(area);
+
+		//Placing the items back, the ones outside of the new area are dropped
+		std::list<std::pair<T, Collisions::AABB>> returned_data;
+		reinsert(returned_data);
 	}
 
 
-	template<typename T>
-	bool ContainedOctree<T>::empty()
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::multi_thread()
+	{
+		return m_Root->multi_thread();
+	}
+
+
+	//The bulk insertions are spread over the threads, when they are big enough
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::set_multi_thread(bool MultiThread)
+	{
+		m_Root->set_multi_thread(MultiThread);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::empty()
 	{
 		return m_Items.empty();
 	}
@@ -204,66 +383,221 @@ namespace DataStructures {
 	*/////////////////////
 
 
-	template<typename T>
-	typename std::list<T>::iterator ContainedOctree<T>::begin()
+	template<typename T, template<typename> class Engine>
+	typename ContainedOctree<T, Engine>::OctreeContainer::iterator ContainedOctree<T, Engine>::begin()
 	{
 		return m_Items.begin();
 	}
 
 
-	template<typename T>
-	typename std::list<T>::iterator ContainedOctree<T>::end()
+	template<typename T, template<typename> class Engine>
+	typename ContainedOctree<T, Engine>::OctreeContainer::iterator ContainedOctree<T, Engine>::end()
 	{
 		return m_Items.end();
 	}
 
 
-	template<typename T>
-	typename std::list<T>::iterator ContainedOctree<T>::cbegin()
+	template<typename T, template<typename> class Engine>
+	typename ContainedOctree<T, Engine>::OctreeContainer::iterator ContainedOctree<T, Engine>::cbegin()
 	{
-		return m_Items.cbegin();
+		return m_Items.begin();
 	}
 
 
-	template<typename T>
-	typename std::list<T>::iterator ContainedOctree<T>::cend()
+	template<typename T, template<typename> class Engine>
+	typename ContainedOctree<T, Engine>::OctreeContainer::iterator ContainedOctree<T, Engine>::cend()
 	{
-		return m_Items.cend();
+		return m_Items.end();
 	}
 
 
-	template<typename T>
-	void ContainedOctree<T>::dfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items)
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::dfs(Collisions::AABB& area, std::list<SlotHandle>& items)
 	{
-		m_Root.dfs(area, items);
+		m_Root->dfs(area, items);
 	}
 
 
-	template<typename T>
-	void ContainedOctree<T>::bfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items)
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::bfs(Collisions::AABB& area, std::list<SlotHandle>& items)
 	{
-		m_Root.bfs(area, items);
+		m_Root->bfs(area, items);
 	}
 
 
-	template<typename T>
-	bool ContainedOctree<T>::contains(Collisions::AABB& area)
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::contains(Collisions::AABB& area)
 	{
-		return m_Root.contains(area);
+		return m_Root->contains(area);
 	}
 
 
-	template<typename T>
-	std::vector<T> ContainedOctree<T>::items()
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::any(Collisions::AABB& area)
+	{
+		//The tree holds only the handles, the boxes are kept next to the items
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+
+		return m_Root->any(area, bounds);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	size_t ContainedOctree<T, Engine>::count(Collisions::AABB& area)
+	{
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+
+		return m_Root->count(area, bounds);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	template<typename F>
+	bool ContainedOctree<T, Engine>::query(Collisions::AABB& area, F&& on_hit)
+	{
+		//The tree gives the handles, the items are looked up right away
+		auto visit = [&](SlotHandle& handle) { return on_hit(handle, m_Items.at(handle).item); };
+
+		return m_Root->query(area, visit);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::query(Collisions::AABB& area, std::vector<SlotHandle>& items)
+	{
+		m_Root->query(area, items);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::query(std::vector<Collisions::AABB>& areas, std::vector<std::vector<SlotHandle>>& results)
+	{
+		m_Root->query(areas, results);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	template<typename S, typename F>
+	bool ContainedOctree<T, Engine>::query_shape(const S& shape, F&& on_hit)
+	{
+		//The tree holds only the handles, the boxes are kept next to the items
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+		auto report = [&](SlotHandle& handle) { return on_hit(handle, m_Items.at(handle).item); };
+
+		return m_Root->query_shape(shape, bounds, report);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	template<typename S>
+	void ContainedOctree<T, Engine>::query_shape(const S& shape, std::vector<SlotHandle>& items)
+	{
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+		auto push = [&items](SlotHandle& handle) { items.push_back(handle); return true; };
+
+		m_Root->query_shape(shape, bounds, push);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	template<typename F>
+	bool ContainedOctree<T, Engine>::overlapping_pairs(F&& on_pair)
+	{
+		//The tree holds only the handles, the boxes are kept next to the items
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+		auto report = [&](SlotHandle& first, SlotHandle& second) { return on_pair(first, m_Items.at(first).item, second, m_Items.at(second).item); };
+
+		return m_Root->overlapping_pairs(bounds, report);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::overlapping_pairs(std::vector<std::pair<SlotHandle, SlotHandle>>& pairs)
+	{
+		//Only reading the storage, so the threads can share it
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+
+		m_Root->overlapping_pairs(bounds, pairs);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	template<typename U, typename F>
+	bool ContainedOctree<T, Engine>::overlapping_pairs(ContainedOctree<U, Engine>& other, F&& on_pair)
+	{
+		//Each tree holds the handles to its own storage
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+		auto other_bounds = [&other](SlotHandle& handle) { return other.m_Items.at(handle).item_position.aabb; };
+		auto report = [&](SlotHandle& mine, SlotHandle& theirs) { return on_pair(mine, m_Items.at(mine).item, theirs, other.m_Items.at(theirs).item); };
+
+		return m_Root->overlapping_pairs(*other.m_Root, bounds, other_bounds, report);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	template<typename F>
+	bool ContainedOctree<T, Engine>::raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, F&& on_hit)
+	{
+		//The tree holds only the handles, the boxes are kept next to the items
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+		auto report = [&](SlotHandle& handle, float distance) { return on_hit(handle, m_Items.at(handle).item, distance); };
+
+		return m_Root->raycast(origin, direction, max_distance, bounds, report);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::nearest(glm::vec3 point, size_t k, std::vector<SlotHandle>& items, float max_distance)
+	{
+		//The tree holds only the handles, the boxes are kept next to the items
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+
+		m_Root->nearest(point, k, bounds, items, max_distance);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	template<typename F>
+	bool ContainedOctree<T, Engine>::cull(const std::array<glm::vec4, 6>& planes, F&& on_visible)
+	{
+		//The tree holds only the handles, the boxes are kept next to the items
+		auto bounds = [this](SlotHandle& handle) { return m_Items.at(handle).item_position.aabb; };
+		auto report = [&](SlotHandle& handle) { return on_visible(handle, m_Items.at(handle).item); };
+
+		return m_Root->cull(planes, bounds, report);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::valid(SlotHandle item)
+	{
+		return m_Items.contains(item);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	T* ContainedOctree<T, Engine>::find(SlotHandle item)
+	{
+		OctreeItem<T, Engine>* found = m_Items.find(item);
+
+		return found ? &found->item : nullptr;
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	std::vector<T> ContainedOctree<T, Engine>::items()
 	{
 		//Stores the found data
 		std::vector<T> Items;
+		Items.reserve(m_Items.size());
 
-		//Pushing available items to the vector
+		//Pushing available items to the vector, the storage is packed so it's a linear walk
 		for (const auto& it : m_Items)
 		{
-			Items.push_back(it->item);
+			Items.push_back(it.item);
 		}
+
+		return Items;
 	}
 
 
@@ -272,56 +606,109 @@ namespace DataStructures {
 	*/////////////////////
 
 
-	template<typename T>
-	bool ContainedOctree<T>::insert(T object, Collisions::AABB area)
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::insert(T object, Collisions::AABB area)
 	{
-		//Temporary storage for the Dependencies::Tree::Location object
-		OctreeItem<T> temp;
-
-		//Inserting the item to the structure
-		temp.item = object;
-
-		//Pushing the structure up the list
-		m_Items.push_back(temp);
+		//Pushing the item into the packed storage, the handle is what goes to the tree
+		SlotHandle handle = m_Items.insert({ object, {} });
 
 		//Filling the remaining data, that We get from the Octree insertion
-		m_Items.back().item_position = m_Root.insert(std::prev(m_Items.end()), area);
+		m_Items.at(handle).item_position = m_Root->insert(handle, area);
 
 		//Depending on the outcome of the insertion gives the result
-		if (m_Items.back().item_position.items_container)
+		if (m_Items.at(handle).item_position.items_container)
 		{
+			//The tree being built in the background hasn't seen this item
+			if (m_Shift)
+			{
+				m_Shift->inserted.push_back(handle);
+			}
+
 			return true;
 		}
-		else
-			return false;
+
+		//The item didn't fit into the tree, so it isn't kept either
+		m_Items.erase(handle);
+
+		return false;
 	}
 
 
-	template<typename T>
-	bool ContainedOctree<T>::remove(typename OctreeContainer::iterator& item)
+	//Inserts every item at once, gives back how many of them made it into the tree
+	template<typename T, template<typename> class Engine>
+	size_t ContainedOctree<T, Engine>::insert(std::vector<std::pair<T, Collisions::AABB>> Items)
 	{
-		/*Basicly, acceses the iterator, finds the container in the accessed structure,
-		finds the iterator in the structure, and demands the container to erase the given iterator from its content*/
-		item->item_position.items_container->erase(item->item_position.items_iterator);
+		//Storing every item up front, the tree gets all of the handles at once
+		std::vector<std::pair<SlotHandle, Collisions::AABB>> handles;
+		handles.reserve(Items.size());
+		m_Items.reserve(m_Items.size() + Items.size());
+
+		for (std::pair<T, Collisions::AABB>& item : Items)
+		{
+			handles.push_back({ m_Items.insert({ std::move(item.first), {} }), item.second });
+		}
+
+		std::vector<typename Engine<SlotHandle>::Location> locations;
+		m_Root->insert(handles, locations);
 
-		//Deletes the original item from the list
+		size_t inserted = 0;
+
+		//Going backwards, so the items moved in place of the erased ones have already been handled
+		for (size_t i = handles.size(); i-- > 0;)
+		{
+			if (locations[i].items_container)
+			{
+				m_Items.at(handles[i].first).item_position = locations[i];
+				inserted++;
+
+				if (m_Shift)
+				{
+					m_Shift->inserted.push_back(handles[i].first);
+				}
+			}
+			else
+			{
+				//The item didn't fit into the tree, so it isn't kept either
+				m_Items.erase(handles[i].first);
+			}
+		}
+
+		return inserted;
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::remove(SlotHandle item)
+	{
+		//Stale handles are recognized by the storage
+		OctreeItem<T, Engine>* found = m_Items.find(item);
+
+		if (!found)
+		{
+			return false;
+		}
+
+		/*Basicly, finds the location of the handle inside the tree
+		and demands the tree to erase it from its content*/
+		m_Root->erase(item, found->item_position);
+
+		//Deletes the original item from the storage
 		m_Items.erase(item);
 
-		//
-		return false;
+		return true;
 	}
 
 
-	template<typename T>
-	void ContainedOctree<T>::clear()
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::clear()
 	{
+		//The pending shift would only bring the items back
+		m_Shift.reset();
+
 		//And the whole Octree
-		m_Root.clear();
+		m_Root->clear();
 
 		//Clears the list of items
-
-		//TODO: CLEAR THE NEW STRUCTS BEFORE DELETING
-
 		m_Items.clear();
 	}
 
@@ -330,73 +717,430 @@ namespace DataStructures {
 	* /  Space altering  /
 	*/////////////////////
 
-	template<typename T>
-	void ContainedOctree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
 	{
-		//Storing the new coordinates for the tree
-		std::array<glm::vec3, 2> bounding_box = m_Root.aabb().bounding_region();
+		//The pending shift goes first, so the moves add up
+		if (m_Shift)
+		{
+			m_Shift->worker.join();
+			apply_shift(returned_data);
+		}
+
+		//The tree hands out only the items it can't keep in place, the ones of the cells that stay aren't touched at all
+		std::vector<SlotHandle> removed;
+		auto take = [&removed](SlotHandle& handle) { removed.push_back(handle); };
+
+		Collisions::AABB previous = m_Root->aabb();
+		m_Root->shift(leaf_nodes, direction, take);
+
+		std::list<std::pair<T, Collisions::AABB>> evicted;
+		reinsert(removed, evicted);
+
+		page(previous, evicted, returned_data);
+	}
 
-		//Getting the side length for the calculations
-		size_t leaf_side_length = m_Root.leaf_node_side_length();
 
-		//Calculating the bounding box
-		switch (direction)
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::shift(glm::ivec3 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		//The pending shift goes first, so the moves add up
+		if (m_Shift)
 		{
-		case Coordinates::Directions::North:
+			m_Shift->worker.join();
+			apply_shift(returned_data);
+		}
 
-			bounding_box[0].z -= leaf_nodes * leaf_side_length;
-			bounding_box[1].z -= leaf_nodes * leaf_side_length;
+		std::vector<SlotHandle> removed;
+		auto take = [&removed](SlotHandle& handle) { removed.push_back(handle); };
 
-			break;
-		case Coordinates::Directions::South:
+		Collisions::AABB previous = m_Root->aabb();
+		m_Root->shift(leaf_offset, take);
 
-			bounding_box[0].z += leaf_nodes * leaf_side_length;
-			bounding_box[1].z += leaf_nodes * leaf_side_length;
+		std::list<std::pair<T, Collisions::AABB>> evicted;
+		reinsert(removed, evicted);
 
-			break;
-		case Coordinates::Directions::East:
+		page(previous, evicted, returned_data);
+	}
 
-			bounding_box[0].x += leaf_nodes * leaf_side_length;
-			bounding_box[1].x += leaf_nodes * leaf_side_length;
 
-			break;
-		case Coordinates::Directions::West:
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::shift_async(glm::ivec3 leaf_offset)
+	{
+		if (m_Shift)
+		{
+			return false;
+		}
+
+		m_Shift = std::make_unique<PendingShift>();
+		PendingShift* pending = m_Shift.get();
 
-			bounding_box[0].x -= leaf_nodes * leaf_side_length;
-			bounding_box[1].x -= leaf_nodes * leaf_side_length;
+		//The copy of the boxes is all that the worker reads, so the current tree stays free for the queries and the changes
+		pending->items.reserve(m_Items.size());
 
-			break;
+		for (size_t i = 0; i < m_Items.size(); i++)
+		{
+			SlotHandle handle = m_Items.handle_at(i);
+			pending->items.push_back({ handle, m_Items.at(handle).item_position.aabb });
 		}
 
-		//Resizing the tree
-		m_Root.resize({ bounding_box[0], bounding_box[1] });
+		//The moved tree has the same settings, only its box is moved by the offset
+		std::array<glm::vec3, 2> bounding_box = m_Root->aabb().bounding_region();
+		glm::vec3 offset = glm::vec3(leaf_offset) * (float)m_Root->leaf_node_side_length();
+		Collisions::AABB area(bounding_box[0] + offset, bounding_box[1] + offset);
+
+		size_t max_depth = m_Root->max_depth();
+		size_t min_dimensions = m_Root->min_dimensions();
+		bool lazy_subdivision = m_Root->lazy_subdivision();
+		bool multi_thread = m_Root->multi_thread();
+
+		pending->worker = std::thread([pending, area, max_depth, min_dimensions, lazy_subdivision, multi_thread]() {
+			pending->root = std::make_unique<Engine<SlotHandle>>(area, max_depth, min_dimensions, lazy_subdivision);
+			pending->root->set_multi_thread(multi_thread);
+			pending->locations.resize(pending->items.size());
 
-		//Iterator of the items list
-		typename std::list<OctreeItem<T>>::iterator it = m_Items.begin();
+			//Built in batches, so clear(), resize() or a load don't wait for the whole tree they are about to throw away
+			std::vector<std::pair<SlotHandle, Collisions::AABB>> batch;
+			std::vector<typename Engine<SlotHandle>::Location> locations;
 
-		//Bulk inserting the content of the tree
-		while (it != m_Items.end())
+			for (size_t first = 0; first < pending->items.size(); first += SHIFT_BUILD_BATCH)
+			{
+				if (pending->cancelled.load(std::memory_order_relaxed))
+				{
+					return;
+				}
+
+				size_t last = std::min(first + SHIFT_BUILD_BATCH, pending->items.size());
+				batch.assign(pending->items.begin() + first, pending->items.begin() + last);
+
+				pending->root->insert(batch, locations);
+				std::copy(locations.begin(), locations.end(), pending->locations.begin() + first);
+			}
+
+			pending->ready.store(true, std::memory_order_release);
+		});
+
+		return true;
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::shift_ready()
+	{
+		return m_Shift && m_Shift->ready.load(std::memory_order_acquire);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::publish_shift(std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		if (!shift_ready())
 		{
+			return false;
+		}
+
+		//The worker is done, joining it only lets the thread go
+		m_Shift->worker.join();
+		apply_shift(returned_data);
+
+		return true;
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::set_chunk_store(ChunkStore<T>* Store)
+	{
+		m_Store = Store;
+	}
+
+
+	/*////////////////////
+	* /     Snapshot     /
+	*/////////////////////
+
+
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::save(const std::string& path)
+	{
+		//The handles mean nothing outside of this container, so the items are written in their place
+		auto convert = [this](SlotHandle& handle) {
+			OctreeItem<T, Engine>& stored = m_Items.at(handle);
+			std::array<glm::vec3, 2> region = stored.item_position.aabb.bounding_region();
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+			Snapshot::Item<T> record;
+			record.item = stored.item;
+
+			for (int i = 0; i < 3; i++)
+			{
+				record.minimum[i] = minimum[i];
+				record.maximum[i] = maximum[i];
+			}
+
+			return record;
+		};
+
+		return m_Root->template save<Snapshot::Item<T>>(path, convert);
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	bool ContainedOctree<T, Engine>::load(const std::string& path)
+	{
+		//The items are gathered aside, the current ones stay valid until the file turns out to be whole
+		OctreeContainer items;
+
+		auto place = [&items](const Snapshot::Item<T>& record, NodeItems<SlotHandle>& container) {
+			glm::vec3 lower(record.minimum[0], record.minimum[1], record.minimum[2]);
+			glm::vec3 upper(record.maximum[0], record.maximum[1], record.maximum[2]);
+
+			SlotHandle handle = items.insert({ record.item, {} });
+			size_t slot = container.insert(handle);
+
+			items.at(handle).item_position = { &container, slot, Collisions::AABB(lower, upper) };
+		};
+
+		if (!m_Root->template load<Snapshot::Item<T>>(path, place))
+		{
+			return false;
+		}
+
+		//The pending shift was built out of the items that are gone now
+		m_Shift.reset();
+		m_Items = std::move(items);
+
+		return true;
+	}
+
+
+	/*
+	* //////////////////////////////
+	* /  Private member functions  /
+	* //////////////////////////////
+	*/
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::reinsert(std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		//Going backwards, so the items moved in place of the erased ones have already been handled
+		for (size_t i = m_Items.size(); i-- > 0;)
+		{
+			SlotHandle handle = m_Items.handle_at(i);
+			OctreeItem<T, Engine>& item = m_Items.at(handle);
+
+			//The handle stays the same, only its location inside the tree changes
+			Collisions::AABB area = item.item_position.aabb;
+			item.item_position = m_Root->insert(handle, area);
 
 			//If the item cannot be inserted, it means that is has been discarded
-			if (!(m_Root.insert(it, it->item_position.aabb)).items_container)
+			if (!item.item_position.items_container)
 			{
 				//Giving the info about the item that didn't fit
-				returned_data.push_back({it->item, it->item_position.aabb});
+				returned_data.push_back({ item.item, area });
+
+				m_Items.erase(handle);
+			}
+		}
+	}
 
-				//Incrementing the iterator
-				it++;
 
-				//Deleting and proceeding further
-				m_Items.erase(std::prev(it));
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::reinsert(std::vector<SlotHandle>& handles, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		for (SlotHandle handle : handles)
+		{
+			//The items removed in the meantime are skipped, their handles are stale
+			if (!m_Items.contains(handle))
+			{
+				continue;
+			}
+
+			OctreeItem<T, Engine>& item = m_Items.at(handle);
+
+			//Going back in with the own box of the item
+			Collisions::AABB area = item.item_position.aabb;
+			item.item_position = m_Root->insert(handle, area);
+
+			//If the item cannot be inserted, it means that is has been discarded
+			if (!item.item_position.items_container)
+			{
+				//Giving the info about the item that didn't fit
+				returned_data.push_back({ item.item, area });
+
+				m_Items.erase(handle);
+			}
+		}
+	}
+
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::apply_shift(std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		std::unique_ptr<PendingShift> pending = std::move(m_Shift);
+		Engine<SlotHandle>& root = *pending->root;
+
+		Collisions::AABB previous = m_Root->aabb();
+		std::list<std::pair<T, Collisions::AABB>> evicted;
+
+		//The items of the copy that are still here take their places in the moved tree, the removed ones leave it.
+		//A handle of the removed item is stale, even if its slot holds another item by now
+		for (size_t i = 0; i < pending->items.size(); i++)
+		{
+			SlotHandle handle = pending->items[i].first;
+			typename Engine<SlotHandle>::Location& location = pending->locations[i];
+			OctreeItem<T, Engine>* item = m_Items.find(handle);
+
+			if (!location.items_container)
+			{
+				//Outside of the moved tree
+				if (item)
+				{
+					evicted.push_back({ item->item, pending->items[i].second });
+					m_Items.erase(handle);
+				}
+			}
+			else if (item)
+			{
+				item->item_position = location;
+			}
+			else
+			{
+				root.erase(handle, location);
+			}
+		}
+
+		//The swap itself, the old tree goes away together with the rest of the pending shift
+		m_Root.swap(pending->root);
+
+		//The items inserted in the meantime are carried over one by one
+		reinsert(pending->inserted, evicted);
+
+		page(previous, evicted, returned_data);
+	}
+
+
+
+	template<typename T, template<typename> class Engine>
+	void ContainedOctree<T, Engine>::page(Collisions::AABB previous, std::list<std::pair<T, Collisions::AABB>>& evicted, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		if (!m_Store)
+		{
+			returned_data.splice(returned_data.end(), evicted);
+			return;
+		}
+
+		Collisions::AABB area = m_Root->aabb();
+
+		//Only the items wholly outside of the tree are written down, the ones still reaching into it are the caller's
+		std::vector<std::pair<T, Collisions::AABB>> leaving;
+
+		for (std::pair<T, Collisions::AABB>& item : evicted)
+		{
+			if (area.intersects2(item.second))
+			{
+				returned_data.push_back(item);
+			}
+			else
+			{
+				leaving.push_back(item);
+			}
+		}
+
+		m_Store->store(leaving);
+
+		//Everything stored lies outside of the previous area, so only the part that came in can bring anything back.
+		//A chunk that couldn't be read stays in the store, it's tried again once the tree comes over it the next time
+		std::vector<std::pair<T, Collisions::AABB>> entering;
+
+		for (Collisions::AABB& slab : outside(area, previous))
+		{
+			m_Store->load(slab, entering);
+		}
+
+		leaving.clear();
+
+		for (std::pair<T, Collisions::AABB>& item : entering)
+		{
+			if (insert(item.first, item.second))
+			{
 				continue;
 			}
-			
-			//Incrementing the iterator
-			++it;
 
+			if (area.intersects2(item.second))
+			{
+				returned_data.push_back(item);
+			}
+			else
+			{
+				leaving.push_back(item);
+			}
+		}
+
+		m_Store->store(leaving);
+
+		//The next move is expected to go the same way, so the part it would bring in is read ahead
+		std::array<glm::vec3, 2> before = previous.bounding_region();
+		std::array<glm::vec3, 2> after = area.bounding_region();
+		glm::vec3 offset = after[0] - before[0];
+
+		if (offset.x != 0.0f || offset.y != 0.0f || offset.z != 0.0f)
+		{
+			Collisions::AABB next(after[0] + offset, after[1] + offset);
+
+			for (Collisions::AABB& slab : outside(next, area))
+			{
+				m_Store->prefetch(slab);
+			}
+		}
+	}
+
+
+	template<typename T, template<typename> class Engine>
+	std::vector<Collisions::AABB> ContainedOctree<T, Engine>::outside(Collisions::AABB& area, Collisions::AABB& other)
+	{
+		std::array<glm::vec3, 2> region = area.bounding_region();
+		std::array<glm::vec3, 2> cut = other.bounding_region();
+		glm::vec3 minimum = glm::min(region[0], region[1]);
+		glm::vec3 maximum = glm::max(region[0], region[1]);
+		glm::vec3 lower = glm::min(cut[0], cut[1]);
+		glm::vec3 upper = glm::max(cut[0], cut[1]);
+
+		std::vector<Collisions::AABB> slabs;
+
+		//Apart from each other, the whole area is outside
+		for (int i = 0; i < 3; i++)
+		{
+			if (maximum[i] <= lower[i] || minimum[i] >= upper[i])
+			{
+				slabs.push_back(area);
+				return slabs;
+			}
+		}
+
+		//The slabs of every axis are cut off, what's left narrows down to the other area on that axis
+		for (int i = 0; i < 3; i++)
+		{
+			if (minimum[i] < lower[i])
+			{
+				glm::vec3 end = maximum;
+				end[i] = lower[i];
+				slabs.push_back(Collisions::AABB(minimum, end));
+				minimum[i] = lower[i];
+			}
+
+			if (maximum[i] > upper[i])
+			{
+				glm::vec3 start = minimum;
+				start[i] = upper[i];
+				slabs.push_back(Collisions::AABB(start, maximum));
+				maximum[i] = upper[i];
+			}
 		}
 
+		return slabs;
 	}
 
 }
@@ -0,0 +1,1058 @@
+//Default Libraries
+#include<list>
+#include<array>
+#include<queue>
+#include<vector>
+#include<cmath>
+#include<algorithm>
+
+//Dependencies
+#include "Morton.h"
+#include "../Common/Parallel.h"
+
+#ifndef LINEAR_OCTREE_H
+#define LINEAR_OCTREE_H 1
+
+//Macros
+#define LINEAR_PENDING_MINIMUM 256
+
+
+/*
+* A pointerless version of the Octree. There are no nodes at all, every item
+* is kept in one continuous array, sorted by the Morton code of the smallest cell
+* that fully contains it. A whole subtree is then just a range of codes, so the
+* searches are done with binary searches over that array instead of chasing pointers.
+* It offers the same interface as the Octree, so it can be used as the engine
+* of the ContainedOctree. Unlike the Octree, a cell takes any number of the items,
+* and the box searches report exactly the items whose boxes intersect the area.
+* The searches never change the tree, the fresh entries wait in a short unsorted
+* list searched by hand, and the erased ones are only marked until enough of them pile up.
+*/
+
+
+namespace DataStructures {
+
+
+	template<typename T>
+	class LinearOctree
+	{
+
+		//A single item of the tree together with its code
+		struct Entry
+		{
+			uint64_t code;
+			size_t level;
+			Collisions::AABB aabb;
+			T item;
+
+			//Erased entries stay in the array until it's compacted, the searches skip them
+			bool erased = false;
+		};
+
+		//Sorting order of the entries, parents go before their children
+		static bool entry_order(const Entry& left, const Entry& right);
+
+		//Finds the code and the level of the smallest cell that contains the area
+		bool locate(Collisions::AABB& area, uint64_t& code, size_t& level);
+
+		//Calculates the bounds of the cell with the given code
+		Collisions::AABB cell_bounds(uint64_t code, size_t level);
+
+		//Moves the freshly inserted entries into the sorted array, and drops the erased ones
+		void flush(void);
+
+		//Flushes once the unsorted entries got too many to search them one by one, or the erased ones take too much of the array
+		void settle(void);
+
+		//Recalculates the grid after a change of the tree bounds
+		void update_grid(void);
+
+		//The movement along the map direction, in the leaf nodes on every axis
+		static glm::ivec3 direction_offset(size_t leaf_nodes, Coordinates::Directions direction);
+
+		//The pair search over a part of the sorted array, path holds the entries enclosing the first one
+		template<typename F>
+		bool pairs_in_range(size_t first, size_t last, std::vector<Entry*>& path, F& on_pair);
+
+		//The pairs with at least one of the entries not sorted in yet
+		template<typename F>
+		bool pending_pairs(F& on_pair);
+
+		//Set of minimal recursive functions that just do their tasks, without tree safety
+		template<typename F>
+		bool recursive_query(uint64_t code, size_t level, typename std::vector<Entry>::iterator first, typename std::vector<Entry>::iterator last, Collisions::AABB& area, F& on_hit);
+
+	protected:
+
+		//The dimensions of the tree
+		Collisions::AABB m_Position;
+		glm::vec3 m_Minimum;
+		glm::vec3 m_CellSize;
+		size_t m_LeafNodeSide;
+		size_t m_MinimumDimensions;
+
+		// Depth checking
+		size_t m_MaxDepth;
+
+		// The flag set
+		bool m_NodeReady = false;
+		bool m_MultiThread = true;
+
+		//All of the items, sorted by their codes
+		std::vector<Entry> m_Entries;
+
+		//Items inserted since the last flush, in no order, they are sorted into the array in bulk
+		std::vector<Entry> m_Pending;
+
+		//The entries of the array marked as erased
+		size_t m_Erased = 0;
+
+	public:
+
+		//The position of an item inside the tree, returned by the insertion
+		struct Location
+		{
+			LinearOctree<T>* items_container = nullptr;
+			uint64_t code = 0;
+			size_t level = 0;
+			Collisions::AABB aabb;
+		};
+
+		/*
+		* Initialisation
+		*/
+
+		LinearOctree();
+		LinearOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions);
+
+		//There are no nodes to build up front, the flag is only there for the same interface as the Octree
+		LinearOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision);
+		~LinearOctree();
+
+		/*
+		* Dimensions && Position
+		*/
+
+		size_t min_dimensions();
+		size_t leaf_node_side_length();
+		Collisions::AABB& aabb();
+		void resize(Collisions::AABB area);
+
+		/*
+		* Capacity
+		*/
+
+		size_t size();
+		size_t max_size();
+		size_t depth();
+		size_t max_depth();
+		bool lazy_subdivision();
+		bool multi_thread();
+		void set_multi_thread(bool MultiThread);
+		bool empty();
+
+		/*
+		* Element access
+		*/
+
+		void dfs(Collisions::AABB& area, std::list<T>& items);
+
+		//Calls on_hit(item) for every found item without allocating, the search stops as soon as it returns false
+		//The tree cannot be modified from inside of on_hit
+		template<typename F>
+		bool query(Collisions::AABB& area, F&& on_hit);
+		void query(Collisions::AABB& area, std::vector<T>& items);
+
+		//Calls on_pair(first, second) once for every pair of the items with overlapping boxes, the search stops as soon as it returns false
+		//The boxes are kept with the entries, bounds is there only for the same interface as the Octree, and isn't called
+		template<typename B, typename F>
+		bool overlapping_pairs(B&& bounds, F&& on_pair);
+
+		//The same pairs appended to a vector, the array is split between the threads when the tree is multi threaded
+		template<typename B>
+		void overlapping_pairs(B&& bounds, std::vector<std::pair<T, T>>& pairs);
+
+		void bfs(Collisions::AABB& area, std::list<T>& items);
+		bool contains(Collisions::AABB& area);
+		void erase_area(Collisions::AABB& area, std::list<T>& items);
+
+		/*
+		* Modifiers
+		*/
+
+		Location insert(T object, Collisions::AABB area);
+		void insert(std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Location>& locations);
+		bool erase(T object, Location& location);
+		void clear();
+
+		/*
+		* Movement
+		*/
+
+		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//The same movement, with every item handed to on_removed(item) and the tree left empty, as the codes of all of them change
+		template<typename F>
+		void shift(size_t leaf_nodes, Coordinates::Directions direction, F&& on_removed);
+
+		//Moves the tree by any number of the leaf nodes on every axis at once, the positive y goes up
+		void shift(glm::ivec3 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		template<typename F>
+		void shift(glm::ivec3 leaf_offset, F&& on_removed);
+	};
+
+
+	/*
+	* ///////////////////////
+	* /		Definitions     /
+	* ///////////////////////
+	*/
+
+
+	//Default Constructor
+	template<typename T>
+	LinearOctree<T>::LinearOctree()
+	{
+		// Does nothing, because the tree doesn't have the bounding space defined
+	}
+
+
+	//Area setting constructor
+	template<typename T>
+	LinearOctree<T>::LinearOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions) :
+		m_Position(BoundingBox)
+	{
+		//The codes can only describe a limited number of levels
+		m_MaxDepth = std::min<size_t>(MaxDepth, MORTON_MAX_DEPTH);
+		m_MinimumDimensions = MinimumDimensions;
+
+		//Calculating the cells
+		update_grid();
+
+		m_NodeReady = true;
+	}
+
+
+	template<typename T>
+	LinearOctree<T>::LinearOctree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision) :
+		LinearOctree(BoundingBox, MaxDepth, MinimumDimensions)
+	{}
+
+
+	//
+	template<typename T>
+	LinearOctree<T>::~LinearOctree()
+	{}
+
+
+	/*////////////////////
+	* /     Capacity     /
+	*/////////////////////
+
+	template<typename T>
+	size_t LinearOctree<T>::min_dimensions()
+	{
+		return m_MinimumDimensions;
+	}
+
+
+	template<typename T>
+	size_t LinearOctree<T>::leaf_node_side_length()
+	{
+		return m_LeafNodeSide;
+	}
+
+
+	template<typename T>
+	Collisions::AABB& LinearOctree<T>::aabb()
+	{
+		return m_Position;
+	}
+
+
+	template<typename T>
+	void LinearOctree<T>::resize(Collisions::AABB area)
+	{
+		//Temporary storage of the bounds
+		std::array<glm::vec3, 2> bounds = area.bounding_region();
+
+		//Updating the coordinates
+		m_Position.update_position(bounds[0], bounds[1]);
+		update_grid();
+
+		//The data is invalidated
+		clear();
+	}
+
+
+	template<typename T>
+	size_t LinearOctree<T>::size()
+	{
+		return m_Entries.size() - m_Erased + m_Pending.size();
+	}
+
+
+	template<typename T>
+	size_t LinearOctree<T>::max_size()
+	{
+		//Returns a theoretical maximum size, which equals to the maximum possible leaf cells
+		return std::pow(8, m_MaxDepth);
+	}
+
+
+	template<typename T>
+	size_t LinearOctree<T>::depth()
+	{
+		return 0;
+	}
+
+
+	template<typename T>
+	size_t LinearOctree<T>::max_depth()
+	{
+		return m_MaxDepth;
+	}
+
+
+	//The cells exist only as the codes of the entries, so nothing is ever built before it's needed
+	template<typename T>
+	bool LinearOctree<T>::lazy_subdivision()
+	{
+		return true;
+	}
+
+
+	template<typename T>
+	bool LinearOctree<T>::multi_thread()
+	{
+		return m_MultiThread;
+	}
+
+
+	template<typename T>
+	void LinearOctree<T>::set_multi_thread(bool MultiThread)
+	{
+		m_MultiThread = MultiThread;
+	}
+
+
+	template<typename T>
+	bool LinearOctree<T>::empty()
+	{
+		return size() == 0;
+	}
+
+
+	/*////////////////////
+	* / Element Access   /
+	*/////////////////////
+
+
+	//Searches for a given area inside the tree
+	template<typename T>
+	void LinearOctree<T>::dfs(Collisions::AABB& area, std::list<T>& items)
+	{
+		auto push = [&items](T& item) { items.push_back(item); return true; };
+
+		query(area, push);
+	}
+
+
+	//Searches for a given area inside the tree, handing every found item to the visitor, returns false if it was stopped
+	template<typename T>
+	template<typename F>
+	bool LinearOctree<T>::query(Collisions::AABB& area, F&& on_hit)
+	{
+		//The root cell covers the whole array
+		if (!recursive_query(0, 0, m_Entries.begin(), m_Entries.end(), area, on_hit))
+		{
+			return false;
+		}
+
+		//The few entries not sorted in yet are checked one by one
+		for (Entry& entry : m_Pending)
+		{
+			if (entry.aabb.intersects2(area) && !on_hit(entry.item)) return false;
+		}
+
+		return true;
+	}
+
+
+	//Searches for a given area inside the tree, appending to a vector that can be reused between the searches
+	template<typename T>
+	void LinearOctree<T>::query(Collisions::AABB& area, std::vector<T>& items)
+	{
+		auto push = [&items](T& item) { items.push_back(item); return true; };
+
+		query(area, push);
+	}
+
+
+	//Reports every pair of the overlapping items once, walking the sorted array with a stack of the enclosing entries
+	template<typename T>
+	template<typename B, typename F>
+	bool LinearOctree<T>::overlapping_pairs(B&&, F&& on_pair)
+	{
+		std::vector<Entry*> path;
+
+		if (!pairs_in_range(0, m_Entries.size(), path, on_pair))
+		{
+			return false;
+		}
+
+		return pending_pairs(on_pair);
+	}
+
+
+	//Reports every pair of the overlapping items once, every part of the array is searched into its own buffer
+	template<typename T>
+	template<typename B>
+	void LinearOctree<T>::overlapping_pairs(B&&, std::vector<std::pair<T, T>>& pairs)
+	{
+		size_t parts = 1;
+
+		if (m_MultiThread && m_Entries.size() >= 2 * PARALLEL_MINIMUM_TASK_SIZE)
+		{
+			parts = std::min(Parallel::worker_count() * 4, m_Entries.size() / PARALLEL_MINIMUM_TASK_SIZE);
+		}
+
+		size_t length = (m_Entries.size() + parts - 1) / parts;
+		std::vector<std::vector<std::pair<T, T>>> buffers(parts);
+
+		Parallel::run(parts, [&](size_t i) {
+			size_t first = std::min(m_Entries.size(), i * length);
+			size_t last = std::min(m_Entries.size(), first + length);
+
+			if (first == last)
+			{
+				return;
+			}
+
+			//The enclosing cells of the first entry are found by their codes, one level after another
+			std::vector<Entry*> path;
+			Entry& start = m_Entries[first];
+
+			for (size_t level = 0; level <= start.level; ++level)
+			{
+				uint64_t span = Morton::span(level, m_MaxDepth);
+				std::pair<uint64_t, size_t> cell = { start.code / span * span, level };
+
+				typename std::vector<Entry>::iterator it = std::lower_bound(m_Entries.begin(), m_Entries.begin() + first, cell,
+					[](const Entry& entry, const std::pair<uint64_t, size_t>& cell) { return std::make_pair(entry.code, entry.level) < cell; });
+
+				for (; it != m_Entries.begin() + first && it->code == cell.first && it->level == cell.second; ++it)
+				{
+					if (!it->erased) path.push_back(&*it);
+				}
+			}
+
+			std::vector<std::pair<T, T>>& buffer = buffers[i];
+			auto collect = [&buffer](T& first, T& second) { buffer.push_back({ first, second }); return true; };
+
+			pairs_in_range(first, last, path, collect);
+		});
+
+		size_t total = pairs.size();
+
+		for (std::vector<std::pair<T, T>>& buffer : buffers)
+		{
+			total += buffer.size();
+		}
+
+		pairs.reserve(total);
+
+		for (std::vector<std::pair<T, T>>& buffer : buffers)
+		{
+			pairs.insert(pairs.end(), buffer.begin(), buffer.end());
+		}
+
+		//The unsorted entries are few, they are paired on this thread
+		auto collect = [&pairs](T& first, T& second) { pairs.push_back({ first, second }); return true; };
+		pending_pairs(collect);
+	}
+
+
+	//Searches for a given area inside the tree, level by level
+	template<typename T>
+	void LinearOctree<T>::bfs(Collisions::AABB& area, std::list<T>& items)
+	{
+		//A cell waiting in the queue, together with the range of its entries
+		struct Cell
+		{
+			uint64_t code;
+			size_t level;
+			typename std::vector<Entry>::iterator first;
+			typename std::vector<Entry>::iterator last;
+		};
+
+		//Contains the main working queue
+		std::queue<Cell> cells;
+		cells.push({ 0, 0, m_Entries.begin(), m_Entries.end() });
+
+		while (!cells.empty())
+		{
+			Cell cell = cells.front();
+			cells.pop();
+
+			//Empty cells and the ones outside of the area are skipped
+			if (cell.first == cell.last)
+			{
+				continue;
+			}
+
+			Collisions::AABB bounds = cell_bounds(cell.code, cell.level);
+
+			if (!bounds.intersects2(area))
+			{
+				continue;
+			}
+
+			//Items of the cell itself are at the beginning of its range
+			typename std::vector<Entry>::iterator it = cell.first;
+
+			for (; it != cell.last && it->code == cell.code && it->level == cell.level; ++it)
+			{
+				if (!it->erased && it->aabb.intersects2(area))
+				{
+					items.push_back(it->item);
+				}
+			}
+
+			if (cell.level == m_MaxDepth)
+			{
+				continue;
+			}
+
+			//Placing the children ranges to the queue
+			uint64_t child_span = Morton::span(cell.level + 1, m_MaxDepth);
+
+			for (uint8_t i = 0; i < 8; ++i)
+			{
+				typename std::vector<Entry>::iterator end = std::lower_bound(it, cell.last, cell.code + (i + 1) * child_span,
+					[](const Entry& entry, uint64_t code) { return entry.code < code; });
+
+				cells.push({ cell.code + i * child_span, cell.level + 1, it, end });
+				it = end;
+			}
+		}
+
+		//The unsorted entries come last, below every level
+		for (Entry& entry : m_Pending)
+		{
+			if (entry.aabb.intersects2(area))
+			{
+				items.push_back(entry.item);
+			}
+		}
+	}
+
+
+	//Checks whether the tree contains a certain area
+	template<typename T>
+	bool LinearOctree<T>::contains(Collisions::AABB& area)
+	{
+		return m_Position.contains(area);
+	}
+
+
+	template<typename T>
+	void LinearOctree<T>::erase_area(Collisions::AABB& area, std::list<T>& items)
+	{
+		flush();
+
+		//Single pass over the array, the order of the remaining entries is kept
+		typename std::vector<Entry>::iterator end = std::remove_if(m_Entries.begin(), m_Entries.end(),
+			[&](Entry& entry) {
+				if (entry.aabb.intersects2(area))
+				{
+					items.push_back(entry.item);
+					return true;
+				}
+				return false;
+			});
+
+		m_Entries.erase(end, m_Entries.end());
+	}
+
+
+	/*////////////////////
+	* /    Modifiers     /
+	*/////////////////////
+
+
+	template<typename T>
+	typename LinearOctree<T>::Location LinearOctree<T>::insert(T object, Collisions::AABB area)
+	{
+		//Checking whether anything can be inserted
+		if (!m_NodeReady)
+		{
+			return {};
+		}
+
+		Entry entry{ 0, 0, area, object };
+
+		if (!locate(area, entry.code, entry.level))
+		{
+			return {};
+		}
+
+		//The entry is sorted in together with the others, once there are enough of them
+		m_Pending.push_back(entry);
+		settle();
+
+		return { this, entry.code, entry.level, area };
+	}
+
+
+	//The entries are only located here, the flush sorts them in bulk
+	template<typename T>
+	void LinearOctree<T>::insert(std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Location>& locations)
+	{
+		locations.assign(items.size(), {});
+
+		//Checking whether anything can be inserted
+		if (!m_NodeReady)
+		{
+			return;
+		}
+
+		//The codes are found independently for every item, so the big insertions do it on all threads
+		std::vector<uint64_t> codes(items.size());
+		std::vector<size_t> levels(items.size(), SIZE_MAX);
+
+		auto locate_range = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				if (!locate(items[i].second, codes[i], levels[i])) levels[i] = SIZE_MAX;
+			}
+		};
+
+		if (m_MultiThread && items.size() >= 2 * PARALLEL_MINIMUM_TASK_SIZE)
+		{
+			Parallel::run_ranges(items.size(), locate_range);
+		}
+		else
+		{
+			locate_range(0, items.size());
+		}
+
+		m_Pending.reserve(m_Pending.size() + items.size());
+
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			if (levels[i] == SIZE_MAX)
+			{
+				continue;
+			}
+
+			m_Pending.push_back({ codes[i], levels[i], items[i].second, items[i].first });
+			locations[i] = { this, codes[i], levels[i], items[i].second };
+		}
+
+		settle();
+	}
+
+
+	template<typename T>
+	bool LinearOctree<T>::erase(T object, Location& location)
+	{
+		if (location.items_container != this)
+		{
+			return false;
+		}
+
+		//The unsorted entries are few, the last one takes the place of the erased one
+		for (Entry& entry : m_Pending)
+		{
+			if (entry.item == object && entry.code == location.code && entry.level == location.level)
+			{
+				entry = m_Pending.back();
+				m_Pending.pop_back();
+				location.items_container = nullptr;
+
+				return true;
+			}
+		}
+
+		//In the array only the entries of the same cell have to be checked, the found one is just marked
+		Entry cell{ location.code, location.level, location.aabb, object };
+		auto range = std::equal_range(m_Entries.begin(), m_Entries.end(), cell, entry_order);
+
+		for (typename std::vector<Entry>::iterator it = range.first; it != range.second; ++it)
+		{
+			if (!it->erased && it->item == object)
+			{
+				it->erased = true;
+				m_Erased++;
+				location.items_container = nullptr;
+
+				settle();
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+
+	template<typename T>
+	void LinearOctree<T>::clear()
+	{
+		m_Entries.clear();
+		m_Pending.clear();
+		m_Erased = 0;
+	}
+
+
+	/*////////////////////
+	* /  Space altering  /
+	*/////////////////////
+
+
+	template<typename T>
+	void LinearOctree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		shift(direction_offset(leaf_nodes, direction), returned_data);
+	}
+
+
+	template<typename T>
+	template<typename F>
+	void LinearOctree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, F&& on_removed)
+	{
+		shift(direction_offset(leaf_nodes, direction), on_removed);
+	}
+
+
+	template<typename T>
+	void LinearOctree<T>::shift(glm::ivec3 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		//Storing the new coordinates for the tree
+		std::array<glm::vec3, 2> bounding_box = m_Position.bounding_region();
+		glm::vec3 offset = glm::vec3(leaf_offset) * (float)m_LeafNodeSide;
+
+		bounding_box[0] += offset;
+		bounding_box[1] += offset;
+
+		flush();
+
+		//Moving the grid, the entries themselves stay where they are
+		m_Position.update_position(bounding_box[0], bounding_box[1]);
+		update_grid();
+
+		//Recoding every entry in place, the ones that don't fit anymore are given back
+		typename std::vector<Entry>::iterator end = std::remove_if(m_Entries.begin(), m_Entries.end(),
+			[&](Entry& entry) {
+				if (!locate(entry.aabb, entry.code, entry.level))
+				{
+					returned_data.push_back({ entry.item, entry.aabb });
+					return true;
+				}
+				return false;
+			});
+
+		m_Entries.erase(end, m_Entries.end());
+
+		//The codes have changed, so the order has to be restored
+		std::sort(m_Entries.begin(), m_Entries.end(), entry_order);
+	}
+
+
+	template<typename T>
+	template<typename F>
+	void LinearOctree<T>::shift(glm::ivec3 leaf_offset, F&& on_removed)
+	{
+		flush();
+
+		for (Entry& entry : m_Entries)
+		{
+			on_removed(entry.item);
+		}
+
+		m_Entries.clear();
+
+		//Only the grid is left to move
+		std::list<std::pair<T, Collisions::AABB>> returned_data;
+		shift(leaf_offset, returned_data);
+	}
+
+
+	/*
+	* //////////////////////////////
+	* /  Private member functions  /
+	* //////////////////////////////
+	*/
+
+
+	template<typename T>
+	glm::ivec3 LinearOctree<T>::direction_offset(size_t leaf_nodes, Coordinates::Directions direction)
+	{
+		int distance = (int)leaf_nodes;
+		glm::ivec3 offset(0);
+
+		switch (direction)
+		{
+		case Coordinates::Directions::North:
+			offset.z = -distance;
+			break;
+		case Coordinates::Directions::South:
+			offset.z = distance;
+			break;
+		case Coordinates::Directions::East:
+			offset.x = distance;
+			break;
+		case Coordinates::Directions::West:
+			offset.x = -distance;
+			break;
+		}
+
+		return offset;
+	}
+
+
+	template<typename T>
+	bool LinearOctree<T>::entry_order(const Entry& left, const Entry& right)
+	{
+		if (left.code != right.code)
+		{
+			return left.code < right.code;
+		}
+
+		return left.level < right.level;
+	}
+
+
+	template<typename T>
+	bool LinearOctree<T>::locate(Collisions::AABB& area, uint64_t& code, size_t& level)
+	{
+		//Items that stick out of the tree can't be placed anywhere
+		if (!m_Position.contains(area))
+		{
+			return false;
+		}
+
+		std::array<glm::vec3, 2> bounds = area.bounding_region();
+
+		//The leaf cells of both of the corners
+		uint32_t last_cell = (1u << m_MaxDepth) - 1;
+		uint32_t minimum[3];
+		uint32_t maximum[3];
+
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			float low = std::min(bounds[0][i], bounds[1][i]) - m_Minimum[i];
+			float high = std::max(bounds[0][i], bounds[1][i]) - m_Minimum[i];
+
+			minimum[i] = std::min<uint32_t>((uint32_t)std::max(0.0f, std::floor(low / m_CellSize[i])), last_cell);
+			maximum[i] = std::min<uint32_t>((uint32_t)std::max(0.0f, std::floor(high / m_CellSize[i])), last_cell);
+		}
+
+		//The highest differing bit tells how many levels up the corners meet in one cell
+		uint32_t difference = (minimum[0] ^ maximum[0]) | (minimum[1] ^ maximum[1]) | (minimum[2] ^ maximum[2]);
+		size_t levels_up = 0;
+
+		while (difference)
+		{
+			difference >>= 1;
+			levels_up++;
+		}
+
+		level = m_MaxDepth - levels_up;
+
+		//The code of the cell is the code of its first leaf
+		code = Morton::encode(minimum[0] >> levels_up << levels_up, minimum[1] >> levels_up << levels_up, minimum[2] >> levels_up << levels_up);
+
+		return true;
+	}
+
+
+	template<typename T>
+	Collisions::AABB LinearOctree<T>::cell_bounds(uint64_t code, size_t level)
+	{
+		uint32_t x, y, z;
+		Morton::decode(code, x, y, z);
+
+		//Side of the cell on the given level
+		glm::vec3 size = m_CellSize * (float)(1u << (m_MaxDepth - level));
+		glm::vec3 minimum = m_Minimum + glm::vec3(x * m_CellSize.x, y * m_CellSize.y, z * m_CellSize.z);
+
+		return { minimum, minimum + size };
+	}
+
+
+	template<typename T>
+	void LinearOctree<T>::flush(void)
+	{
+		//The erased entries go first, the order of the rest is kept
+		if (m_Erased)
+		{
+			m_Entries.erase(std::remove_if(m_Entries.begin(), m_Entries.end(), [](const Entry& entry) { return entry.erased; }), m_Entries.end());
+			m_Erased = 0;
+		}
+
+		if (m_Pending.empty())
+		{
+			return;
+		}
+
+		//Sorting only the new entries, and merging them with the already sorted ones
+		std::sort(m_Pending.begin(), m_Pending.end(), entry_order);
+
+		size_t middle = m_Entries.size();
+		m_Entries.insert(m_Entries.end(), m_Pending.begin(), m_Pending.end());
+		std::inplace_merge(m_Entries.begin(), m_Entries.begin() + middle, m_Entries.end(), entry_order);
+
+		m_Pending.clear();
+	}
+
+
+	//Both of the limits grow with the array, so a flush is paid off by the insertions or the erasures since the last one
+	template<typename T>
+	void LinearOctree<T>::settle(void)
+	{
+		size_t pending_limit = std::max<size_t>(LINEAR_PENDING_MINIMUM, (size_t)std::sqrt((double)m_Entries.size()));
+
+		if (m_Pending.size() > pending_limit || m_Erased * 4 > m_Entries.size())
+		{
+			flush();
+		}
+	}
+
+
+	template<typename T>
+	void LinearOctree<T>::update_grid(void)
+	{
+		std::array<glm::vec3, 2> bounds = m_Position.bounding_region();
+
+		//The grid starts at the minimal corner, whatever the order of the corners is
+		m_Minimum = glm::min(bounds[0], bounds[1]);
+		m_CellSize = (glm::max(bounds[0], bounds[1]) - m_Minimum) / (float)(1u << m_MaxDepth);
+
+		//Calculating the side length
+		m_LeafNodeSide = m_CellSize.x;
+	}
+
+
+	template<typename T>
+	template<typename F>
+	bool LinearOctree<T>::recursive_query(uint64_t code, size_t level, typename std::vector<Entry>::iterator first, typename std::vector<Entry>::iterator last, Collisions::AABB& area, F& on_hit)
+	{
+		//No items below this cell
+		if (first == last)
+		{
+			return true;
+		}
+
+		Collisions::AABB bounds = cell_bounds(code, level);
+
+		//Checking for overlapping
+		if (!bounds.intersects2(area))
+		{
+			return true;
+		}
+
+		//If the whole cell is inside of the area, then the whole range is too
+		if (area.contains(bounds))
+		{
+			for (; first != last; ++first)
+			{
+				if (!first->erased && !on_hit(first->item)) return false;
+			}
+
+			return true;
+		}
+
+		//Items of the cell itself are at the beginning of its range
+		for (; first != last && first->code == code && first->level == level; ++first)
+		{
+			if (!first->erased && first->aabb.intersects2(area))
+			{
+				if (!on_hit(first->item)) return false;
+			}
+		}
+
+		if (level == m_MaxDepth)
+		{
+			return true;
+		}
+
+		//Splitting the rest of the range between the children
+		uint64_t child_span = Morton::span(level + 1, m_MaxDepth);
+
+		for (uint8_t i = 0; i < 8 && first != last; ++i)
+		{
+			typename std::vector<Entry>::iterator end = std::lower_bound(first, last, code + (i + 1) * child_span,
+				[](const Entry& entry, uint64_t code) { return entry.code < code; });
+
+			if (!recursive_query(code + i * child_span, level + 1, first, end, area, on_hit))
+			{
+				return false;
+			}
+
+			first = end;
+		}
+
+		return true;
+	}
+
+
+
+	template<typename T>
+	template<typename F>
+	bool LinearOctree<T>::pairs_in_range(size_t first, size_t last, std::vector<Entry*>& path, F& on_pair)
+	{
+		for (size_t i = first; i < last; ++i)
+		{
+			Entry& entry = m_Entries[i];
+
+			if (entry.erased)
+			{
+				continue;
+			}
+
+			//A cell covers the codes of all of its leaves, the entries that don't enclose this one are left
+			while (!path.empty() && entry.code >= path.back()->code + Morton::span(path.back()->level, m_MaxDepth))
+			{
+				path.pop_back();
+			}
+
+			for (Entry* other : path)
+			{
+				if (other->aabb.intersects2(entry.aabb) && !on_pair(other->item, entry.item)) return false;
+			}
+
+			path.push_back(&entry);
+		}
+
+		return true;
+	}
+
+
+	//The unsorted entries against the array, found by a search with the box of each of them, and against each other
+	template<typename T>
+	template<typename F>
+	bool LinearOctree<T>::pending_pairs(F& on_pair)
+	{
+		for (size_t i = 0; i < m_Pending.size(); ++i)
+		{
+			Entry& entry = m_Pending[i];
+			auto pair = [&](T& other) { return on_pair(other, entry.item); };
+
+			if (!recursive_query(0, 0, m_Entries.begin(), m_Entries.end(), entry.aabb, pair))
+			{
+				return false;
+			}
+
+			for (size_t j = 0; j < i; ++j)
+			{
+				if (m_Pending[j].aabb.intersects2(entry.aabb) && !on_pair(m_Pending[j].item, entry.item)) return false;
+			}
+		}
+
+		return true;
+	}
+}
+#endif
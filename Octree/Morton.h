@@ -0,0 +1,79 @@
+//Default Libraries
+#include<cstdint>
+
+#ifndef MORTON_H
+#define MORTON_H 1
+
+//Macros
+#define MORTON_MAX_DEPTH 21
+
+
+/*
+* Morton (Z-order) codes for the linear trees. Every axis gets 21 bits,
+* interleaved as x in the lowest bit, then y and z, so a single 64 bit
+* code describes any cell of a tree that is at most 21 levels deep.
+* The children of one cell always occupy a continuous range of codes.
+*/
+
+
+namespace DataStructures {
+
+	namespace Morton {
+
+
+		//Spreads the lowest 21 bits of the value, so that there are two empty bits between each of them
+		inline uint64_t spread(uint32_t value)
+		{
+			uint64_t x = value & 0x1fffff;
+
+			x = (x | x << 32) & 0x1f00000000ffff;
+			x = (x | x << 16) & 0x1f0000ff0000ff;
+			x = (x | x << 8) & 0x100f00f00f00f00f;
+			x = (x | x << 4) & 0x10c30c30c30c30c3;
+			x = (x | x << 2) & 0x1249249249249249;
+
+			return x;
+		}
+
+
+		//Reverses the spreading, by gathering every third bit back together
+		inline uint32_t compact(uint64_t value)
+		{
+			uint64_t x = value & 0x1249249249249249;
+
+			x = (x ^ (x >> 2)) & 0x10c30c30c30c30c3;
+			x = (x ^ (x >> 4)) & 0x100f00f00f00f00f;
+			x = (x ^ (x >> 8)) & 0x1f0000ff0000ff;
+			x = (x ^ (x >> 16)) & 0x1f00000000ffff;
+			x = (x ^ (x >> 32)) & 0x1fffff;
+
+			return (uint32_t)x;
+		}
+
+
+		//Builds the code out of the cell coordinates
+		inline uint64_t encode(uint32_t x, uint32_t y, uint32_t z)
+		{
+			return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+		}
+
+
+		//Gives back the cell coordinates hidden in the code
+		inline void decode(uint64_t code, uint32_t& x, uint32_t& y, uint32_t& z)
+		{
+			x = compact(code);
+			y = compact(code >> 1);
+			z = compact(code >> 2);
+		}
+
+
+		//How many leaf codes are covered by a single cell on the given level
+		inline uint64_t span(size_t level, size_t max_depth)
+		{
+			return (uint64_t)1 << (3 * (max_depth - level));
+		}
+
+	}
+
+}
+#endif
@@ -1,11 +1,26 @@
 //Default Libraries
 #include<list>
+#include<cmath>
+#include<vector>
+#include<cstdint>
 #include<queue>
 #include<memory>
+#include<limits>
+#include<string>
 #include<iostream>
 #include<algorithm>
 
 //Dependencies
+#include "../Common/NodePool.h"
+#include "../Common/NodeItems.h"
+#include "../Common/SimdBounds.h"
+#include "../Common/TraversalStack.h"
+#include "../Common/Parallel.h"
+#include "../Common/Raycast.h"
+#include "../Common/Shapes.h"
+#include "../Common/Snapshot.h"
+#include "../Common/Torus.h"
+
 #ifndef AABB_H
 #define AABB_H 1
 
@@ -28,6 +43,14 @@
 */
 
 
+namespace Trees {
+
+	//Defined together with the ContainedOctree
+	template<typename T>
+	struct Location;
+
+}
+
 
 namespace DataStructures {
 
@@ -36,6 +59,9 @@ namespace DataStructures {
 	class Octree
 	{
 
+		//The trees of the other item types, for the searches that go through two trees at once
+		template<typename U>
+		friend class Octree;
 
 		/*
 		* Place for the aliases,
@@ -47,76 +73,181 @@ namespace DataStructures {
 		//Alias for the octant coordinates
 		using OctantBoxes = std::array<Collisions::AABB, 8>;
 
-		//Trick for storing the data about Octants
-		enum class Octants : unsigned char {
-			O1 = 0x01, // = 0b00000001 -> 1 << 1
-			O2 = 0x02, // = 0b00000010 -> 1 << 2
-			O3 = 0x04, // = 0b00000100 -> 1 << 3
-			O4 = 0x08, // = 0b00001000 -> 1 << 4
-			O5 = 0x10, // = 0b00010000 -> 1 << 5
-			O6 = 0x20, // = 0b00100000 -> 1 << 6
-			O7 = 0x40, // = 0b01000000 -> 1 << 7
-			O8 = 0x80  // = 0b10000000 -> 1 << 8
+		//Alias for the octants, they are owned by the node pool of the root and known by their index in it
+		using OctantIndices = std::array<uint32_t, 8>;
+
+		//Everything that is the same for every node of the tree, owned by the root
+		struct SharedData
+		{
+			//The pool that all of the nodes are allocated from
+			NodePool<Octree<T>> pool;
+
+			//The half extents of the nodes on every depth, a node finds its own by its depth
+			std::vector<glm::vec3> half_extents;
+
+			//The nodes above this depth are allowed to subdivide
+			size_t subdivision_depth = 0;
+
+			//Where the nodes lie in the world, the shifts only move the seam of it
+			Torus torus;
+
+			size_t leaf_node_side = 0;
+			size_t minimum_dimensions = 0;
+			size_t max_depth = 0;
+			bool lazy_subdivision = false;
+			bool multi_thread = false;
 		};
 
-		//Intelligently calculates the BB's for all needed octants
-		void calculate_bounding_box(Collisions::AABB& BoundingBox, Octants Octant);
+		//Sets the center of the root and the sizes of every level below it
+		void update_dimensions(Collisions::AABB& area);
+
+		//The geometry of the octants, derived from the center of the node
+		glm::vec3 octant_center(uint8_t octant);
+		glm::vec3 octant_center(const glm::vec3& center, size_t depth, uint8_t octant);
+		Collisions::AABB octant_bounds(uint8_t octant);
+
+		//The only octant that can hold the whole area, or -1 if the area crosses the center
+		int containing_octant(Collisions::AABB& area);
+		int containing_octant(const glm::vec3& center, size_t depth, const glm::vec3& minimum, const glm::vec3& maximum);
 
 		//Speaks for itself
 		bool is_leaf_node(void);
 
-		//
-		std::array<std::shared_ptr<Octree<T>>, 8>& access_octants();
+		//Checks the depth and the dimensions limits before any subdivision
+		bool can_subdivide(void);
+
+		//Turns the index of an active octant into the node
+		Octree<T>* octant(uint8_t index);
+
+		//The octants of the node reaching into the area, tested against the planes splitting the node,
+		//or one by one for the node across the seam, whose octants don't lie next to each other in the world
+		unsigned overlap_mask(Octree<T>& node, Collisions::AABB& area);
+
+		//The same, but creates the octant first if it doesn't exist yet, in the reserved pool slot if one is given
+		Octree<T>* obtain_octant(uint8_t index, uint32_t* reserved_slot = nullptr);
+
+		//Gives the whole subtree back to the node pool
+		void release_octants(void);
 
 		//
 		void collect_items(std::list<std::pair<T, Collisions::AABB>>& items);
 
-		//Set of minimal recursive functions that just do their tasks, without tree safety
-		void recursive_subdivide(void); //OK
-		void recursive_dfs(Collisions::AABB& area, std::list<T>& items); //OK
+		//The number of levels from this node down to the deepest possible one
+		size_t levels(void);
+
+		//The iterative traversal engine. visit(node, descend) is called for every node in the depth first order,
+		//it can narrow down the mask of the octants to descend into, and returning false stops the whole walk
+		template<typename F>
+		bool traverse(F& visit);
+
+		//The pair search below this node, path holds the items above it that can still reach into it
+		template<typename B, typename F>
+		bool pairs_below(std::vector<std::pair<T*, Collisions::AABB>>& path, B& bounds, F& on_pair);
+
+		//Calls on_pair(other, item) for the items of this subtree overlapping any of the other items, possibly from another tree
+		template<typename I, typename B, typename F>
+		bool pairs_with(std::vector<std::pair<I*, Collisions::AABB>>& others, B& bounds, F& on_pair);
+
+		//The movement along the map direction, in the leaf nodes on every axis
+		static glm::ivec3 direction_offset(size_t leaf_nodes, Coordinates::Directions direction);
+
+		//Moves the seam of the world by the cells of the deepest level, the nodes themselves stay where they are.
+		//on_removed(item, position) gets the items of the nodes that reach out of the moved world, only the nodes reaching into
+		//the leaving slabs are visited. Returns false if the offset doesn't line up with the cells, or it's the whole world or more
+		template<typename F>
+		bool wrap_cells(glm::vec3 offset, F& on_removed);
+
+		//Set of minimal functions that just do their tasks, without tree safety
+		void subdivide(void); //OK
 		Trees::Location<T> recursive_insert(T object, Collisions::AABB area); //OK
-		void recursive_resize(Collisions::AABB& area); //OK
+
+		//Whether the node takes the item of the area, a node holds a single item, but the root takes all of the items
+		//lying across the wrap of a shifted world, there's no other node holding them
+		bool takes(Collisions::AABB& area);
+
+		//The node of an item in the bulk insertion, as the Morton code of the path leading to it, 3 bits per level
+		struct Placement
+		{
+			uint64_t code;
+			size_t level;
+			size_t item;
+		};
+
+		//A subtree of the bulk insertion that is built on its own thread, inside of its own range of pool slots
+		struct BuildTask
+		{
+			Octree<T>* node;
+			size_t level;
+			Placement* first;
+			Placement* last;
+			uint32_t reserved_slot;
+			size_t reserved;
+
+			//The nodes above, they learn how many items the task has added once it's done
+			std::vector<Octree<T>*> ancestors;
+			size_t inserted;
+		};
+
+		//Parts of the bulk insertion
+		Placement place(Collisions::AABB& area, size_t item, size_t path_length);
+		static uint8_t path_octant(uint64_t code, size_t level, size_t path_length);
+		static size_t new_nodes(Placement* first, Placement* last, size_t level, size_t path_length);
+		size_t build(Octree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, uint32_t* reserved_slot);
+		void split_build(Octree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, std::vector<Octree<T>*>& ancestors, std::vector<BuildTask>& tasks);
 
 
 	protected:
 
-		//The dimensions of the tree
-		Collisions::AABB m_Position;
-		size_t m_LeafNodeSide;
-		size_t m_MinimumDimensions;
+		/*
+		* A node keeps only what differs between the nodes. The bounds are derived from the center
+		* and the half extents of its depth, the bounds of the Octants are derived from the
+		* same values while traversing, and the settings of the tree are shared through the root.
+		* On a 64 bit build, with the 8 byte SlotHandle as T, a node takes 112 bytes, so two cache lines,
+		* the item count of the subtree fills the padding in front of the shared data pointer.
+		*/
+
+		// The center of the node
+		glm::vec3 m_Center;
 
 		// Depth checking
-		size_t m_MaxDepth;
-		size_t m_Depth = 0;
+		uint16_t m_Depth = 0;
 
 		// A clever way of knowing whether the Octants are active
 		// if the value is shifted 8 times to the left, that means, that all of the octants have been set
-		unsigned char m_ActiveOctants;
-
-		// The bounds of the potential Octants
-		OctantBoxes m_OctantsBounds;
-
-		// The Octants themselves, will be made with the use of a bounds calulating function
-		std::array<std::shared_ptr<Octree<T>>, 8> m_Octants;
+		unsigned char m_ActiveOctants = 0;
 
 		// The flag set
 		bool m_IsLeaf = false;
 		bool m_NodeReady = false;
 		bool m_IsRoot = false;
-		bool m_MultiThread = false;
+
+		// The Octants themselves, only the ones marked as active are valid
+		OctantIndices m_Octants = {};
+
+		// The number of the items in the whole subtree, kept up to date by every insertion and erasure
+		uint32_t m_Count = 0;
+
+		// The settings and the pool of the tree, owned by the root
+		SharedData* m_Data = nullptr;
+		std::unique_ptr<SharedData> m_OwnedData;
 
 		//Item that the node is storing. Can become anything that the programmer wants it to
-		std::list<T> m_Item;
+		//The first items are kept inline, and every item keeps its slot until erased
+		NodeItems<T> m_Item;
 
 	public:
 
+		//The position of an item inside the tree, returned by the insertion
+		using Location = Trees::Location<T>;
+
 		/*
 		* Initialisation
 		*/
 
 		Octree();
 		Octree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions);
-		Octree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, size_t Depth);
+		Octree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision);
+		Octree(glm::vec3 Center, size_t Depth, SharedData* Data);
 		Octree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, std::list<std::shared_ptr<T>> Items);
 		~Octree();
 
@@ -126,7 +257,7 @@ namespace DataStructures {
 
 		size_t min_dimensions();
 		size_t leaf_node_side_length();
-		Collisions::AABB& aabb();
+		Collisions::AABB aabb();
 		OctantBoxes octants_positions();
 		void resize(Collisions::AABB area);
 
@@ -138,30 +269,118 @@ namespace DataStructures {
 		size_t max_size(); //OK
 		size_t depth(); //OK
 		size_t max_depth(); //OK
+		bool lazy_subdivision(); //OK
+		bool multi_thread();
+		void set_multi_thread(bool MultiThread);
 		bool empty(); //OK
 
 		/*
 		* Element access
 		*/
 
-		void dfs(Collisions::AABB& area, std::list<T>& items); //TODO
-		void bfs(Collisions::AABB& area, std::list<T>& items); //TODO
+		void dfs(Collisions::AABB& area, std::list<T>& items);
+
+		//Calls on_hit(item) for every found item without allocating, the search stops as soon as it returns false
+		//The tree cannot be modified from inside of on_hit
+		template<typename F>
+		bool query(Collisions::AABB& area, F&& on_hit);
+		void query(Collisions::AABB& area, std::vector<T>& items);
+
+		//Many searches in one walk, results[i] gets the same items as the search of areas[i] would, in the same order
+		//The buffers are only cleared, so they can be kept between the calls without allocating again
+		void query(std::vector<Collisions::AABB>& areas, std::vector<std::vector<T>>& results);
+
+		//Whether any item box overlaps the area, and how many of them do, bounds(item) gives the box of an item
+		//The subtrees lying inside of the area add their item counts without going down, the empty ones are skipped
+		template<typename B>
+		bool any(Collisions::AABB& area, B&& bounds);
+		template<typename B>
+		size_t count(Collisions::AABB& area, B&& bounds);
+
+		//Calls on_hit(item) for the items whose boxes intersect the shape, bounds(item) gives the box of an item, returning false stops the search
+		//The shape answers intersects(box) and contains(box), like the ones in Shapes.h, the subtrees inside of it are reported without any tests
+		template<typename S, typename B, typename F>
+		bool query_shape(const S& shape, B&& bounds, F&& on_hit);
+
+		//Calls on_pair(first, second) once for every pair of the items with overlapping boxes, bounds(item) gives the box of an item
+		//The search stops as soon as on_pair returns false, the tree cannot be modified from inside of it
+		template<typename B, typename F>
+		bool overlapping_pairs(B&& bounds, F&& on_pair);
+
+		//The same pairs appended to a vector, the subtrees are searched on all threads when the tree is multi threaded
+		template<typename B>
+		void overlapping_pairs(B&& bounds, std::vector<std::pair<T, T>>& pairs);
+
+		//Calls on_pair(item, other_item) once for every item of this tree overlapping an item of the other one
+		//Both of the trees are walked together, the node pairs with the separate boxes are skipped as a whole
+		template<typename U, typename B, typename C, typename F>
+		bool overlapping_pairs(Octree<U>& other, B&& bounds, C&& other_bounds, F&& on_pair);
+
+		//Calls on_hit(item, distance) for the items hit by the ray origin + t * direction with t up to max_distance, the nearest ones first
+		//bounds(item) gives the box of an item, the cast stops as soon as on_hit returns false, so stopping on the first call gives the first hit
+		template<typename B, typename F>
+		bool raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, B&& bounds, F&& on_hit);
+
+		//Appends the k items nearest to the point, the nearest first, bounds(item) gives the box of an item
+		//The distance is measured to the nearest point of the box, the items farther than max_distance are left out
+		template<typename B>
+		void nearest(glm::vec3 point, size_t k, B&& bounds, std::vector<T>& items, float max_distance = std::numeric_limits<float>::infinity());
+
+		//Calls on_visible(item) for the items inside of the frustum, bounds(item) gives the box of an item, returning false stops the search
+		//A plane is a normal with the distance in w, the inside is where dot(normal, point) + w >= 0. The subtrees found inside of a plane
+		//aren't tested against it anymore, and the ones inside of all of them are reported without any tests
+		template<typename B, typename F>
+		bool cull(const std::array<glm::vec4, 6>& planes, B&& bounds, F&& on_visible);
+
+		void bfs(Collisions::AABB& area, std::list<T>& items);
 		bool contains(Collisions::AABB& area); //OK
 		void erase_area(Collisions::AABB& area, std::list<T>& items);
-		std::list<T> access_elements();
+		NodeItems<T>& access_elements();
 
 		/*
 		* Modifiers
 		*/
 
 		Trees::Location<T> insert(T object, Collisions::AABB area); //OK
+		void insert(std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations);
+		bool erase(T object, Trees::Location<T>& location);
 		void clear(); //OK 
 
 		/*
 		* Movement
 		*/
 
-		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data); //TODO
+		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//The same movement, but the items taken out of the tree are handed to on_removed(item), to be inserted again or dropped by the caller.
+		//The nodes stay where they are and the world wraps around them, see Torus.h, only the items of the nodes reaching out of the moved world are taken out
+		template<typename F>
+		void shift(size_t leaf_nodes, Coordinates::Directions direction, F&& on_removed);
+
+		//Moves the tree by any number of the leaf nodes on every axis at once, the positive y goes up.
+		//A diagonal or a vertical move costs the same single pass as the one along a map direction
+		void shift(glm::ivec3 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		template<typename F>
+		void shift(glm::ivec3 leaf_offset, F&& on_removed);
+
+		/*
+		* Snapshot
+		*/
+
+		//Writes the whole tree into the flat file described in Snapshot.h, the items byte by byte, so T has to be trivially copyable
+		bool save(const std::string& path);
+
+		//Puts the tree of the file in place of this one, the nodes are created straight from the mapped file in one pass, without any insertions.
+		//Returns false and leaves the tree as it was if the file isn't a whole snapshot of an Octree of the same T
+		bool load(const std::string& path);
+
+		//The same, with the items written as the records of R, convert(item) gives the record of an item.
+		//place(record, items) puts the item of the record into the items of its node, this way the containers add their own data
+		template<typename R, typename C>
+		bool save(const std::string& path, C&& convert);
+		template<typename R, typename P>
+		bool load(const std::string& path, P&& place);
 	};
 
 
@@ -174,54 +393,62 @@ namespace DataStructures {
 
 	//Default Constructor
 	template<typename T>
-	Octree<T>::Octree()
+	Octree<T>::Octree() :
+		m_OwnedData(std::make_unique<SharedData>())
 	{
 		// Does nothing, because the Octree doesn't have the bounding space defined
+		m_Data = m_OwnedData.get();
+		m_Data->half_extents.assign(1, glm::vec3(0.0f));
+		m_IsRoot = true;
 	}
 
 
 	//Area setting constructor, should be always first
 	template<typename T>
 	Octree<T>::Octree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions) :
-		m_Position(BoundingBox)
+		Octree(BoundingBox, MaxDepth, MinimumDimensions, false)
+	{}
+
+
+	//Area setting constructor, that can postpone creating the children until an insertion needs them
+	template<typename T>
+	Octree<T>::Octree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision) :
+		m_OwnedData(std::make_unique<SharedData>())
 	{
+		//The root shares the settings and the pool with every node below
+		m_Data = m_OwnedData.get();
+
 		//Setting max depth available for the Tree
-		m_MaxDepth = MaxDepth;
-		m_MinimumDimensions = MinimumDimensions;
+		m_Data->max_depth = MaxDepth;
+		m_Data->minimum_dimensions = MinimumDimensions;
+		m_Data->lazy_subdivision = LazySubdivision;
 
-		//Calculating the side length
-		m_LeafNodeSide = m_Position.dimensions().x / std::pow(2.0, m_MaxDepth);
+		//The big bulk insertions are spread over the threads unless it's turned off
+		m_Data->multi_thread = true;
+
+		//Calculating the center and the sizes of the levels
+		update_dimensions(BoundingBox);
 
 		//Every octree starts as a leaf node before any subdivisions
 		m_IsLeaf = true;
 		m_NodeReady = true;
 		m_IsRoot = true;
-		m_MultiThread = true;
 
 		//Proceeds to subdivision
-		recursive_subdivide();
+		subdivide();
 	}
 
 
-	//Area setting constructor, that takes a depth param, used in subdivision
+	//Node constructor, used in subdivision, the size follows from the depth
 	template<typename T>
-	Octree<T>::Octree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, size_t Depth) :
-		m_Position(BoundingBox), m_Depth(Depth)
+	Octree<T>::Octree(glm::vec3 Center, size_t Depth, SharedData* Data) :
+		m_Center(Center), m_Depth((uint16_t)Depth), m_Data(Data)
 	{
 		//Every octree starts as a leaf node before any subdivisions
 		m_IsLeaf = true;
 		m_NodeReady = true;
 
-		//Sets the current level
-		m_Depth = Depth;
-		m_MaxDepth = MaxDepth;
-		m_MinimumDimensions = MinimumDimensions;
-
-		//Calculating the side length
-		m_LeafNodeSide = m_Position.dimensions().x / std::pow(2.0, m_MaxDepth);
-
-		//Proceeds to subdivision
-		recursive_subdivide();
+		//The subdivision is driven by the root, level after level without recursion
 	}
 
 
@@ -238,47 +465,40 @@ namespace DataStructures {
 	template<typename T>
 	size_t Octree<T>::leaf_node_side_length()
 	{
-		return m_LeafNodeSide;
+		return m_Data->leaf_node_side;
 	}
 
 
 	template<typename T>
-	Collisions::AABB& Octree<T>::aabb()
+	Collisions::AABB Octree<T>::aabb()
 	{
-		return m_Position;
+		return m_Data->torus.bounds(m_Center, m_Data->half_extents[m_Depth]);
 	}
 
 
 	template<typename T>
 	std::array<Collisions::AABB, 8> Octree<T>::octants_positions()
 	{
-		return m_OctantsBounds;
-	}
-
-
-	template<typename T>
-	size_t Octree<T>::size()
-	{
-		size_t count = 0;
-
-		//Checks if the item is allocated
-		if (!m_Item.empty())
-		{
-			//If yes, then adds one to count
-			count += m_Item.size();
-		}
+		OctantBoxes bounds;
 
-		//Iterates recursively through all of the octants
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
+		//The nodes that cannot subdivide don't have any octants
+		if (can_subdivide())
 		{
-			if (m_Octants[i])
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
 			{
-				count += m_Octants[i]->size();
+				bounds[i] = octant_bounds(i);
 			}
 		}
 
-		//Returns the final value and recursive iteration values
-		return count;
+		return bounds;
+	}
+
+
+	template<typename T> inline
+		size_t Octree<T>::size()
+	{
+		//Every node knows the items of its whole subtree
+		return m_Count;
 	}
 
 
@@ -286,14 +506,14 @@ namespace DataStructures {
 	size_t Octree<T>::max_size()
 	{
 		//Returns a theoretical maximum size, which equals to the maximum possible nodes
-		return std::pow(NUMBER_OF_OCTANTS, m_MaxDepth);
+		return std::pow(NUMBER_OF_OCTANTS, m_Data->max_depth);
 	}
 
 
 	template<typename T>
 	size_t Octree<T>::min_dimensions()
 	{
-		return m_MinimumDimensions;
+		return m_Data->minimum_dimensions;
 	}
 
 
@@ -307,23 +527,47 @@ namespace DataStructures {
 	template<typename T> inline
 		size_t Octree<T>::max_depth()
 	{
-		return m_MaxDepth;
+		return m_Data->max_depth;
+	}
+
+
+	template<typename T> inline
+		bool Octree<T>::lazy_subdivision()
+	{
+		return m_Data->lazy_subdivision;
+	}
+
+
+	template<typename T> inline
+		bool Octree<T>::multi_thread()
+	{
+		return m_Data->multi_thread;
+	}
+
+
+	template<typename T> inline
+		void Octree<T>::set_multi_thread(bool MultiThread)
+	{
+		m_Data->multi_thread = MultiThread;
 	}
 
 
 	template<typename T>
 	void Octree<T>::resize(Collisions::AABB area)
 	{
+		//Updating the coordinates
+		update_dimensions(area);
+
 		//The tree has to be built a new, data is invalidated
-		recursive_resize(area);
+		clear();
 	}
 
 
 	template<typename T>
 	bool Octree<T>::empty()
 	{
-		//If there are no Octants in the root node, then the tree is empty
-		if (!m_Octants[0]) return true;
+		//Nothing is stored in the node, nor anywhere below it
+		return m_Count == 0;
 	}
 
 
@@ -336,608 +580,2280 @@ namespace DataStructures {
 	template<typename T>
 	void Octree<T>::dfs(Collisions::AABB& area, std::list<T>& items)
 	{
-		//This can go deep into the recursion
-		recursive_dfs(area, items);
+		auto push = [&items](T& item) { items.push_back(item); return true; };
+
+		query(area, push);
 	}
 
 
-	//Searches for a given area inside the tree
+	//Searches for a given area inside the tree, handing every found item to the visitor, returns false if it was stopped
 	template<typename T>
-	void Octree<T>::bfs(Collisions::AABB& area, std::list<T>& items)
+	template<typename F>
+	bool Octree<T>::query(Collisions::AABB& area, F&& on_hit)
 	{
-		//Lamda for asigning the children to the queue
-		auto asign_children = [](std::list<std::shared_ptr<Octree<T>>>& temp_queue, std::array<std::shared_ptr<Octree<T>>, 8>& temp) {
-			//Pushing the octants to a temporary container
-			for (uint8_t j = 0; j < NUMBER_OF_OCTANTS; ++j)
+		auto visit = [&](Octree<T>& node, unsigned& descend) {
+			//Checking the node for the items
+			if (!node.m_Item.empty())
 			{
-				if (temp[j])
+				Collisions::AABB position = node.aabb();
+
+				//Adding an item if it fits the octree, or items if they cross through trees
+				if (position.contains(area))
 				{
-					//If the pointer isn't null, I am placing it on to the queue
-					temp_queue.push_back(temp[j]);
+					for (auto& it : node.m_Item)
+					{
+						if (!on_hit(it)) return false;
+					}
 				}
-				else
+				else if (node.is_leaf_node() && position.intersects2(area))
 				{
-					//Else I tell the function, that We propably reached the leaf node
-					return false;
+					for (auto& it : node.m_Item)
+					{
+						if (!on_hit(it)) return false;
+					}
 				}
+			}
 
+			//Checking all of the active child nodes for overlapping at once, against the planes splitting the node
+			if (descend)
+			{
+				descend &= overlap_mask(node, area);
 			}
 
-			//Comes down here when every octant has been found and pushed to the queue
 			return true;
 		};
 
-		//Contains the main working queue
-		std::list<std::shared_ptr<Octree<T>>> octants;
+		return traverse(visit);
+	}
 
-		//Checking if the root contains the item
-		if (!m_Item.empty())
+
+	//Searches for a given area inside the tree, appending to a vector that can be reused between the searches
+	template<typename T>
+	void Octree<T>::query(Collisions::AABB& area, std::vector<T>& items)
+	{
+		auto push = [&items](T& item) { items.push_back(item); return true; };
+
+		query(area, push);
+	}
+
+
+	//Goes down once for all of the areas, every waiting node carries the list of the searches that still reach it
+	template<typename T>
+	void Octree<T>::query(std::vector<Collisions::AABB>& areas, std::vector<std::vector<T>>& results)
+	{
+		results.resize(areas.size());
+
+		for (std::vector<T>& result : results)
 		{
-			//Adding an item if it fits the octree, or items if they cross through trees
-			if (area.contains(m_Position))
-			{
-				for (const auto& it : m_Item)
-				{
-					items.push_back((it));
-				}
-			}
+			result.clear();
 		}
 
-		//Placing the root octants to the queue
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
+		if (areas.empty())
 		{
-			if (m_Octants[i])
-				octants.push_back(m_Octants[i]);
+			return;
 		}
 
-		//Iterative breadth first search implementation for an octree
-		size_t CurrentDepth = m_Depth;
+		//The searches are sorted by the path to their smallest enclosing node, so the ones going down together lie together
+		std::vector<uint32_t> lists(areas.size());
 
-		while (CurrentDepth < m_MaxDepth)
+		for (uint32_t i = 0; i < lists.size(); ++i)
 		{
-			//Setting current depth
-			CurrentDepth++;
+			lists[i] = i;
+		}
 
-			//For building the next octants queue
-			std::list<std::shared_ptr<Octree<T>>> lower_octants;
+		size_t path_length = levels();
 
-			typename std::list<std::shared_ptr<Octree<T>>>::iterator it;
+		if ((path_length - 1) * 3 <= 63)
+		{
+			std::vector<Placement> placements(areas.size());
 
-			//Using a Lambda, that enables returning only from the 2 nested loops
-			[&] {
-				//Checking the list
-				for (it = octants.begin(); it!=octants.end(); ++it)
-				{
-					//Take the AABB of the octant
-					Collisions::AABB comparing = (**it).aabb();
+			for (size_t i = 0; i < areas.size(); ++i)
+			{
+				placements[i] = place(areas[i], i, path_length);
+			}
 
-					std::array<glm::vec3, 2> test = comparing.bounding_region();
+			std::sort(placements.begin(), placements.end(), [](const Placement& left, const Placement& right) {
+				return left.code != right.code ? left.code < right.code : left.level < right.level;
+			});
 
-					//Compare with the given area
-					if (comparing.intersects2(area)) {
+			for (size_t i = 0; i < placements.size(); ++i)
+			{
+				lists[i] = (uint32_t)placements[i].item;
+			}
+		}
 
-						//Adding an item if it fits the octree, or items if they cross through trees
-						std::list<T> temp = (**it).access_elements();
+		//The lists of the waiting nodes lie one after another, the one on the top of the stack always being the last
+		TraversalStack<std::pair<Octree<T>*, size_t>, NUMBER_OF_OCTANTS> stack(levels());
+		stack.push({ this, 0 });
 
-						if (area.contains(comparing))
-						{
-							for (const auto& it : temp)
-							{
-								items.push_back((it));
-							}
-						}
-						else if (is_leaf_node() && comparing.intersects2(area))
-						{
-							for (const auto& it : temp)
-							{
-								items.push_back((it));
-							}
-						}
+		//The searches of the current node with the octants they reach
+		std::vector<std::pair<uint32_t, unsigned>> active;
 
-					}
+		while (!stack.empty())
+		{
+			std::pair<Octree<T>*, size_t> entry = stack.pop();
+			Octree<T>* node = entry.first;
 
-					//If the tree reached leaf nodes, this fails
-					if (!asign_children(lower_octants, (**it).access_octants()))
+			Collisions::AABB position = node->aabb();
+
+			active.clear();
+
+			for (size_t i = entry.second; i < lists.size(); ++i)
+			{
+				uint32_t search = lists[i];
+				Collisions::AABB& area = areas[search];
+
+				//Taking the items on the same conditions as the single search
+				if (!node->m_Item.empty() && (position.contains(area) || (node->is_leaf_node() && position.intersects2(area))))
+				{
+					for (T& item : node->m_Item)
 					{
-						return;
+						results[search].push_back(item);
 					}
 				}
-			}();
 
-			//Swaping the queues
-			std::swap(octants, lower_octants);
-		}
-	}
+				if (node->m_ActiveOctants)
+				{
+					active.push_back({ search, overlap_mask(*node, area) & node->m_ActiveOctants });
+				}
+			}
 
+			//The list of the node isn't needed anymore, the ones of the octants take its place
+			lists.resize(entry.second);
 
-	//Checks whether the tree contains a certain area
-	template<typename T>
-	bool Octree<T>::contains(Collisions::AABB& area)
-	{
-		return m_Position.contains(area);
+			//Pushed backwards, so that the octants are visited in their order
+			for (int i = NUMBER_OF_OCTANTS - 1; i >= 0; i--)
+			{
+				size_t first = lists.size();
+
+				for (std::pair<uint32_t, unsigned>& search : active)
+				{
+					if (search.second & (1 << i)) lists.push_back(search.first);
+				}
+
+				if (lists.size() > first)
+				{
+					stack.push({ node->octant(i), first });
+				}
+			}
+		}
 	}
 
 
+	//Stops on the first item found, the subtrees without any items aren't entered at all
 	template<typename T>
-	void Octree<T>::erase_area(Collisions::AABB& area, std::list<T>& items)
+	template<typename B>
+	bool Octree<T>::any(Collisions::AABB& area, B&& bounds)
 	{
-		//Checking the parent node for the items
-		if (!m_Item.empty())
-		{
-			//Adding an item if it fits the octree, or items if they cross through trees
-			if (area.contains(m_Position))
+		bool found = false;
+
+		auto visit = [&](Octree<T>& node, unsigned& descend) {
+			if (!node.m_Count)
 			{
-				//Pushing the found item into the list
-				for (const auto& it : m_Item)
-				{
-					items.push_back((it));
-				}
+				descend = 0;
+				return true;
+			}
 
-				m_Item.clear();
+			Collisions::AABB position = node.aabb();
+
+			//Every item below lies inside of the area as well
+			if (area.contains(position))
+			{
+				found = true;
+				return false;
 			}
-			else if (is_leaf_node() && m_Position.intersects2(area))
+
+			for (T& item : node.m_Item)
 			{
-				//Pushing the found item into the list
-				for (const auto& it : m_Item)
+				Collisions::AABB box = bounds(item);
+
+				if (area.intersects2(box))
 				{
-					items.push_back((it));
+					found = true;
+					return false;
 				}
-
-				m_Item.clear();
 			}
-		}
 
-		//Checking the child nodes
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
-		{
-			if (m_Octants[i])
+			if (descend)
 			{
-				//Checking for overlapping
-				if (m_OctantsBounds[i].intersects2(area))
-				{
-					m_Octants[i]->erase_area(area, items);
-				}
+				descend &= overlap_mask(node, area);
 			}
+
+			return true;
+		};
+
+		Collisions::AABB position = aabb();
+
+		if (position.intersects2(area))
+		{
+			traverse(visit);
 		}
 
+		return found;
 	}
 
 
+	//Counts the items, adding the whole subtrees inside of the area at once
 	template<typename T>
-	std::list<T> Octree<T>::access_elements()
+	template<typename B>
+	size_t Octree<T>::count(Collisions::AABB& area, B&& bounds)
 	{
-		return m_Item;
-	}
+		size_t count = 0;
 
+		auto visit = [&](Octree<T>& node, unsigned& descend) {
+			if (!node.m_Count)
+			{
+				descend = 0;
+				return true;
+			}
 
-	/*////////////////////
-	* /    Modifiers     /
-	*/////////////////////
+			Collisions::AABB position = node.aabb();
 
+			if (area.contains(position))
+			{
+				count += node.m_Count;
+				descend = 0;
+				return true;
+			}
 
-	template<typename T>
-	Trees::Location<T> Octree<T>::insert(T object, Collisions::AABB area)
-	{
-		//Checking whether anything can be inserted
-		if (!m_NodeReady)
-		{
-			return {};
-		}
+			for (T& item : node.m_Item)
+			{
+				Collisions::AABB box = bounds(item);
 
-		//
-		return recursive_insert(object, area);
+				if (area.intersects2(box)) count++;
+			}
+
+			if (descend)
+			{
+				descend &= overlap_mask(node, area);
+			}
+
+			return true;
+		};
+
+		Collisions::AABB position = aabb();
+
+		if (position.intersects2(area))
+		{
+			traverse(visit);
+		}
+
+		return count;
+	}
+
+
+	//The same traversal as the box search, with the shape deciding which nodes are reached
+	template<typename T>
+	template<typename S, typename B, typename F>
+	bool Octree<T>::query_shape(const S& shape, B&& bounds, F&& on_hit)
+	{
+		//Everything below a node inside of the shape is found
+		auto found = [&on_hit](Octree<T>& node, unsigned&) {
+			for (T& item : node.m_Item)
+			{
+				if (!on_hit(item)) return false;
+			}
+
+			return true;
+		};
+
+		auto visit = [&](Octree<T>& node, unsigned& descend) {
+			Collisions::AABB position = node.aabb();
+
+			//None of the octants can reach the shape either
+			if (!shape.intersects(position))
+			{
+				descend = 0;
+				return true;
+			}
+
+			if (shape.contains(position))
+			{
+				descend = 0;
+				return node.traverse(found);
+			}
+
+			for (T& item : node.m_Item)
+			{
+				Collisions::AABB box = bounds(item);
+
+				if (shape.intersects(box) && !on_hit(item)) return false;
+			}
+
+			return true;
+		};
+
+		return traverse(visit);
+	}
+
+
+	//Reports every pair of the overlapping items once, bounds(item) gives the box of an item, returns false if it was stopped
+	template<typename T>
+	template<typename B, typename F>
+	bool Octree<T>::overlapping_pairs(B&& bounds, F&& on_pair)
+	{
+		//The items of the nodes on the current path, the nodes of one level don't overlap, so only those can reach the items below
+		std::vector<std::pair<T*, Collisions::AABB>> path;
+
+		return pairs_below(path, bounds, on_pair);
+	}
+
+
+	//Reports every pair of the overlapping items once, every thread writes only to the buffers of its own subtrees
+	template<typename T>
+	template<typename B>
+	void Octree<T>::overlapping_pairs(B&& bounds, std::vector<std::pair<T, T>>& pairs)
+	{
+		//A subtree searched on its own, with the items above it that still reach into it
+		struct PairTask
+		{
+			Octree<T>* node;
+			std::vector<std::pair<T*, Collisions::AABB>> path;
+		};
+
+		auto push = [&pairs](T& first, T& second) { pairs.push_back({ first, second }); return true; };
+
+		std::vector<PairTask> tasks;
+		tasks.push_back({ this, {} });
+
+		//Splitting the top of the tree level by level, until every thread has a few subtrees to take
+		size_t wanted = m_Data->multi_thread ? Parallel::worker_count() * 8 : 1;
+		bool split = true;
+
+		while (tasks.size() < wanted && split)
+		{
+			std::vector<PairTask> next;
+			split = false;
+
+			for (PairTask& task : tasks)
+			{
+				Octree<T>* node = task.node;
+
+				if (!node->m_ActiveOctants)
+				{
+					next.push_back(std::move(task));
+					continue;
+				}
+
+				//The items of the split node are paired right here
+				for (T& item : node->m_Item)
+				{
+					Collisions::AABB box = bounds(item);
+
+					for (std::pair<T*, Collisions::AABB>& other : task.path)
+					{
+						if (other.second.intersects2(box)) push(*other.first, item);
+					}
+
+					task.path.push_back({ &item, box });
+				}
+
+				//Every octant takes only the items that reach into it
+				for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+				{
+					if (!(node->m_ActiveOctants & (1 << i)))
+					{
+						continue;
+					}
+
+					Collisions::AABB area = node->octant_bounds(i);
+					PairTask child = { node->octant(i), {} };
+
+					for (std::pair<T*, Collisions::AABB>& other : task.path)
+					{
+						if (other.second.intersects2(area)) child.path.push_back(other);
+					}
+
+					next.push_back(std::move(child));
+				}
+
+				split = true;
+			}
+
+			tasks.swap(next);
+		}
+
+		//Every task has its own buffer, they are joined in the order of the tasks once all of them are done
+		std::vector<std::vector<std::pair<T, T>>> buffers(tasks.size());
+
+		Parallel::run(tasks.size(), [&](size_t i) {
+			std::vector<std::pair<T, T>>& buffer = buffers[i];
+			auto collect = [&buffer](T& first, T& second) { buffer.push_back({ first, second }); return true; };
+
+			tasks[i].node->pairs_below(tasks[i].path, bounds, collect);
+		});
+
+		size_t total = pairs.size();
+
+		for (std::vector<std::pair<T, T>>& buffer : buffers)
+		{
+			total += buffer.size();
+		}
+
+		pairs.reserve(total);
+
+		for (std::vector<std::pair<T, T>>& buffer : buffers)
+		{
+			pairs.insert(pairs.end(), buffer.begin(), buffer.end());
+		}
+	}
+
+
+	//Reports the overlapping items of two trees, descending through the pairs of nodes with the overlapping boxes
+	template<typename T>
+	template<typename U, typename B, typename C, typename F>
+	bool Octree<T>::overlapping_pairs(Octree<U>& other, B&& bounds, C&& other_bounds, F&& on_pair)
+	{
+		//The node pairs waiting for the search
+		std::vector<std::pair<Octree<T>*, Octree<U>*>> stack;
+
+		Collisions::AABB other_position = other.aabb();
+
+		if (aabb().intersects2(other_position))
+		{
+			stack.push_back({ this, &other });
+		}
+
+		//The items of the current pair of nodes, with their boxes
+		std::vector<std::pair<T*, Collisions::AABB>> mine;
+		std::vector<std::pair<U*, Collisions::AABB>> theirs;
+
+		auto swapped = [&on_pair](U& their, T& my) { return on_pair(my, their); };
+
+		while (!stack.empty())
+		{
+			Octree<T>* node = stack.back().first;
+			Octree<U>* other_node = stack.back().second;
+			stack.pop_back();
+
+			mine.clear();
+			theirs.clear();
+
+			for (T& item : node->m_Item)
+			{
+				mine.push_back({ &item, bounds(item) });
+			}
+
+			for (U& item : other_node->m_Item)
+			{
+				theirs.push_back({ &item, other_bounds(item) });
+			}
+
+			//The items of both of the nodes against each other
+			for (std::pair<T*, Collisions::AABB>& my : mine)
+			{
+				for (std::pair<U*, Collisions::AABB>& their : theirs)
+				{
+					if (my.second.intersects2(their.second) && !on_pair(*my.first, *their.first)) return false;
+				}
+			}
+
+			//The items of every node against everything below the other one, these pairs won't be met deeper
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+			{
+				if (!mine.empty() && (other_node->m_ActiveOctants & (1 << i)))
+				{
+					if (!other_node->octant(i)->pairs_with(mine, other_bounds, on_pair)) return false;
+				}
+
+				if (!theirs.empty() && (node->m_ActiveOctants & (1 << i)))
+				{
+					if (!node->octant(i)->pairs_with(theirs, bounds, swapped)) return false;
+				}
+			}
+
+			//Going down together, only through the octants that overlap
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+			{
+				if (!(node->m_ActiveOctants & (1 << i)))
+				{
+					continue;
+				}
+
+				Collisions::AABB area = node->octant_bounds(i);
+
+				for (uint8_t j = 0; j < NUMBER_OF_OCTANTS; j++)
+				{
+					if (!(other_node->m_ActiveOctants & (1 << j)))
+					{
+						continue;
+					}
+
+					Collisions::AABB other_area = other_node->octant_bounds(j);
+
+					if (area.intersects2(other_area))
+					{
+						stack.push_back({ node->octant(i), other_node->octant(j) });
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+
+	//Walks only the nodes along the ray, nearest entry first, and reports the hit items in the order of their distance
+	template<typename T>
+	template<typename B, typename F>
+	bool Octree<T>::raycast(glm::vec3 origin, glm::vec3 direction, float max_distance, B&& bounds, F&& on_hit)
+	{
+		//The hits waiting until none of the nodes ahead can hold anything nearer, the nearest one on the top
+		std::vector<std::pair<float, T*>> hits;
+		auto farther = [](const std::pair<float, T*>& left, const std::pair<float, T*>& right) { return left.first > right.first; };
+
+		//Reports the waiting hits up to the distance
+		auto report = [&](float distance) {
+			while (!hits.empty() && hits.front().first <= distance)
+			{
+				std::pop_heap(hits.begin(), hits.end(), farther);
+				std::pair<float, T*> hit = hits.back();
+				hits.pop_back();
+
+				if (!on_hit(*hit.second, hit.first)) return false;
+			}
+
+			return true;
+		};
+
+		//Clips the ray to the box, the entry point is the distance of the box
+		auto clip = [&](const Collisions::AABB& box, float& enter) {
+			std::array<glm::vec3, 2> region = box.bounding_region();
+			float exit = max_distance;
+			enter = 0.0f;
+
+			return Raycast::clip_box(origin, direction, glm::min(region[0], region[1]), glm::max(region[0], region[1]), enter, exit);
+		};
+
+		//Every waiting node knows where the ray enters it, the nearest entry on the top. The order of the octants along the ray
+		//can't be told from the signs of its direction, a shifted tree has its octants across the seam far apart in the world
+		std::vector<std::pair<float, Octree<T>*>> nodes;
+		auto later = [](const std::pair<float, Octree<T>*>& left, const std::pair<float, Octree<T>*>& right) { return left.first > right.first; };
+
+		float enter = 0.0f;
+
+		if (clip(aabb(), enter))
+		{
+			nodes.push_back({ enter, this });
+		}
+
+		while (!nodes.empty())
+		{
+			std::pop_heap(nodes.begin(), nodes.end(), later);
+			std::pair<float, Octree<T>*> entry = nodes.back();
+			nodes.pop_back();
+
+			Octree<T>* node = entry.second;
+
+			//The nodes come in the order of their entry points, and the items lie inside of their nodes,
+			//so nothing met from now on can be nearer than this node
+			if (!report(entry.first))
+			{
+				return false;
+			}
+
+			for (T& item : node->m_Item)
+			{
+				std::array<glm::vec3, 2> region = bounds(item).bounding_region();
+				float item_enter = 0.0f;
+				float item_exit = max_distance;
+
+				if (Raycast::clip_box(origin, direction, glm::min(region[0], region[1]), glm::max(region[0], region[1]), item_enter, item_exit))
+				{
+					hits.push_back({ item_enter, &item });
+					std::push_heap(hits.begin(), hits.end(), farther);
+				}
+			}
+
+			if (!node->m_ActiveOctants)
+			{
+				continue;
+			}
+
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+			{
+				if ((node->m_ActiveOctants & (1 << i)) && clip(node->octant_bounds(i), enter))
+				{
+					nodes.push_back({ enter, node->octant(i) });
+					std::push_heap(nodes.begin(), nodes.end(), later);
+				}
+			}
+		}
+
+		return report(max_distance);
+	}
+
+
+	//Best first search, the nodes and the items wait in one queue ordered by their distance to the point
+	template<typename T>
+	template<typename B>
+	void Octree<T>::nearest(glm::vec3 point, size_t k, B&& bounds, std::vector<T>& items, float max_distance)
+	{
+		//Either a node or an item, with the squared distance to its box
+		struct Candidate
+		{
+			float distance;
+			Octree<T>* node;
+			T* item;
+		};
+
+		auto farther = [](const Candidate& left, const Candidate& right) { return left.distance > right.distance; };
+		std::priority_queue<Candidate, std::vector<Candidate>, decltype(farther)> queue(farther);
+
+		//The squared distance to the nearest point of the box, zero inside of it
+		auto distance = [&point](const glm::vec3& minimum, const glm::vec3& maximum) {
+			glm::vec3 offset = glm::clamp(point, minimum, maximum) - point;
+			return glm::dot(offset, offset);
+		};
+
+		//The squared distance to the box of a node in the world
+		auto node_distance = [&distance](const Collisions::AABB& box) {
+			std::array<glm::vec3, 2> region = box.bounding_region();
+			return distance(glm::min(region[0], region[1]), glm::max(region[0], region[1]));
+		};
+
+		float limit = max_distance * max_distance;
+
+		if (k > 0)
+		{
+			queue.push({ node_distance(aabb()), this, nullptr });
+		}
+
+		//A node is never nearer than its box, so once an item comes out of the queue, nothing left can be nearer than it
+		while (!queue.empty() && queue.top().distance <= limit)
+		{
+			Candidate candidate = queue.top();
+			queue.pop();
+
+			if (candidate.item)
+			{
+				items.push_back(*candidate.item);
+
+				if (--k == 0)
+				{
+					return;
+				}
+
+				continue;
+			}
+
+			Octree<T>* node = candidate.node;
+
+			for (T& item : node->m_Item)
+			{
+				std::array<glm::vec3, 2> region = bounds(item).bounding_region();
+
+				queue.push({ distance(glm::min(region[0], region[1]), glm::max(region[0], region[1])), nullptr, &item });
+			}
+
+			if (!node->m_ActiveOctants)
+			{
+				continue;
+			}
+
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+			{
+				if (node->m_ActiveOctants & (1 << i))
+				{
+					queue.push({ node_distance(node->octant_bounds(i)), node->octant(i), nullptr });
+				}
+			}
+		}
+	}
+
+
+	//Frustum culling, every waiting node carries the mask of the planes that it still crosses
+	template<typename T>
+	template<typename B, typename F>
+	bool Octree<T>::cull(const std::array<glm::vec4, 6>& planes, B&& bounds, F&& on_visible)
+	{
+		//Tests the box against the planes of the mask, the ones it's fully inside of are dropped, returns false if it's outside of any
+		auto classify = [&planes](const glm::vec3& center, const glm::vec3& half, unsigned& mask) {
+			for (unsigned i = 0; i < planes.size(); i++)
+			{
+				if (!(mask & (1u << i)))
+				{
+					continue;
+				}
+
+				const glm::vec4& plane = planes[i];
+
+				//The signed distance of the center, and how far the box reaches towards the normal
+				float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+				float reach = half.x * std::fabs(plane.x) + half.y * std::fabs(plane.y) + half.z * std::fabs(plane.z);
+
+				if (distance + reach < 0.0f)
+				{
+					return false;
+				}
+
+				if (distance - reach >= 0.0f)
+				{
+					mask &= ~(1u << i);
+				}
+			}
+
+			return true;
+		};
+
+		//Everything below a node inside of the whole frustum is visible
+		auto visible = [&on_visible](Octree<T>& node, unsigned&) {
+			for (T& item : node.m_Item)
+			{
+				if (!on_visible(item)) return false;
+			}
+
+			return true;
+		};
+
+		TraversalStack<std::pair<Octree<T>*, unsigned>, NUMBER_OF_OCTANTS> stack(levels());
+		stack.push({ this, (1u << planes.size()) - 1 });
+
+		while (!stack.empty())
+		{
+			std::pair<Octree<T>*, unsigned> entry = stack.pop();
+			Octree<T>* node = entry.first;
+			unsigned mask = entry.second;
+
+			//The box of the node in the world, which is the node itself until the tree is shifted
+			std::array<glm::vec3, 2> box = node->aabb().bounding_region();
+
+			if (!classify((box[0] + box[1]) * 0.5f, glm::abs(box[1] - box[0]) * 0.5f, mask))
+			{
+				continue;
+			}
+
+			if (!mask)
+			{
+				if (!node->traverse(visible)) return false;
+
+				continue;
+			}
+
+			//The items are tested only against the planes that their node crosses
+			for (T& item : node->m_Item)
+			{
+				std::array<glm::vec3, 2> region = bounds(item).bounding_region();
+				unsigned item_mask = mask;
+
+				if (classify((region[0] + region[1]) * 0.5f, glm::abs(region[1] - region[0]) * 0.5f, item_mask) && !on_visible(item))
+				{
+					return false;
+				}
+			}
+
+			for (int i = NUMBER_OF_OCTANTS - 1; i >= 0; i--)
+			{
+				if (node->m_ActiveOctants & (1 << i))
+				{
+					stack.push({ node->octant(i), mask });
+				}
+			}
+		}
+
+		return true;
+	}
+
+
+	//Searches for a given area inside the tree
+	template<typename T>
+	void Octree<T>::bfs(Collisions::AABB& area, std::list<T>& items)
+	{
+		//Lamda for asigning the children to the queue
+		auto asign_children = [this](std::list<Octree<T>*>& temp_queue, Octree<T>& temp) {
+			//Pushing the octants to a temporary container
+			for (uint8_t j = 0; j < NUMBER_OF_OCTANTS; ++j)
+			{
+				if (temp.m_ActiveOctants & (1 << j))
+				{
+					//If the octant is active, I am placing it on to the queue
+					temp_queue.push_back(temp.octant(j));
+				}
+				else if (!m_Data->lazy_subdivision)
+				{
+					//Else I tell the function, that We propably reached the leaf node
+					return false;
+				}
+
+			}
+
+			//Comes down here when every octant has been found and pushed to the queue
+			return true;
+		};
+
+		//Contains the main working queue
+		std::list<Octree<T>*> octants;
+
+		//Checking if the root contains the item
+		if (!m_Item.empty())
+		{
+			//Adding an item if it fits the octree, or items if they cross through trees
+			Collisions::AABB position = aabb();
+
+			if (area.contains(position))
+			{
+				for (const auto& it : m_Item)
+				{
+					items.push_back((it));
+				}
+			}
+		}
+
+		//Placing the root octants to the queue
+		for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+		{
+			if (m_ActiveOctants & (1 << i))
+				octants.push_back(octant(i));
+		}
+
+		//Iterative breadth first search implementation for an octree
+		size_t CurrentDepth = m_Depth;
+
+		while (CurrentDepth < m_Data->max_depth)
+		{
+			//Setting current depth
+			CurrentDepth++;
+
+			//For building the next octants queue
+			std::list<Octree<T>*> lower_octants;
+
+			typename std::list<Octree<T>*>::iterator it;
+
+			//Using a Lambda, that enables returning only from the 2 nested loops
+			[&] {
+				//Checking the list
+				for (it = octants.begin(); it!=octants.end(); ++it)
+				{
+					//Take the AABB of the octant
+					Collisions::AABB comparing = (**it).aabb();
+
+					std::array<glm::vec3, 2> test = comparing.bounding_region();
+
+					//Compare with the given area
+					if (comparing.intersects2(area)) {
+
+						//Adding an item if it fits the octree, or items if they cross through trees
+						NodeItems<T>& temp = (**it).access_elements();
+
+						if (area.contains(comparing))
+						{
+							for (const auto& it : temp)
+							{
+								items.push_back((it));
+							}
+						}
+						else if (is_leaf_node() && comparing.intersects2(area))
+						{
+							for (const auto& it : temp)
+							{
+								items.push_back((it));
+							}
+						}
+
+					}
+
+					//If the tree reached leaf nodes, this fails
+					if (!asign_children(lower_octants, **it))
+					{
+						return;
+					}
+				}
+			}();
+
+			//Swaping the queues
+			std::swap(octants, lower_octants);
+		}
+	}
+
+
+	//Checks whether the tree contains a certain area
+	template<typename T>
+	bool Octree<T>::contains(Collisions::AABB& area)
+	{
+		return aabb().contains(area);
+	}
+
+
+	template<typename T>
+	void Octree<T>::erase_area(Collisions::AABB& area, std::list<T>& items)
+	{
+		//Whatever gets appended from here on, leaves this subtree
+		size_t erased = items.size();
+
+		//Checking the parent node for the items
+		if (!m_Item.empty())
+		{
+			Collisions::AABB position = aabb();
+
+			//Adding an item if it fits the octree, or items if they cross through trees
+			if (area.contains(position))
+			{
+				//Pushing the found item into the list
+				for (const auto& it : m_Item)
+				{
+					items.push_back((it));
+				}
+
+				m_Item.clear();
+			}
+			else if (is_leaf_node() && position.intersects2(area))
+			{
+				//Pushing the found item into the list
+				for (const auto& it : m_Item)
+				{
+					items.push_back((it));
+				}
+
+				m_Item.clear();
+			}
+		}
+
+		if (!m_ActiveOctants)
+		{
+			m_Count -= (uint32_t)(items.size() - erased);
+			return;
+		}
+
+		//Checking all of the active child nodes for overlapping at once, against the planes splitting the node
+		unsigned overlapping = overlap_mask(*this, area) & m_ActiveOctants;
+
+		for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+		{
+			if (overlapping & (1 << i))
+			{
+				Octree<T>* child = octant(i);
+				child->erase_area(area, items);
+
+				//In the lazy mode the emptied children are given back to the pool right away
+				if (m_Data->lazy_subdivision && child->is_leaf_node() && child->m_Item.empty())
+				{
+					m_Data->pool.destroy(m_Octants[i]);
+					m_ActiveOctants &= ~(1 << i);
+				}
+			}
+		}
+
+		//Without any children left the node becomes a leaf again
+		if (m_Data->lazy_subdivision && !m_ActiveOctants)
+		{
+			m_IsLeaf = true;
+		}
+
+		m_Count -= (uint32_t)(items.size() - erased);
+
+	}
+
+
+	template<typename T>
+	NodeItems<T>& Octree<T>::access_elements()
+	{
+		return m_Item;
+	}
+
+
+	/*////////////////////
+	* /    Modifiers     /
+	*/////////////////////
+
+
+	template<typename T>
+	Trees::Location<T> Octree<T>::insert(T object, Collisions::AABB area)
+	{
+		//Checking whether anything can be inserted
+		if (!m_NodeReady)
+		{
+			return {};
+		}
+
+		//
+		return recursive_insert(object, area);
+
+	}
+
+
+	//Inserts all of the items in one sorted pass, the locations are given back in the order of the items
+	template<typename T>
+	void Octree<T>::insert(std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations)
+	{
+		locations.assign(items.size(), {});
+
+		//Checking whether anything can be inserted
+		if (!m_NodeReady)
+		{
+			return;
+		}
+
+		//The path to a node takes 3 bits per level, the trees too deep for that are filled one item at a time
+		size_t path_length = levels();
+
+		if ((path_length - 1) * 3 > 63)
+		{
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				locations[i] = insert(items[i].first, items[i].second);
+			}
+
+			return;
+		}
+
+		//Only the big insertions are worth spreading over the threads
+		bool parallel = m_Data->multi_thread && items.size() >= 2 * PARALLEL_MINIMUM_TASK_SIZE && Parallel::worker_count() > 1;
+
+		//Finding the node of every item, without touching any node
+		std::vector<Placement> placements(items.size());
+
+		auto locate = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				placements[i] = place(items[i].second, i, path_length);
+			}
+		};
+
+		//Sorting by the path, the parents go before their children, and the items of one node keep their order
+		auto order = [](const Placement& left, const Placement& right) {
+			return left.code != right.code ? left.code < right.code : left.level < right.level;
+		};
+
+		if (!parallel)
+		{
+			locate(0, items.size());
+			std::stable_sort(placements.begin(), placements.end(), order);
+
+			build(this, 0, placements.data(), placements.data() + placements.size(), path_length, items, locations, nullptr);
+
+			return;
+		}
+
+		Parallel::run_ranges(items.size(), locate);
+
+		//The items staying in this node go first, then the ones of every octant, each group is sorted on its own thread
+		std::array<size_t, 10> groups = {};
+
+		for (const Placement& placement : placements)
+		{
+			groups[(placement.level ? 1 + path_octant(placement.code, 1, path_length) : 0) + 1]++;
+		}
+
+		for (size_t i = 1; i < groups.size(); ++i)
+		{
+			groups[i] += groups[i - 1];
+		}
+
+		std::vector<Placement> sorted(placements.size());
+		std::array<size_t, 10> next = groups;
+
+		for (const Placement& placement : placements)
+		{
+			sorted[next[placement.level ? 1 + path_octant(placement.code, 1, path_length) : 0]++] = placement;
+		}
+
+		Parallel::run(groups.size() - 1, [&](size_t i) {
+			std::stable_sort(sorted.begin() + groups[i], sorted.begin() + groups[i + 1], order);
+		});
+
+		//The subtrees are split further while they stay large, the nodes above the tasks are built right away
+		std::vector<BuildTask> tasks;
+		std::vector<Octree<T>*> ancestors;
+		split_build(this, 0, sorted.data(), sorted.data() + sorted.size(), path_length, items, locations, ancestors, tasks);
+
+		//Every task gets enough pool slots for the nodes it may create, the eager trees have them all already
+		for (BuildTask& task : tasks)
+		{
+			task.reserved = m_Data->lazy_subdivision ? new_nodes(task.first, task.last, task.level, path_length) : 0;
+			task.reserved_slot = m_Data->pool.reserve_range(task.reserved);
+		}
+
+		Parallel::run(tasks.size(), [&](size_t i) {
+			uint32_t slot = tasks[i].reserved_slot;
+
+			tasks[i].inserted = build(tasks[i].node, tasks[i].level, tasks[i].first, tasks[i].last, path_length, items, locations, &slot);
+		});
+
+		for (BuildTask& task : tasks)
+		{
+			m_Data->pool.close_range(task.reserved_slot, task.reserved);
+
+			//The counts above the subtrees are shared between the tasks, so they are updated afterwards
+			for (Octree<T>* ancestor : task.ancestors)
+			{
+				ancestor->m_Count += (uint32_t)task.inserted;
+			}
+		}
+	}
+
+
+	//The item itself isn't needed, the location leads straight to its slot
+	template<typename T>
+	bool Octree<T>::erase(T, Trees::Location<T>& location)
+	{
+		//The item has never been inserted, or it's already gone
+		if (!location.items_container)
+		{
+			return false;
+		}
+
+		//The counts on the path to the node go down, the path follows from the area, the same way as in the insertion
+		Octree<T>* node = this;
+
+		while (true)
+		{
+			node->m_Count--;
+
+			if (&node->m_Item == location.items_container || !node->can_subdivide())
+			{
+				break;
+			}
+
+			int i = node->containing_octant(location.aabb);
+
+			if (i < 0 || !(node->m_ActiveOctants & (1 << i)))
+			{
+				break;
+			}
+
+			node = node->octant(i);
+		}
+
+		//The location points straight at the slot inside the node
+		location.items_container->erase(location.items_slot);
+		location.items_container = nullptr;
+
+		return true;
+	}
+
+
+	template<typename T>
+	void Octree<T>::clear()
+	{
+		//Enabling the user to write a top-down new tree, by removing the locking flags
+		m_Item.clear();
+		m_Count = 0;
+
+		//Freeing the whole subtree in one go
+		release_octants();
+
+		//Building the initial structure again, this time out of the already pooled memory
+		subdivide();
+	}
+
+
+	/*////////////////////
+	* /  Space altering  /
+	*/////////////////////
+
+
+	template<typename T>
+	void Octree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		shift(direction_offset(leaf_nodes, direction), returned_data);
+	}
+
+
+	template<typename T>
+	template<typename F>
+	void Octree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, F&& on_removed)
+	{
+		shift(direction_offset(leaf_nodes, direction), on_removed);
+	}
+
+
+	template<typename T>
+	void Octree<T>::shift(glm::ivec3 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		//Temporary items list
+		std::list<std::pair<T, Collisions::AABB>> items;
+
+		auto collect = [&items](T& item, Collisions::AABB& position) { items.push_back({ item, position }); };
+
+		glm::vec3 offset = glm::vec3(leaf_offset) * (float)m_Data->leaf_node_side;
+
+		//Wrapping only the cells that leave around, or moving the whole tree if the cells don't line up
+		if (!wrap_cells(offset, collect))
+		{
+			//Placing all of the contained items into a list of pairs(item + coordinates)
+			collect_items(items);
+
+			//Resizing the tree
+			std::array<glm::vec3, 2> bounding_box = aabb().bounding_region();
+			resize({ bounding_box[0] + offset, bounding_box[1] + offset });
+		}
+
+		//Iterator of the items list
+		typename std::list<std::pair<T, Collisions::AABB>>::iterator it;
+
+		//Bulk inserting the taken out items
+		for (it = items.begin(); it!=items.end(); ++it)
+		{
+			//If the item cannot be inserted, it means that is has been discarded
+			if (!insert((*it).first, (*it).second).items_container)
+			{
+				returned_data.push_back(*it);
+			}
+
+		}
+
+		//Clearing the temporary items list
+		items.clear();
+	}
+
+
+	template<typename T>
+	template<typename F>
+	void Octree<T>::shift(glm::ivec3 leaf_offset, F&& on_removed)
+	{
+		auto removed = [&on_removed](T& item, Collisions::AABB&) { on_removed(item); };
+
+		glm::vec3 offset = glm::vec3(leaf_offset) * (float)m_Data->leaf_node_side;
+
+		if (!wrap_cells(offset, removed))
+		{
+			//Every item is taken out, the tree is built a new at the moved position
+			auto visit = [&on_removed](Octree<T>& node, unsigned&) {
+				for (T& item : node.m_Item)
+				{
+					on_removed(item);
+				}
+
+				return true;
+			};
+
+			traverse(visit);
+
+			std::array<glm::vec3, 2> bounding_box = aabb().bounding_region();
+			resize({ bounding_box[0] + offset, bounding_box[1] + offset });
+		}
+	}
+
+
+	/*////////////////////
+	* /     Snapshot     /
+	*/////////////////////
+
+
+	template<typename T>
+	bool Octree<T>::save(const std::string& path)
+	{
+		auto convert = [](T& item) { return item; };
+
+		return save<T>(path, convert);
+	}
+
+
+	template<typename T>
+	bool Octree<T>::load(const std::string& path)
+	{
+		auto place = [](const T& record, NodeItems<T>& items) { items.insert(record); };
+
+		return load<T>(path, place);
+	}
+
+
+	template<typename T>
+	template<typename R, typename C>
+	bool Octree<T>::save(const std::string& path, C&& convert)
+	{
+		//Only the root holds the settings of the whole tree
+		if (!m_OwnedData)
+		{
+			return false;
+		}
+
+		//The breadth first order, the children of a node take the next free indices
+		std::vector<Octree<T>*> order(1, this);
+		std::vector<Snapshot::Node<NUMBER_OF_OCTANTS>> nodes;
+		uint64_t first = 0;
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			Octree<T>* node = order[i];
+			Snapshot::Node<NUMBER_OF_OCTANTS> saved = {};
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				saved.center[axis] = node->m_Center[axis];
+			}
+
+			saved.depth = node->m_Depth;
+			saved.active = node->m_ActiveOctants;
+			saved.leaf = node->m_IsLeaf;
+
+			for (uint8_t c = 0; c < NUMBER_OF_OCTANTS; c++)
+			{
+				if (node->m_ActiveOctants & (1 << c))
+				{
+					saved.children[c] = (uint32_t)order.size();
+					order.push_back(node->octant(c));
+				}
+			}
+
+			saved.first = first;
+			saved.count = node->m_Item.size();
+			first += saved.count;
+
+			nodes.push_back(saved);
+		}
+
+		Snapshot::Header header = {};
+		header.subdivision_depth = m_Data->subdivision_depth;
+		header.leaf_node_side = m_Data->leaf_node_side;
+		header.minimum_dimensions = m_Data->minimum_dimensions;
+		header.max_depth = m_Data->max_depth;
+		header.lazy_subdivision = m_Data->lazy_subdivision;
+		header.multi_thread = m_Data->multi_thread;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			header.moved[axis] = m_Data->torus.cells()[axis];
+		}
+
+		//The records follow the nodes in the same order
+		auto write_records = [&order, &convert](std::ofstream& file) {
+			for (Octree<T>* node : order)
+			{
+				for (T& item : node->m_Item)
+				{
+					R record = convert(item);
+					file.write(reinterpret_cast<const char*>(&record), sizeof(R));
+				}
+			}
+		};
+
+		return Snapshot::write<R, NUMBER_OF_OCTANTS>(path, header, m_Data->half_extents, nodes, write_records);
+	}
+
+
+	template<typename T>
+	template<typename R, typename P>
+	bool Octree<T>::load(const std::string& path, P&& place)
+	{
+		if (!m_OwnedData)
+		{
+			return false;
+		}
+
+		Snapshot::View<R, NUMBER_OF_OCTANTS> view;
+
+		//The whole file is checked before anything of the tree is touched
+		if (!view.open(path) || !view.validate())
+		{
+			return false;
+		}
+
+		const Snapshot::Header& header = view.header();
+
+		//The settings have to be the ones update_dimensions gives: a level for every depth down to the subdivision depth,
+		//which is at most one past the max depth. The validation keeps the depths of the nodes below the levels, so within the subdivision depth too
+		if (header.subdivision_depth > UINT16_MAX - 1 || header.levels != header.subdivision_depth + 1 || (header.subdivision_depth > header.max_depth && header.subdivision_depth - 1 > header.max_depth))
+		{
+			return false;
+		}
+
+		//The current nodes go back to the pool, the sizes of the levels and the settings come from the file
+		m_Item.clear();
+		release_octants();
+
+		m_Data->subdivision_depth = header.subdivision_depth;
+		m_Data->leaf_node_side = header.leaf_node_side;
+		m_Data->minimum_dimensions = header.minimum_dimensions;
+		m_Data->max_depth = header.max_depth;
+		m_Data->lazy_subdivision = header.lazy_subdivision;
+		m_Data->multi_thread = header.multi_thread;
+		m_Data->half_extents.resize(header.levels);
+
+		for (size_t depth = 0; depth < header.levels; depth++)
+		{
+			m_Data->half_extents[depth] = view.half_extents(depth);
+		}
+
+		const Snapshot::Node<NUMBER_OF_OCTANTS>& root = view.at(0);
+		m_Center = glm::vec3(root.center[0], root.center[1], root.center[2]);
+		m_Depth = 0;
+		m_IsLeaf = root.leaf;
+
+		//The world is put back where the saved tree had moved it
+		m_Data->torus.reset(m_Center - m_Data->half_extents[0], m_Center + m_Data->half_extents[0], m_Data->half_extents[header.levels - 1] * 2.0f);
+		m_Data->torus.set_moved(glm::ivec3((int)header.moved[0], (int)header.moved[1], (int)header.moved[2]));
+
+		//The tree made by the default constructor takes the insertions from now on
+		m_NodeReady = true;
+
+		//A node of the file is created by its parent, which always comes earlier, so a single pass creates them all
+		std::vector<Octree<T>*> created(view.nodes(), nullptr);
+		std::vector<uint32_t> parents(view.nodes(), 0);
+		created[0] = this;
+
+		for (size_t i = 0; i < view.nodes(); i++)
+		{
+			const Snapshot::Node<NUMBER_OF_OCTANTS>& saved = view.at(i);
+			Octree<T>* node = created[i];
+
+			for (uint8_t c = 0; c < NUMBER_OF_OCTANTS; c++)
+			{
+				if (!(saved.active & (1 << c)))
+				{
+					continue;
+				}
+
+				const Snapshot::Node<NUMBER_OF_OCTANTS>& child = view.at(saved.children[c]);
+
+				node->m_Octants[c] = m_Data->pool.create(glm::vec3(child.center[0], child.center[1], child.center[2]), child.depth, m_Data);
+				node->m_ActiveOctants |= (1 << c);
+
+				created[saved.children[c]] = node->octant(c);
+				created[saved.children[c]]->m_IsLeaf = child.leaf;
+				parents[saved.children[c]] = (uint32_t)i;
+			}
+
+			for (uint64_t r = saved.first; r < saved.first + saved.count; r++)
+			{
+				place(view.record(r), node->m_Item);
+			}
+
+			node->m_Count = (uint32_t)node->m_Item.size();
+		}
+
+		//Going backwards every subtree is counted before it's added to its parent
+		for (size_t i = view.nodes() - 1; i > 0; i--)
+		{
+			created[parents[i]]->m_Count += created[i]->m_Count;
+		}
+
+		return true;
+	}
+
+
+	/*
+	* //////////////////////////////
+	* /  Private member functions  /
+	* //////////////////////////////
+	*/
+
+
+	template<typename T>
+	void Octree<T>::update_dimensions(Collisions::AABB& area)
+	{
+		//Temporary storage of the bounds
+		std::array<glm::vec3, 2> bounds = area.bounding_region();
+		glm::vec3 minimum = glm::min(bounds[0], bounds[1]);
+		glm::vec3 maximum = glm::max(bounds[0], bounds[1]);
+
+		m_Center = (minimum + maximum) * 0.5f;
+
+		//Every level halves the size, until the depth or the dimensions limit is reached
+		std::vector<glm::vec3>& half_extents = m_Data->half_extents;
+		half_extents.assign(1, (maximum - minimum) * 0.5f);
+
+		size_t depth = 0;
+
+		while (depth <= m_Data->max_depth && depth < UINT16_MAX - 1)
+		{
+			//Safety checking whether the dimensions aren't smaller than the minimum value
+			glm::vec3 dimensions = half_extents[depth] * 2.0f;
+
+			if (dimensions.x < m_Data->minimum_dimensions || dimensions.y < m_Data->minimum_dimensions || dimensions.z < m_Data->minimum_dimensions)
+			{
+				break;
+			}
+
+			half_extents.push_back(half_extents[depth] * 0.5f);
+			depth++;
+		}
+
+		m_Data->subdivision_depth = depth;
+
+		//Calculating the side length
+		m_Data->leaf_node_side = (maximum.x - minimum.x) / std::pow(2.0, m_Data->max_depth);
+
+		//The world starts out as the box itself, it wraps by the cells of the deepest level
+		m_Data->torus.reset(minimum, maximum, half_extents[depth] * 2.0f);
+	}
+
+
+	template<typename T>
+	glm::ivec3 Octree<T>::direction_offset(size_t leaf_nodes, Coordinates::Directions direction)
+	{
+		int distance = (int)leaf_nodes;
+		glm::ivec3 offset(0);
+
+		switch (direction)
+		{
+		case Coordinates::Directions::North:
+			offset.z = -distance;
+			break;
+		case Coordinates::Directions::South:
+			offset.z = distance;
+			break;
+		case Coordinates::Directions::East:
+			offset.x = distance;
+			break;
+		case Coordinates::Directions::West:
+			offset.x = -distance;
+			break;
+		}
+
+		return offset;
+	}
+
+
+	template<typename T>
+	template<typename F>
+	bool Octree<T>::wrap_cells(glm::vec3 offset, F& on_removed)
+	{
+		Torus& torus = m_Data->torus;
+		glm::vec3 cell = torus.cell();
+		glm::ivec3 grid = torus.grid();
+		glm::ivec3 cells(0);
+
+		//Only the whole tree wraps, by whole cells of the deepest level, and by less than the whole world
+		if (!m_OwnedData)
+		{
+			return false;
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			float count = std::round(offset[i] / cell[i]);
+
+			if (count * cell[i] != offset[i] || count >= grid[i] || count <= -grid[i])
+			{
+				return false;
+			}
+
+			cells[i] = (int)count;
+		}
+
+		std::array<glm::vec3, 2> world = torus.world().bounding_region();
+		glm::vec3 first = glm::min(world[0], world[1]);
+		glm::vec3 last = glm::max(world[0], world[1]);
+
+		//The slabs of the world left behind, one for every axis it moves along, and the world they leave to
+		std::vector<std::array<glm::vec3, 2>> slabs;
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (!cells[i])
+			{
+				continue;
+			}
+
+			std::array<glm::vec3, 2> slab = { first, last };
+
+			if (cells[i] > 0)
+			{
+				slab[1][i] = first[i] + offset[i];
+			}
+			else
+			{
+				slab[0][i] = last[i] + offset[i];
+			}
+
+			slabs.push_back(slab);
+		}
+
+		//The boxes lie on the grid of the cells, half of a cell keeps the rounding away from touching boxes
+		glm::vec3 tolerance = cell * 0.5f;
+
+		auto reaches = [&tolerance](const std::array<glm::vec3, 2>& region, const std::array<glm::vec3, 2>& slab) {
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+			for (int i = 0; i < 3; i++)
+			{
+				if (maximum[i] <= slab[0][i] + tolerance[i] || minimum[i] >= slab[1][i] - tolerance[i]) return false;
+			}
+
+			return true;
+		};
+
+		auto stays = [&](const std::array<glm::vec3, 2>& region) {
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+			for (int i = 0; i < 3; i++)
+			{
+				if (minimum[i] < first[i] + offset[i] - tolerance[i] || maximum[i] > last[i] + offset[i] + tolerance[i]) return false;
+			}
+
+			return true;
+		};
+
+		//Only the nodes reaching into the slabs are visited, the ones across the seam reach into all of them
+		std::vector<Octree<T>*> visited;
+		TraversalStack<Octree<T>*, NUMBER_OF_OCTANTS> stack(levels());
+		stack.push(this);
+
+		while (!stack.empty())
+		{
+			Octree<T>* node = stack.pop();
+			visited.push_back(node);
+
+			Collisions::AABB position = node->aabb();
+			std::array<glm::vec3, 2> region = position.bounding_region();
+
+			//The items of the nodes reaching out of the moved world can't stay
+			if (!node->m_Item.empty() && !stays(region))
+			{
+				for (T& item : node->m_Item)
+				{
+					on_removed(item, position);
+				}
+
+				node->m_Item.clear();
+			}
+
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+			{
+				if (!(node->m_ActiveOctants & (1 << i)))
+				{
+					continue;
+				}
+
+				std::array<glm::vec3, 2> bounds = node->octant_bounds(i).bounding_region();
+
+				for (std::array<glm::vec3, 2>& slab : slabs)
+				{
+					if (reaches(bounds, slab))
+					{
+						stack.push(node->octant(i));
+						break;
+					}
+				}
+			}
+		}
+
+		//The children are visited after their parents, so going backwards the counts are settled from the bottom up
+		for (auto it = visited.rbegin(); it != visited.rend(); ++it)
+		{
+			Octree<T>* node = *it;
+			node->m_Count = (uint32_t)node->m_Item.size();
+
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+			{
+				if (!(node->m_ActiveOctants & (1 << i)))
+				{
+					continue;
+				}
+
+				Octree<T>* child = node->octant(i);
+
+				//In the lazy mode the emptied children are given back to the pool
+				if (m_Data->lazy_subdivision && child->is_leaf_node() && !child->m_Count)
+				{
+					m_Data->pool.destroy(node->m_Octants[i]);
+					node->m_ActiveOctants &= ~(1 << i);
+					continue;
+				}
+
+				node->m_Count += child->m_Count;
+			}
+
+			if (m_Data->lazy_subdivision && !node->m_ActiveOctants)
+			{
+				node->m_IsLeaf = true;
+			}
+		}
+
+		//The slabs left behind are the cells entering on the other side, the nodes stay where they are
+		torus.move(cells);
+
+		return true;
+	}
+
+
+	template<typename T>
+	glm::vec3 Octree<T>::octant_center(uint8_t octant)
+	{
+		return octant_center(m_Center, m_Depth, octant);
+	}
+
+
+	template<typename T>
+	glm::vec3 Octree<T>::octant_center(const glm::vec3& center, size_t depth, uint8_t octant)
+	{
+		//The octants are half the size of the node, so their centers lie their own half extents away
+		glm::vec3 offset = m_Data->half_extents[depth + 1];
+
+		return glm::vec3(
+			center.x + ((octant & 0x1) ? offset.x : -offset.x),
+			center.y + ((octant & 0x4) ? -offset.y : offset.y),
+			center.z + ((octant & 0x2) ? offset.z : -offset.z));
+	}
+
+
+	template<typename T>
+	Collisions::AABB Octree<T>::octant_bounds(uint8_t octant)
+	{
+		return m_Data->torus.bounds(octant_center(octant), m_Data->half_extents[m_Depth + 1]);
+	}
+
+
+	template<typename T>
+	int Octree<T>::containing_octant(Collisions::AABB& area)
+	{
+		glm::vec3 minimum, maximum;
+
+		//The nodes are found by the slots of the area, the one lying across the wrap stays above all of them
+		if (!m_Data->torus.slots(area, minimum, maximum))
+		{
+			return -1;
+		}
+
+		return containing_octant(m_Center, m_Depth, minimum, maximum);
+	}
+
+
+	template<typename T>
+	int Octree<T>::containing_octant(const glm::vec3& center, size_t depth, const glm::vec3& minimum, const glm::vec3& maximum)
+	{
+		glm::vec3 half = m_Data->half_extents[depth];
+
+		//Bits of the octant number standing for the upper half of x, y and z, the y bit is set for the lower half
+		const int bits[3] = { 0x1, 0x4, 0x2 };
+		int octant = 0;
+
+		for (int i = 0; i < 3; i++)
+		{
+			//The area has to be inside of the node in the first place
+			if (minimum[i] < center[i] - half[i] || maximum[i] > center[i] + half[i])
+			{
+				return -1;
+			}
+
+			bool upper;
+
+			if (maximum[i] <= center[i])
+			{
+				upper = false;
+			}
+			else if (minimum[i] >= center[i])
+			{
+				upper = true;
+			}
+			else
+			{
+				//Crossing the center, none of the octants can hold it
+				return -1;
+			}
+
+			if (upper != (i == 1))
+			{
+				octant |= bits[i];
+			}
+		}
 
+		return octant;
 	}
 
 
 	template<typename T>
-	void Octree<T>::clear()
+	bool Octree<T>::is_leaf_node(void)
 	{
-		//Enabling the user to write a top-down new tree, by removing the locking flags
-		m_Item.clear();
+		return m_IsLeaf;
+	}
 
-		//Proceeding to the Octants
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
-		{
 
-			if (m_Octants[i])
-			{
-				// Recursively cleaning
-				m_Octants[i]->clear();
-			}
-		}
+	template<typename T>
+	bool Octree<T>::can_subdivide(void)
+	{
+		//Both the depth and the dimensions limits are the same for a whole level, so they are checked once per tree
+		return m_Depth < m_Data->subdivision_depth;
 	}
 
 
-	/*////////////////////
-	* /  Space altering  /
-	*/////////////////////
+	template<typename T>
+	Octree<T>* Octree<T>::octant(uint8_t index)
+	{
+		return m_Data->pool.at(m_Octants[index]);
+	}
 
 
 	template<typename T>
-	void Octree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	unsigned Octree<T>::overlap_mask(Octree<T>& node, Collisions::AABB& area)
 	{
-		//Storing the new coordinates for the tree
-		std::array<glm::vec3, 2> bounding_box = m_Position.bounding_region();
-
-		//Temporary items list
-		std::list<std::pair<T, Collisions::AABB>> items;
+		glm::vec3 half = m_Data->half_extents[node.m_Depth];
+		glm::vec3 offset;
 
-		//Calculating the bounding box
-		switch (direction)
+		if (m_Data->torus.offset(node.m_Center, half, offset))
 		{
-		case Coordinates::Directions::North:
+			return Simd::overlap_mask_octants(node.m_Center + offset, half, area);
+		}
 
-			bounding_box[0].z -= leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].z -= leaf_nodes * m_LeafNodeSide;
+		unsigned mask = 0;
 
-			break;
-		case Coordinates::Directions::South:
-			
-			bounding_box[0].z += leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].z += leaf_nodes * m_LeafNodeSide;
+		for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+		{
+			if (node.octant_bounds(i).intersects2(area))
+			{
+				mask |= 1 << i;
+			}
+		}
 
-			break;
-		case Coordinates::Directions::East:
+		return mask;
+	}
 
-			bounding_box[0].x += leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].x += leaf_nodes * m_LeafNodeSide;
 
-			break;
-		case Coordinates::Directions::West:
-			
-			bounding_box[0].x -= leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].x -= leaf_nodes * m_LeafNodeSide;
+	template<typename T>
+	Octree<T>* Octree<T>::obtain_octant(uint8_t index, uint32_t* reserved_slot)
+	{
+		//Does the child exist?
+		if (!(m_ActiveOctants & (1 << index)))
+		{
+			//If no, create that child, the node stops being a leaf
+			m_IsLeaf = false;
+			m_ActiveOctants |= 1 << index;
 
-			break;
+			if (reserved_slot)
+			{
+				//The parallel builds take the next slot of their own range
+				m_Octants[index] = (*reserved_slot)++;
+				m_Data->pool.create_at(m_Octants[index], octant_center(index), m_Depth + 1, m_Data);
+			}
+			else
+			{
+				m_Octants[index] = m_Data->pool.create(octant_center(index), m_Depth + 1, m_Data);
+			}
 		}
 
-		//Placing all of the contained items into a list of pairs(item + coordinates)
-		collect_items(items);
-
-		//Resizing the tree
-		resize({ bounding_box[0], bounding_box[1] });
+		return octant(index);
+	}
 
-		//Iterator of the items list
-		typename std::list<std::pair<T, Collisions::AABB>>::iterator it;
 
-		//Bulk inserting the content of the tree
-		for (it = items.begin(); it!=items.end(); ++it)
+	template<typename T>
+	void Octree<T>::release_octants(void)
+	{
+		if (m_OwnedData)
 		{
-			//If the item cannot be inserted, it means that is has been discarded
-			if (!insert((*it).first, (*it).second).items_container)
+			//The root owns the pool, so every node can be destroyed at once
+			m_Data->pool.reset();
+		}
+		else
+		{
+			//Otherwise the subtree has to be handed back node by node, the stack holds the pool indices
+			TraversalStack<uint32_t, NUMBER_OF_OCTANTS> stack(levels());
+
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; ++i)
 			{
-				returned_data.push_back(*it);
+				if (m_ActiveOctants & (1 << i)) stack.push(m_Octants[i]);
 			}
 
+			while (!stack.empty())
+			{
+				uint32_t index = stack.pop();
+				Octree<T>* node = m_Data->pool.at(index);
+
+				//The children are taken before the node itself is gone
+				for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; ++i)
+				{
+					if (node->m_ActiveOctants & (1 << i)) stack.push(node->m_Octants[i]);
+				}
+
+				m_Data->pool.destroy(index);
+			}
 		}
 
-		//Clearing the temporary items list
-		items.clear();
+		//Nothing is left below, so the node becomes a leaf again
+		m_ActiveOctants = 0;
+		m_IsLeaf = true;
 	}
 
+	template<typename T>
+	void Octree<T>::collect_items(std::list<std::pair<T, Collisions::AABB>>& items)
+	{
+		auto visit = [&items](Octree<T>& node, unsigned&) {
+			if (!node.m_Item.empty())
+			{
+				Collisions::AABB position = node.aabb();
 
-	/*
-	* //////////////////////////////
-	* /  Private member functions  /
-	* //////////////////////////////
-	*/
+				for (const auto& it : node.m_Item)
+				{
+					items.push_back({ (it), position });
+				}
+			}
+
+			return true;
+		};
+
+		traverse(visit);
+	}
 
 
 	template<typename T>
-	void Octree<T>::calculate_bounding_box(Collisions::AABB& BoundingBox, Octants Octant)
+	size_t Octree<T>::levels(void)
 	{
-		// Here is the center of the parent node Octree
-		glm::vec3 center = m_Position.center();
+		return m_Data->subdivision_depth + 1 - m_Depth;
+	}
 
-		// And It's side length for all dimensions
-		glm::vec3 dimensions = m_Position.dimensions();
 
-		// Variables for storing the min and max valus
-		glm::vec3 minimum;
-		glm::vec3 maximum;
+	template<typename T>
+	template<typename F>
+	bool Octree<T>::traverse(F& visit)
+	{
+		TraversalStack<Octree<T>*, NUMBER_OF_OCTANTS> stack(levels());
+		stack.push(this);
 
-		// Calculating the 8 different boudning boxes for the Octants
-		if (Octant == Octants::O1)
+		while (!stack.empty())
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x - 0.5 * dimensions.x, center.y, center.z);
+			Octree<T>* node = stack.pop();
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x, center.y + 0.5 * dimensions.y, center.z - 0.5 * dimensions.z);
+			//By default every active child is visited
+			unsigned descend = node->m_ActiveOctants;
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+			if (!visit(*node, descend))
+			{
+				return false;
+			}
 
-			return;
+			//Pushed backwards, so that the octants are visited in their order
+			for (int i = NUMBER_OF_OCTANTS - 1; i >= 0; i--)
+			{
+				if (descend & (1 << i))
+				{
+					stack.push(node->octant(i));
+				}
+			}
 		}
-		else if (Octant == Octants::O2)
-		{
-			// The minimum coordinate of the bounding box
-			minimum = center;
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x+0.5*dimensions.x, center.y + 0.5 * dimensions.y, center.z - 0.5 * dimensions.z);
+		return true;
+	}
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
 
+	template<typename T>
+	void Octree<T>::subdivide(void)
+	{
+		//In the lazy mode the children are created only once an insertion needs them
+		if (m_Data->lazy_subdivision)
+		{
 			return;
 		}
-		else if (Octant == Octants::O3)
-		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x - 0.5 * dimensions.x, center.y, center.z + 0.5 * dimensions.z);
-
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x, center.y + 0.5 * dimensions.y, center.z);
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+		//Building the tree top-down, with the nodes waiting for their subdivision on the stack
+		TraversalStack<Octree<T>*, NUMBER_OF_OCTANTS> stack(levels());
+		stack.push(this);
 
-			return;
-		}
-		else if (Octant == Octants::O4)
+		while (!stack.empty())
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x, center.y, center.z + 0.5 * dimensions.z);
+			Octree<T>* node = stack.pop();
+
+			// If is not a leaf node or the maximum depth has beed aproached
+			if (!node->is_leaf_node() || !node->can_subdivide())
+			{
+				continue;
+			}
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x + 0.5 * dimensions.x, center.y + 0.5 * dimensions.y, center.z);
+			//If it came down here It can't be a leaf node
+			node->m_IsLeaf = false;
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+			//Creating the octants octrees, their bounds follow from the center of the node
+			for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; i++)
+			{
+				node->m_Octants[i] = m_Data->pool.create(node->octant_center(i), node->m_Depth + 1, m_Data);
+			}
 
-			return;
+			//Every child is active now
+			node->m_ActiveOctants = (1 << NUMBER_OF_OCTANTS) - 1;
+
+			for (int i = NUMBER_OF_OCTANTS - 1; i >= 0; i--)
+			{
+				stack.push(node->octant(i));
+			}
 		}
-		else if (Octant == Octants::O5)
+	}
+
+
+	template<typename T>
+	Trees::Location<T> Octree<T>::recursive_insert(T object, Collisions::AABB area)
+	{
+		//Checking whether the children can contain the item, only one of them can, and it follows from the center
+		if (can_subdivide())
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x - 0.5 * dimensions.x, center.y - 0.5 * dimensions.y, center.z);
+			int i = containing_octant(area);
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x, center.y, center.z - 0.5 * dimensions.z);
+			if (i >= 0)
+			{
+				//Proceeding to the insertion, the child is created if it doesn't exist yet
+				Trees::Location<T> location = obtain_octant(i)->recursive_insert(object, area);
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+				if (location.items_container)
+				{
+					m_Count++;
+				}
 
-			return;
+				return location;
+			}
 		}
-		else if (Octant == Octants::O6)
+
+		//Inserting an item
+		if (takes(area))
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x, center.y-0.5*dimensions.y, center.z);
+			//Inserting the object to the first free slot
+			size_t slot = m_Item.insert(object);
+			m_Count++;
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x + 0.5 * dimensions.x, center.y, center.z - 0.5 * dimensions.z);
+			//Returning the Dependencies::Tree::Location struct
+			return { &m_Item, slot, area };
+		}
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+		//Returning empty struct
+		return {};
+	}
 
-			return;
-		}
-		else if (Octant == Octants::O7)
+
+	template<typename T>
+	bool Octree<T>::takes(Collisions::AABB& area)
+	{
+		if (!contains(area))
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x - 0.5 * dimensions.x, center.y - 0.5 * dimensions.y, center.z + 0.5 * dimensions.z);
+			return false;
+		}
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x, center.y, center.z);
+		return m_Item.empty() || (m_IsRoot && m_Data->torus.across(area));
+	}
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
 
-			return;
-		}
-		else if (Octant == Octants::O8)
+	template<typename T>
+	typename Octree<T>::Placement Octree<T>::place(Collisions::AABB& area, size_t item, size_t path_length)
+	{
+		glm::vec3 minimum, maximum;
+		Placement placement = { 0, 0, item };
+
+		if (!m_Data->torus.slots(area, minimum, maximum))
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x, center.y - 0.5 * dimensions.y, center.z + 0.5 * dimensions.z);
+			return placement;
+		}
+
+		//Going down the same way as the single insertion does, so both end up in the same node
+		glm::vec3 center = m_Center;
+		size_t depth = m_Depth;
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x + 0.5 * dimensions.x, center.y, center.z);
+		while (depth < m_Data->subdivision_depth)
+		{
+			int octant = containing_octant(center, depth, minimum, maximum);
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+			if (octant < 0)
+			{
+				break;
+			}
 
-			return;
+			center = octant_center(center, depth, (uint8_t)octant);
+			depth++;
+			placement.level++;
+			placement.code |= (uint64_t)octant << (3 * (path_length - 1 - placement.level));
 		}
 
+		return placement;
 	}
 
 
 	template<typename T>
-	bool Octree<T>::is_leaf_node(void)
+	uint8_t Octree<T>::path_octant(uint64_t code, size_t level, size_t path_length)
 	{
-		return m_IsLeaf;
+		return (uint8_t)((code >> (3 * (path_length - 1 - level))) & 0x7);
 	}
 
 
+	//Counts the nodes on the paths of the sorted placements below the level, every shared node is counted once
 	template<typename T>
-	std::array<std::shared_ptr<Octree<T>>, 8>& Octree<T>::access_octants()
+	size_t Octree<T>::new_nodes(Placement* first, Placement* last, size_t level, size_t path_length)
 	{
-		return m_Octants;
-	}
+		size_t count = 0;
+		Placement* previous = nullptr;
 
-	template<typename T>
-	void Octree<T>::collect_items(std::list<std::pair<T, Collisions::AABB>>& items)
-	{
-		if (!m_Item.empty())
+		for (Placement* it = first; it != last; ++it)
 		{
-			for (const auto& it : m_Item)
+			size_t shared = level;
+
+			while (previous && shared < previous->level && shared < it->level && path_octant(previous->code, shared + 1, path_length) == path_octant(it->code, shared + 1, path_length))
 			{
-				items.push_back({ (it), m_Position });
+				shared++;
 			}
+
+			count += it->level > shared ? it->level - shared : 0;
+			previous = it;
 		}
-		for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; ++i)
-		{
-			if(m_Octants[i])
-				m_Octants[i]->collect_items(items);
-		}
+
+		return count;
 	}
 
 
+	//One pass over the sorted placements below the node, every node is reached through the path of the previous item
+	//Returns the number of the inserted items, the counts of the nodes above the given one are left to the caller
 	template<typename T>
-	void Octree<T>::recursive_subdivide(void)
+	size_t Octree<T>::build(Octree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, uint32_t* reserved_slot)
 	{
+		std::vector<Octree<T>*> path(path_length, nullptr);
+		path[level] = node;
 
-		// If is a leaf node or the maximum depth has beed aproached
-		if (!is_leaf_node())
+		Placement* previous = nullptr;
+		size_t inserted = 0;
+
+		for (Placement* it = first; it != last; ++it)
 		{
-			return;
+			size_t shared = level;
+
+			while (previous && shared < previous->level && shared < it->level && path_octant(previous->code, shared + 1, path_length) == path_octant(it->code, shared + 1, path_length))
+			{
+				shared++;
+			}
+
+			//Going down only through the part of the path that differs, creating the missing nodes
+			for (size_t i = shared + 1; i <= it->level; ++i)
+			{
+				path[i] = path[i - 1]->obtain_octant(path_octant(it->code, i, path_length), reserved_slot);
+			}
+
+			previous = it;
+
+			//The node takes the item on the same conditions as in the single insertion
+			Octree<T>* target = path[it->level];
+			std::pair<T, Collisions::AABB>& item = items[it->item];
+
+			if (target->takes(item.second))
+			{
+				size_t slot = target->m_Item.insert(item.first);
+				locations[it->item] = { &target->m_Item, slot, item.second };
+				inserted++;
+
+				for (size_t i = level; i <= it->level; ++i)
+				{
+					path[i]->m_Count++;
+				}
+			}
 		}
-		else if (!(m_Depth <= m_MaxDepth))
+
+		return inserted;
+	}
+
+
+	//Builds the top of the tree on the calling thread and leaves the large enough subtrees as the tasks
+	template<typename T>
+	void Octree<T>::split_build(Octree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, std::vector<Octree<T>*>& ancestors, std::vector<BuildTask>& tasks)
+	{
+		if ((size_t)(last - first) <= PARALLEL_MINIMUM_TASK_SIZE || level + 1 >= path_length)
 		{
+			tasks.push_back({ node, level, first, last, 0, 0, ancestors, 0 });
 			return;
 		}
 
-		//Getting the current bb dimensions
-		glm::vec3 dimensions = m_Position.dimensions();
+		//The items of the node itself are sorted before the ones of its octants
+		Placement* it = first;
 
-		//Safety checking whether the dimensions aren't smaller than the minimum value
-		for (int i = 0; i < 3; i++)
+		while (it != last && it->level == level)
 		{
-			if (dimensions[i] < m_MinimumDimensions) return;
+			++it;
 		}
 
-		/*
-		* Creating the coordinates of the Octants, I am using a clever little technique,
-		* by shifting bit-wise a number one, I achieve the needed enum class members values,
-		* that allows to correctly recognize Octants based on their hex code.
-		*/
+		size_t inserted = build(node, level, first, it, path_length, items, locations, nullptr);
 
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
+		for (Octree<T>* ancestor : ancestors)
 		{
-			calculate_bounding_box(m_OctantsBounds[i], static_cast<Octants>(1 << i));
+			ancestor->m_Count += (uint32_t)inserted;
 		}
 
-		//If it came down here It can't be a leaf node
-		m_IsLeaf = false;
+		//The rest is grouped by the octant the paths go through
+		ancestors.push_back(node);
 
-		//Creating the octants octrees
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
+		while (it != last)
 		{
-			m_Octants[i] = std::make_shared<Octree<T>>(m_OctantsBounds[i], m_MaxDepth, m_MinimumDimensions, m_Depth + 1);
+			uint8_t octant = path_octant(it->code, level + 1, path_length);
+			Placement* end = it;
+
+			while (end != last && path_octant(end->code, level + 1, path_length) == octant)
+			{
+				++end;
+			}
+
+			split_build(node->obtain_octant(octant), level + 1, it, end, path_length, items, locations, ancestors, tasks);
+			it = end;
 		}
 
+		ancestors.pop_back();
 	}
 
 
+	//The search of the pairs with an explicit stack, the path can already hold the items of the nodes above
 	template<typename T>
-	void Octree<T>::recursive_dfs(Collisions::AABB& area, std::list<T>& items)
+	template<typename B, typename F>
+	bool Octree<T>::pairs_below(std::vector<std::pair<T*, Collisions::AABB>>& path, B& bounds, F& on_pair)
 	{
-		//Checking the parent node for the items
-		if (!m_Item.empty())
+		//Every waiting node knows how many of the items on the path lie above it
+		TraversalStack<std::pair<Octree<T>*, size_t>, NUMBER_OF_OCTANTS> stack(levels());
+		stack.push({ this, path.size() });
+
+		while (!stack.empty())
 		{
-			//Adding an item if it fits the octree, or items if they cross through trees
-			if (m_Position.contains(area))
-			{
-				for (const auto& it : m_Item)
-				{
-					items.push_back((it));
-				}
-			}
-			else if (is_leaf_node() && m_Position.intersects2(area))
+			std::pair<Octree<T>*, size_t> entry = stack.pop();
+			Octree<T>* node = entry.first;
+
+			//Leaving the items of the nodes, that aren't above this one
+			path.resize(entry.second);
+
+			for (T& item : node->m_Item)
 			{
-				for (const auto& it : m_Item)
+				Collisions::AABB box = bounds(item);
+
+				//Against the items above, and the ones of this node that came before
+				for (std::pair<T*, Collisions::AABB>& other : path)
 				{
-					items.push_back((it));
+					if (other.second.intersects2(box) && !on_pair(*other.first, item)) return false;
 				}
+
+				path.push_back({ &item, box });
 			}
-		}
 
-		//Checking the child nodes
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
-		{
-			if (m_Octants[i])
+			//Pushed backwards, so that the octants are visited in their order
+			for (int i = NUMBER_OF_OCTANTS - 1; i >= 0; i--)
 			{
-				//Checking for overlapping
-				if (m_OctantsBounds[i].intersects2(area))
+				if (node->m_ActiveOctants & (1 << i))
 				{
-					m_Octants[i]->recursive_dfs(area, items);
+					stack.push({ node->octant(i), path.size() });
 				}
 			}
 		}
 
+		return true;
 	}
 
+
+
+	//Walks the subtree only while the node reaches any of the other items
 	template<typename T>
-	Trees::Location<T> Octree<T>::recursive_insert(T object, Collisions::AABB area)
+	template<typename I, typename B, typename F>
+	bool Octree<T>::pairs_with(std::vector<std::pair<I*, Collisions::AABB>>& others, B& bounds, F& on_pair)
 	{
-		//Checking whether the children can contain the item
-		for (int i = 0; i < NUMBER_OF_OCTANTS; i++)
-		{
-			if (m_OctantsBounds[i].contains(area))
+		auto visit = [&](Octree<T>& node, unsigned& descend) {
+			Collisions::AABB position = node.aabb();
+			bool reached = false;
+
+			for (std::pair<I*, Collisions::AABB>& other : others)
 			{
-				// Within the depth limit?
-				if (m_Depth <= m_MaxDepth)
+				if (other.second.intersects2(position))
 				{
-					//If yes, does the child exist?
-					if (!m_Octants[i])
-					{
-						//If no, create that child
-						m_Octants[i] = std::make_shared<Octree<T>>(m_OctantsBounds[i], m_Depth + 1, m_MinimumDimensions);
-					}
-					//If yes, proceed to the insertion
-					return m_Octants[i]->recursive_insert(object, area);
+					reached = true;
+					break;
 				}
-
 			}
 
-		}
-
-		//Inserting an item
-		if (m_Item.empty())
-		{
-			if (m_Position.contains(area))
-			{
-				//Inserting the object to the list 
-				m_Item.push_back(object);
-
-				//Returning the Dependencies::Tree::Location struct
-				return { &m_Item, std::prev(m_Item.end()), area };
-			}
-			else
+			//Nothing below can overlap the other items either
+			if (!reached)
 			{
-				//Returning empty struct
-				return {};
+				descend = 0;
+				return true;
 			}
-		}
-		else
-		{
-			//Returning empty struct
-			return {};
-		}
-
-	}
-
-
-	template<typename T>
-	void Octree<T>::recursive_resize(Collisions::AABB& area)
-	{
-		//Temporary storage of the bounds
-		std::array<glm::vec3, 2> bounds = area.bounding_region();
-
-		//Updating the coordinates
-		m_Position.update_position(bounds[0], bounds[1]);
 
-		//Clearing the content
-		m_Item.clear();
+			for (T& item : node.m_Item)
+			{
+				Collisions::AABB box = bounds(item);
 
-		// Calcaulating the potential children coordinates
-		for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; ++i)
-		{
-			calculate_bounding_box(m_OctantsBounds[i], (Octants)(1 << i));
-		}
+				for (std::pair<I*, Collisions::AABB>& other : others)
+				{
+					if (other.second.intersects2(box) && !on_pair(*other.first, item)) return false;
+				}
+			}
 
-		for (uint8_t i = 0; i < NUMBER_OF_OCTANTS; ++i)
-		{
-			//Updating the octants with the bb data pulled from pre-calculated octantbounds
-			if (m_Octants[i])
-				m_Octants[i]->recursive_resize(m_OctantsBounds[i]);
-		}
+			return true;
+		};
 
+		return traverse(visit);
 	}
-
 }
 #endif
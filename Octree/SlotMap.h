@@ -0,0 +1,246 @@
+//Default Libraries
+#include<vector>
+#include<cstdint>
+#include<utility>
+
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H 1
+
+
+/*
+* A dense container with stable handles. The values are packed one after
+* another, so iterating is a plain walk through an array. A handle is a slot number
+* with a generation, the slot points at the current position of the value,
+* and the generation changes every time the slot is freed, so a handle to
+* an erased value can always be recognized.
+*/
+
+
+namespace DataStructures {
+
+
+	//Stable reference to a value stored inside of a SlotMap
+	struct SlotHandle
+	{
+		uint32_t index = UINT32_MAX;
+		uint32_t generation = 0;
+
+		bool operator==(const SlotHandle& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+	};
+
+
+	template<typename V>
+	class SlotMap
+	{
+
+		//Connects the handle with the position of the value
+		struct Slot
+		{
+			//Position of the value, or the next free slot when unused
+			uint32_t position = 0;
+			uint32_t generation = 0;
+		};
+
+	protected:
+
+		//The values, packed
+		std::vector<V> m_Values;
+
+		//The slot of every value, in the same order as the values
+		std::vector<uint32_t> m_ValueSlots;
+
+		//The indirection table
+		std::vector<Slot> m_Slots;
+
+		//The head of the free slots list
+		uint32_t m_FreeSlot = UINT32_MAX;
+
+	public:
+
+		using iterator = typename std::vector<V>::iterator;
+
+		/*
+		* Capacity
+		*/
+
+		size_t size();
+		bool empty();
+		void reserve(size_t capacity);
+
+		/*
+		* Element access
+		*/
+
+		bool contains(SlotHandle handle);
+		V* find(SlotHandle handle);
+		V& at(SlotHandle handle);
+		SlotHandle handle_at(size_t position);
+		iterator begin();
+		iterator end();
+
+		/*
+		* Modifiers
+		*/
+
+		SlotHandle insert(V value);
+		bool erase(SlotHandle handle);
+		void clear();
+	};
+
+
+	/*
+	* ///////////////////////
+	* /		Definitions     /
+	* ///////////////////////
+	*/
+
+
+	template<typename V>
+	size_t SlotMap<V>::size()
+	{
+		return m_Values.size();
+	}
+
+
+	template<typename V>
+	bool SlotMap<V>::empty()
+	{
+		return m_Values.empty();
+	}
+
+
+	template<typename V>
+	void SlotMap<V>::reserve(size_t capacity)
+	{
+		m_Values.reserve(capacity);
+		m_ValueSlots.reserve(capacity);
+		m_Slots.reserve(capacity);
+	}
+
+
+	template<typename V>
+	bool SlotMap<V>::contains(SlotHandle handle)
+	{
+		return handle.index < m_Slots.size() && m_Slots[handle.index].generation == handle.generation;
+	}
+
+
+	template<typename V>
+	V* SlotMap<V>::find(SlotHandle handle)
+	{
+		//Stale handles are recognized by their generation
+		if (!contains(handle))
+		{
+			return nullptr;
+		}
+
+		return &m_Values[m_Slots[handle.index].position];
+	}
+
+
+	template<typename V>
+	V& SlotMap<V>::at(SlotHandle handle)
+	{
+		return m_Values[m_Slots[handle.index].position];
+	}
+
+
+	template<typename V>
+	SlotHandle SlotMap<V>::handle_at(size_t position)
+	{
+		uint32_t slot = m_ValueSlots[position];
+
+		return { slot, m_Slots[slot].generation };
+	}
+
+
+	template<typename V>
+	typename SlotMap<V>::iterator SlotMap<V>::begin()
+	{
+		return m_Values.begin();
+	}
+
+
+	template<typename V>
+	typename SlotMap<V>::iterator SlotMap<V>::end()
+	{
+		return m_Values.end();
+	}
+
+
+	template<typename V>
+	SlotHandle SlotMap<V>::insert(V value)
+	{
+		uint32_t slot;
+
+		//Reusing a free slot, or making a new one
+		if (m_FreeSlot != UINT32_MAX)
+		{
+			slot = m_FreeSlot;
+			m_FreeSlot = m_Slots[slot].position;
+		}
+		else
+		{
+			slot = (uint32_t)m_Slots.size();
+			m_Slots.push_back({});
+		}
+
+		//The value always goes to the end
+		m_Slots[slot].position = (uint32_t)m_Values.size();
+		m_Values.push_back(std::move(value));
+		m_ValueSlots.push_back(slot);
+
+		return { slot, m_Slots[slot].generation };
+	}
+
+
+	template<typename V>
+	bool SlotMap<V>::erase(SlotHandle handle)
+	{
+		if (!contains(handle))
+		{
+			return false;
+		}
+
+		uint32_t position = m_Slots[handle.index].position;
+
+		//The last value takes the place of the erased one, so the values stay packed
+		if (position != m_Values.size() - 1)
+		{
+			m_Values[position] = std::move(m_Values.back());
+			m_ValueSlots[position] = m_ValueSlots.back();
+			m_Slots[m_ValueSlots[position]].position = position;
+		}
+
+		m_Values.pop_back();
+		m_ValueSlots.pop_back();
+
+		//Invalidating every handle to the slot, and placing it on the free list
+		m_Slots[handle.index].generation++;
+		m_Slots[handle.index].position = m_FreeSlot;
+		m_FreeSlot = handle.index;
+
+		return true;
+	}
+
+
+	template<typename V>
+	void SlotMap<V>::clear()
+	{
+		//Every handle given so far has to become stale
+		for (size_t i = 0; i < m_ValueSlots.size(); ++i)
+		{
+			uint32_t slot = m_ValueSlots[i];
+
+			m_Slots[slot].generation++;
+			m_Slots[slot].position = m_FreeSlot;
+			m_FreeSlot = slot;
+		}
+
+		m_Values.clear();
+		m_ValueSlots.clear();
+	}
+
+}
+#endif
@@ -0,0 +1,352 @@
+//Dependencies
+#include SPATIAL_TREES_DEPENDENCIES
+#include "../ContainedOctree.h"
+#include "../../Common/benchmarks/Measure.h"
+
+//Default Libraries
+#include<list>
+#include<array>
+#include<cmath>
+#include<vector>
+#include<memory>
+#include<cstdio>
+#include<algorithm>
+
+
+/*
+* The costs of the Octree, each table is meant to be read row against row. Every tree is filled
+* with small random items packed densely enough for most of the nodes to hold one.
+* The rows marked "shared" are the tree as it was before the node pool: a heap block per node
+* behind a shared pointer, with the boxes of the octants stored and every walk a recursion.
+*/
+
+
+using namespace DataStructures;
+
+
+namespace {
+
+	//The side of a leaf node, the worlds below are whole numbers of the leaves
+	const float LEAF = 4.0f;
+	const int RUNS = 5;
+
+
+	//About one item per cell of the deepest level of a world of the side
+	std::vector<Collisions::AABB> boxes(float world)
+	{
+		std::vector<Collisions::AABB> items((size_t)(world * world * world / 8.0f));
+
+		for (Collisions::AABB& item : items)
+		{
+			glm::vec3 corner(Benchmarks::uniform(0.0f, world - 1.0f), Benchmarks::uniform(0.0f, world - 1.0f), Benchmarks::uniform(0.0f, world - 1.0f));
+			item = Collisions::AABB(corner, corner + glm::vec3(0.4f));
+		}
+
+		return items;
+	}
+
+
+	template<typename Tree>
+	void fill(Tree& tree, std::vector<Collisions::AABB>& items)
+	{
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			tree.insert((int)i, items[i]);
+		}
+	}
+
+
+	//The node before the pool, subdivided in the constructor down to the same depth as the eager Octree
+	struct Previous
+	{
+		Collisions::AABB position;
+		std::array<Collisions::AABB, 8> bounds;
+		std::array<std::shared_ptr<Previous>, 8> octants;
+		std::list<int> items;
+		bool leaf = true;
+
+		Previous(Collisions::AABB area, size_t max_depth, size_t minimum_dimensions, size_t depth = 0) :
+			position(area)
+		{
+			std::array<glm::vec3, 2> region = area.bounding_region();
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 dimensions = glm::max(region[0], region[1]) - minimum;
+			glm::vec3 half = dimensions * 0.5f;
+
+			if (depth > max_depth || dimensions.x < minimum_dimensions || dimensions.y < minimum_dimensions || dimensions.z < minimum_dimensions)
+			{
+				return;
+			}
+
+			leaf = false;
+
+			for (int i = 0; i < 8; i++)
+			{
+				glm::vec3 corner = minimum + glm::vec3((float)(i & 1), (float)((i >> 1) & 1), (float)((i >> 2) & 1)) * half;
+				bounds[i] = Collisions::AABB(corner, corner + half);
+				octants[i] = std::make_shared<Previous>(bounds[i], max_depth, minimum_dimensions, depth + 1);
+			}
+		}
+
+		//A node takes a single item, like the one of the Octree, the rest of them are refused
+		void insert(int item, Collisions::AABB& area)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				if (octants[i] && bounds[i].contains(area))
+				{
+					octants[i]->insert(item, area);
+					return;
+				}
+			}
+
+			if (items.empty() && position.contains(area))
+			{
+				items.push_back(item);
+			}
+		}
+
+		//The same rule as the search of the Octree, the items of a node holding the area, or of a leaf reaching into it
+		void query(Collisions::AABB& area, std::vector<int>& found)
+		{
+			if (!items.empty() && (position.contains(area) || (leaf && position.intersects2(area))))
+			{
+				found.insert(found.end(), items.begin(), items.end());
+			}
+
+			for (int i = 0; i < 8; i++)
+			{
+				if (octants[i] && bounds[i].intersects2(area))
+				{
+					octants[i]->query(area, found);
+				}
+			}
+		}
+	};
+
+
+	//The shift of a filled tree, the best of the runs, every run on a tree filled a new
+	void shift(int leaves, int slab)
+	{
+		float world = LEAF * (float)leaves;
+		size_t depth = (size_t)std::log2((double)leaves);
+		double best = 0.0;
+		size_t size = 0, removed = 0;
+
+		for (int run = 0; run < RUNS; ++run)
+		{
+			Octree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(world)), depth, 1);
+			std::vector<Collisions::AABB> items = boxes(world);
+			fill(tree, items);
+
+			size = tree.size();
+			removed = 0;
+
+			double elapsed = Benchmarks::milliseconds([&]() {
+				tree.shift(glm::ivec3(slab, 0, 0), [&removed](int&) { removed++; });
+			});
+
+			best = run ? std::min(best, elapsed) : elapsed;
+		}
+
+		std::printf("%8d %8d %10zu %10zu %10.3f\n", leaves, slab, size, removed, best);
+	}
+
+
+	//Creating the eager tree and filling it, the best of the runs, with the memory it took, every row in a process of its own
+	template<typename Tree>
+	void build(int leaves, const char* layout)
+	{
+		Benchmarks::isolated([&]() {
+			float world = LEAF * (float)leaves;
+			size_t depth = (size_t)std::log2((double)leaves);
+			std::vector<Collisions::AABB> items = boxes(world);
+			double best = 0.0;
+			long memory = 0;
+
+			//The memory is the one of the first run, the later ones get the memory that the first one freed
+			for (int run = 0; run < RUNS; ++run)
+			{
+				std::unique_ptr<Tree> tree;
+				long before = Benchmarks::resident_kilobytes();
+
+				double elapsed = Benchmarks::milliseconds([&]() {
+					tree.reset(new Tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(world)), depth, 1));
+					fill(*tree, items);
+				});
+
+				if (!run)
+				{
+					memory = Benchmarks::resident_kilobytes() - before;
+				}
+
+				best = run ? std::min(best, elapsed) : elapsed;
+			}
+
+			std::printf("%8d %8s %10zu %10.3f %10ld\n", leaves, layout, items.size(), best, memory);
+		});
+	}
+
+
+	//The boxes of the searches, 8 units wide, inside of a world of the side
+	std::vector<Collisions::AABB> searches(float world, int count)
+	{
+		std::vector<Collisions::AABB> areas(count);
+
+		for (Collisions::AABB& area : areas)
+		{
+			glm::vec3 corner(Benchmarks::uniform(0.0f, world - 8.0f), Benchmarks::uniform(0.0f, world - 8.0f), Benchmarks::uniform(0.0f, world - 8.0f));
+			area = Collisions::AABB(corner, corner + glm::vec3(8.0f));
+		}
+
+		return areas;
+	}
+
+
+	//Searching the whole world, which visits every node, and the boxes around the random points. The found items are summed up,
+	//the same for both of the layouts
+	template<typename Tree>
+	void walk(int leaves, const char* layout, std::vector<Collisions::AABB>& items, std::vector<Collisions::AABB>& areas)
+	{
+		float world = LEAF * (float)leaves;
+		size_t depth = (size_t)std::log2((double)leaves);
+
+		Collisions::AABB whole(glm::vec3(0.0f), glm::vec3(world));
+		Tree tree(whole, depth, 1);
+		fill(tree, items);
+
+		size_t all = 0, found = 0;
+		std::vector<int> results;
+
+		double walking = Benchmarks::milliseconds([&]() {
+			for (int run = 0; run < RUNS; ++run)
+			{
+				results.clear();
+				tree.query(whole, results);
+				all += results.size();
+			}
+		});
+
+		double searching = Benchmarks::milliseconds([&]() {
+			for (Collisions::AABB& area : areas)
+			{
+				results.clear();
+				tree.query(area, results);
+				found += results.size();
+			}
+		});
+
+		std::printf("%8d %8s %10.3f %10zu %10.3f %10zu\n", leaves, layout, walking / RUNS, all / RUNS, searching, found);
+	}
+
+
+	//The searches of a tick one by one, through dfs and through query, against all of them in a single walk, the best of the runs.
+	//The handles found by every way are summed up, they have to be the same
+	void batch(ContainedOctree<int>& tree, const char* kind, std::vector<Collisions::AABB>& areas)
+	{
+		std::list<SlotHandle> listed;
+		std::vector<SlotHandle> handles;
+		std::vector<std::vector<SlotHandle>> results;
+		double times[3] = {};
+		size_t found[3] = {};
+
+		for (int run = 0; run < RUNS; ++run)
+		{
+			size_t counts[3] = {};
+
+			double elapsed[3] = {
+				Benchmarks::milliseconds([&]() {
+					for (Collisions::AABB& area : areas)
+					{
+						listed.clear();
+						tree.dfs(area, listed);
+						counts[0] += listed.size();
+					}
+				}),
+				Benchmarks::milliseconds([&]() {
+					for (Collisions::AABB& area : areas)
+					{
+						handles.clear();
+						tree.query(area, handles);
+						counts[1] += handles.size();
+					}
+				}),
+				Benchmarks::milliseconds([&]() {
+					tree.query(areas, results);
+
+					for (std::vector<SlotHandle>& result : results)
+					{
+						counts[2] += result.size();
+					}
+				})
+			};
+
+			for (int way = 0; way < 3; ++way)
+			{
+				times[way] = run ? std::min(times[way], elapsed[way]) : elapsed[way];
+				found[way] = counts[way];
+			}
+		}
+
+		std::printf("%8zu %8s %10.3f %10.3f %10.3f %10zu%s\n", areas.size(), kind, times[0], times[1], times[2], found[2],
+			found[0] == found[2] && found[1] == found[2] ? "" : " differ");
+	}
+
+}
+
+
+int main()
+{
+	//The pool takes the nodes in blocks, without a heap block and a reference count for every one of them.
+	//It goes first, the rows measure their memory in processes of their own, but those start with the memory of this one
+	std::printf("Build of an eager tree\n%8s %8s %10s %10s %10s\n", "world", "layout", "items", "ms", "KB");
+
+	for (int leaves : { 8, 16, 32 })
+	{
+		build<Octree<int>>(leaves, "pool");
+		build<Previous>(leaves, "shared");
+	}
+
+	//The explicit stack against the recursion, the search of the Octree also tests all of the octants of a node at once
+	std::printf("\nWalks of an eager tree, %d searches\n%8s %8s %10s %10s %10s %10s\n", 2000, "world", "layout", "whole ms", "items", "query ms", "found");
+
+	for (int leaves : { 16, 32 })
+	{
+		std::vector<Collisions::AABB> items = boxes(LEAF * (float)leaves);
+		std::vector<Collisions::AABB> areas = searches(LEAF * (float)leaves, 2000);
+
+		walk<Octree<int>>(leaves, "pool", items, areas);
+		walk<Previous>(leaves, "shared", items, areas);
+	}
+
+	//A single walk for all of the searches of a tick, every node is visited once for the searches still reaching into it
+	std::printf("\nSearches of a tick on a world of %d leaves\n%8s %8s %10s %10s %10s %10s\n", 16, "searches", "tree", "dfs ms", "query ms", "batch ms", "found");
+
+	for (bool lazy : { false, true })
+	{
+		std::vector<Collisions::AABB> items = boxes(LEAF * 16.0f);
+		ContainedOctree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(LEAF * 16.0f)), 4, 1, lazy);
+		fill(tree, items);
+
+		for (int count : { 100, 1000, 4000 })
+		{
+			std::vector<Collisions::AABB> areas = searches(LEAF * 16.0f, count);
+			batch(tree, lazy ? "lazy" : "eager", areas);
+		}
+	}
+
+	//The nodes stay in place, so a shift costs the slab of the cells leaving the world, not the whole world
+	std::printf("\nShift by a slab of leaves\n%8s %8s %10s %10s %10s\n", "world", "slab", "items", "removed", "ms");
+
+	for (int slab : { 1, 2, 4, 8 })
+	{
+		shift(32, slab);
+	}
+
+	for (int leaves : { 16, 32, 64 })
+	{
+		shift(leaves, 1);
+	}
+
+	return 0;
+}
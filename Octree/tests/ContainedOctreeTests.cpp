@@ -0,0 +1,507 @@
+//Dependencies
+#include SPATIAL_TREES_DEPENDENCIES
+#include "../ContainedOctree.h"
+#include "../../Common/tests/Check.h"
+
+//Default Libraries
+#include<map>
+#include<set>
+#include<list>
+#include<vector>
+#include<thread>
+#include<cstdio>
+#include<fstream>
+#include<algorithm>
+
+
+/*
+* The ContainedOctree against the plain list of the items it was given. Every item the container
+* takes in stays either inside of it or comes back through returned_data, so the two together
+* always hold all of the living items, and the searches by the item boxes are compared with
+* a brute force walk over the items the container holds.
+*/
+
+
+using namespace DataStructures;
+
+
+namespace {
+
+	//The world of every test, 64 units wide, with the cells of 2 units at the deepest level
+	const float WORLD = 64.0f;
+	const size_t MAX_DEPTH = 4;
+	const size_t MINIMUM_DIMENSIONS = 1;
+
+	//The shifts go by the nodes at the max depth
+	const float LEAF = WORLD / (float)(1 << MAX_DEPTH);
+
+
+	Collisions::AABB random_box(float minimum, float maximum, float largest)
+	{
+		glm::vec3 corner(Tests::uniform(minimum, maximum), Tests::uniform(minimum, maximum), Tests::uniform(minimum, maximum));
+		glm::vec3 size(Tests::uniform(0.1f, largest), Tests::uniform(0.1f, largest), Tests::uniform(0.1f, largest));
+
+		return Collisions::AABB(corner, corner + size);
+	}
+
+
+	//A sphere around the whole world, every item is inside of it
+	Shapes::Sphere everything()
+	{
+		return Shapes::Sphere{ glm::vec3(WORLD * 0.5f), WORLD * 100.0f };
+	}
+
+
+	template<template<typename> class Engine>
+	std::map<int, SlotHandle> handles(ContainedOctree<int, Engine>& tree)
+	{
+		std::map<int, SlotHandle> found;
+
+		tree.query_shape(everything(), [&found](SlotHandle handle, int& item) {
+			found[item] = handle;
+			return true;
+		});
+
+		return found;
+	}
+
+
+	//The items kept by the container and the ones it gave back are the living items, each of them once
+	template<template<typename> class Engine>
+	bool accounted(ContainedOctree<int, Engine>& tree, std::list<std::pair<int, Collisions::AABB>>& returned_data, const std::set<int>& living)
+	{
+		std::multiset<int> seen;
+
+		for (OctreeItem<int, Engine>& stored : tree)
+		{
+			seen.insert(stored.item);
+		}
+
+		for (std::pair<int, Collisions::AABB>& item : returned_data)
+		{
+			seen.insert(item.first);
+		}
+
+		return seen.size() == living.size() && std::set<int>(seen.begin(), seen.end()) == living;
+	}
+
+
+	//Every kept item is inside of the tree, and the counts of the random areas match the brute force ones
+	template<template<typename> class Engine>
+	bool consistent(ContainedOctree<int, Engine>& tree)
+	{
+		bool inside = true;
+		Collisions::AABB bounds = tree.aabb();
+
+		for (OctreeItem<int, Engine>& stored : tree)
+		{
+			inside = inside && bounds.contains(stored.item_position.aabb);
+		}
+
+		std::array<glm::vec3, 2> region = bounds.bounding_region();
+		bool counted = true;
+
+		for (int i = 0; i < 200; ++i)
+		{
+			Collisions::AABB area = random_box(region[0].x - 4.0f, region[1].x, 24.0f);
+			size_t expected = 0;
+
+			for (OctreeItem<int, Engine>& stored : tree)
+			{
+				if (area.intersects2(stored.item_position.aabb)) expected++;
+			}
+
+			counted = counted && tree.count(area) == expected;
+		}
+
+		return inside && counted && handles(tree).size() == tree.size();
+	}
+
+
+	void async_shift()
+	{
+		ContainedOctree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS);
+		std::set<int> living;
+		std::list<std::pair<int, Collisions::AABB>> returned_data;
+
+		int next = 0;
+
+		for (; next < 3000; ++next)
+		{
+			if (tree.insert(next, random_box(0.0f, WORLD - 3.0f, 3.0f))) living.insert(next);
+		}
+
+		//The moved tree is built aside, only one at a time
+		CHECK(tree.shift_async(glm::ivec3(3, 0, -2)));
+		CHECK(!tree.shift_async(glm::ivec3(1, 0, 0)));
+
+		//The changes made in the meantime go to the current tree and are carried over
+		std::map<int, SlotHandle> current = handles(tree);
+
+		for (auto it = current.begin(); it != current.end(); std::advance(it, 3))
+		{
+			CHECK(tree.remove(it->second));
+			living.erase(it->first);
+
+			if (std::distance(it, current.end()) <= 3) break;
+		}
+
+		for (int limit = next + 500; next < limit; ++next)
+		{
+			if (tree.insert(next, random_box(0.0f, WORLD - 3.0f, 3.0f))) living.insert(next);
+		}
+
+		while (!tree.publish_shift(returned_data))
+		{
+			std::this_thread::yield();
+		}
+
+		CHECK(!tree.shift_ready());
+
+		std::array<glm::vec3, 2> region = tree.aabb().bounding_region();
+		CHECK(region[0] == glm::vec3(3.0f * LEAF, 0.0f, -2.0f * LEAF));
+
+		CHECK(accounted(tree, returned_data, living));
+		CHECK(consistent(tree));
+	}
+
+
+	void cancelled_shift()
+	{
+		ContainedOctree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS);
+
+		std::vector<std::pair<int, Collisions::AABB>> items;
+
+		for (int i = 0; i < 100000; ++i)
+		{
+			items.push_back({ i, random_box(0.0f, WORLD - 1.0f, 1.0f) });
+		}
+
+		tree.insert(items);
+
+		//Clearing drops the tree being built, the container is empty and takes the next shift right away
+		CHECK(tree.shift_async(glm::ivec3(1, 0, 0)));
+		tree.clear();
+
+		CHECK(tree.empty() && !tree.shift_ready());
+
+		std::list<std::pair<int, Collisions::AABB>> returned_data;
+		CHECK(tree.shift_async(glm::ivec3(1, 0, 0)));
+
+		while (!tree.publish_shift(returned_data))
+		{
+			std::this_thread::yield();
+		}
+
+		CHECK(tree.empty() && returned_data.empty());
+
+		//Resizing drops it as well, the items are placed by the new area only
+		tree.insert(items);
+
+		CHECK(tree.shift_async(glm::ivec3(-5, 0, 0)));
+		tree.resize(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD * 0.5f)));
+
+		CHECK(!tree.shift_ready() && !tree.empty());
+		CHECK(consistent(tree));
+	}
+
+
+
+	//The store against the items handed to it, every item comes back once, from the chunks reaching into the area
+	void chunk_store()
+	{
+		ChunkStore<int> store("chunk_store.bin", 8.0f);
+		CHECK(store.is_open());
+
+		std::map<int, Collisions::AABB> stored;
+		std::vector<std::pair<int, Collisions::AABB>> items;
+
+		for (int i = 0; i < 4000; ++i)
+		{
+			items.push_back({ i, random_box(-WORLD, WORLD, 3.0f) });
+			stored[i] = items.back().second;
+		}
+
+		//Stored in two parts, the second one while the first one may still be on its way to the file
+		std::vector<std::pair<int, Collisions::AABB>> first(items.begin(), items.begin() + 2500), second(items.begin() + 2500, items.end());
+		store.store(first);
+		store.store(second);
+
+		CHECK(store.size() == items.size());
+
+		bool found = true, once = true;
+
+		for (int i = 0; i < 60 && !stored.empty(); ++i)
+		{
+			Collisions::AABB area = random_box(-WORLD, WORLD, 24.0f);
+
+			if (i % 3 == 0) store.prefetch(area);
+			if (i % 5 == 0) store.flush();
+
+			std::vector<std::pair<int, Collisions::AABB>> loaded;
+			store.load(area, loaded);
+
+			std::set<int> taken;
+
+			for (auto& item : loaded)
+			{
+				once = once && stored.count(item.first) && taken.insert(item.first).second;
+				stored.erase(item.first);
+			}
+
+			//Nothing reaching into the area is left behind
+			for (auto& item : stored)
+			{
+				found = found && !area.intersects2(item.second);
+			}
+
+			CHECK(store.size() == stored.size());
+		}
+
+		CHECK(found);
+		CHECK(once);
+
+		//Whatever is left comes out at once
+		std::vector<std::pair<int, Collisions::AABB>> rest;
+		Collisions::AABB everywhere(glm::vec3(-4.0f * WORLD), glm::vec3(4.0f * WORLD));
+		store.load(everywhere, rest);
+
+		CHECK(rest.size() == stored.size() && store.size() == 0 && store.chunks() == 0);
+
+		//The runs freed next to each other merge, so a chunk as big as all of them fits the file without growing it
+		store.flush();
+		uint64_t capacity = store.capacity();
+
+		std::vector<std::pair<int, Collisions::AABB>> crowded;
+
+		for (int i = 0; i < 3000; ++i)
+		{
+			crowded.push_back({ i, Collisions::AABB(glm::vec3(1.0f), glm::vec3(2.0f)) });
+		}
+
+		store.store(crowded);
+		store.flush();
+
+		CHECK(store.capacity() <= std::max<uint64_t>(capacity, crowded.size()));
+		CHECK(store.good());
+
+		std::vector<std::pair<int, Collisions::AABB>> back;
+		CHECK(store.load(everywhere, back));
+		CHECK(back.size() == crowded.size());
+
+		//A chunk that can't be read stays in the store with its runs, and the load says so
+		store.store(crowded);
+		store.flush();
+
+		{
+			std::ofstream cut("chunk_store.bin", std::ios::binary | std::ios::trunc);
+		}
+
+		back.clear();
+		CHECK(!store.load(everywhere, back));
+		CHECK(back.empty() && store.size() == crowded.size() && store.chunks() == 1 && !store.good());
+
+		std::remove("chunk_store.bin");
+
+		//Without the file the records stay in the memory, they come back all the same
+		ChunkStore<int> broken("missing_directory/chunk_store.bin", 8.0f);
+		CHECK(!broken.is_open());
+
+		broken.store(crowded);
+		broken.flush();
+
+		back.clear();
+		broken.load(everywhere, back);
+		CHECK(!broken.good() && back.size() == crowded.size() && broken.size() == 0);
+	}
+
+
+	//The items leaving the tree are paged out and come back once the tree moves back over them
+	void paging()
+	{
+		ChunkStore<int> store("paging.bin", 8.0f);
+		ContainedOctree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS);
+		tree.set_chunk_store(&store);
+
+		std::set<int> living;
+
+		for (int i = 0; i < 3000; ++i)
+		{
+			if (tree.insert(i, random_box(0.0f, WORLD - 3.0f, 3.0f))) living.insert(i);
+		}
+
+		std::list<std::pair<int, Collisions::AABB>> given;
+		bool reaching = true;
+
+		//Away and back, every item is in the tree, given back in returned_data, or in the store
+		const glm::ivec3 moves[] = { glm::ivec3(2, 0, 0), glm::ivec3(2, 0, 1), glm::ivec3(0, 0, 3), glm::ivec3(-4, 0, -4) };
+
+		for (const glm::ivec3& move : moves)
+		{
+			std::list<std::pair<int, Collisions::AABB>> returned_data;
+			tree.shift(move, returned_data);
+
+			//Only the items wholly outside of the tree are paged out
+			for (auto& item : returned_data)
+			{
+				reaching = reaching && tree.aabb().intersects2(item.second);
+			}
+
+			given.splice(given.end(), returned_data);
+
+			std::set<int> seen;
+
+			for (OctreeItem<int>& stored : tree) seen.insert(stored.item);
+			for (auto& item : given) seen.insert(item.first);
+
+			CHECK(seen.size() + store.size() == living.size());
+		}
+
+		CHECK(reaching);
+
+		//Back at the start, nothing that fits the tree is left in the store
+		std::array<glm::vec3, 2> region = tree.aabb().bounding_region();
+		CHECK(region[0] == glm::vec3(0.0f));
+
+		std::vector<std::pair<int, Collisions::AABB>> rest;
+		Collisions::AABB everywhere(glm::vec3(-4.0f * WORLD), glm::vec3(4.0f * WORLD));
+		store.load(everywhere, rest);
+
+		bool outside = true;
+
+		for (auto& item : rest)
+		{
+			outside = outside && !tree.aabb().intersects2(item.second);
+		}
+
+		CHECK(outside);
+
+		tree.set_chunk_store(nullptr);
+		std::remove("paging.bin");
+	}
+
+
+	//The pointerless engine reports exactly the items whose boxes intersect the area, so it's compared with them directly
+	void linear_engine()
+	{
+		ContainedOctree<int, LinearOctree> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS);
+		std::map<int, Collisions::AABB> living;
+
+		std::vector<std::pair<int, Collisions::AABB>> items;
+
+		for (int i = 0; i < 5000; ++i)
+		{
+			items.push_back({ i, random_box(0.0f, WORLD - 4.0f, 4.0f) });
+			living[i] = items.back().second;
+		}
+
+		//Every item fits, a cell takes any number of them
+		CHECK(tree.insert(items) == items.size());
+
+		Collisions::AABB world(glm::vec3(0.0f), glm::vec3(WORLD));
+		std::map<int, SlotHandle> handles;
+
+		tree.query(world, [&handles](SlotHandle handle, int& item) {
+			handles[item] = handle;
+			return true;
+		});
+
+		CHECK(handles.size() == items.size());
+
+		//Erasing a half of them, then a few fresh ones are left waiting to be sorted in
+		for (int i = 0; i < 5000; i += 2)
+		{
+			CHECK(tree.remove(handles[i]));
+			living.erase(i);
+		}
+
+		for (int i = 5000; i < 5050; ++i)
+		{
+			Collisions::AABB box = random_box(0.0f, WORLD - 4.0f, 4.0f);
+			CHECK(tree.insert(i, box));
+			living[i] = box;
+		}
+
+		CHECK(tree.size() == living.size());
+
+		bool found = true;
+
+		for (int i = 0; i < 300; ++i)
+		{
+			Collisions::AABB area = random_box(-4.0f, WORLD, 16.0f);
+			std::set<int> expected;
+
+			for (auto& item : living)
+			{
+				if (area.intersects2(item.second)) expected.insert(item.first);
+			}
+
+			std::set<int> dfs, bfs, visited;
+			std::list<SlotHandle> dfs_handles, bfs_handles;
+			tree.dfs(area, dfs_handles);
+			tree.bfs(area, bfs_handles);
+
+			for (SlotHandle handle : dfs_handles) dfs.insert(*tree.find(handle));
+			for (SlotHandle handle : bfs_handles) bfs.insert(*tree.find(handle));
+
+			tree.query(area, [&visited](SlotHandle, int& item) { visited.insert(item); return true; });
+
+			found = found && dfs == expected && bfs == expected && visited == expected && dfs_handles.size() == expected.size();
+		}
+
+		CHECK(found);
+
+		//The pairs, of the sorted and the waiting entries alike
+		std::set<std::pair<int, int>> expected;
+
+		for (auto first = living.begin(); first != living.end(); ++first)
+		{
+			for (auto second = std::next(first); second != living.end(); ++second)
+			{
+				if (first->second.intersects2(second->second)) expected.insert({ first->first, second->first });
+			}
+		}
+
+		std::set<std::pair<int, int>> reported;
+		size_t calls = 0;
+
+		tree.overlapping_pairs([&](SlotHandle, int& first, SlotHandle, int& second) {
+			reported.insert({ std::min(first, second), std::max(first, second) });
+			calls++;
+			return true;
+		});
+
+		CHECK(reported == expected && calls == expected.size());
+
+		for (bool multi_thread : { false, true })
+		{
+			tree.set_multi_thread(multi_thread);
+
+			std::vector<std::pair<SlotHandle, SlotHandle>> pairs;
+			tree.overlapping_pairs(pairs);
+
+			std::set<std::pair<int, int>> collected;
+
+			for (auto& pair : pairs)
+			{
+				int first = *tree.find(pair.first), second = *tree.find(pair.second);
+				collected.insert({ std::min(first, second), std::max(first, second) });
+			}
+
+			CHECK(collected == expected && pairs.size() == expected.size());
+		}
+	}
+
+}
+
+
+int main()
+{
+	async_shift();
+	cancelled_shift();
+	chunk_store();
+	paging();
+	linear_engine();
+
+	return Tests::failures();
+}
@@ -0,0 +1,1086 @@
+//Dependencies
+#include SPATIAL_TREES_DEPENDENCIES
+#include "../ContainedOctree.h"
+#include "../../Common/tests/Check.h"
+
+//Default Libraries
+#include<map>
+#include<list>
+#include<tuple>
+#include<vector>
+#include<cstdio>
+#include<cstddef>
+#include<fstream>
+#include<algorithm>
+
+
+/*
+* The Octree against a brute force search over the same items. The box search of the tree
+* reports the items by the nodes holding them, so the brute force side follows every item
+* to the node it ends up in, the deepest one holding its whole box, and applies the same rule.
+* Every other search works on the boxes of the items, and is compared with them directly.
+*/
+
+
+using namespace DataStructures;
+
+
+namespace {
+
+	//The world of every test, 64 units wide, with the cells of 2 units at the deepest level
+	const float WORLD = 64.0f;
+	const size_t MAX_DEPTH = 4;
+	const size_t MINIMUM_DIMENSIONS = 1;
+
+
+	Collisions::AABB random_box(float minimum, float maximum, float largest)
+	{
+		glm::vec3 corner(Tests::uniform(minimum, maximum), Tests::uniform(minimum, maximum), Tests::uniform(minimum, maximum));
+		glm::vec3 size(Tests::uniform(0.1f, largest), Tests::uniform(0.1f, largest), Tests::uniform(0.1f, largest));
+
+		return Collisions::AABB(corner, corner + size);
+	}
+
+
+	std::vector<int> sorted(std::vector<int> items)
+	{
+		std::sort(items.begin(), items.end());
+		return items;
+	}
+
+
+	/*
+	* Follows every insertion the way the tree does, without any tree: an item goes down while one octant holds
+	* its whole box, and stays in the node it stopped at, if that node doesn't hold any item yet.
+	*/
+	class Model
+	{
+	public:
+
+		//A node by its depth and its position in the grid of that depth
+		using Key = std::tuple<size_t, int, int, int>;
+
+		struct Item
+		{
+			Collisions::AABB box;
+			Key node;
+			bool stored = false;
+		};
+
+		glm::vec3 origin;
+		float side;
+		size_t depth;
+		bool lazy;
+
+		std::vector<Item> items;
+		std::map<Key, int> occupied;
+
+		//The nodes with children, only matters for the lazy trees
+		std::map<Key, bool> parents;
+
+		Model(glm::vec3 Origin, float Side, size_t Depth, bool Lazy) :
+			origin(Origin), side(Side), depth(Depth), lazy(Lazy)
+		{}
+
+		Collisions::AABB bounds(const Key& key)
+		{
+			float cell = side / (float)(1 << std::get<0>(key));
+			glm::vec3 minimum = origin + glm::vec3((float)std::get<1>(key), (float)std::get<2>(key), (float)std::get<3>(key)) * cell;
+
+			return Collisions::AABB(minimum, minimum + glm::vec3(cell));
+		}
+
+		bool leaf(const Key& key)
+		{
+			return lazy ? !parents.count(key) : std::get<0>(key) == depth;
+		}
+
+		//Returns whether the tree is expected to take the item
+		bool insert(int id, Collisions::AABB box)
+		{
+			if ((int)items.size() <= id)
+			{
+				items.resize(id + 1);
+			}
+
+			Item& item = items[id];
+			item.box = box;
+			item.stored = false;
+
+			if (!bounds(Key(0, 0, 0, 0)).contains(box))
+			{
+				return false;
+			}
+
+			std::array<glm::vec3, 2> region = box.bounding_region();
+			Key key(0, 0, 0, 0);
+
+			while (std::get<0>(key) < depth)
+			{
+				Collisions::AABB node = bounds(key);
+				glm::vec3 center = node.center();
+				int step[3];
+				bool inside = true;
+
+				for (int i = 0; i < 3; ++i)
+				{
+					if (region[1][i] <= center[i]) step[i] = 0;
+					else if (region[0][i] >= center[i]) step[i] = 1;
+					else inside = false;
+				}
+
+				if (!inside)
+				{
+					break;
+				}
+
+				parents[key] = true;
+				key = Key(std::get<0>(key) + 1, std::get<1>(key) * 2 + step[0], std::get<2>(key) * 2 + step[1], std::get<3>(key) * 2 + step[2]);
+			}
+
+			item.node = key;
+
+			if (occupied.count(key))
+			{
+				return false;
+			}
+
+			occupied[key] = id;
+			item.stored = true;
+
+			return true;
+		}
+
+		void erase(int id)
+		{
+			occupied.erase(items[id].node);
+			items[id].stored = false;
+		}
+
+		std::vector<int> query(Collisions::AABB& area)
+		{
+			std::vector<int> found;
+
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				if (!items[i].stored) continue;
+
+				Collisions::AABB node = bounds(items[i].node);
+
+				if (node.contains(area) || (leaf(items[i].node) && node.intersects2(area)))
+				{
+					found.push_back((int)i);
+				}
+			}
+
+			return found;
+		}
+
+		std::vector<int> stored()
+		{
+			std::vector<int> found;
+
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				if (items[i].stored) found.push_back((int)i);
+			}
+
+			return found;
+		}
+	};
+
+
+	//The tree and the model filled with the same random items
+	struct Fixture
+	{
+		Octree<int> tree;
+		Model model;
+		std::vector<Trees::Location<int>> locations;
+
+		Fixture(bool lazy, size_t count, float largest) :
+			tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS, lazy),
+			model(glm::vec3(0.0f), WORLD, MAX_DEPTH + 1, lazy)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				Collisions::AABB box = random_box(0.0f, WORLD - largest, largest);
+				locations.push_back(tree.insert((int)i, box));
+
+				CHECK(model.insert((int)i, box) == (locations.back().items_container != nullptr));
+			}
+		}
+
+		//The boxes of the items, for the searches that need them
+		Collisions::AABB box(int item)
+		{
+			return model.items[item].box;
+		}
+	};
+
+
+	void box_search()
+	{
+		for (bool lazy : { false, true })
+		{
+			Fixture fixture(lazy, 1500, 6.0f);
+			Octree<int>& tree = fixture.tree;
+
+			CHECK(tree.size() == fixture.model.stored().size());
+
+			std::vector<Collisions::AABB> areas;
+			std::vector<std::vector<int>> expected;
+
+			for (int i = 0; i < 300; ++i)
+			{
+				Collisions::AABB area = random_box(-4.0f, WORLD, 12.0f);
+				areas.push_back(area);
+				expected.push_back(fixture.model.query(area));
+
+				std::vector<int> found;
+				tree.query(area, found);
+				CHECK(sorted(found) == expected.back());
+
+				std::list<int> listed;
+				tree.dfs(area, listed);
+				CHECK(listed.size() == found.size());
+			}
+
+			//The batch gives every area the same items in the same order as the single search
+			std::vector<std::vector<int>> results;
+			tree.query(areas, results);
+
+			bool same = results.size() == areas.size();
+
+			for (size_t i = 0; same && i < areas.size(); ++i)
+			{
+				std::vector<int> single;
+				tree.query(areas[i], single);
+				same = single == results[i];
+			}
+
+			CHECK(same);
+
+			//Stopping the search on the first item
+			size_t calls = 0;
+			tree.query(areas[0], [&calls](int&) { calls++; return false; });
+			CHECK(calls == std::min<size_t>(1, expected[0].size()));
+		}
+	}
+
+
+	void erasing()
+	{
+		Fixture fixture(false, 1000, 4.0f);
+		Octree<int>& tree = fixture.tree;
+
+		for (int i = 0; i < 1000; i += 2)
+		{
+			bool stored = fixture.model.items[i].stored;
+
+			CHECK(tree.erase(i, fixture.locations[i]) == stored);
+			CHECK(!tree.erase(i, fixture.locations[i]));
+
+			if (stored) fixture.model.erase(i);
+		}
+
+		CHECK(tree.size() == fixture.model.stored().size());
+
+		bool same = true;
+
+		for (int i = 0; i < 100; ++i)
+		{
+			Collisions::AABB area = random_box(0.0f, WORLD, 16.0f);
+			std::vector<int> found;
+			tree.query(area, found);
+			same = same && sorted(found) == fixture.model.query(area);
+		}
+
+		CHECK(same);
+
+		//The freed nodes take the items again
+		Collisions::AABB box = fixture.model.items[0].box;
+		bool expected = fixture.model.insert(5000, box);
+		CHECK((tree.insert(5000, box).items_container != nullptr) == expected);
+	}
+
+
+	void bulk_insertion()
+	{
+		std::vector<std::pair<int, Collisions::AABB>> items;
+
+		for (int i = 0; i < 20000; ++i)
+		{
+			items.push_back({ i, random_box(0.0f, WORLD - 1.0f, 1.0f) });
+		}
+
+		//The same items built on one thread, on 8 of them whatever the machine has, and inserted one by one
+		Collisions::AABB world(glm::vec3(0.0f), glm::vec3(WORLD));
+		Octree<int> serial(world, MAX_DEPTH, MINIMUM_DIMENSIONS);
+		Octree<int> parallel(world, MAX_DEPTH, MINIMUM_DIMENSIONS);
+		Octree<int> single(world, MAX_DEPTH, MINIMUM_DIMENSIONS);
+
+		std::vector<Trees::Location<int>> serial_locations, parallel_locations;
+
+		serial.set_multi_thread(false);
+		serial.insert(items, serial_locations);
+
+		Parallel::set_worker_count(8);
+		parallel.insert(items, parallel_locations);
+		Parallel::set_worker_count(0);
+
+		for (std::pair<int, Collisions::AABB>& item : items)
+		{
+			single.insert(item.first, item.second);
+		}
+
+		CHECK(parallel.size() == serial.size());
+		CHECK(single.size() == serial.size());
+
+		//The threads take the same items into the same nodes
+		bool same = true;
+
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			bool located = serial_locations[i].items_container != nullptr;
+
+			same = same && located == (parallel_locations[i].items_container != nullptr);
+
+			if (located)
+			{
+				same = same && parallel_locations[i].items_container->at(parallel_locations[i].items_slot) == items[i].first;
+			}
+		}
+
+		CHECK(same);
+
+		for (int i = 0; i < 200; ++i)
+		{
+			Collisions::AABB area = random_box(0.0f, WORLD, 8.0f);
+			std::vector<int> first, second, third;
+			serial.query(area, first);
+			parallel.query(area, second);
+			single.query(area, third);
+			same = same && sorted(first) == sorted(second) && first.size() == third.size();
+		}
+
+		CHECK(same);
+	}
+
+
+	void counting()
+	{
+		Fixture fixture(true, 1500, 6.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		bool same = true;
+
+		for (int i = 0; i < 300; ++i)
+		{
+			Collisions::AABB area = random_box(-8.0f, WORLD, 20.0f);
+			size_t expected = 0;
+
+			for (int item : stored)
+			{
+				if (area.intersects2(fixture.box(item))) expected++;
+			}
+
+			same = same && fixture.tree.count(area, bounds) == expected && fixture.tree.any(area, bounds) == (expected > 0);
+		}
+
+		CHECK(same);
+	}
+
+
+	void shapes()
+	{
+		Fixture fixture(false, 1500, 6.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		bool same = true;
+
+		for (int i = 0; i < 100; ++i)
+		{
+			Shapes::Sphere sphere{ glm::vec3(Tests::uniform(0.0f, WORLD), Tests::uniform(0.0f, WORLD), Tests::uniform(0.0f, WORLD)), Tests::uniform(1.0f, 20.0f) };
+			std::vector<int> found, expected;
+
+			fixture.tree.query_shape(sphere, bounds, [&found](int& item) { found.push_back(item); return true; });
+
+			for (int item : stored)
+			{
+				Collisions::AABB box = fixture.box(item);
+				if (sphere.intersects(box)) expected.push_back(item);
+			}
+
+			same = same && sorted(found) == expected;
+		}
+
+		CHECK(same);
+	}
+
+
+	std::vector<std::pair<int, int>> ordered(std::vector<std::pair<int, int>> pairs)
+	{
+		for (std::pair<int, int>& pair : pairs)
+		{
+			if (pair.first > pair.second) std::swap(pair.first, pair.second);
+		}
+
+		std::sort(pairs.begin(), pairs.end());
+		return pairs;
+	}
+
+
+	void pairs()
+	{
+		Fixture fixture(false, 3000, 4.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		std::vector<std::pair<int, int>> expected;
+
+		for (size_t i = 0; i < stored.size(); ++i)
+		{
+			for (size_t j = i + 1; j < stored.size(); ++j)
+			{
+				if (fixture.box(stored[i]).intersects2(fixture.box(stored[j]))) expected.push_back({ stored[i], stored[j] });
+			}
+		}
+
+		std::vector<std::pair<int, int>> visited;
+		fixture.tree.overlapping_pairs(bounds, [&visited](int& first, int& second) { visited.push_back({ first, second }); return true; });
+		CHECK(ordered(visited) == ordered(expected));
+
+		//The threads give the same pairs as the single one, with 8 of them whatever the machine has
+		std::vector<std::pair<int, int>> serial, parallel;
+
+		fixture.tree.set_multi_thread(false);
+		fixture.tree.overlapping_pairs(bounds, serial);
+
+		Parallel::set_worker_count(8);
+		fixture.tree.set_multi_thread(true);
+		fixture.tree.overlapping_pairs(bounds, parallel);
+		Parallel::set_worker_count(0);
+
+		CHECK(ordered(serial) == ordered(expected));
+		CHECK(ordered(parallel) == ordered(expected));
+
+		//Against another tree, every item of the first one with every item of the second
+		Fixture other(true, 1000, 4.0f);
+		auto other_bounds = [&other](int& item) { return other.box(item); };
+		std::vector<int> other_stored = other.model.stored();
+
+		expected.clear();
+
+		for (int first : stored)
+		{
+			for (int second : other_stored)
+			{
+				if (fixture.box(first).intersects2(other.box(second))) expected.push_back({ first, second });
+			}
+		}
+
+		std::vector<std::pair<int, int>> joined;
+		fixture.tree.overlapping_pairs(other.tree, bounds, other_bounds, [&joined](int& first, int& second) { joined.push_back({ first, second }); return true; });
+
+		std::sort(joined.begin(), joined.end());
+		std::sort(expected.begin(), expected.end());
+		CHECK(joined == expected);
+	}
+
+
+	void raycasts()
+	{
+		Fixture fixture(true, 1500, 6.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		bool same = true;
+		bool nearest_first = true;
+
+		for (int i = 0; i < 200; ++i)
+		{
+			glm::vec3 origin(Tests::uniform(-10.0f, WORLD + 10.0f), Tests::uniform(-10.0f, WORLD + 10.0f), Tests::uniform(-10.0f, WORLD + 10.0f));
+			glm::vec3 direction(Tests::uniform(-1.0f, 1.0f), Tests::uniform(-1.0f, 1.0f), Tests::uniform(-1.0f, 1.0f));
+			float reach = Tests::uniform(10.0f, 100.0f);
+
+			if (i % 10 == 0) direction = glm::vec3(0.0f, 0.0f, 1.0f);
+
+			std::vector<std::pair<float, int>> hits, expected;
+
+			fixture.tree.raycast(origin, direction, reach, bounds, [&hits](int& item, float distance) { hits.push_back({ distance, item }); return true; });
+
+			for (int item : stored)
+			{
+				std::array<glm::vec3, 2> region = fixture.box(item).bounding_region();
+				float enter = 0.0f, exit = reach;
+
+				if (Raycast::clip_box(origin, direction, region[0], region[1], enter, exit)) expected.push_back({ enter, item });
+			}
+
+			for (size_t h = 1; h < hits.size(); ++h)
+			{
+				nearest_first = nearest_first && hits[h - 1].first <= hits[h].first;
+			}
+
+			std::sort(hits.begin(), hits.end());
+			std::sort(expected.begin(), expected.end());
+			same = same && hits == expected;
+		}
+
+		CHECK(same);
+		CHECK(nearest_first);
+	}
+
+
+	void nearest_items()
+	{
+		Fixture fixture(false, 1500, 3.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		auto distance = [&fixture](const glm::vec3& point, int item) {
+			std::array<glm::vec3, 2> region = fixture.box(item).bounding_region();
+			glm::vec3 offset = glm::clamp(point, region[0], region[1]) - point;
+			return glm::dot(offset, offset);
+		};
+
+		bool same = true;
+
+		for (int i = 0; i < 100; ++i)
+		{
+			glm::vec3 point(Tests::uniform(-5.0f, WORLD + 5.0f), Tests::uniform(-5.0f, WORLD + 5.0f), Tests::uniform(-5.0f, WORLD + 5.0f));
+			size_t k = 1 + i % 12;
+
+			std::vector<int> found;
+			fixture.tree.nearest(point, k, bounds, found);
+
+			std::vector<float> expected;
+
+			for (int item : stored)
+			{
+				expected.push_back(distance(point, item));
+			}
+
+			std::sort(expected.begin(), expected.end());
+			expected.resize(std::min(k, expected.size()));
+
+			std::vector<float> distances;
+
+			for (int item : found)
+			{
+				distances.push_back(distance(point, item));
+			}
+
+			same = same && distances == expected;
+		}
+
+		CHECK(same);
+	}
+
+
+	void culling()
+	{
+		Fixture fixture(false, 1500, 6.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		bool same = true;
+
+		for (int i = 0; i < 100; ++i)
+		{
+			//An axis aligned box of planes, turned a little around y
+			glm::vec3 center(Tests::uniform(0.0f, WORLD), Tests::uniform(0.0f, WORLD), Tests::uniform(0.0f, WORLD));
+			float size = Tests::uniform(4.0f, 30.0f);
+			float angle = Tests::uniform(0.0f, 0.7f);
+			glm::vec3 x(std::cos(angle), 0.0f, std::sin(angle));
+			glm::vec3 y(0.0f, 1.0f, 0.0f);
+			glm::vec3 z(-std::sin(angle), 0.0f, std::cos(angle));
+
+			std::array<glm::vec4, 6> planes;
+			const glm::vec3 normals[6] = { x, -x, y, -y, z, -z };
+
+			for (int p = 0; p < 6; ++p)
+			{
+				planes[p] = glm::vec4(normals[p].x, normals[p].y, normals[p].z, size - glm::dot(normals[p], center));
+			}
+
+			std::vector<int> found, expected;
+			fixture.tree.cull(planes, bounds, [&found](int& item) { found.push_back(item); return true; });
+
+			for (int item : stored)
+			{
+				std::array<glm::vec3, 2> region = fixture.box(item).bounding_region();
+				glm::vec3 middle = (region[0] + region[1]) * 0.5f;
+				glm::vec3 half = (region[1] - region[0]) * 0.5f;
+				bool inside = true;
+
+				for (const glm::vec4& plane : planes)
+				{
+					float distance = plane.x * middle.x + plane.y * middle.y + plane.z * middle.z + plane.w;
+					float reach = half.x * std::fabs(plane.x) + half.y * std::fabs(plane.y) + half.z * std::fabs(plane.z);
+
+					inside = inside && distance + reach >= 0.0f;
+				}
+
+				if (inside) expected.push_back(item);
+			}
+
+			same = same && sorted(found) == expected;
+		}
+
+		CHECK(same);
+	}
+
+
+	/*
+	* The shifts keep the nodes in place and wrap the world around them, so after every one of them the items are
+	* compared with the boxes they were inserted with: the ones taken out reached out of the moved world, and the
+	* searches by the item boxes give the same items as the brute force walk over the rest.
+	*/
+	void shifts()
+	{
+		const float LEAF = WORLD / (float)(1 << MAX_DEPTH);
+
+		for (bool lazy : { false, true })
+		{
+			Octree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS, lazy);
+			std::map<int, Collisions::AABB> stored;
+			int next = 0;
+
+			auto bounds = [&stored](int& item) { return stored.at(item); };
+
+			//A random area of the world, reaching a little out of it
+			auto around = [](const std::array<glm::vec3, 2>& world, float largest) {
+				Collisions::AABB area = random_box(-4.0f, WORLD, largest);
+				std::array<glm::vec3, 2> region = area.bounding_region();
+
+				return Collisions::AABB(region[0] + world[0], region[1] + world[0]);
+			};
+
+			//Fills the current world, the items lying across the edge where it wraps are kept by the root
+			auto fill = [&](int count) {
+				std::array<glm::vec3, 2> world = tree.aabb().bounding_region();
+
+				for (int i = 0; i < count; ++i, ++next)
+				{
+					glm::vec3 corner(Tests::uniform(world[0].x, world[1].x - 3.0f), Tests::uniform(world[0].y, world[1].y - 3.0f), Tests::uniform(world[0].z, world[1].z - 3.0f));
+					Collisions::AABB box(corner, corner + glm::vec3(Tests::uniform(0.1f, 3.0f), Tests::uniform(0.1f, 3.0f), Tests::uniform(0.1f, 3.0f)));
+
+					if (tree.insert(next, box).items_container) stored[next] = box;
+				}
+			};
+
+			fill(3000);
+
+			bool inside = true, counted = true, shaped = true, cast = true, near = true, culled = true, paired = true;
+
+			for (int step = 0; step < 24; ++step)
+			{
+				glm::ivec3 offset((int)Tests::uniform(-3.0f, 4.0f), (int)Tests::uniform(-1.0f, 2.0f), (int)Tests::uniform(-3.0f, 4.0f));
+				std::array<glm::vec3, 2> before = tree.aabb().bounding_region();
+				size_t removed = 0;
+
+				tree.shift(offset, [&](int& item) { stored.erase(item); removed++; });
+
+				//The world moved, and only the items reaching out of it were taken out
+				std::array<glm::vec3, 2> after = tree.aabb().bounding_region();
+				CHECK(after[0] == before[0] + glm::vec3(offset) * LEAF && after[1] == before[1] + glm::vec3(offset) * LEAF);
+
+				fill(150);
+
+				CHECK(tree.size() == stored.size());
+
+				for (auto& item : stored)
+				{
+					inside = inside && tree.aabb().contains(item.second);
+				}
+
+				for (int i = 0; i < 10; ++i)
+				{
+					Collisions::AABB area = around(after, 20.0f);
+
+					Shapes::Sphere sphere{ area.center(), Tests::uniform(1.0f, 16.0f) };
+					std::vector<int> expected, around, found;
+
+					for (auto& item : stored)
+					{
+						if (area.intersects2(item.second)) expected.push_back(item.first);
+						if (sphere.intersects(item.second)) around.push_back(item.first);
+					}
+
+					counted = counted && tree.count(area, bounds) == expected.size() && tree.any(area, bounds) == !expected.empty();
+
+					tree.query_shape(sphere, bounds, [&found](int& item) { found.push_back(item); return true; });
+					shaped = shaped && sorted(found) == around;
+
+					//A ray through the area, against every stored box
+					glm::vec3 origin = area.center() - glm::vec3(30.0f, 5.0f, 20.0f);
+					glm::vec3 direction(Tests::uniform(0.2f, 1.0f), Tests::uniform(-0.3f, 0.5f), Tests::uniform(0.0f, 1.0f));
+					std::vector<std::pair<float, int>> hits, reference;
+
+					tree.raycast(origin, direction, 80.0f, bounds, [&hits](int& item, float distance) { hits.push_back({ distance, item }); return true; });
+
+					for (auto& item : stored)
+					{
+						std::array<glm::vec3, 2> region = item.second.bounding_region();
+						float enter = 0.0f, exit = 80.0f;
+
+						if (Raycast::clip_box(origin, direction, region[0], region[1], enter, exit)) reference.push_back({ enter, item.first });
+					}
+
+					for (size_t h = 1; h < hits.size(); ++h)
+					{
+						cast = cast && hits[h - 1].first <= hits[h].first;
+					}
+
+					std::sort(hits.begin(), hits.end());
+					std::sort(reference.begin(), reference.end());
+					cast = cast && hits == reference;
+
+					//The nearest ones, by their distances
+					std::vector<int> nearest;
+					std::vector<float> distances, reference_distances;
+					tree.nearest(sphere.center, 5, bounds, nearest);
+
+					auto distance = [&stored, &sphere](int item) {
+						std::array<glm::vec3, 2> region = stored.at(item).bounding_region();
+						glm::vec3 offset = glm::clamp(sphere.center, region[0], region[1]) - sphere.center;
+						return glm::dot(offset, offset);
+					};
+
+					for (int item : nearest) distances.push_back(distance(item));
+					for (auto& item : stored) reference_distances.push_back(distance(item.first));
+
+					std::sort(reference_distances.begin(), reference_distances.end());
+					reference_distances.resize(std::min<size_t>(5, reference_distances.size()));
+					near = near && distances == reference_distances;
+
+					//The area itself as the frustum
+					std::array<glm::vec3, 2> region = area.bounding_region();
+					std::array<glm::vec4, 6> planes = {
+						glm::vec4(1.0f, 0.0f, 0.0f, -region[0].x), glm::vec4(-1.0f, 0.0f, 0.0f, region[1].x),
+						glm::vec4(0.0f, 1.0f, 0.0f, -region[0].y), glm::vec4(0.0f, -1.0f, 0.0f, region[1].y),
+						glm::vec4(0.0f, 0.0f, 1.0f, -region[0].z), glm::vec4(0.0f, 0.0f, -1.0f, region[1].z) };
+
+					std::vector<int> visible;
+					tree.cull(planes, bounds, [&visible](int& item) { visible.push_back(item); return true; });
+					culled = culled && sorted(visible) == expected;
+				}
+
+				//The pairs now and then, they take a while
+				if (step % 6 == 5)
+				{
+					std::vector<std::pair<int, int>> expected, visited;
+
+					for (auto first = stored.begin(); first != stored.end(); ++first)
+					{
+						for (auto second = std::next(first); second != stored.end(); ++second)
+						{
+							if (first->second.intersects2(second->second)) expected.push_back({ first->first, second->first });
+						}
+					}
+
+					tree.overlapping_pairs(bounds, [&visited](int& first, int& second) { visited.push_back({ first, second }); return true; });
+					paired = paired && ordered(visited) == ordered(expected);
+				}
+			}
+
+			CHECK(inside);
+			CHECK(counted);
+			CHECK(shaped);
+			CHECK(cast);
+			CHECK(near);
+			CHECK(culled);
+			CHECK(paired);
+
+			//The moved world goes into the snapshot, the loaded tree and the mapped file search the same place
+			std::string path = lazy ? "octree_shifted_lazy.snapshot" : "octree_shifted.snapshot";
+			CHECK(tree.save(path));
+
+			Octree<int> loaded;
+			CHECK(loaded.load(path));
+
+			Snapshot::View<int, NUMBER_OF_OCTANTS> view;
+			CHECK(view.open(path) && view.validate());
+
+			std::array<glm::vec3, 2> world = tree.aabb().bounding_region();
+			std::array<glm::vec3, 2> mapped_world = view.aabb().bounding_region();
+			CHECK(loaded.aabb().bounding_region() == world && mapped_world == world);
+
+			bool same = true;
+
+			for (int i = 0; i < 200; ++i)
+			{
+				Collisions::AABB area = around(world, 12.0f);
+
+				std::vector<int> expected, found, mapped;
+
+				tree.query(area, expected);
+				loaded.query(area, found);
+				view.query(area, mapped);
+
+				same = same && sorted(found) == sorted(expected) && sorted(mapped) == sorted(expected);
+			}
+
+			CHECK(same);
+
+			view.close();
+			std::remove(path.c_str());
+
+			//A move by the whole world or more keeps nothing, the tree is built at the new place
+			size_t removed = 0;
+			tree.shift(glm::ivec3(1 << MAX_DEPTH, 0, 0), [&removed](int&) { removed++; });
+
+			std::array<glm::vec3, 2> moved = tree.aabb().bounding_region();
+			CHECK(removed == stored.size() && tree.empty());
+			CHECK(moved[0] == world[0] + glm::vec3(WORLD, 0.0f, 0.0f));
+		}
+
+		//A shift by one leaf visits and empties only the slab of the cells leaving the world, and the few nodes lying across the seam
+		Octree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS);
+
+		for (int i = 0; i < 40000; ++i)
+		{
+			tree.insert(i, random_box(0.0f, WORLD - 1.0f, 0.5f));
+		}
+
+		size_t total = tree.size();
+		std::list<std::pair<int, Collisions::AABB>> returned_data;
+
+		tree.shift(glm::ivec3(1, 0, 0), returned_data);
+		tree.shift(glm::ivec3(0, 0, -1), returned_data);
+
+		size_t kept = tree.size();
+		CHECK(returned_data.size() < total / 4);
+
+		//The items the tree couldn't take back, together with the ones it kept, are all of the items
+		std::list<std::pair<int, Collisions::AABB>> more;
+		tree.shift(glm::ivec3(1, 0, 0), more);
+		CHECK(tree.size() + more.size() == kept);
+	}
+
+
+	//The items lying across the edge where the shifted world wraps, every one of them fits in the world, so all of them are taken,
+	//the same as a tree built at the moved place takes them
+	void wrap_insertions()
+	{
+		for (bool lazy : { false, true })
+		{
+			Octree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(16.0f)), 4, 1, lazy);
+			Octree<int> bulk(Collisions::AABB(glm::vec3(0.0f), glm::vec3(16.0f)), 4, 1, lazy);
+			std::list<std::pair<int, Collisions::AABB>> returned;
+
+			tree.shift(glm::ivec3(1, 0, 0), returned);
+			bulk.shift(glm::ivec3(1, 0, 0), returned);
+			CHECK(returned.empty());
+
+			std::vector<std::pair<int, Collisions::AABB>> items;
+
+			for (int i = 0; i < 16; ++i)
+			{
+				glm::vec3 corner(15.6f, 1.0f + (float)(i % 4) * 4.0f, 1.0f + (float)(i / 4) * 4.0f);
+				items.push_back({ i, Collisions::AABB(corner, corner + glm::vec3(0.8f)) });
+			}
+
+			size_t taken = 0;
+
+			for (auto& item : items)
+			{
+				taken += tree.insert(item.first, item.second).items_container ? 1 : 0;
+			}
+
+			std::vector<Trees::Location<int>> locations;
+			bulk.insert(items, locations);
+
+			CHECK(taken == items.size());
+			CHECK(tree.size() == items.size());
+			CHECK(bulk.size() == items.size());
+			CHECK(std::all_of(locations.begin(), locations.end(), [](Trees::Location<int>& location) { return location.items_container != nullptr; }));
+
+			//The searches find them by their boxes
+			std::map<int, Collisions::AABB> boxes(items.begin(), items.end());
+			auto bounds = [&boxes](int& item) { return boxes.at(item); };
+			Collisions::AABB seam(glm::vec3(15.0f, 0.0f, 0.0f), glm::vec3(17.0f, 17.0f, 17.0f));
+
+			CHECK(tree.count(seam, bounds) == items.size());
+			CHECK(bulk.count(seam, bounds) == items.size());
+
+			//Moving back, all of them reach out of the world again
+			tree.shift(glm::ivec3(-1, 0, 0), returned);
+			CHECK(returned.size() == items.size());
+			CHECK(tree.size() == 0);
+		}
+	}
+
+
+	void snapshots()
+	{
+		for (bool lazy : { false, true })
+		{
+			Fixture fixture(lazy, 1500, 6.0f);
+			std::string path = lazy ? "octree_lazy.snapshot" : "octree.snapshot";
+
+			CHECK(fixture.tree.save(path));
+
+			Octree<int> loaded;
+			CHECK(loaded.load(path));
+			CHECK(loaded.size() == fixture.tree.size());
+
+			Snapshot::View<int, NUMBER_OF_OCTANTS> view;
+			CHECK(view.open(path));
+			CHECK(view.validate());
+			CHECK(view.size() == fixture.tree.size());
+
+			bool same = true;
+
+			for (int i = 0; i < 200; ++i)
+			{
+				Collisions::AABB area = random_box(-4.0f, WORLD, 12.0f);
+				std::vector<int> expected = fixture.model.query(area);
+				std::vector<int> found, mapped;
+
+				loaded.query(area, found);
+				view.query(area, mapped);
+
+				same = same && sorted(found) == expected && sorted(mapped) == expected;
+			}
+
+			CHECK(same);
+
+			view.close();
+			std::remove(path.c_str());
+		}
+	}
+
+
+	//Writes the value over the bytes of the file at the offset
+	template<typename V>
+	void patch(const std::string& path, uint64_t offset, const V& value)
+	{
+		std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp((std::streamoff)offset);
+		file.write(reinterpret_cast<const char*>(&value), sizeof(V));
+	}
+
+
+	template<typename V>
+	V read(const std::string& path, uint64_t offset)
+	{
+		V value;
+		std::ifstream file(path, std::ios::binary);
+		file.seekg((std::streamoff)offset);
+		file.read(reinterpret_cast<char*>(&value), sizeof(V));
+
+		return value;
+	}
+
+
+	void damaged_snapshots()
+	{
+		typedef Snapshot::Node<NUMBER_OF_OCTANTS> Node;
+
+		Fixture fixture(false, 1500, 6.0f);
+		const std::string path = "octree_damaged.snapshot";
+		const std::string copy = "octree_damaged_copy.snapshot";
+
+		CHECK(fixture.tree.save(path));
+
+		Snapshot::Header header = read<Snapshot::Header>(path, 0);
+		Node root = read<Node>(path, header.nodes_offset);
+
+		//The first child of the root, the root of a full tree has all of them
+		CHECK(root.active & 1);
+		uint64_t child = header.nodes_offset + root.children[0] * sizeof(Node);
+
+		//The search needs no walk over the whole file first, it checks the nodes it reaches
+		Collisions::AABB area(glm::vec3(-WORLD), glm::vec3(2.0f * WORLD));
+		{
+			Snapshot::View<int, NUMBER_OF_OCTANTS> view;
+			std::vector<int> found;
+
+			CHECK(view.open(path));
+			CHECK(view.query(area, [&found](const int& record) { found.push_back(record); return true; }));
+			CHECK(sorted(found) == fixture.model.query(area));
+		}
+
+		//Every damage is made on a copy, the tree that fails to load keeps what it had
+		auto damaged = [&](uint64_t offset, auto value)
+		{
+			std::ifstream source(path, std::ios::binary);
+			std::ofstream target(copy, std::ios::binary);
+			target << source.rdbuf();
+			target.close();
+
+			patch(copy, offset, value);
+		};
+
+		Octree<int> loaded;
+		CHECK(loaded.load(path));
+		size_t size = loaded.size();
+
+		//The levels not matching the subdivision depth
+		damaged(offsetof(Snapshot::Header, subdivision_depth), header.subdivision_depth + 1);
+		CHECK(!loaded.load(copy));
+		CHECK(loaded.size() == size);
+
+		damaged(offsetof(Snapshot::Header, max_depth), header.subdivision_depth - 2);
+		CHECK(!loaded.load(copy));
+		CHECK(loaded.size() == size);
+
+		//A child more than one level below its parent, and a child pointing back at its parent
+		Snapshot::View<int, NUMBER_OF_OCTANTS> view;
+
+		damaged(child + offsetof(Node, depth), (uint16_t)(root.depth + 2));
+		CHECK(view.open(copy));
+		CHECK(!view.query(area, [](const int&) { return true; }));
+		CHECK(!view.validate());
+		CHECK(!loaded.load(copy));
+		CHECK(loaded.size() == size);
+		view.close();
+
+		damaged(header.nodes_offset + offsetof(Node, children), (uint32_t)0);
+		CHECK(view.open(copy));
+		CHECK(!view.query(area, [](const int&) { return true; }));
+		CHECK(!view.validate());
+		CHECK(!loaded.load(copy));
+		view.close();
+
+		//A file cut short ends before its sections
+		{
+			std::ifstream source(path, std::ios::binary);
+			std::vector<char> bytes((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+			std::ofstream target(copy, std::ios::binary);
+			target.write(bytes.data(), (std::streamsize)(bytes.size() - sizeof(int)));
+		}
+
+		CHECK(!view.open(copy));
+		CHECK(!loaded.load(copy));
+		CHECK(loaded.size() == size);
+
+		std::remove(path.c_str());
+		std::remove(copy.c_str());
+	}
+
+}
+
+
+int main()
+{
+	box_search();
+	erasing();
+	bulk_insertion();
+	counting();
+	shapes();
+	pairs();
+	raycasts();
+	nearest_items();
+	culling();
+	shifts();
+	wrap_insertions();
+	snapshots();
+	damaged_snapshots();
+
+	return Tests::failures();
+}
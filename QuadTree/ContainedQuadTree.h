@@ -14,8 +14,8 @@ namespace Trees {
 	template<typename T>
 	struct Location
 	{
-		typename std::list<T>* items_container = nullptr;
-		typename std::list<T>::iterator items_iterator;
+		typename DataStructures::NodeItems<T>* items_container = nullptr;
+		size_t items_slot = 0;
 		typename Collisions::AABB aabb;
 	};
 
@@ -39,6 +39,9 @@ namespace DataStructures {
 
 		using OctreeContainer = std::list<QuadTreeItem<T>>;
 
+		//Places the items taken out by a shift back in the tree
+		void reinsert(std::vector<typename OctreeContainer::iterator>& removed, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
 	protected:
 
 		QuadTree<typename OctreeContainer::iterator> m_Root;
@@ -52,6 +55,8 @@ namespace DataStructures {
 
 		ContainedQuadTree();
 		ContainedQuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions);
+		ContainedQuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision);
+		ContainedQuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, std::vector<std::pair<T, Collisions::AABB>> Items);
 		~ContainedQuadTree();
 
 		/*
@@ -59,7 +64,7 @@ namespace DataStructures {
 		*/
 
 		size_t min_dimensions();
-		Collisions::AABB& aabb();
+		Collisions::AABB aabb();
 		void resize(Collisions::AABB area);
 
 		/*////////
@@ -70,6 +75,8 @@ namespace DataStructures {
 		size_t max_size();
 		size_t depth();
 		size_t max_depth();
+		bool multi_thread();
+		void set_multi_thread(bool MultiThread);
 		bool empty();
 
 		/*//////////////
@@ -77,16 +84,45 @@ namespace DataStructures {
 		*///////////////
 
 		//Iterators that enable using this container in a for loop(optional)
-		typename std::list<T>::iterator begin();
-		typename std::list<T>::iterator end();
-		typename std::list<T>::iterator cbegin();
-		typename std::list<T>::iterator cend();
+		typename OctreeContainer::iterator begin();
+		typename OctreeContainer::iterator end();
+		typename OctreeContainer::iterator cbegin();
+		typename OctreeContainer::iterator cend();
 
 		//Search functions
-		void dfs(Collisions::AABB& area, typename std::list<T>::iterator& items);
-		void bfs(Collisions::AABB& area, typename std::list<T>::iterator& items);
+		void dfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items);
+		void bfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items);
 		bool contains(Collisions::AABB& area);
 
+		//Calls on_hit(iterator, item) for every found item without allocating, the search stops as soon as it returns false
+		template<typename F>
+		bool query(Collisions::AABB& area, F&& on_hit);
+		void query(Collisions::AABB& area, std::vector<typename OctreeContainer::iterator>& items);
+
+		//Calls on_hit(iterator, item) for the items intersecting the shape, a sphere, a capsule, an oriented box, or anything alike
+		//Returning false stops the search
+		template<typename S, typename F>
+		bool query_shape(const S& shape, F&& on_hit);
+		template<typename S>
+		void query_shape(const S& shape, std::vector<typename OctreeContainer::iterator>& items);
+
+		//Calls on_pair(first_iterator, first_item, second_iterator, second_item) once for every pair of the overlapping items
+		//The broad phase of the collision detection, the search stops as soon as on_pair returns false
+		template<typename F>
+		bool overlapping_pairs(F&& on_pair);
+
+		//The same pairs of iterators appended to a vector, searched on all threads when the tree is multi threaded
+		void overlapping_pairs(std::vector<std::pair<typename OctreeContainer::iterator, typename OctreeContainer::iterator>>& pairs);
+
+		//Calls on_hit(iterator, item, distance) for the items hit by the ray over the map, with t up to max_distance, the nearest ones first
+		//The x and y of the ray stand for the x and z of the world, returning false stops the cast, e.g. on the first hit
+		template<typename F>
+		bool raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, F&& on_hit);
+
+		//Appends the iterators of the k items nearest to the point on the map, the nearest first, leaving out the ones farther than max_distance
+		//One search in place of growing a query box until it finds enough items
+		void nearest(glm::vec2 point, size_t k, std::vector<typename OctreeContainer::iterator>& items, float max_distance = std::numeric_limits<float>::infinity());
+
 		//Others
 		std::vector<T> items();
 
@@ -95,6 +131,7 @@ namespace DataStructures {
 		*//////////
 
 		bool insert(T object, Collisions::AABB area);
+		size_t insert(std::vector<std::pair<T, Collisions::AABB>> Items);
 		bool remove(typename OctreeContainer::iterator& item);
 		void clear();
 
@@ -102,7 +139,22 @@ namespace DataStructures {
 		* Space altering
 		*///////////////
 
-		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data); //TODO
+		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//Moves by any number of the leaf nodes on the map at once, the x and y of the offset stand for the x and z of the world
+		void shift(glm::ivec2 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		/*//////////
+		* Snapshot
+		*///////////
+
+		//Writes the tree with the items and their boxes as the Snapshot::Item<T> records, T has to be trivially copyable.
+		//The file can also be searched in place by the Snapshot::View, without loading it
+		bool save(const std::string& path);
+
+		//Puts the tree and the items of the file in place of the current ones.
+		//Returns false and keeps everything as it was if the file can't be read
+		bool load(const std::string& path);
 
 	};
 
@@ -126,10 +178,24 @@ namespace DataStructures {
 	{}
 
 
+	template<typename T>
+	ContainedQuadTree<T>::ContainedQuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision) :
+		m_Root(BoundingBox, MaxDepth, MinimumDimensions, LazySubdivision)
+	{}
+
+
+	template<typename T>
+	ContainedQuadTree<T>::ContainedQuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, std::vector<std::pair<T, Collisions::AABB>> Items) :
+		m_Root(BoundingBox, MaxDepth, MinimumDimensions)
+	{
+		insert(std::move(Items));
+	}
+
+
 	template<typename T>
 	ContainedQuadTree<T>::~ContainedQuadTree()
 	{
-		clear();
+		//The root gives every node back to its pool on its own, no need to rebuild the tree with clear()
 	}
 
 
@@ -138,7 +204,7 @@ namespace DataStructures {
 	*/////////////////////
 
 	template<typename T>
-	Collisions::AABB& ContainedQuadTree<T>::aabb()
+	Collisions::AABB ContainedQuadTree<T>::aabb()
 	{
 		return m_Root.aabb();
 	}
@@ -178,8 +244,32 @@ namespace DataStructures {
 		//Cleaning the tree of the iterators
 		m_Root.resize(area);
 
-		//Cleaning the list
-		m_Items.clear();
+		//Placing the items back, the ones outside of the new area are dropped
+		std::vector<typename OctreeContainer::iterator> all;
+		all.reserve(m_Items.size());
+
+		for (typename OctreeContainer::iterator it = m_Items.begin(); it != m_Items.end(); ++it)
+		{
+			all.push_back(it);
+		}
+
+		std::list<std::pair<T, Collisions::AABB>> returned_data;
+		reinsert(all, returned_data);
+	}
+
+
+	template<typename T>
+	bool ContainedQuadTree<T>::multi_thread()
+	{
+		return m_Root.multi_thread();
+	}
+
+
+	//The bulk insertions are spread over the threads, when they are big enough
+	template<typename T>
+	void ContainedQuadTree<T>::set_multi_thread(bool MultiThread)
+	{
+		m_Root.set_multi_thread(MultiThread);
 	}
 
 
@@ -196,42 +286,42 @@ namespace DataStructures {
 
 
 	template<typename T>
-	typename std::list<T>::iterator ContainedQuadTree<T>::begin()
+	typename ContainedQuadTree<T>::OctreeContainer::iterator ContainedQuadTree<T>::begin()
 	{
 		return m_Items.begin();
 	}
 
 
 	template<typename T>
-	typename std::list<T>::iterator ContainedQuadTree<T>::end()
+	typename ContainedQuadTree<T>::OctreeContainer::iterator ContainedQuadTree<T>::end()
 	{
 		return m_Items.end();
 	}
 
 
 	template<typename T>
-	typename std::list<T>::iterator ContainedQuadTree<T>::cbegin()
+	typename ContainedQuadTree<T>::OctreeContainer::iterator ContainedQuadTree<T>::cbegin()
 	{
-		return m_Items.cbegin();
+		return m_Items.begin();
 	}
 
 
 	template<typename T>
-	typename std::list<T>::iterator ContainedQuadTree<T>::cend()
+	typename ContainedQuadTree<T>::OctreeContainer::iterator ContainedQuadTree<T>::cend()
 	{
-		return m_Items.cend();
+		return m_Items.end();
 	}
 
 
 	template<typename T>
-	void ContainedQuadTree<T>::dfs(Collisions::AABB& area, typename std::list<T>::iterator& items)
+	void ContainedQuadTree<T>::dfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items)
 	{
 		m_Root.dfs(area, items);
 	}
 
 
 	template<typename T>
-	void ContainedQuadTree<T>::bfs(Collisions::AABB& area, typename std::list<T>::iterator& items)
+	void ContainedQuadTree<T>::bfs(Collisions::AABB& area, std::list<typename OctreeContainer::iterator>& items)
 	{
 		m_Root.bfs(area, items);
 	}
@@ -240,7 +330,92 @@ namespace DataStructures {
 	template<typename T>
 	bool ContainedQuadTree<T>::contains(Collisions::AABB& area)
 	{
-		m_Root.contains(area);
+		return m_Root.contains(area);
+	}
+
+
+	template<typename T>
+	template<typename F>
+	bool ContainedQuadTree<T>::query(Collisions::AABB& area, F&& on_hit)
+	{
+		//The tree keeps the iterators to the list, so the items are right at hand
+		auto visit = [&](typename OctreeContainer::iterator& item) { return on_hit(item, item->item); };
+
+		return m_Root.query(area, visit);
+	}
+
+
+	template<typename T>
+	void ContainedQuadTree<T>::query(Collisions::AABB& area, std::vector<typename OctreeContainer::iterator>& items)
+	{
+		m_Root.query(area, items);
+	}
+
+
+	template<typename T>
+	template<typename S, typename F>
+	bool ContainedQuadTree<T>::query_shape(const S& shape, F&& on_hit)
+	{
+		//The tree keeps the iterators to the list, the boxes are stored with the items
+		auto bounds = [](typename OctreeContainer::iterator& item) { return item->item_position.aabb; };
+		auto report = [&](typename OctreeContainer::iterator& item) { return on_hit(item, item->item); };
+
+		return m_Root.query_shape(shape, bounds, report);
+	}
+
+
+	template<typename T>
+	template<typename S>
+	void ContainedQuadTree<T>::query_shape(const S& shape, std::vector<typename OctreeContainer::iterator>& items)
+	{
+		auto bounds = [](typename OctreeContainer::iterator& item) { return item->item_position.aabb; };
+		auto push = [&items](typename OctreeContainer::iterator& item) { items.push_back(item); return true; };
+
+		m_Root.query_shape(shape, bounds, push);
+	}
+
+
+	template<typename T>
+	template<typename F>
+	bool ContainedQuadTree<T>::overlapping_pairs(F&& on_pair)
+	{
+		//The tree keeps the iterators to the list, the boxes are stored with the items
+		auto bounds = [](typename OctreeContainer::iterator& item) { return item->item_position.aabb; };
+		auto report = [&](typename OctreeContainer::iterator& first, typename OctreeContainer::iterator& second) { return on_pair(first, first->item, second, second->item); };
+
+		return m_Root.overlapping_pairs(bounds, report);
+	}
+
+
+	template<typename T>
+	void ContainedQuadTree<T>::overlapping_pairs(std::vector<std::pair<typename OctreeContainer::iterator, typename OctreeContainer::iterator>>& pairs)
+	{
+		//Only reading the list, so the threads can share it
+		auto bounds = [](typename OctreeContainer::iterator& item) { return item->item_position.aabb; };
+
+		m_Root.overlapping_pairs(bounds, pairs);
+	}
+
+
+	template<typename T>
+	template<typename F>
+	bool ContainedQuadTree<T>::raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, F&& on_hit)
+	{
+		//The tree keeps the iterators to the list, the boxes are stored with the items
+		auto bounds = [](typename OctreeContainer::iterator& item) { return item->item_position.aabb; };
+		auto report = [&](typename OctreeContainer::iterator& item, float distance) { return on_hit(item, item->item, distance); };
+
+		return m_Root.raycast(origin, direction, max_distance, bounds, report);
+	}
+
+
+	template<typename T>
+	void ContainedQuadTree<T>::nearest(glm::vec2 point, size_t k, std::vector<typename OctreeContainer::iterator>& items, float max_distance)
+	{
+		//The tree keeps the iterators to the list, the boxes are stored with the items
+		auto bounds = [](typename OctreeContainer::iterator& item) { return item->item_position.aabb; };
+
+		m_Root.nearest(point, k, bounds, items, max_distance);
 	}
 
 
@@ -249,12 +424,15 @@ namespace DataStructures {
 	{
 		//Stores the found data
 		std::vector<T> Items;
+		Items.reserve(m_Items.size());
 
 		//Pushing available items to the vector
 		for (const auto& it : m_Items)
 		{
-			Items.push_back(it->item);
+			Items.push_back(it.item);
 		}
+
+		return Items;
 	}
 
 
@@ -283,8 +461,48 @@ namespace DataStructures {
 		{
 			return true;
 		}
-		else
-			return false;
+
+		//The item didn't fit into the tree, so it isn't kept either
+		m_Items.pop_back();
+
+		return false;
+	}
+
+
+	//Inserts every item at once, gives back how many of them made it into the tree
+	template<typename T>
+	size_t ContainedQuadTree<T>::insert(std::vector<std::pair<T, Collisions::AABB>> Items)
+	{
+		//Storing every item up front, the tree gets all of the iterators at once
+		std::vector<std::pair<typename OctreeContainer::iterator, Collisions::AABB>> iterators;
+		iterators.reserve(Items.size());
+
+		for (std::pair<T, Collisions::AABB>& item : Items)
+		{
+			m_Items.push_back({ std::move(item.first), {} });
+			iterators.push_back({ std::prev(m_Items.end()), item.second });
+		}
+
+		std::vector<Trees::Location<typename OctreeContainer::iterator>> locations;
+		m_Root.insert(iterators, locations);
+
+		size_t inserted = 0;
+
+		for (size_t i = 0; i < iterators.size(); ++i)
+		{
+			if (locations[i].items_container)
+			{
+				iterators[i].first->item_position = locations[i];
+				inserted++;
+			}
+			else
+			{
+				//The item didn't fit into the tree, so it isn't kept either
+				m_Items.erase(iterators[i].first);
+			}
+		}
+
+		return inserted;
 	}
 
 
@@ -293,10 +511,12 @@ namespace DataStructures {
 	{
 		/*Basicly, acceses the iterator, finds the container in the accessed structure,
 		finds the iterator in the structure, and demands the container to erase the given iterator from its content*/
-		item->item_position.items_container->erase(item->item_position.items_iterator);
+		item->item_position.items_container->erase(item->item_position.items_slot);
 
 		//Deletes the original item from the list
 		m_Items.erase(item);
+
+		return true;
 	}
 
 
@@ -320,70 +540,112 @@ namespace DataStructures {
 	template<typename T>
 	void ContainedQuadTree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
 	{
-		//Storing the new coordinates for the tree
-		std::array<glm::vec3, 2> bounding_box = m_Root.aabb().bounding_region();
+		//The tree hands out only the items it can't keep in place, the ones of the cells that stay aren't touched at all
+		std::vector<typename OctreeContainer::iterator> removed;
+		auto take = [&removed](typename OctreeContainer::iterator& it) { removed.push_back(it); };
 
-		//Getting the side length for the calculations
-		size_t leaf_side_length = m_Root.leaf_node_side_length();
+		m_Root.shift(leaf_nodes, direction, take);
 
-		//Calculating the bounding box
-		switch (direction)
-		{
-		case Coordinates::Directions::North:
+		reinsert(removed, returned_data);
+	}
 
-			bounding_box[0].z -= leaf_nodes * leaf_side_length;
-			bounding_box[1].z -= leaf_nodes * leaf_side_length;
 
-			break;
-		case Coordinates::Directions::South:
+	template<typename T>
+	void ContainedQuadTree<T>::shift(glm::ivec2 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		std::vector<typename OctreeContainer::iterator> removed;
+		auto take = [&removed](typename OctreeContainer::iterator& it) { removed.push_back(it); };
+
+		m_Root.shift(leaf_offset, take);
+
+		reinsert(removed, returned_data);
+	}
+
+
+	/*////////////////////
+	* /     Snapshot     /
+	*/////////////////////
+
+
+	template<typename T>
+	bool ContainedQuadTree<T>::save(const std::string& path)
+	{
+		//The iterators mean nothing outside of this container, so the items are written in their place
+		auto convert = [](typename OctreeContainer::iterator& it) {
+			std::array<glm::vec3, 2> region = it->item_position.aabb.bounding_region();
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+			Snapshot::Item<T> record;
+			record.item = it->item;
+
+			for (int i = 0; i < 3; i++)
+			{
+				record.minimum[i] = minimum[i];
+				record.maximum[i] = maximum[i];
+			}
+
+			return record;
+		};
 
-			bounding_box[0].z += leaf_nodes * leaf_side_length;
-			bounding_box[1].z += leaf_nodes * leaf_side_length;
+		return m_Root.template save<Snapshot::Item<T>>(path, convert);
+	}
 
-			break;
-		case Coordinates::Directions::East:
 
-			bounding_box[0].x += leaf_nodes * leaf_side_length;
-			bounding_box[1].x += leaf_nodes * leaf_side_length;
+	template<typename T>
+	bool ContainedQuadTree<T>::load(const std::string& path)
+	{
+		//The items are gathered aside, the current ones stay valid until the file turns out to be whole
+		OctreeContainer items;
 
-			break;
-		case Coordinates::Directions::West:
+		auto place = [&items](const Snapshot::Item<T>& record, NodeItems<typename OctreeContainer::iterator>& container) {
+			glm::vec3 lower(record.minimum[0], record.minimum[1], record.minimum[2]);
+			glm::vec3 upper(record.maximum[0], record.maximum[1], record.maximum[2]);
 
-			bounding_box[0].x -= leaf_nodes * leaf_side_length;
-			bounding_box[1].x -= leaf_nodes * leaf_side_length;
+			items.push_back({ record.item, {} });
+			typename OctreeContainer::iterator it = std::prev(items.end());
+			size_t slot = container.insert(it);
 
-			break;
+			it->item_position = { &container, slot, Collisions::AABB(lower, upper) };
+		};
+
+		if (!m_Root.template load<Snapshot::Item<T>>(path, place))
+		{
+			return false;
 		}
 
-		//Resizing the tree
-		m_Root.resize({ bounding_box[0], bounding_box[1] });
+		//The iterators stay valid, the nodes of the list only change their owner
+		m_Items.swap(items);
+
+		return true;
+	}
+
+
+	/*
+	* //////////////////////////////
+	* /  Private member functions  /
+	* //////////////////////////////
+	*/
 
-		//Iterator of the items list
-		typename std::list<QuadTreeItem<T>>::iterator it = m_Items.begin();
 
-		//Bulk inserting the content of the tree
-		while (it != m_Items.end())
+	template<typename T>
+	void ContainedQuadTree<T>::reinsert(std::vector<typename OctreeContainer::iterator>& removed, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		for (typename OctreeContainer::iterator it : removed)
 		{
+			//Going back in with the own box of the item
+			Collisions::AABB area = it->item_position.aabb;
+			it->item_position = m_Root.insert(it, area);
 
 			//If the item cannot be inserted, it means that is has been discarded
-			if (!(m_Root.insert(it, it->item_position.aabb)).items_container)
+			if (!it->item_position.items_container)
 			{
 				//Giving the info about the item that didn't fit
-				returned_data.push_back({ it->item, it->item_position.aabb });
+				returned_data.push_back({ it->item, area });
 
-				//Incrementing the iterator
-				it++;
-
-				//Deleting and proceeding further
-				m_Items.erase(std::prev(it));
-				continue;
+				m_Items.erase(it);
 			}
-
-			//Incrementing the iterator
-			++it;
-
 		}
-
 	}
 
 }
@@ -1,11 +1,26 @@
 //Default Libraries
 #include<list>
+#include<cmath>
+#include<vector>
+#include<cstdint>
 #include<queue>
 #include<memory>
+#include<limits>
+#include<string>
 #include<iostream>
 #include<algorithm>
 
 //Dependencies
+#include "../Common/NodePool.h"
+#include "../Common/NodeItems.h"
+#include "../Common/SimdBounds.h"
+#include "../Common/TraversalStack.h"
+#include "../Common/Parallel.h"
+#include "../Common/Raycast.h"
+#include "../Common/Shapes.h"
+#include "../Common/Snapshot.h"
+#include "../Common/Torus.h"
+
 //Dependencies
 #ifndef AABB_H
 #define AABB_H 1
@@ -22,6 +37,15 @@
 */
 
 
+namespace Trees {
+
+	//Defined together with the ContainedQuadTree
+	template<typename T>
+	struct Location;
+
+}
+
+
 namespace DataStructures {
 
 	template<typename T>
@@ -30,60 +54,153 @@ namespace DataStructures {
 		//Alias for the children coordinates
 		using ChildrenBoxes = std::array<Collisions::AABB, 4>;
 
-		//Trick for storing the data about Children
-		enum class Children : unsigned char {
-			O1 = 0x01, // = 0b00000001 -> 1 << 1
-			O2 = 0x02, // = 0b00000010 -> 1 << 2
-			O3 = 0x04, // = 0b00000100 -> 1 << 3
-			O4 = 0x08, // = 0b00001000 -> 1 << 4
+		//Alias for the children, they are owned by the node pool of the root and known by their index in it
+		using ChildrenIndices = std::array<uint32_t, 4>;
+
+		//Everything that is the same for every node of the tree, owned by the root
+		struct SharedData
+		{
+			//The pool that all of the nodes are allocated from
+			NodePool<QuadTree<T>> pool;
+
+			//The half extents of the nodes on every depth, a node finds its own by its depth
+			std::vector<glm::vec3> half_extents;
+
+			//The nodes above this depth are allowed to subdivide
+			size_t subdivision_depth = 0;
+
+			//Where the nodes lie on the map, the shifts only move the seam of it
+			Torus torus;
+
+			size_t leaf_node_side = 0;
+			size_t minimum_dimensions = 0;
+			size_t max_depth = 0;
+			bool lazy_subdivision = false;
+			bool multi_thread = false;
 		};
 
+		//Sets the center of the root and the sizes of every level below it
+		void update_dimensions(Collisions::AABB& area);
+
+		//The geometry of the children, derived from the center of the node
+		glm::vec3 child_center(uint8_t child);
+		glm::vec3 child_center(const glm::vec3& center, size_t depth, uint8_t child);
+		Collisions::AABB child_bounds(uint8_t child);
 
-		//Intelligently calculates the BB's for all needed Children
-		void calculate_bounding_box(Collisions::AABB& BoundingBox, Children Octant);
+		//The only child that can hold the whole area, or -1 if the area crosses the center
+		int containing_child(Collisions::AABB& area);
+		int containing_child(const glm::vec3& center, size_t depth, const glm::vec3& minimum, const glm::vec3& maximum);
 
 		//Speaks for itself
 		bool is_leaf_node(void);
 
-		//
-		std::array<std::shared_ptr<QuadTree<T>>, 4>& access_children();
+		//Checks the depth and the dimensions limits before any subdivision
+		bool can_subdivide(void);
+
+		//Turns the index of an active child into the node
+		QuadTree<T>* child(uint8_t index);
+
+		//The children of the node reaching into the area, tested against the planes splitting the node,
+		//or one by one for the node across the seam, whose children don't lie next to each other on the map
+		unsigned overlap_mask(QuadTree<T>& node, Collisions::AABB& area);
+
+		//The same, but creates the child first if it doesn't exist yet, in the reserved pool slot if one is given
+		QuadTree<T>* obtain_child(uint8_t index, uint32_t* reserved_slot = nullptr);
+
+		//Gives the whole subtree back to the node pool
+		void release_children(void);
 
 		//
 		void collect_items(std::list<std::pair<T, Collisions::AABB>>& items);
 
-		//Set of minimal recursive functions that just do their tasks, without tree safety
-		void recursive_subdivide(void); //OK
-		void recursive_dfs(Collisions::AABB& area, std::list<T>& items); //OK
+		//The number of levels from this node down to the deepest possible one
+		size_t levels(void);
+
+		//The iterative traversal engine. visit(node, descend) is called for every node in the depth first order,
+		//it can narrow down the mask of the children to descend into, and returning false stops the whole walk
+		template<typename F>
+		bool traverse(F& visit);
+
+		//The pair search below this node, path holds the items above it that can still reach into it
+		template<typename B, typename F>
+		bool pairs_below(std::vector<std::pair<T*, Collisions::AABB>>& path, B& bounds, F& on_pair);
+
+		//The movement along the map direction, in the leaf nodes on x and z
+		static glm::ivec2 direction_offset(size_t leaf_nodes, Coordinates::Directions direction);
+
+		//Moves the seam of the map by the cells of the deepest level, the nodes themselves stay where they are.
+		//on_removed(item, position) gets the items of the nodes that reach out of the moved map, only the nodes reaching into
+		//the leaving slabs are visited. Returns false if the offset doesn't line up with the cells, or it's the whole map or more
+		template<typename F>
+		bool wrap_cells(glm::vec3 offset, F& on_removed);
+
+		//Set of minimal functions that just do their tasks, without tree safety
+		void subdivide(void); //OK
 		Trees::Location<T> recursive_insert(T object, Collisions::AABB area); //OK
-		void recursive_resize(Collisions::AABB& area); //OK
+
+		//Whether the node takes the item of the area, a node holds a single item, but the root takes all of the items
+		//lying across the wrap of a shifted map, there's no other node holding them
+		bool takes(Collisions::AABB& area);
+
+		//The node of an item in the bulk insertion, as the Morton code of the path leading to it, 2 bits per level
+		struct Placement
+		{
+			uint64_t code;
+			size_t level;
+			size_t item;
+		};
+
+		//A subtree of the bulk insertion that is built on its own thread, inside of its own range of pool slots
+		struct BuildTask
+		{
+			QuadTree<T>* node;
+			size_t level;
+			Placement* first;
+			Placement* last;
+			uint32_t reserved_slot;
+			size_t reserved;
+		};
+
+		//Parts of the bulk insertion
+		Placement place(Collisions::AABB& area, size_t item, size_t path_length);
+		static uint8_t path_child(uint64_t code, size_t level, size_t path_length);
+		static size_t new_nodes(Placement* first, Placement* last, size_t level, size_t path_length);
+		void build(QuadTree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, uint32_t* reserved_slot);
+		void split_build(QuadTree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, std::vector<BuildTask>& tasks);
 
 	protected:
 
-		//The dimensions of the tree
-		Collisions::AABB m_Position;
-		size_t m_LeafNodeSide;
-		size_t m_MinimumDimensions;
+		/*
+		* A node keeps only its center and depth, the bounds of the node and of its Children
+		* are derived from them and the half extents of the level, shared through the root.
+		* The Children split x and z, keeping the whole height of the node.
+		* On a 64 bit build, with the 8 byte SlotHandle as T, a node takes 96 bytes, so two cache lines.
+		*/
+
+		// The center of the node
+		glm::vec3 m_Center;
 
 		// Depth checking
-		size_t m_MaxDepth;
-		size_t m_Depth = 0;
+		uint16_t m_Depth = 0;
 
 		// A clever way of knowing whether the Children are active
-		// if the value is shifted 8 times to the left, that means, that all of the Children have been set
-		unsigned char m_ActiveChildren;
-
-		// The bounds of the potential Children
-		ChildrenBoxes m_ChildrenBounds;
-
-		// The Children themselves, will be made with the use of a bounds calulating function
-		std::array<std::shared_ptr<QuadTree<T>>, 4> m_Children;
+		// if the value is shifted 4 times to the left, that means, that all of the Children have been set
+		unsigned char m_ActiveChildren = 0;
 
 		// The flag set
 		bool m_IsLeaf = false;
 		bool m_NodeReady = false;
 
+		// The Children themselves, only the ones marked as active are valid
+		ChildrenIndices m_Children = {};
+
+		// The settings and the pool of the tree, owned by the root
+		SharedData* m_Data = nullptr;
+		std::unique_ptr<SharedData> m_OwnedData;
+
 		//Item that the node is storing. Can become anything that the programmer wants it to
-		std::list<T> m_Item;
+		//The first items are kept inline, and every item keeps its slot until erased
+		NodeItems<T> m_Item;
 
 	public:
 
@@ -93,7 +210,8 @@ namespace DataStructures {
 
 		QuadTree();
 		QuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions);
-		QuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, size_t Depth);
+		QuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision);
+		QuadTree(glm::vec3 Center, size_t Depth, SharedData* Data);
 		~QuadTree();
 
 		/*
@@ -102,7 +220,7 @@ namespace DataStructures {
 
 		size_t min_dimensions();
 		size_t leaf_node_side_length();
-		Collisions::AABB& aabb();
+		Collisions::AABB aabb();
 		ChildrenBoxes children_positions();
 		void resize(Collisions::AABB area);
 
@@ -114,31 +232,96 @@ namespace DataStructures {
 		size_t max_size();
 		size_t depth();
 		size_t max_depth();
+		bool lazy_subdivision();
+		bool multi_thread();
+		void set_multi_thread(bool MultiThread);
 		bool empty();
 
 		/*//////////////
 		* Element access
 		*///////////////
 
-		void dfs(Collisions::AABB& area, std::list<T>& items); //TODO
-		void bfs(Collisions::AABB& area, std::list<T>& items); //TODO
+		void dfs(Collisions::AABB& area, std::list<T>& items);
+
+		//Calls on_hit(item) for every found item without allocating, the search stops as soon as it returns false
+		//The tree cannot be modified from inside of on_hit
+		template<typename F>
+		bool query(Collisions::AABB& area, F&& on_hit);
+		void query(Collisions::AABB& area, std::vector<T>& items);
+
+		//Calls on_hit(item) for the items whose boxes intersect the shape, bounds(item) gives the box of an item, returning false stops the search
+		//The shape answers intersects(box) and contains(box), like the ones in Shapes.h, the subtrees inside of it are reported without any tests
+		template<typename S, typename B, typename F>
+		bool query_shape(const S& shape, B&& bounds, F&& on_hit);
+
+		//Calls on_pair(first, second) once for every pair of the items with overlapping boxes, bounds(item) gives the box of an item
+		//The search stops as soon as on_pair returns false, the tree cannot be modified from inside of it
+		template<typename B, typename F>
+		bool overlapping_pairs(B&& bounds, F&& on_pair);
+
+		//The same pairs appended to a vector, the subtrees are searched on all threads when the tree is multi threaded
+		template<typename B>
+		void overlapping_pairs(B&& bounds, std::vector<std::pair<T, T>>& pairs);
+
+		//Calls on_hit(item, distance) for the items hit by the ray origin + t * direction with t up to max_distance, the nearest ones first
+		//The ray goes over the map, its x and y stand for the x and z of the world, so the heights of the boxes don't matter
+		//bounds(item) gives the box of an item, the cast stops as soon as on_hit returns false, so stopping on the first call gives the first hit
+		template<typename B, typename F>
+		bool raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, B&& bounds, F&& on_hit);
+
+		//Appends the k items nearest to the point on the map, the nearest first, bounds(item) gives the box of an item
+		//The x and y of the point stand for the x and z of the world, the distance is measured to the nearest point of the box
+		//and the items farther than max_distance are left out
+		template<typename B>
+		void nearest(glm::vec2 point, size_t k, B&& bounds, std::vector<T>& items, float max_distance = std::numeric_limits<float>::infinity());
+
+		void bfs(Collisions::AABB& area, std::list<T>& items);
 		bool contains(Collisions::AABB& area); //OK
 		void erase_area(Collisions::AABB& area, std::list<T>& items);
-		std::list<T> access_elements();
+		NodeItems<T>& access_elements();
 
 		/*/////////
 		* Modifiers
 		*//////////
 
 		Trees::Location<T> insert(T object, Collisions::AABB area); //OK
+		void insert(std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations);
 		void clear(); //OK 
 
 		/*//////////////
 		* Space altering
 		*///////////////
 
-		//TODO: To redesign this function for it to suit the chunking system better. To specify the template for the chunks
 		void shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		//The same movement, but the items taken out of the tree are handed to on_removed(item), to be inserted again or dropped by the caller.
+		//The nodes stay where they are and the map wraps around them, see Torus.h, only the items of the nodes reaching out of the moved map are taken out
+		template<typename F>
+		void shift(size_t leaf_nodes, Coordinates::Directions direction, F&& on_removed);
+
+		//Moves the tree by any number of the leaf nodes on the map at once, the x and y of the offset stand for the x and z of the world
+		void shift(glm::ivec2 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data);
+
+		template<typename F>
+		void shift(glm::ivec2 leaf_offset, F&& on_removed);
+
+		/*//////////
+		* Snapshot
+		*///////////
+
+		//Writes the whole tree into the flat file described in Snapshot.h, the items byte by byte, so T has to be trivially copyable
+		bool save(const std::string& path);
+
+		//Puts the tree of the file in place of this one, the nodes are created straight from the mapped file in one pass, without any insertions.
+		//Returns false and leaves the tree as it was if the file isn't a whole snapshot of a QuadTree of the same T
+		bool load(const std::string& path);
+
+		//The same, with the items written as the records of R, convert(item) gives the record of an item.
+		//place(record, items) puts the item of the record into the items of its node, this way the containers add their own data
+		template<typename R, typename C>
+		bool save(const std::string& path, C&& convert);
+		template<typename R, typename P>
+		bool load(const std::string& path, P&& place);
 	};
 
 
@@ -152,52 +335,60 @@ namespace DataStructures {
 
 	//Default Constructor
 	template<typename T>
-	QuadTree<T>::QuadTree()
+	QuadTree<T>::QuadTree() :
+		m_OwnedData(std::make_unique<SharedData>())
 	{
 		// Does nothing, because the QuadTree doesn't have the bounding space defined
+		m_Data = m_OwnedData.get();
+		m_Data->half_extents.assign(1, glm::vec3(0.0f));
 	}
 
 
 	//Area setting constructor, should be always first
 	template<typename T>
 	QuadTree<T>::QuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions) :
-		m_Position(BoundingBox)
+		QuadTree(BoundingBox, MaxDepth, MinimumDimensions, false)
+	{}
+
+
+	//Area setting constructor, that can postpone creating the children until an insertion needs them
+	template<typename T>
+	QuadTree<T>::QuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, bool LazySubdivision) :
+		m_OwnedData(std::make_unique<SharedData>())
 	{
+		//The root shares the settings and the pool with every node below
+		m_Data = m_OwnedData.get();
+
 		//Setting max depth available for the Tree
-		m_MaxDepth = MaxDepth;
-		m_MinimumDimensions = MinimumDimensions;
+		m_Data->max_depth = MaxDepth;
+		m_Data->minimum_dimensions = MinimumDimensions;
+		m_Data->lazy_subdivision = LazySubdivision;
 
-		//Calculating the side length
-		m_LeafNodeSide = m_Position.dimensions().x / std::pow(2.0, m_MaxDepth);
+		//The big bulk insertions are spread over the threads unless it's turned off
+		m_Data->multi_thread = true;
+
+		//Calculating the center and the sizes of the levels
+		update_dimensions(BoundingBox);
 
 		//Every QuadTree starts as a leaf node before any subdivisions
 		m_IsLeaf = true;
 		m_NodeReady = true;
 
 		//Proceeds to subdivision
-		recursive_subdivide();
+		subdivide();
 	}
 
 
-	//Area setting constructor, that takes a depth param, used in subdivision
+	//Node constructor, used in subdivision, the size follows from the depth
 	template<typename T>
-	QuadTree<T>::QuadTree(Collisions::AABB BoundingBox, size_t MaxDepth, size_t MinimumDimensions, size_t Depth) :
-		m_Position(BoundingBox), m_Depth(Depth)
+	QuadTree<T>::QuadTree(glm::vec3 Center, size_t Depth, SharedData* Data) :
+		m_Center(Center), m_Depth((uint16_t)Depth), m_Data(Data)
 	{
 		//Every QuadTree starts as a leaf node before any subdivisions
 		m_IsLeaf = true;
 		m_NodeReady = true;
 
-		//Sets the current level
-		m_Depth = Depth;
-		m_MaxDepth = MaxDepth;
-		m_MinimumDimensions = MinimumDimensions;
-
-		//Calculating the side length
-		m_LeafNodeSide = m_Position.dimensions().x / std::pow(2.0, m_MaxDepth);
-
-		//Proceeds to subdivision
-		recursive_subdivide();
+		//The subdivision is driven by the root, level after level without recursion
 	}
 
 
@@ -214,21 +405,32 @@ namespace DataStructures {
 	template<typename T>
 	size_t QuadTree<T>::leaf_node_side_length()
 	{
-		return m_LeafNodeSide;
+		return m_Data->leaf_node_side;
 	}
 
 
 	template<typename T>
-	Collisions::AABB& QuadTree<T>::aabb()
+	Collisions::AABB QuadTree<T>::aabb()
 	{
-		return m_Position;
+		return m_Data->torus.bounds(m_Center, m_Data->half_extents[m_Depth]);
 	}
 
 
 	template<typename T>
 	std::array<Collisions::AABB, 4> QuadTree<T>::children_positions()
 	{
-		return m_ChildrenBounds;
+		ChildrenBoxes bounds;
+
+		//The nodes that cannot subdivide don't have any children
+		if (can_subdivide())
+		{
+			for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+			{
+				bounds[i] = child_bounds(i);
+			}
+		}
+
+		return bounds;
 	}
 
 
@@ -237,22 +439,11 @@ namespace DataStructures {
 	{
 		size_t count = 0;
 
-		//Checks if the item is allocated
-		if (!m_Item.empty())
-		{
-			//If yes, then adds one to count
-			count += m_Item.size();
-		}
-		//Iterates recursively through all of the Children
-		for (int i = 0; i < NUMBER_OF_CHILDREN; i++)
-		{
-			if (m_Children[i])
-			{
-				count += m_Children[i]->size();
-			}
-		}
+		//Every node of the subtree adds its own items
+		auto visit = [&count](QuadTree<T>& node, unsigned&) { count += node.m_Item.size(); return true; };
+
+		traverse(visit);
 
-		//Returns the final value and recursive iteration values
 		return count;
 	}
 
@@ -261,14 +452,14 @@ namespace DataStructures {
 	size_t QuadTree<T>::max_size()
 	{
 		//Returns a theoretical maximum size, which equals to the maximum possible nodes
-		return std::pow(NUMBER_OF_CHILDREN, m_MaxDepth);
+		return std::pow(NUMBER_OF_CHILDREN, m_Data->max_depth);
 	}
 
 
 	template<typename T>
 	size_t QuadTree<T>::min_dimensions()
 	{
-		return m_MinimumDimensions;
+		return m_Data->minimum_dimensions;
 	}
 
 
@@ -282,23 +473,47 @@ namespace DataStructures {
 	template<typename T> inline
 		size_t QuadTree<T>::max_depth()
 	{
-		return m_MaxDepth;
+		return m_Data->max_depth;
+	}
+
+
+	template<typename T> inline
+		bool QuadTree<T>::lazy_subdivision()
+	{
+		return m_Data->lazy_subdivision;
+	}
+
+
+	template<typename T> inline
+		bool QuadTree<T>::multi_thread()
+	{
+		return m_Data->multi_thread;
+	}
+
+
+	template<typename T> inline
+		void QuadTree<T>::set_multi_thread(bool MultiThread)
+	{
+		m_Data->multi_thread = MultiThread;
 	}
 
 
 	template<typename T>
 	void QuadTree<T>::resize(Collisions::AABB area)
 	{
+		//Updating the coordinates
+		update_dimensions(area);
+
 		//The tree has to be built a new, data is invalidated
-		recursive_resize(area);
+		clear();
 	}
 
 
 	template<typename T>
 	bool QuadTree<T>::empty()
 	{
-		//If there are no Children in the root node, then the tree is empty
-		if (!m_Children[0]) return true;
+		//Nothing is stored in the node, nor anywhere below it
+		return size() == 0;
 	}
 
 
@@ -311,557 +526,1751 @@ namespace DataStructures {
 	template<typename T>
 	void QuadTree<T>::dfs(Collisions::AABB& area, std::list<T>& items)
 	{
-		//This can go deep into the recursion
-		recursive_dfs(area, items);
+		auto push = [&items](T& item) { items.push_back(item); return true; };
+
+		query(area, push);
 	}
 
 
-	//Searches for a given area inside the tree
+	//Searches for a given area inside the tree, handing every found item to the visitor, returns false if it was stopped
 	template<typename T>
-	void QuadTree<T>::bfs(Collisions::AABB& area, std::list<T>& items)
+	template<typename F>
+	bool QuadTree<T>::query(Collisions::AABB& area, F&& on_hit)
 	{
-		//Lamda for asigning the children to the queue
-		auto asign_children = [](std::list<std::shared_ptr<QuadTree<T>>>& temp_queue, std::array<std::shared_ptr<QuadTree<T>>, 8>& temp) {
-			//Pushing the Children to a temporary container
-			for (uint8_t j = 0; j < NUMBER_OF_CHILDREN; ++j)
+		auto visit = [&](QuadTree<T>& node, unsigned& descend) {
+			//Checking the node for the items
+			if (!node.m_Item.empty())
 			{
-				if (temp[j])
+				Collisions::AABB position = node.aabb();
+
+				//Adding an item if it fits the QuadTree, or items if they cross through trees
+				if (position.contains(area))
 				{
-					//If the pointer isn't null, I am placing it on to the queue
-					temp_queue.push_back(temp[j]);
+					for (auto& it : node.m_Item)
+					{
+						if (!on_hit(it)) return false;
+					}
 				}
-				else
+				else if (node.is_leaf_node() && position.intersects2(area))
 				{
-					//Else I tell the function, that We propably reached the leaf node
-					return false;
+					for (auto& it : node.m_Item)
+					{
+						if (!on_hit(it)) return false;
+					}
 				}
+			}
 
+			//Checking all of the active child nodes for overlapping at once, against the planes splitting the node
+			if (descend)
+			{
+				descend &= overlap_mask(node, area);
 			}
 
-			//Comes down here when every octant has been found and pushed to the queue
 			return true;
 		};
 
-		//Contains the main working queue
-		std::list<std::shared_ptr<QuadTree<T>>> Children;
-
-		//Checking if the root contains the item
-		if (!m_Item.empty())
-		{
-			//Adding an item if it fits the QuadTree, or items if they cross through trees
-			if (area.contains(m_Position))
-			{
-				for (const auto& it : m_Item)
-				{
-					items.push_back((it));
-				}
-			}
-		}
+		return traverse(visit);
+	}
 
-		//Placing the root Children to the queue
-		for (int i = 0; i < NUMBER_OF_CHILDREN; i++)
-		{
-			if (m_Children[i])
-				Children.push_back(m_Children[i]);
-		}
 
-		//Iterative breadth first search implementation for an QuadTree
-		size_t CurrentDepth = m_Depth;
+	//Searches for a given area inside the tree, appending to a vector that can be reused between the searches
+	template<typename T>
+	void QuadTree<T>::query(Collisions::AABB& area, std::vector<T>& items)
+	{
+		auto push = [&items](T& item) { items.push_back(item); return true; };
 
-		while (CurrentDepth < m_MaxDepth)
-		{
-			//Setting current depth
-			CurrentDepth++;
+		query(area, push);
+	}
 
-			//For building the next Children queue
-			std::list<std::shared_ptr<QuadTree<T>>> lower_Children;
 
-			typename std::list<std::shared_ptr<QuadTree<T>>>::iterator it;
+	//The same traversal as the box search, with the shape deciding which nodes are reached
+	template<typename T>
+	template<typename S, typename B, typename F>
+	bool QuadTree<T>::query_shape(const S& shape, B&& bounds, F&& on_hit)
+	{
+		//Everything below a node inside of the shape is found
+		auto found = [&on_hit](QuadTree<T>& node, unsigned&) {
+			for (T& item : node.m_Item)
+			{
+				if (!on_hit(item)) return false;
+			}
 
-			//Using a Lambda, that enables returning only from the 2 nested loops
-			[&] {
-				//Checking the list
-				for (it = Children.begin(); it != Children.end(); ++it)
-				{
-					//Take the AABB of the octant
-					Collisions::AABB comparing = (**it).aabb();
+			return true;
+		};
 
-					std::array<glm::vec3, 2> test = comparing.bounding_region();
+		auto visit = [&](QuadTree<T>& node, unsigned& descend) {
+			Collisions::AABB position = node.aabb();
 
-					//Compare with the given area
-					if (comparing.intersects2 (area)) {
+			//None of the children can reach the shape either
+			if (!shape.intersects(position))
+			{
+				descend = 0;
+				return true;
+			}
 
-						//Adding an item if it fits the QuadTree, or items if they cross through trees
-						std::list<T> temp = (**it).access_elements();
+			if (shape.contains(position))
+			{
+				descend = 0;
+				return node.traverse(found);
+			}
 
-						if (area.contains(comparing))
-						{
-							for (const auto& it : temp)
-							{
-								items.push_back((it));
-							}
-						}
-						else if (is_leaf_node() && comparing.intersects2(area))
-						{
-							for (const auto& it : temp)
-							{
-								items.push_back((it));
-							}
-						}
+			for (T& item : node.m_Item)
+			{
+				Collisions::AABB box = bounds(item);
 
-					}
+				if (shape.intersects(box) && !on_hit(item)) return false;
+			}
 
-					//If the tree reached leaf nodes, this fails
-					if (!asign_children(lower_Children, (**it).access_Children()))
-					{
-						return;
-					}
-				}
-			}();
+			return true;
+		};
 
-			//Swaping the queues
-			std::swap(Children, lower_Children);
-		}
+		return traverse(visit);
 	}
 
 
-	//Checks whether the tree contains a certain area
+	//Reports every pair of the overlapping items once, bounds(item) gives the box of an item, returns false if it was stopped
 	template<typename T>
-	bool QuadTree<T>::contains(Collisions::AABB& area)
+	template<typename B, typename F>
+	bool QuadTree<T>::overlapping_pairs(B&& bounds, F&& on_pair)
 	{
-		return m_Position.contains(area);
+		//The items of the nodes on the current path, the nodes of one level don't overlap, so only those can reach the items below
+		std::vector<std::pair<T*, Collisions::AABB>> path;
+
+		return pairs_below(path, bounds, on_pair);
 	}
 
 
+	//Reports every pair of the overlapping items once, every thread writes only to the buffers of its own subtrees
 	template<typename T>
-	void QuadTree<T>::erase_area(Collisions::AABB& area, std::list<T>& items)
+	template<typename B>
+	void QuadTree<T>::overlapping_pairs(B&& bounds, std::vector<std::pair<T, T>>& pairs)
 	{
-		//Checking the parent node for the items
-		if (!m_Item.empty())
+		//A subtree searched on its own, with the items above it that still reach into it
+		struct PairTask
 		{
-			//Adding an item if it fits the QuadTree, or items if they cross through trees
-			if (area.contains(m_Position))
+			QuadTree<T>* node;
+			std::vector<std::pair<T*, Collisions::AABB>> path;
+		};
+
+		auto push = [&pairs](T& first, T& second) { pairs.push_back({ first, second }); return true; };
+
+		std::vector<PairTask> tasks;
+		tasks.push_back({ this, {} });
+
+		//Splitting the top of the tree level by level, until every thread has a few subtrees to take
+		size_t wanted = m_Data->multi_thread ? Parallel::worker_count() * 8 : 1;
+		bool split = true;
+
+		while (tasks.size() < wanted && split)
+		{
+			std::vector<PairTask> next;
+			split = false;
+
+			for (PairTask& task : tasks)
 			{
-				//Pushing the found item into the list
-				for (const auto& it : m_Item)
+				QuadTree<T>* node = task.node;
+
+				if (!node->m_ActiveChildren)
 				{
-					items.push_back((it));
+					next.push_back(std::move(task));
+					continue;
 				}
 
-				m_Item.clear();
-			}
-			else if (is_leaf_node() && m_Position.intersects2(area))
-			{
-				//Pushing the found item into the list
-				for (const auto& it : m_Item)
+				//The items of the split node are paired right here
+				for (T& item : node->m_Item)
 				{
-					items.push_back((it));
-				}
+					Collisions::AABB box = bounds(item);
 
-				m_Item.clear();
-			}
-		}
+					for (std::pair<T*, Collisions::AABB>& other : task.path)
+					{
+						if (other.second.intersects2(box)) push(*other.first, item);
+					}
 
-		//Checking the child nodes
-		for (int i = 0; i < NUMBER_OF_CHILDREN; i++)
-		{
-			if (m_Children[i])
-			{
-				//Checking for overlapping
-				if (m_ChildrenBounds[i].intersects2(area))
+					task.path.push_back({ &item, box });
+				}
+
+				//Every child takes only the items that reach into it
+				for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
 				{
-					m_Children[i]->erase_area(area, items);
+					if (!(node->m_ActiveChildren & (1 << i)))
+					{
+						continue;
+					}
+
+					Collisions::AABB area = node->child_bounds(i);
+					PairTask child = { node->child(i), {} };
+
+					for (std::pair<T*, Collisions::AABB>& other : task.path)
+					{
+						if (other.second.intersects2(area)) child.path.push_back(other);
+					}
+
+					next.push_back(std::move(child));
 				}
-			}
-		}
 
-	}
+				split = true;
+			}
 
+			tasks.swap(next);
+		}
 
-	template<typename T>
-	std::list<T> QuadTree<T>::access_elements()
-	{
-		return m_Item;
-	}
+		//Every task has its own buffer, they are joined in the order of the tasks once all of them are done
+		std::vector<std::vector<std::pair<T, T>>> buffers(tasks.size());
 
+		Parallel::run(tasks.size(), [&](size_t i) {
+			std::vector<std::pair<T, T>>& buffer = buffers[i];
+			auto collect = [&buffer](T& first, T& second) { buffer.push_back({ first, second }); return true; };
 
-	/*////////////////////
-	* /    Modifiers     /
-	*/////////////////////
+			tasks[i].node->pairs_below(tasks[i].path, bounds, collect);
+		});
 
+		size_t total = pairs.size();
 
-	template<typename T>
-	Trees::Location<T> QuadTree<T>::insert(T object, Collisions::AABB area)
-	{
-		//Checking whether anything can be inserted
-		if (!m_NodeReady)
+		for (std::vector<std::pair<T, T>>& buffer : buffers)
 		{
-			return {};
+			total += buffer.size();
 		}
 
-		//
-		return recursive_insert(object, area);
+		pairs.reserve(total);
 
+		for (std::vector<std::pair<T, T>>& buffer : buffers)
+		{
+			pairs.insert(pairs.end(), buffer.begin(), buffer.end());
+		}
 	}
 
 
+	//Walks only the nodes along the ray, nearest entry first, and reports the hit items in the order of their distance
 	template<typename T>
-	void QuadTree<T>::clear()
+	template<typename B, typename F>
+	bool QuadTree<T>::raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, B&& bounds, F&& on_hit)
 	{
-		//Enabling the user to write a top-down new tree, by removing the locking flags
-		m_Item.clear();
-
-		//Proceeding to the Children
-		for (int i = 0; i < NUMBER_OF_CHILDREN; i++)
-		{
+		//The hits waiting until none of the nodes ahead can hold anything nearer, the nearest one on the top
+		std::vector<std::pair<float, T*>> hits;
+		auto farther = [](const std::pair<float, T*>& left, const std::pair<float, T*>& right) { return left.first > right.first; };
 
-			if (m_Children[i])
+		//Reports the waiting hits up to the distance
+		auto report = [&](float distance) {
+			while (!hits.empty() && hits.front().first <= distance)
 			{
-				// Recursively cleaning
-				m_Children[i]->clear();
+				std::pop_heap(hits.begin(), hits.end(), farther);
+				std::pair<float, T*> hit = hits.back();
+				hits.pop_back();
+
+				if (!on_hit(*hit.second, hit.first)) return false;
 			}
-		}
-	}
 
+			return true;
+		};
 
-	/*////////////////////
-	* /  Space altering  /
-	*/////////////////////
+		//Only the x and the z slabs of a box, gives where the ray enters it
+		auto clip = [&](const glm::vec3& minimum, const glm::vec3& maximum, float& enter) {
+			float exit = max_distance;
+			enter = 0.0f;
+
+			return Raycast::clip_slab(origin.x, direction.x, minimum.x, maximum.x, enter, exit)
+				&& Raycast::clip_slab(origin.y, direction.y, minimum.z, maximum.z, enter, exit);
+		};
+
+		//The same for the box of a node on the map
+		auto clip_node = [&](const Collisions::AABB& box, float& enter) {
+			std::array<glm::vec3, 2> region = box.bounding_region();
+
+			return clip(glm::min(region[0], region[1]), glm::max(region[0], region[1]), enter);
+		};
+
+		//Every waiting node knows where the ray enters it, the nearest entry on the top. The order of the children along the ray
+		//can't be told from the signs of its direction, a shifted tree has its children across the seam far apart on the map
+		std::vector<std::pair<float, QuadTree<T>*>> nodes;
+		auto later = [](const std::pair<float, QuadTree<T>*>& left, const std::pair<float, QuadTree<T>*>& right) { return left.first > right.first; };
+
+		float enter;
+
+		if (clip_node(aabb(), enter))
+		{
+			nodes.push_back({ enter, this });
+		}
+
+		while (!nodes.empty())
+		{
+			std::pop_heap(nodes.begin(), nodes.end(), later);
+			std::pair<float, QuadTree<T>*> entry = nodes.back();
+			nodes.pop_back();
+
+			QuadTree<T>* node = entry.second;
+
+			//The nodes come in the order of their entry points, and the items lie inside of their nodes,
+			//so nothing met from now on can be nearer than this node
+			if (!report(entry.first))
+			{
+				return false;
+			}
+
+			for (T& item : node->m_Item)
+			{
+				std::array<glm::vec3, 2> region = bounds(item).bounding_region();
+
+				if (clip(glm::min(region[0], region[1]), glm::max(region[0], region[1]), enter))
+				{
+					hits.push_back({ enter, &item });
+					std::push_heap(hits.begin(), hits.end(), farther);
+				}
+			}
+
+			if (!node->m_ActiveChildren)
+			{
+				continue;
+			}
+
+			for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+			{
+				if ((node->m_ActiveChildren & (1 << i)) && clip_node(node->child_bounds(i), enter))
+				{
+					nodes.push_back({ enter, node->child(i) });
+					std::push_heap(nodes.begin(), nodes.end(), later);
+				}
+			}
+		}
+
+		return report(max_distance);
+	}
+
+
+	//Best first search, the nodes and the items wait in one queue ordered by their distance to the point
+	template<typename T>
+	template<typename B>
+	void QuadTree<T>::nearest(glm::vec2 point, size_t k, B&& bounds, std::vector<T>& items, float max_distance)
+	{
+		//Either a node or an item, with the squared distance to its box
+		struct Candidate
+		{
+			float distance;
+			QuadTree<T>* node;
+			T* item;
+		};
+
+		auto farther = [](const Candidate& left, const Candidate& right) { return left.distance > right.distance; };
+		std::priority_queue<Candidate, std::vector<Candidate>, decltype(farther)> queue(farther);
+
+		//The squared distance to the nearest point of the box on the map, zero inside of it
+		auto distance = [&point](const glm::vec3& minimum, const glm::vec3& maximum) {
+			float x = std::max(minimum.x, std::min(point.x, maximum.x)) - point.x;
+			float z = std::max(minimum.z, std::min(point.y, maximum.z)) - point.y;
+			return x * x + z * z;
+		};
+
+		//The squared distance to the box of a node on the map
+		auto node_distance = [&distance](const Collisions::AABB& box) {
+			std::array<glm::vec3, 2> region = box.bounding_region();
+			return distance(glm::min(region[0], region[1]), glm::max(region[0], region[1]));
+		};
+
+		float limit = max_distance * max_distance;
+
+		if (k > 0)
+		{
+			queue.push({ node_distance(aabb()), this, nullptr });
+		}
+
+		//A node is never nearer than its box, so once an item comes out of the queue, nothing left can be nearer than it
+		while (!queue.empty() && queue.top().distance <= limit)
+		{
+			Candidate candidate = queue.top();
+			queue.pop();
+
+			if (candidate.item)
+			{
+				items.push_back(*candidate.item);
+
+				if (--k == 0)
+				{
+					return;
+				}
+
+				continue;
+			}
+
+			QuadTree<T>* node = candidate.node;
+
+			for (T& item : node->m_Item)
+			{
+				std::array<glm::vec3, 2> region = bounds(item).bounding_region();
+
+				queue.push({ distance(glm::min(region[0], region[1]), glm::max(region[0], region[1])), nullptr, &item });
+			}
+
+			if (!node->m_ActiveChildren)
+			{
+				continue;
+			}
+
+			for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+			{
+				if (node->m_ActiveChildren & (1 << i))
+				{
+					queue.push({ node_distance(node->child_bounds(i)), node->child(i), nullptr });
+				}
+			}
+		}
+	}
+
+
+	//Searches for a given area inside the tree
+	template<typename T>
+	void QuadTree<T>::bfs(Collisions::AABB& area, std::list<T>& items)
+	{
+		//Lamda for asigning the children to the queue
+		auto asign_children = [this](std::list<QuadTree<T>*>& temp_queue, QuadTree<T>& temp) {
+			//Pushing the Children to a temporary container
+			for (uint8_t j = 0; j < NUMBER_OF_CHILDREN; ++j)
+			{
+				if (temp.m_ActiveChildren & (1 << j))
+				{
+					//If the child is active, I am placing it on to the queue
+					temp_queue.push_back(temp.child(j));
+				}
+				else if (!m_Data->lazy_subdivision)
+				{
+					//Else I tell the function, that We propably reached the leaf node
+					return false;
+				}
+
+			}
+
+			//Comes down here when every octant has been found and pushed to the queue
+			return true;
+		};
+
+		//Contains the main working queue
+		std::list<QuadTree<T>*> Children;
+
+		//Checking if the root contains the item
+		if (!m_Item.empty())
+		{
+			//Adding an item if it fits the QuadTree, or items if they cross through trees
+			Collisions::AABB position = aabb();
+
+			if (area.contains(position))
+			{
+				for (const auto& it : m_Item)
+				{
+					items.push_back((it));
+				}
+			}
+		}
+
+		//Placing the root Children to the queue
+		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+		{
+			if (m_ActiveChildren & (1 << i))
+				Children.push_back(child(i));
+		}
+
+		//Iterative breadth first search implementation for an QuadTree
+		size_t CurrentDepth = m_Depth;
+
+		while (CurrentDepth < m_Data->max_depth)
+		{
+			//Setting current depth
+			CurrentDepth++;
+
+			//For building the next Children queue
+			std::list<QuadTree<T>*> lower_Children;
+
+			typename std::list<QuadTree<T>*>::iterator it;
+
+			//Using a Lambda, that enables returning only from the 2 nested loops
+			[&] {
+				//Checking the list
+				for (it = Children.begin(); it != Children.end(); ++it)
+				{
+					//Take the AABB of the octant
+					Collisions::AABB comparing = (**it).aabb();
+
+					std::array<glm::vec3, 2> test = comparing.bounding_region();
+
+					//Compare with the given area
+					if (comparing.intersects2 (area)) {
+
+						//Adding an item if it fits the QuadTree, or items if they cross through trees
+						NodeItems<T>& temp = (**it).access_elements();
+
+						if (area.contains(comparing))
+						{
+							for (const auto& it : temp)
+							{
+								items.push_back((it));
+							}
+						}
+						else if (is_leaf_node() && comparing.intersects2(area))
+						{
+							for (const auto& it : temp)
+							{
+								items.push_back((it));
+							}
+						}
+
+					}
+
+					//If the tree reached leaf nodes, this fails
+					if (!asign_children(lower_Children, **it))
+					{
+						return;
+					}
+				}
+			}();
+
+			//Swaping the queues
+			std::swap(Children, lower_Children);
+		}
+	}
+
+
+	//Checks whether the tree contains a certain area
+	template<typename T>
+	bool QuadTree<T>::contains(Collisions::AABB& area)
+	{
+		return aabb().contains(area);
+	}
+
+
+	template<typename T>
+	void QuadTree<T>::erase_area(Collisions::AABB& area, std::list<T>& items)
+	{
+		//Checking the parent node for the items
+		if (!m_Item.empty())
+		{
+			Collisions::AABB position = aabb();
+
+			//Adding an item if it fits the QuadTree, or items if they cross through trees
+			if (area.contains(position))
+			{
+				//Pushing the found item into the list
+				for (const auto& it : m_Item)
+				{
+					items.push_back((it));
+				}
+
+				m_Item.clear();
+			}
+			else if (is_leaf_node() && position.intersects2(area))
+			{
+				//Pushing the found item into the list
+				for (const auto& it : m_Item)
+				{
+					items.push_back((it));
+				}
+
+				m_Item.clear();
+			}
+		}
+
+		if (!m_ActiveChildren)
+		{
+			return;
+		}
+
+		//Checking all of the active child nodes for overlapping at once, against the planes splitting the node
+		unsigned overlapping = overlap_mask(*this, area) & m_ActiveChildren;
+
+		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+		{
+			if (overlapping & (1 << i))
+			{
+				QuadTree<T>* node = child(i);
+				node->erase_area(area, items);
+
+				//In the lazy mode the emptied children are given back to the pool right away
+				if (m_Data->lazy_subdivision && node->is_leaf_node() && node->m_Item.empty())
+				{
+					m_Data->pool.destroy(m_Children[i]);
+					m_ActiveChildren &= ~(1 << i);
+				}
+			}
+		}
+
+		//Without any children left the node becomes a leaf again
+		if (m_Data->lazy_subdivision && !m_ActiveChildren)
+		{
+			m_IsLeaf = true;
+		}
+
+	}
+
+
+	template<typename T>
+	NodeItems<T>& QuadTree<T>::access_elements()
+	{
+		return m_Item;
+	}
+
+
+	/*////////////////////
+	* /    Modifiers     /
+	*/////////////////////
+
+
+	template<typename T>
+	Trees::Location<T> QuadTree<T>::insert(T object, Collisions::AABB area)
+	{
+		//Checking whether anything can be inserted
+		if (!m_NodeReady)
+		{
+			return {};
+		}
+
+		//
+		return recursive_insert(object, area);
+
+	}
+
+
+	//Inserts all of the items in one sorted pass, the locations are given back in the order of the items
+	template<typename T>
+	void QuadTree<T>::insert(std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations)
+	{
+		locations.assign(items.size(), {});
+
+		//Checking whether anything can be inserted
+		if (!m_NodeReady)
+		{
+			return;
+		}
+
+		//The path to a node takes 2 bits per level, the trees too deep for that are filled one item at a time
+		size_t path_length = levels();
+
+		if ((path_length - 1) * 2 > 63)
+		{
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				locations[i] = insert(items[i].first, items[i].second);
+			}
+
+			return;
+		}
+
+		//Only the big insertions are worth spreading over the threads
+		bool parallel = m_Data->multi_thread && items.size() >= 2 * PARALLEL_MINIMUM_TASK_SIZE && Parallel::worker_count() > 1;
+
+		//Finding the node of every item, without touching any node
+		std::vector<Placement> placements(items.size());
+
+		auto locate = [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				placements[i] = place(items[i].second, i, path_length);
+			}
+		};
+
+		//Sorting by the path, the parents go before their children, and the items of one node keep their order
+		auto order = [](const Placement& left, const Placement& right) {
+			return left.code != right.code ? left.code < right.code : left.level < right.level;
+		};
+
+		if (!parallel)
+		{
+			locate(0, items.size());
+			std::stable_sort(placements.begin(), placements.end(), order);
+
+			build(this, 0, placements.data(), placements.data() + placements.size(), path_length, items, locations, nullptr);
+
+			return;
+		}
+
+		Parallel::run_ranges(items.size(), locate);
+
+		//The items staying in this node go first, then the ones of every child, each group is sorted on its own thread
+		std::array<size_t, 6> groups = {};
+
+		for (const Placement& placement : placements)
+		{
+			groups[(placement.level ? 1 + path_child(placement.code, 1, path_length) : 0) + 1]++;
+		}
+
+		for (size_t i = 1; i < groups.size(); ++i)
+		{
+			groups[i] += groups[i - 1];
+		}
+
+		std::vector<Placement> sorted(placements.size());
+		std::array<size_t, 6> next = groups;
+
+		for (const Placement& placement : placements)
+		{
+			sorted[next[placement.level ? 1 + path_child(placement.code, 1, path_length) : 0]++] = placement;
+		}
+
+		Parallel::run(groups.size() - 1, [&](size_t i) {
+			std::stable_sort(sorted.begin() + groups[i], sorted.begin() + groups[i + 1], order);
+		});
+
+		//The subtrees are split further while they stay large, the nodes above the tasks are built right away
+		std::vector<BuildTask> tasks;
+		split_build(this, 0, sorted.data(), sorted.data() + sorted.size(), path_length, items, locations, tasks);
+
+		//Every task gets enough pool slots for the nodes it may create, the eager trees have them all already
+		for (BuildTask& task : tasks)
+		{
+			task.reserved = m_Data->lazy_subdivision ? new_nodes(task.first, task.last, task.level, path_length) : 0;
+			task.reserved_slot = m_Data->pool.reserve_range(task.reserved);
+		}
+
+		Parallel::run(tasks.size(), [&](size_t i) {
+			uint32_t slot = tasks[i].reserved_slot;
+
+			build(tasks[i].node, tasks[i].level, tasks[i].first, tasks[i].last, path_length, items, locations, &slot);
+		});
+
+		for (BuildTask& task : tasks)
+		{
+			m_Data->pool.close_range(task.reserved_slot, task.reserved);
+		}
+	}
+
+
+	template<typename T>
+	void QuadTree<T>::clear()
+	{
+		//Enabling the user to write a top-down new tree, by removing the locking flags
+		m_Item.clear();
+
+		//Freeing the whole subtree in one go
+		release_children();
+
+		//Building the initial structure again, this time out of the already pooled memory
+		subdivide();
+	}
+
+
+	/*////////////////////
+	* /  Space altering  /
+	*/////////////////////
+
+
+	template<typename T>
+	void QuadTree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		shift(direction_offset(leaf_nodes, direction), returned_data);
+	}
 
 
 	template<typename T>
-	void QuadTree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	template<typename F>
+	void QuadTree<T>::shift(size_t leaf_nodes, Coordinates::Directions direction, F&& on_removed)
+	{
+		shift(direction_offset(leaf_nodes, direction), on_removed);
+	}
+
+
+	template<typename T>
+	void QuadTree<T>::shift(glm::ivec2 leaf_offset, std::list<std::pair<T, Collisions::AABB>>& returned_data)
+	{
+		//Temporary items list
+		std::list<std::pair<T, Collisions::AABB>> items;
+
+		auto collect = [&items](T& item, Collisions::AABB& position) { items.push_back({ item, position }); };
+
+		//The height of the tree never changes
+		float side = (float)m_Data->leaf_node_side;
+		glm::vec3 offset(leaf_offset.x * side, 0.0f, leaf_offset.y * side);
+
+		//Wrapping only the cells that leave around, or moving the whole tree if the cells don't line up
+		if (!wrap_cells(offset, collect))
+		{
+			//Placing all of the contained items into a list of pairs(item + coordinates)
+			collect_items(items);
+
+			//Resizing the tree
+			std::array<glm::vec3, 2> bounding_box = aabb().bounding_region();
+			resize({ bounding_box[0] + offset, bounding_box[1] + offset });
+		}
+
+		//Iterator of the items list
+		typename std::list<std::pair<T, Collisions::AABB>>::iterator it;
+
+		//Bulk inserting the taken out items
+		for (it = items.begin(); it != items.end(); ++it)
+		{
+			//If the item cannot be inserted, it means that is has been discarded
+			if (!insert((*it).first, (*it).second).items_container)
+			{
+				returned_data.push_back(*it);
+			}
+
+		}
+
+		//Clearing the temporary items list
+		items.clear();
+	}
+
+
+	template<typename T>
+	template<typename F>
+	void QuadTree<T>::shift(glm::ivec2 leaf_offset, F&& on_removed)
+	{
+		auto removed = [&on_removed](T& item, Collisions::AABB&) { on_removed(item); };
+
+		float side = (float)m_Data->leaf_node_side;
+		glm::vec3 offset(leaf_offset.x * side, 0.0f, leaf_offset.y * side);
+
+		if (!wrap_cells(offset, removed))
+		{
+			//Every item is taken out, the tree is built a new at the moved position
+			auto visit = [&on_removed](QuadTree<T>& node, unsigned&) {
+				for (T& item : node.m_Item)
+				{
+					on_removed(item);
+				}
+
+				return true;
+			};
+
+			traverse(visit);
+
+			std::array<glm::vec3, 2> bounding_box = aabb().bounding_region();
+			resize({ bounding_box[0] + offset, bounding_box[1] + offset });
+		}
+	}
+
+
+	/*////////////////////
+	* /     Snapshot     /
+	*/////////////////////
+
+
+	template<typename T>
+	bool QuadTree<T>::save(const std::string& path)
+	{
+		auto convert = [](T& item) { return item; };
+
+		return save<T>(path, convert);
+	}
+
+
+	template<typename T>
+	bool QuadTree<T>::load(const std::string& path)
+	{
+		auto place = [](const T& record, NodeItems<T>& items) { items.insert(record); };
+
+		return load<T>(path, place);
+	}
+
+
+	template<typename T>
+	template<typename R, typename C>
+	bool QuadTree<T>::save(const std::string& path, C&& convert)
+	{
+		//Only the root holds the settings of the whole tree
+		if (!m_OwnedData)
+		{
+			return false;
+		}
+
+		//The breadth first order, the children of a node take the next free indices
+		std::vector<QuadTree<T>*> order(1, this);
+		std::vector<Snapshot::Node<NUMBER_OF_CHILDREN>> nodes;
+		uint64_t first = 0;
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			QuadTree<T>* node = order[i];
+			Snapshot::Node<NUMBER_OF_CHILDREN> saved = {};
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				saved.center[axis] = node->m_Center[axis];
+			}
+
+			saved.depth = node->m_Depth;
+			saved.active = node->m_ActiveChildren;
+			saved.leaf = node->m_IsLeaf;
+
+			for (uint8_t c = 0; c < NUMBER_OF_CHILDREN; c++)
+			{
+				if (node->m_ActiveChildren & (1 << c))
+				{
+					saved.children[c] = (uint32_t)order.size();
+					order.push_back(node->child(c));
+				}
+			}
+
+			saved.first = first;
+			saved.count = node->m_Item.size();
+			first += saved.count;
+
+			nodes.push_back(saved);
+		}
+
+		Snapshot::Header header = {};
+		header.subdivision_depth = m_Data->subdivision_depth;
+		header.leaf_node_side = m_Data->leaf_node_side;
+		header.minimum_dimensions = m_Data->minimum_dimensions;
+		header.max_depth = m_Data->max_depth;
+		header.lazy_subdivision = m_Data->lazy_subdivision;
+		header.multi_thread = m_Data->multi_thread;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			header.moved[axis] = m_Data->torus.cells()[axis];
+		}
+
+		//The records follow the nodes in the same order
+		auto write_records = [&order, &convert](std::ofstream& file) {
+			for (QuadTree<T>* node : order)
+			{
+				for (T& item : node->m_Item)
+				{
+					R record = convert(item);
+					file.write(reinterpret_cast<const char*>(&record), sizeof(R));
+				}
+			}
+		};
+
+		return Snapshot::write<R, NUMBER_OF_CHILDREN>(path, header, m_Data->half_extents, nodes, write_records);
+	}
+
+
+	template<typename T>
+	template<typename R, typename P>
+	bool QuadTree<T>::load(const std::string& path, P&& place)
+	{
+		if (!m_OwnedData)
+		{
+			return false;
+		}
+
+		Snapshot::View<R, NUMBER_OF_CHILDREN> view;
+
+		//The whole file is checked before anything of the tree is touched
+		if (!view.open(path) || !view.validate())
+		{
+			return false;
+		}
+
+		const Snapshot::Header& header = view.header();
+
+		//The settings have to be the ones update_dimensions gives: a level for every depth down to the subdivision depth,
+		//which is at most one past the max depth. The validation keeps the depths of the nodes below the levels, so within the subdivision depth too
+		if (header.subdivision_depth > UINT16_MAX - 1 || header.levels != header.subdivision_depth + 1 || (header.subdivision_depth > header.max_depth && header.subdivision_depth - 1 > header.max_depth))
+		{
+			return false;
+		}
+
+		//The current nodes go back to the pool, the sizes of the levels and the settings come from the file
+		m_Item.clear();
+		release_children();
+
+		m_Data->subdivision_depth = header.subdivision_depth;
+		m_Data->leaf_node_side = header.leaf_node_side;
+		m_Data->minimum_dimensions = header.minimum_dimensions;
+		m_Data->max_depth = header.max_depth;
+		m_Data->lazy_subdivision = header.lazy_subdivision;
+		m_Data->multi_thread = header.multi_thread;
+		m_Data->half_extents.resize(header.levels);
+
+		for (size_t depth = 0; depth < header.levels; depth++)
+		{
+			m_Data->half_extents[depth] = view.half_extents(depth);
+		}
+
+		const Snapshot::Node<NUMBER_OF_CHILDREN>& root = view.at(0);
+		m_Center = glm::vec3(root.center[0], root.center[1], root.center[2]);
+		m_Depth = 0;
+		m_IsLeaf = root.leaf;
+
+		//The map is put back where the saved tree had moved it
+		m_Data->torus.reset(m_Center - m_Data->half_extents[0], m_Center + m_Data->half_extents[0], m_Data->half_extents[header.levels - 1] * 2.0f);
+		m_Data->torus.set_moved(glm::ivec3((int)header.moved[0], (int)header.moved[1], (int)header.moved[2]));
+
+		//The tree made by the default constructor takes the insertions from now on
+		m_NodeReady = true;
+
+		//A node of the file is created by its parent, which always comes earlier, so a single pass creates them all
+		std::vector<QuadTree<T>*> created(view.nodes(), nullptr);
+		created[0] = this;
+
+		for (size_t i = 0; i < view.nodes(); i++)
+		{
+			const Snapshot::Node<NUMBER_OF_CHILDREN>& saved = view.at(i);
+			QuadTree<T>* node = created[i];
+
+			for (uint8_t c = 0; c < NUMBER_OF_CHILDREN; c++)
+			{
+				if (!(saved.active & (1 << c)))
+				{
+					continue;
+				}
+
+				const Snapshot::Node<NUMBER_OF_CHILDREN>& child = view.at(saved.children[c]);
+
+				node->m_Children[c] = m_Data->pool.create(glm::vec3(child.center[0], child.center[1], child.center[2]), child.depth, m_Data);
+				node->m_ActiveChildren |= (1 << c);
+
+				created[saved.children[c]] = node->child(c);
+				created[saved.children[c]]->m_IsLeaf = child.leaf;
+			}
+
+			for (uint64_t r = saved.first; r < saved.first + saved.count; r++)
+			{
+				place(view.record(r), node->m_Item);
+			}
+		}
+
+		return true;
+	}
+
+
+	/*
+	* //////////////////////////////
+	* /  Private member functions  /
+	* //////////////////////////////
+	*/
+
+
+	template<typename T>
+	void QuadTree<T>::update_dimensions(Collisions::AABB& area)
+	{
+		//Temporary storage of the bounds
+		std::array<glm::vec3, 2> bounds = area.bounding_region();
+		glm::vec3 minimum = glm::min(bounds[0], bounds[1]);
+		glm::vec3 maximum = glm::max(bounds[0], bounds[1]);
+
+		m_Center = (minimum + maximum) * 0.5f;
+
+		//Every level halves the size on x and z, until the depth or the dimensions limit is reached
+		std::vector<glm::vec3>& half_extents = m_Data->half_extents;
+		half_extents.assign(1, (maximum - minimum) * 0.5f);
+
+		size_t depth = 0;
+
+		while (depth <= m_Data->max_depth && depth < UINT16_MAX - 1)
+		{
+			//Safety checking whether the dimensions aren't smaller than the minimum value, the height is never split
+			glm::vec3 dimensions = half_extents[depth] * 2.0f;
+
+			if (dimensions.x < m_Data->minimum_dimensions || dimensions.z < m_Data->minimum_dimensions)
+			{
+				break;
+			}
+
+			half_extents.push_back(glm::vec3(half_extents[depth].x * 0.5f, half_extents[depth].y, half_extents[depth].z * 0.5f));
+			depth++;
+		}
+
+		m_Data->subdivision_depth = depth;
+
+		//Calculating the side length
+		m_Data->leaf_node_side = (maximum.x - minimum.x) / std::pow(2.0, m_Data->max_depth);
+
+		//The map starts out as the box itself, it wraps by the cells of the deepest level, the height is a single cell
+		m_Data->torus.reset(minimum, maximum, half_extents[depth] * 2.0f);
+	}
+
+
+	template<typename T>
+	glm::ivec2 QuadTree<T>::direction_offset(size_t leaf_nodes, Coordinates::Directions direction)
+	{
+		int distance = (int)leaf_nodes;
+		glm::ivec2 offset(0);
+
+		switch (direction)
+		{
+		case Coordinates::Directions::North:
+			offset.y = -distance;
+			break;
+		case Coordinates::Directions::South:
+			offset.y = distance;
+			break;
+		case Coordinates::Directions::East:
+			offset.x = distance;
+			break;
+		case Coordinates::Directions::West:
+			offset.x = -distance;
+			break;
+		}
+
+		return offset;
+	}
+
+
+	template<typename T>
+	template<typename F>
+	bool QuadTree<T>::wrap_cells(glm::vec3 offset, F& on_removed)
 	{
-		//TODO: To redesign this function for it to suit the chunking system better. To specify the template for the chunks
+		//The axes of the map, the children split only these two
+		const int axes[2] = { 0, 2 };
+
+		Torus& torus = m_Data->torus;
+		glm::vec3 cell = torus.cell();
+		glm::ivec3 grid = torus.grid();
+		glm::ivec3 cells(0);
+
+		//Only the whole tree wraps, by whole cells of the deepest level, and by less than the whole map
+		if (!m_OwnedData)
+		{
+			return false;
+		}
+
+		for (int axis : axes)
+		{
+			float count = std::round(offset[axis] / cell[axis]);
+
+			if (count * cell[axis] != offset[axis] || count >= grid[axis] || count <= -grid[axis])
+			{
+				return false;
+			}
+
+			cells[axis] = (int)count;
+		}
+
+		std::array<glm::vec3, 2> world = torus.world().bounding_region();
+		glm::vec3 first = glm::min(world[0], world[1]);
+		glm::vec3 last = glm::max(world[0], world[1]);
+
+		//The slabs of the map left behind, one for every axis it moves along, and the map they leave to
+		std::vector<std::array<glm::vec3, 2>> slabs;
+
+		for (int axis : axes)
+		{
+			if (!cells[axis])
+			{
+				continue;
+			}
+
+			std::array<glm::vec3, 2> slab = { first, last };
+
+			if (cells[axis] > 0)
+			{
+				slab[1][axis] = first[axis] + offset[axis];
+			}
+			else
+			{
+				slab[0][axis] = last[axis] + offset[axis];
+			}
+
+			slabs.push_back(slab);
+		}
+
+		//The boxes lie on the grid of the cells, half of a cell keeps the rounding away from touching boxes
+		glm::vec3 tolerance = cell * 0.5f;
+
+		auto reaches = [&](const std::array<glm::vec3, 2>& region, const std::array<glm::vec3, 2>& slab) {
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+			for (int axis : axes)
+			{
+				if (maximum[axis] <= slab[0][axis] + tolerance[axis] || minimum[axis] >= slab[1][axis] - tolerance[axis]) return false;
+			}
+
+			return true;
+		};
+
+		auto stays = [&](const std::array<glm::vec3, 2>& region) {
+			glm::vec3 minimum = glm::min(region[0], region[1]);
+			glm::vec3 maximum = glm::max(region[0], region[1]);
+
+			for (int axis : axes)
+			{
+				if (minimum[axis] < first[axis] + offset[axis] - tolerance[axis] || maximum[axis] > last[axis] + offset[axis] + tolerance[axis]) return false;
+			}
+
+			return true;
+		};
+
+		//Only the nodes reaching into the slabs are visited, the ones across the seam reach into all of them
+		std::vector<QuadTree<T>*> visited;
+		TraversalStack<QuadTree<T>*, NUMBER_OF_CHILDREN> stack(levels());
+		stack.push(this);
+
+		while (!stack.empty())
+		{
+			QuadTree<T>* node = stack.pop();
+			visited.push_back(node);
+
+			Collisions::AABB position = node->aabb();
+			std::array<glm::vec3, 2> region = position.bounding_region();
+
+			//The items of the nodes reaching out of the moved map can't stay
+			if (!node->m_Item.empty() && !stays(region))
+			{
+				for (T& item : node->m_Item)
+				{
+					on_removed(item, position);
+				}
+
+				node->m_Item.clear();
+			}
+
+			for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+			{
+				if (!(node->m_ActiveChildren & (1 << i)))
+				{
+					continue;
+				}
+
+				std::array<glm::vec3, 2> bounds = node->child_bounds(i).bounding_region();
+
+				for (std::array<glm::vec3, 2>& slab : slabs)
+				{
+					if (reaches(bounds, slab))
+					{
+						stack.push(node->child(i));
+						break;
+					}
+				}
+			}
+		}
+
+		//In the lazy mode the emptied children are given back to the pool, going backwards they are emptied before their parents
+		for (auto it = visited.rbegin(); it != visited.rend() && m_Data->lazy_subdivision; ++it)
+		{
+			QuadTree<T>* node = *it;
+
+			for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+			{
+				if ((node->m_ActiveChildren & (1 << i)) && node->child(i)->is_leaf_node() && node->child(i)->m_Item.empty())
+				{
+					m_Data->pool.destroy(node->m_Children[i]);
+					node->m_ActiveChildren &= ~(1 << i);
+				}
+			}
 
-		//Storing the new coordinates for the tree
-		std::array<glm::vec3, 2> bounding_box = m_Position.bounding_region();
+			if (!node->m_ActiveChildren)
+			{
+				node->m_IsLeaf = true;
+			}
+		}
 
-		//Temporary items list
-		std::list<std::pair<T, Collisions::AABB>> items;
+		//The slabs left behind are the cells entering on the other side, the nodes stay where they are
+		torus.move(cells);
 
-		//Calculating the bounding box
-		switch (direction)
-		{
-		case Coordinates::Directions::North:
+		return true;
+	}
 
-			bounding_box[0].z -= leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].z -= leaf_nodes * m_LeafNodeSide;
 
-			break;
-		case Coordinates::Directions::South:
+	template<typename T>
+	glm::vec3 QuadTree<T>::child_center(uint8_t child)
+	{
+		return child_center(m_Center, m_Depth, child);
+	}
 
-			bounding_box[0].z += leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].z += leaf_nodes * m_LeafNodeSide;
 
-			break;
-		case Coordinates::Directions::East:
+	template<typename T>
+	glm::vec3 QuadTree<T>::child_center(const glm::vec3& center, size_t depth, uint8_t child)
+	{
+		//The children are half the size of the node, so their centers lie their own half extents away
+		glm::vec3 offset = m_Data->half_extents[depth + 1];
 
-			bounding_box[0].x += leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].x += leaf_nodes * m_LeafNodeSide;
+		return glm::vec3(
+			center.x + ((child & 0x1) ? offset.x : -offset.x),
+			center.y,
+			center.z + ((child & 0x2) ? offset.z : -offset.z));
+	}
 
-			break;
-		case Coordinates::Directions::West:
 
-			bounding_box[0].x -= leaf_nodes * m_LeafNodeSide;
-			bounding_box[1].x -= leaf_nodes * m_LeafNodeSide;
+	template<typename T>
+	Collisions::AABB QuadTree<T>::child_bounds(uint8_t child)
+	{
+		return m_Data->torus.bounds(child_center(child), m_Data->half_extents[m_Depth + 1]);
+	}
+
 
-			break;
+	template<typename T>
+	int QuadTree<T>::containing_child(Collisions::AABB& area)
+	{
+		glm::vec3 minimum, maximum;
+
+		//The nodes are found by the slots of the area, the one lying across the wrap stays above all of them
+		if (!m_Data->torus.slots(area, minimum, maximum))
+		{
+			return -1;
 		}
 
-		//Placing all of the contained items into a list of pairs(item + coordinates)
-		collect_items(items);
+		return containing_child(m_Center, m_Depth, minimum, maximum);
+	}
 
-		//Resizing the tree
-		resize({ bounding_box[0], bounding_box[1] });
 
-		//Iterator of the items list
-		typename std::list<std::pair<T, Collisions::AABB>>::iterator it;
+	template<typename T>
+	int QuadTree<T>::containing_child(const glm::vec3& center, size_t depth, const glm::vec3& minimum, const glm::vec3& maximum)
+	{
+		glm::vec3 half = m_Data->half_extents[depth];
 
-		//Bulk inserting the content of the tree
-		for (it = items.begin(); it != items.end(); ++it)
+		int child = 0;
+
+		for (int i = 0; i < 3; i++)
 		{
-			//If the item cannot be inserted, it means that is has been discarded
-			if (!insert((*it).first, (*it).second).items_container)
+			//The area has to be inside of the node in the first place
+			if (minimum[i] < center[i] - half[i] || maximum[i] > center[i] + half[i])
 			{
-				returned_data.push_back(*it);
+				return -1;
 			}
 
+			//The height isn't split
+			if (i == 1)
+			{
+				continue;
+			}
+
+			if (maximum[i] <= center[i])
+			{
+				continue;
+			}
+			else if (minimum[i] >= center[i])
+			{
+				//The upper half of x is the bit 0, of z the bit 1
+				child |= (i == 0) ? 0x1 : 0x2;
+			}
+			else
+			{
+				//Crossing the center, none of the children can hold it
+				return -1;
+			}
 		}
 
-		//Clearing the temporary items list
-		items.clear();
+		return child;
 	}
 
 
-	/*
-	* //////////////////////////////
-	* /  Private member functions  /
-	* //////////////////////////////
-	*/
+	template<typename T>
+	bool QuadTree<T>::is_leaf_node(void)
+	{
+		return m_IsLeaf;
+	}
 
 
 	template<typename T>
-	void QuadTree<T>::calculate_bounding_box(Collisions::AABB& BoundingBox, Children Octant)
+	bool QuadTree<T>::can_subdivide(void)
 	{
-		// Here is the center of the parent node QuadTree
-		glm::vec3 center = m_Position.center();
-
-		// And It's side length for all dimensions
-		glm::vec3 dimensions = m_Position.dimensions();
+		//Both the depth and the dimensions limits are the same for a whole level, so they are checked once per tree
+		return m_Depth < m_Data->subdivision_depth;
+	}
 
-		// Variables for storing the min and max valus
-		glm::vec3 minimum;
-		glm::vec3 maximum;
 
-		// Calculating the 8 different boudning boxes for the Children
-		if (Octant == Children::O1)
-		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x - 0.5 * dimensions.x, center.y, center.z);
+	template<typename T>
+	QuadTree<T>* QuadTree<T>::child(uint8_t index)
+	{
+		return m_Data->pool.at(m_Children[index]);
+	}
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x, center.y + 0.5 * dimensions.y, center.z - 0.5 * dimensions.z);
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+	template<typename T>
+	unsigned QuadTree<T>::overlap_mask(QuadTree<T>& node, Collisions::AABB& area)
+	{
+		glm::vec3 half = m_Data->half_extents[node.m_Depth];
+		glm::vec3 offset;
 
-			return;
+		if (m_Data->torus.offset(node.m_Center, half, offset))
+		{
+			return Simd::overlap_mask_quadrants(node.m_Center + offset, half, area);
 		}
-		else if (Octant == Children::O2)
+
+		unsigned mask = 0;
+
+		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
 		{
-			// The minimum coordinate of the bounding box
-			minimum = center;
+			if (node.child_bounds(i).intersects2(area))
+			{
+				mask |= 1 << i;
+			}
+		}
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x + 0.5 * dimensions.x, center.y + 0.5 * dimensions.y, center.z - 0.5 * dimensions.z);
+		return mask;
+	}
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
 
-			return;
-		}
-		else if (Octant == Children::O3)
+	template<typename T>
+	QuadTree<T>* QuadTree<T>::obtain_child(uint8_t index, uint32_t* reserved_slot)
+	{
+		//Does the child exist?
+		if (!(m_ActiveChildren & (1 << index)))
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x - 0.5 * dimensions.x, center.y, center.z + 0.5 * dimensions.z);
+			//If no, create that child, the node stops being a leaf
+			m_IsLeaf = false;
+			m_ActiveChildren |= 1 << index;
+
+			if (reserved_slot)
+			{
+				//The parallel builds take the next slot of their own range
+				m_Children[index] = (*reserved_slot)++;
+				m_Data->pool.create_at(m_Children[index], child_center(index), m_Depth + 1, m_Data);
+			}
+			else
+			{
+				m_Children[index] = m_Data->pool.create(child_center(index), m_Depth + 1, m_Data);
+			}
+		}
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x, center.y + 0.5 * dimensions.y, center.z);
+		return child(index);
+	}
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
 
-			return;
+	template<typename T>
+	void QuadTree<T>::release_children(void)
+	{
+		if (m_OwnedData)
+		{
+			//The root owns the pool, so every node can be destroyed at once
+			m_Data->pool.reset();
 		}
-		else if (Octant == Children::O4)
+		else
 		{
-			// The minimum coordinate of the bounding box
-			minimum = glm::vec3(center.x, center.y, center.z + 0.5 * dimensions.z);
+			//Otherwise the subtree has to be handed back node by node, the stack holds the pool indices
+			TraversalStack<uint32_t, NUMBER_OF_CHILDREN> stack(levels());
 
-			// The maximum coordinate of the bounding box
-			maximum = glm::vec3(center.x + 0.5 * dimensions.x, center.y + 0.5 * dimensions.y, center.z);
+			for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; ++i)
+			{
+				if (m_ActiveChildren & (1 << i)) stack.push(m_Children[i]);
+			}
 
-			// Updating the given bounding box
-			BoundingBox.update_position(minimum, maximum);
+			while (!stack.empty())
+			{
+				uint32_t index = stack.pop();
+				QuadTree<T>* node = m_Data->pool.at(index);
 
-			return;
+				//The children are taken before the node itself is gone
+				for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; ++i)
+				{
+					if (node->m_ActiveChildren & (1 << i)) stack.push(node->m_Children[i]);
+				}
+
+				m_Data->pool.destroy(index);
+			}
 		}
 
+		//Nothing is left below, so the node becomes a leaf again
+		m_ActiveChildren = 0;
+		m_IsLeaf = true;
 	}
 
-
 	template<typename T>
-	bool QuadTree<T>::is_leaf_node(void)
+	void QuadTree<T>::collect_items(std::list<std::pair<T, Collisions::AABB>>& items)
 	{
-		return m_IsLeaf;
+		auto visit = [&items](QuadTree<T>& node, unsigned&) {
+			if (!node.m_Item.empty())
+			{
+				Collisions::AABB position = node.aabb();
+
+				for (const auto& it : node.m_Item)
+				{
+					items.push_back({ (it), position });
+				}
+			}
+
+			return true;
+		};
+
+		traverse(visit);
 	}
 
 
 	template<typename T>
-	std::array<std::shared_ptr<QuadTree<T>>, 4>& QuadTree<T>::access_children()
+	size_t QuadTree<T>::levels(void)
 	{
-		return m_Children;
+		return m_Data->subdivision_depth + 1 - m_Depth;
 	}
 
+
 	template<typename T>
-	void QuadTree<T>::collect_items(std::list<std::pair<T, Collisions::AABB>>& items)
+	template<typename F>
+	bool QuadTree<T>::traverse(F& visit)
 	{
-		if (!m_Item.empty())
+		TraversalStack<QuadTree<T>*, NUMBER_OF_CHILDREN> stack(levels());
+		stack.push(this);
+
+		while (!stack.empty())
 		{
-			for (const auto& it : m_Item)
+			QuadTree<T>* node = stack.pop();
+
+			//By default every active child is visited
+			unsigned descend = node->m_ActiveChildren;
+
+			if (!visit(*node, descend))
 			{
-				items.push_back({ (it), m_Position });
+				return false;
+			}
+
+			//Pushed backwards, so that the children are visited in their order
+			for (int i = NUMBER_OF_CHILDREN - 1; i >= 0; i--)
+			{
+				if (descend & (1 << i))
+				{
+					stack.push(node->child(i));
+				}
 			}
 		}
-		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; ++i)
-		{
-			if (m_Children[i])
-				m_Children[i]->collect_items(items);
-		}
+
+		return true;
 	}
 
 
 	template<typename T>
-	void QuadTree<T>::recursive_subdivide(void)
+	void QuadTree<T>::subdivide(void)
 	{
-
-		// If is a leaf node or the maximum depth has beed aproached
-		if (!is_leaf_node())
+		//In the lazy mode the children are created only once an insertion needs them
+		if (m_Data->lazy_subdivision)
 		{
 			return;
 		}
-		else if (!(m_Depth <= m_MaxDepth))
+
+		//Building the tree top-down, with the nodes waiting for their subdivision on the stack
+		TraversalStack<QuadTree<T>*, NUMBER_OF_CHILDREN> stack(levels());
+		stack.push(this);
+
+		while (!stack.empty())
 		{
-			return;
+			QuadTree<T>* node = stack.pop();
+
+			// If is not a leaf node or the maximum depth has beed aproached
+			if (!node->is_leaf_node() || !node->can_subdivide())
+			{
+				continue;
+			}
+
+			//If it came down here It can't be a leaf node
+			node->m_IsLeaf = false;
+
+			//Creating the children QuadTrees, their bounds follow from the center of the node
+			for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+			{
+				node->m_Children[i] = m_Data->pool.create(node->child_center(i), node->m_Depth + 1, m_Data);
+			}
+
+			//Every child is active now
+			node->m_ActiveChildren = (1 << NUMBER_OF_CHILDREN) - 1;
+
+			for (int i = NUMBER_OF_CHILDREN - 1; i >= 0; i--)
+			{
+				stack.push(node->child(i));
+			}
 		}
+	}
 
-		//Getting the current bb dimensions
-		glm::vec3 dimensions = m_Position.dimensions();
 
-		//Safety checking whether the dimensions aren't smaller than the minimum value
-		for (uint8_t i = 0; i < 3; i++)
+	template<typename T>
+	Trees::Location<T> QuadTree<T>::recursive_insert(T object, Collisions::AABB area)
+	{
+		//Checking whether the children can contain the item, only one of them can, and it follows from the center
+		if (can_subdivide())
 		{
-			if (dimensions[i] < MINIMUM_DIMENSION) return;
-		}
+			int i = containing_child(area);
 
-		/*
-		* Creating the coordinates of the Children, I am using a clever little technique,
-		* by shifting bit-wise a number one, I achieve the needed enum class members values,
-		* that allows to correctly recognize Children based on their hex code.
-		*/
+			if (i >= 0)
+			{
+				//Proceeding to the insertion, the child is created if it doesn't exist yet
+				return obtain_child(i)->recursive_insert(object, area);
+			}
+		}
 
-		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+		//Inserting an item
+		if (takes(area))
 		{
-			calculate_bounding_box(m_ChildrenBounds[i], static_cast<Children>(1 << i));
+			//Inserting the object to the first free slot
+			size_t slot = m_Item.insert(object);
+
+			//Returning the Dependencies::Tree::Location struct
+			return { &m_Item, slot, area };
 		}
 
-		//If it came down here It can't be a leaf node
-		m_IsLeaf = false;
+		//Returning empty struct
+		return {};
+	}
 
-		//Creating the Children QuadTrees
-		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+
+	template<typename T>
+	bool QuadTree<T>::takes(Collisions::AABB& area)
+	{
+		if (!contains(area))
 		{
-			m_Children[i] = std::make_shared<QuadTree<T>>(m_ChildrenBounds[i], m_MaxDepth, m_MinimumDimensions, m_Depth + 1);
+			return false;
 		}
 
+		return m_Item.empty() || (m_Depth == 0 && m_Data->torus.across(area));
 	}
 
-
 	template<typename T>
-	void QuadTree<T>::recursive_dfs(Collisions::AABB& area, std::list<T>& items)
+	typename QuadTree<T>::Placement QuadTree<T>::place(Collisions::AABB& area, size_t item, size_t path_length)
 	{
-		//Checking the parent node for the items
-		if (!m_Item.empty())
+		glm::vec3 minimum, maximum;
+		Placement placement = { 0, 0, item };
+
+		if (!m_Data->torus.slots(area, minimum, maximum))
 		{
-			//Adding an item if it fits the QuadTree, or items if they cross through trees
-			if (m_Position.contains(area))
-			{
-				for (const auto& it : m_Item)
-				{
-					items.push_back((it));
-				}
-			}
-			else if (is_leaf_node() && m_Position.intersects2(area))
-			{
-				for (const auto& it : m_Item)
-				{
-					items.push_back((it));
-				}
-			}
+			return placement;
 		}
 
-		//Checking the child nodes
-		for (int i = 0; i < NUMBER_OF_CHILDREN; i++)
+		//Going down the same way as the single insertion does, so both end up in the same node
+		glm::vec3 center = m_Center;
+		size_t depth = m_Depth;
+
+		while (depth < m_Data->subdivision_depth)
 		{
-			if (m_Children[i])
+			int child = containing_child(center, depth, minimum, maximum);
+
+			if (child < 0)
 			{
-				//Checking for overlapping
-				if (m_ChildrenBounds[i].intersects2(area))
-				{
-					m_Children[i]->recursive_dfs(area, items);
-				}
+				break;
 			}
+
+			center = child_center(center, depth, (uint8_t)child);
+			depth++;
+			placement.level++;
+			placement.code |= (uint64_t)child << (2 * (path_length - 1 - placement.level));
 		}
 
+		return placement;
 	}
 
+
 	template<typename T>
-	Trees::Location<T> QuadTree<T>::recursive_insert(T object, Collisions::AABB area)
+	uint8_t QuadTree<T>::path_child(uint64_t code, size_t level, size_t path_length)
 	{
-		//Checking whether the children can contain the item
-		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; i++)
+		return (uint8_t)((code >> (2 * (path_length - 1 - level))) & 0x3);
+	}
+
+
+	//Counts the nodes on the paths of the sorted placements below the level, every shared node is counted once
+	template<typename T>
+	size_t QuadTree<T>::new_nodes(Placement* first, Placement* last, size_t level, size_t path_length)
+	{
+		size_t count = 0;
+		Placement* previous = nullptr;
+
+		for (Placement* it = first; it != last; ++it)
 		{
-			if (m_ChildrenBounds[i].contains(area))
-			{
-				// Within the depth limit?
-				if (m_Depth <= m_MaxDepth)
-				{
-					//If yes, does the child exist?
-					if (!m_Children[i])
-					{
-						//If no, create that child
-						m_Children[i] = std::make_shared<QuadTree<T>>(m_ChildrenBounds[i], m_Depth + 1, m_MinimumDimensions);
-					}
-					//If yes, proceed to the insertion
-					return m_Children[i]->recursive_insert(object, area);
-				}
+			size_t shared = level;
 
+			while (previous && shared < previous->level && shared < it->level && path_child(previous->code, shared + 1, path_length) == path_child(it->code, shared + 1, path_length))
+			{
+				shared++;
 			}
 
+			count += it->level > shared ? it->level - shared : 0;
+			previous = it;
 		}
 
-		//Inserting an item
-		if (m_Item.empty())
+		return count;
+	}
+
+
+	//One pass over the sorted placements below the node, every node is reached through the path of the previous item
+	template<typename T>
+	void QuadTree<T>::build(QuadTree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, uint32_t* reserved_slot)
+	{
+		std::vector<QuadTree<T>*> path(path_length, nullptr);
+		path[level] = node;
+
+		Placement* previous = nullptr;
+
+		for (Placement* it = first; it != last; ++it)
 		{
-			if (m_Position.contains(area))
+			size_t shared = level;
+
+			while (previous && shared < previous->level && shared < it->level && path_child(previous->code, shared + 1, path_length) == path_child(it->code, shared + 1, path_length))
 			{
-				//Inserting the object to the list 
-				m_Item.push_back(object);
+				shared++;
+			}
 
-				//Returning the Dependencies::Tree::Location struct
-				return { &m_Item, std::prev(m_Item.end()), area };
+			//Going down only through the part of the path that differs, creating the missing nodes
+			for (size_t i = shared + 1; i <= it->level; ++i)
+			{
+				path[i] = path[i - 1]->obtain_child(path_child(it->code, i, path_length), reserved_slot);
 			}
-			else
+
+			previous = it;
+
+			//The node takes the item on the same conditions as in the single insertion
+			QuadTree<T>* target = path[it->level];
+			std::pair<T, Collisions::AABB>& item = items[it->item];
+
+			if (target->takes(item.second))
 			{
-				//Returning empty struct
-				return {};
+				size_t slot = target->m_Item.insert(item.first);
+				locations[it->item] = { &target->m_Item, slot, item.second };
 			}
 		}
-		else
-		{
-			//Returning empty struct
-			return {};
-		}
-
 	}
 
 
+	//Builds the top of the tree on the calling thread and leaves the large enough subtrees as the tasks
 	template<typename T>
-	void QuadTree<T>::recursive_resize(Collisions::AABB& area)
+	void QuadTree<T>::split_build(QuadTree<T>* node, size_t level, Placement* first, Placement* last, size_t path_length, std::vector<std::pair<T, Collisions::AABB>>& items, std::vector<Trees::Location<T>>& locations, std::vector<BuildTask>& tasks)
 	{
-		//Temporary storage of the bounds
-		std::array<glm::vec3, 2> bounds = area.bounding_region();
+		if ((size_t)(last - first) <= PARALLEL_MINIMUM_TASK_SIZE || level + 1 >= path_length)
+		{
+			tasks.push_back({ node, level, first, last, 0, 0 });
+			return;
+		}
 
-		//Updating the coordinates
-		m_Position.update_position(bounds[0], bounds[1]);
+		//The items of the node itself are sorted before the ones of its children
+		Placement* it = first;
 
-		//Clearing the content
-		m_Item.clear();
+		while (it != last && it->level == level)
+		{
+			++it;
+		}
+
+		build(node, level, first, it, path_length, items, locations, nullptr);
 
-		// Calcaulating the potential children coordinates
-		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; ++i)
+		//The rest is grouped by the child the paths go through
+		while (it != last)
 		{
-			calculate_bounding_box(m_ChildrenBounds[i], (Children)(1 << i));
+			uint8_t child = path_child(it->code, level + 1, path_length);
+			Placement* end = it;
+
+			while (end != last && path_child(end->code, level + 1, path_length) == child)
+			{
+				++end;
+			}
+
+			split_build(node->obtain_child(child), level + 1, it, end, path_length, items, locations, tasks);
+			it = end;
 		}
+	}
+
 
-		for (uint8_t i = 0; i < NUMBER_OF_CHILDREN; ++i)
+	//The search of the pairs with an explicit stack, the path can already hold the items of the nodes above
+	template<typename T>
+	template<typename B, typename F>
+	bool QuadTree<T>::pairs_below(std::vector<std::pair<T*, Collisions::AABB>>& path, B& bounds, F& on_pair)
+	{
+		//Every waiting node knows how many of the items on the path lie above it
+		TraversalStack<std::pair<QuadTree<T>*, size_t>, NUMBER_OF_CHILDREN> stack(levels());
+		stack.push({ this, path.size() });
+
+		while (!stack.empty())
 		{
-			//Updating the Children with the bb data pulled from pre-calculated octantbounds
-			if (m_Children[i])
-				m_Children[i]->recursive_resize(m_ChildrenBounds[i]);
+			std::pair<QuadTree<T>*, size_t> entry = stack.pop();
+			QuadTree<T>* node = entry.first;
+
+			//Leaving the items of the nodes, that aren't above this one
+			path.resize(entry.second);
+
+			for (T& item : node->m_Item)
+			{
+				Collisions::AABB box = bounds(item);
+
+				//Against the items above, and the ones of this node that came before
+				for (std::pair<T*, Collisions::AABB>& other : path)
+				{
+					if (other.second.intersects2(box) && !on_pair(*other.first, item)) return false;
+				}
+
+				path.push_back({ &item, box });
+			}
+
+			//Pushed backwards, so that the children are visited in their order
+			for (int i = NUMBER_OF_CHILDREN - 1; i >= 0; i--)
+			{
+				if (node->m_ActiveChildren & (1 << i))
+				{
+					stack.push({ node->child(i), path.size() });
+				}
+			}
 		}
 
+		return true;
 	}
 
 }
@@ -0,0 +1,839 @@
+//Dependencies
+#include SPATIAL_TREES_DEPENDENCIES
+#include "../ContainedQuadTree.h"
+#include "../../Common/tests/Check.h"
+
+//Default Libraries
+#include<map>
+#include<list>
+#include<tuple>
+#include<vector>
+#include<cstdio>
+#include<cstddef>
+#include<fstream>
+#include<algorithm>
+
+
+/*
+* The QuadTree against a brute force search over the same items. The box search of the tree
+* reports the items by the nodes holding them, so the brute force side follows every item
+* to the node it ends up in, the deepest one holding its whole box on the map, and applies the same rule.
+* Every other search works on the boxes of the items, and is compared with them directly.
+*/
+
+
+using namespace DataStructures;
+
+
+namespace {
+
+	//The world of every test, 64 units wide and high, with the cells of 2 units at the deepest level
+	const float WORLD = 64.0f;
+	const size_t MAX_DEPTH = 4;
+	const size_t MINIMUM_DIMENSIONS = 1;
+
+
+	Collisions::AABB random_box(float minimum, float maximum, float largest)
+	{
+		glm::vec3 corner(Tests::uniform(minimum, maximum), Tests::uniform(minimum, maximum), Tests::uniform(minimum, maximum));
+		glm::vec3 size(Tests::uniform(0.1f, largest), Tests::uniform(0.1f, largest), Tests::uniform(0.1f, largest));
+
+		return Collisions::AABB(corner, corner + size);
+	}
+
+
+	std::vector<int> sorted(std::vector<int> items)
+	{
+		std::sort(items.begin(), items.end());
+		return items;
+	}
+
+
+	/*
+	* Follows every insertion the way the tree does, without any tree: an item goes down while one child holds
+	* its whole box, and stays in the node it stopped at, if that node doesn't hold any item yet.
+	*/
+	class Model
+	{
+	public:
+
+		//A node by its depth and its position in the grid of that depth, x and z
+		using Key = std::tuple<size_t, int, int>;
+
+		struct Item
+		{
+			Collisions::AABB box;
+			Key node;
+			bool stored = false;
+		};
+
+		glm::vec3 origin;
+		float side;
+		size_t depth;
+		bool lazy;
+
+		std::vector<Item> items;
+		std::map<Key, int> occupied;
+
+		//The nodes with children, only matters for the lazy trees
+		std::map<Key, bool> parents;
+
+		Model(glm::vec3 Origin, float Side, size_t Depth, bool Lazy) :
+			origin(Origin), side(Side), depth(Depth), lazy(Lazy)
+		{}
+
+		Collisions::AABB bounds(const Key& key)
+		{
+			float cell = side / (float)(1 << std::get<0>(key));
+			glm::vec3 minimum = origin + glm::vec3((float)std::get<1>(key) * cell, 0.0f, (float)std::get<2>(key) * cell);
+
+			return Collisions::AABB(minimum, minimum + glm::vec3(cell, side, cell));
+		}
+
+		bool leaf(const Key& key)
+		{
+			return lazy ? !parents.count(key) : std::get<0>(key) == depth;
+		}
+
+		//Returns whether the tree is expected to take the item
+		bool insert(int id, Collisions::AABB box)
+		{
+			if ((int)items.size() <= id)
+			{
+				items.resize(id + 1);
+			}
+
+			Item& item = items[id];
+			item.box = box;
+			item.stored = false;
+
+			if (!bounds(Key(0, 0, 0)).contains(box))
+			{
+				return false;
+			}
+
+			std::array<glm::vec3, 2> region = box.bounding_region();
+			Key key(0, 0, 0);
+
+			while (std::get<0>(key) < depth)
+			{
+				glm::vec3 center = bounds(key).center();
+				int step[3] = { 0, 0, 0 };
+				bool inside = true;
+
+				for (int i : { 0, 2 })
+				{
+					if (region[1][i] <= center[i]) step[i] = 0;
+					else if (region[0][i] >= center[i]) step[i] = 1;
+					else inside = false;
+				}
+
+				if (!inside)
+				{
+					break;
+				}
+
+				parents[key] = true;
+				key = Key(std::get<0>(key) + 1, std::get<1>(key) * 2 + step[0], std::get<2>(key) * 2 + step[2]);
+			}
+
+			item.node = key;
+
+			if (occupied.count(key))
+			{
+				return false;
+			}
+
+			occupied[key] = id;
+			item.stored = true;
+
+			return true;
+		}
+
+		std::vector<int> query(Collisions::AABB& area)
+		{
+			std::vector<int> found;
+
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				if (!items[i].stored) continue;
+
+				Collisions::AABB node = bounds(items[i].node);
+
+				if (node.contains(area) || (leaf(items[i].node) && node.intersects2(area)))
+				{
+					found.push_back((int)i);
+				}
+			}
+
+			return found;
+		}
+
+		std::vector<int> stored()
+		{
+			std::vector<int> found;
+
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				if (items[i].stored) found.push_back((int)i);
+			}
+
+			return found;
+		}
+	};
+
+
+	//The tree and the model filled with the same random items
+	struct Fixture
+	{
+		QuadTree<int> tree;
+		Model model;
+
+		Fixture(bool lazy, size_t count, float largest) :
+			tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS, lazy),
+			model(glm::vec3(0.0f), WORLD, MAX_DEPTH + 1, lazy)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				Collisions::AABB box = random_box(0.0f, WORLD - largest, largest);
+				Trees::Location<int> location = tree.insert((int)i, box);
+
+				CHECK(model.insert((int)i, box) == (location.items_container != nullptr));
+			}
+		}
+
+		Collisions::AABB box(int item)
+		{
+			return model.items[item].box;
+		}
+	};
+
+
+	void box_search()
+	{
+		for (bool lazy : { false, true })
+		{
+			Fixture fixture(lazy, 800, 6.0f);
+
+			CHECK(fixture.tree.size() == fixture.model.stored().size());
+
+			bool same = true;
+
+			for (int i = 0; i < 300; ++i)
+			{
+				Collisions::AABB area = random_box(-4.0f, WORLD, 12.0f);
+				std::vector<int> found;
+				fixture.tree.query(area, found);
+				same = same && sorted(found) == fixture.model.query(area);
+			}
+
+			CHECK(same);
+		}
+	}
+
+
+	void bulk_insertion()
+	{
+		std::vector<std::pair<int, Collisions::AABB>> items;
+
+		for (int i = 0; i < 20000; ++i)
+		{
+			items.push_back({ i, random_box(0.0f, WORLD - 1.0f, 1.0f) });
+		}
+
+		//The same items built on one thread, on 8 of them whatever the machine has, and inserted one by one
+		Collisions::AABB world(glm::vec3(0.0f), glm::vec3(WORLD));
+		QuadTree<int> serial(world, MAX_DEPTH, MINIMUM_DIMENSIONS);
+		QuadTree<int> parallel(world, MAX_DEPTH, MINIMUM_DIMENSIONS);
+		QuadTree<int> single(world, MAX_DEPTH, MINIMUM_DIMENSIONS);
+
+		std::vector<Trees::Location<int>> serial_locations, parallel_locations;
+
+		serial.set_multi_thread(false);
+		serial.insert(items, serial_locations);
+
+		Parallel::set_worker_count(8);
+		parallel.insert(items, parallel_locations);
+		Parallel::set_worker_count(0);
+
+		for (std::pair<int, Collisions::AABB>& item : items)
+		{
+			single.insert(item.first, item.second);
+		}
+
+		CHECK(parallel.size() == serial.size());
+		CHECK(single.size() == serial.size());
+
+		//The threads take the same items into the same nodes
+		bool same = true;
+
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			bool located = serial_locations[i].items_container != nullptr;
+
+			same = same && located == (parallel_locations[i].items_container != nullptr);
+
+			if (located)
+			{
+				same = same && parallel_locations[i].items_container->at(parallel_locations[i].items_slot) == items[i].first;
+			}
+		}
+
+		CHECK(same);
+
+		for (int i = 0; i < 200; ++i)
+		{
+			Collisions::AABB area = random_box(0.0f, WORLD, 8.0f);
+			std::vector<int> first, second, third;
+			serial.query(area, first);
+			parallel.query(area, second);
+			single.query(area, third);
+			same = same && sorted(first) == sorted(second) && first.size() == third.size();
+		}
+
+		CHECK(same);
+	}
+
+
+	void shapes()
+	{
+		Fixture fixture(false, 800, 6.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		bool same = true;
+
+		for (int i = 0; i < 100; ++i)
+		{
+			Shapes::Sphere sphere{ glm::vec3(Tests::uniform(0.0f, WORLD), Tests::uniform(0.0f, WORLD), Tests::uniform(0.0f, WORLD)), Tests::uniform(1.0f, 20.0f) };
+			std::vector<int> found, expected;
+
+			fixture.tree.query_shape(sphere, bounds, [&found](int& item) { found.push_back(item); return true; });
+
+			for (int item : stored)
+			{
+				Collisions::AABB box = fixture.box(item);
+				if (sphere.intersects(box)) expected.push_back(item);
+			}
+
+			same = same && sorted(found) == expected;
+		}
+
+		CHECK(same);
+	}
+
+
+	std::vector<std::pair<int, int>> ordered(std::vector<std::pair<int, int>> pairs)
+	{
+		for (std::pair<int, int>& pair : pairs)
+		{
+			if (pair.first > pair.second) std::swap(pair.first, pair.second);
+		}
+
+		std::sort(pairs.begin(), pairs.end());
+		return pairs;
+	}
+
+
+	void pairs()
+	{
+		Fixture fixture(true, 1500, 4.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		std::vector<std::pair<int, int>> expected;
+
+		for (size_t i = 0; i < stored.size(); ++i)
+		{
+			for (size_t j = i + 1; j < stored.size(); ++j)
+			{
+				if (fixture.box(stored[i]).intersects2(fixture.box(stored[j]))) expected.push_back({ stored[i], stored[j] });
+			}
+		}
+
+		std::vector<std::pair<int, int>> visited;
+		fixture.tree.overlapping_pairs(bounds, [&visited](int& first, int& second) { visited.push_back({ first, second }); return true; });
+		CHECK(ordered(visited) == ordered(expected));
+
+		//The threads give the same pairs as the single one, with 8 of them whatever the machine has
+		std::vector<std::pair<int, int>> serial, parallel;
+
+		fixture.tree.set_multi_thread(false);
+		fixture.tree.overlapping_pairs(bounds, serial);
+
+		Parallel::set_worker_count(8);
+		fixture.tree.set_multi_thread(true);
+		fixture.tree.overlapping_pairs(bounds, parallel);
+		Parallel::set_worker_count(0);
+
+		CHECK(ordered(serial) == ordered(expected));
+		CHECK(ordered(parallel) == ordered(expected));
+	}
+
+
+	void raycasts()
+	{
+		Fixture fixture(true, 800, 6.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		bool same = true;
+		bool nearest_first = true;
+
+		for (int i = 0; i < 200; ++i)
+		{
+			glm::vec2 origin(Tests::uniform(-10.0f, WORLD + 10.0f), Tests::uniform(-10.0f, WORLD + 10.0f));
+			glm::vec2 direction(Tests::uniform(-1.0f, 1.0f), Tests::uniform(-1.0f, 1.0f));
+			float reach = Tests::uniform(10.0f, 100.0f);
+
+			if (i % 10 == 0) direction = glm::vec2(1.0f, 0.0f);
+
+			std::vector<std::pair<float, int>> hits, expected;
+
+			fixture.tree.raycast(origin, direction, reach, bounds, [&hits](int& item, float distance) { hits.push_back({ distance, item }); return true; });
+
+			for (int item : stored)
+			{
+				std::array<glm::vec3, 2> region = fixture.box(item).bounding_region();
+				float enter = 0.0f, exit = reach;
+
+				if (Raycast::clip_slab(origin.x, direction.x, region[0].x, region[1].x, enter, exit)
+					&& Raycast::clip_slab(origin.y, direction.y, region[0].z, region[1].z, enter, exit))
+				{
+					expected.push_back({ enter, item });
+				}
+			}
+
+			for (size_t h = 1; h < hits.size(); ++h)
+			{
+				nearest_first = nearest_first && hits[h - 1].first <= hits[h].first;
+			}
+
+			std::sort(hits.begin(), hits.end());
+			std::sort(expected.begin(), expected.end());
+			same = same && hits == expected;
+		}
+
+		CHECK(same);
+		CHECK(nearest_first);
+	}
+
+
+	void nearest_items()
+	{
+		Fixture fixture(false, 800, 3.0f);
+		auto bounds = [&fixture](int& item) { return fixture.box(item); };
+		std::vector<int> stored = fixture.model.stored();
+
+		auto distance = [&fixture](const glm::vec2& point, int item) {
+			std::array<glm::vec3, 2> region = fixture.box(item).bounding_region();
+			glm::vec2 offset = glm::clamp(point, glm::vec2(region[0].x, region[0].z), glm::vec2(region[1].x, region[1].z)) - point;
+			return glm::dot(offset, offset);
+		};
+
+		bool same = true;
+
+		for (int i = 0; i < 100; ++i)
+		{
+			glm::vec2 point(Tests::uniform(-5.0f, WORLD + 5.0f), Tests::uniform(-5.0f, WORLD + 5.0f));
+			size_t k = 1 + i % 12;
+
+			std::vector<int> found;
+			fixture.tree.nearest(point, k, bounds, found);
+
+			std::vector<float> expected, distances;
+
+			for (int item : stored)
+			{
+				expected.push_back(distance(point, item));
+			}
+
+			std::sort(expected.begin(), expected.end());
+			expected.resize(std::min(k, expected.size()));
+
+			for (int item : found)
+			{
+				distances.push_back(distance(point, item));
+			}
+
+			same = same && distances == expected;
+		}
+
+		CHECK(same);
+	}
+
+
+	/*
+	* The shifts keep the nodes in place and wrap the map around them, so after every one of them the items are
+	* compared with the boxes they were inserted with: the ones taken out reached out of the moved map, and the
+	* searches by the item boxes give the same items as the brute force walk over the rest.
+	*/
+	void shifts()
+	{
+		const float LEAF = WORLD / (float)(1 << MAX_DEPTH);
+
+		for (bool lazy : { false, true })
+		{
+			QuadTree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS, lazy);
+			std::map<int, Collisions::AABB> stored;
+			int next = 0;
+
+			auto bounds = [&stored](int& item) { return stored.at(item); };
+
+			//A random area of the map, reaching a little out of it
+			auto around = [](const std::array<glm::vec3, 2>& world, float largest) {
+				std::array<glm::vec3, 2> region = random_box(-4.0f, WORLD, largest).bounding_region();
+
+				return Collisions::AABB(region[0] + world[0], region[1] + world[0]);
+			};
+
+			//Fills the current map, the items lying across the edge where it wraps are kept by the root
+			auto fill = [&](int count) {
+				std::array<glm::vec3, 2> world = tree.aabb().bounding_region();
+
+				for (int i = 0; i < count; ++i, ++next)
+				{
+					glm::vec3 corner(Tests::uniform(world[0].x, world[1].x - 3.0f), Tests::uniform(0.0f, WORLD - 3.0f), Tests::uniform(world[0].z, world[1].z - 3.0f));
+					Collisions::AABB box(corner, corner + glm::vec3(Tests::uniform(0.1f, 3.0f), Tests::uniform(0.1f, 3.0f), Tests::uniform(0.1f, 3.0f)));
+
+					if (tree.insert(next, box).items_container) stored[next] = box;
+				}
+			};
+
+			fill(800);
+
+			bool inside = true, shaped = true, cast = true, near = true, paired = true;
+
+			for (int step = 0; step < 24; ++step)
+			{
+				glm::ivec2 offset((int)Tests::uniform(-3.0f, 4.0f), (int)Tests::uniform(-3.0f, 4.0f));
+				std::array<glm::vec3, 2> before = tree.aabb().bounding_region();
+
+				tree.shift(offset, [&stored](int& item) { stored.erase(item); });
+
+				//The map moved on x and z, and only the items reaching out of it were taken out
+				std::array<glm::vec3, 2> after = tree.aabb().bounding_region();
+				glm::vec3 moved(offset.x * LEAF, 0.0f, offset.y * LEAF);
+				CHECK(after[0] == before[0] + moved && after[1] == before[1] + moved);
+
+				fill(60);
+
+				CHECK(tree.size() == stored.size());
+
+				for (auto& item : stored)
+				{
+					inside = inside && tree.aabb().contains(item.second);
+				}
+
+				for (int i = 0; i < 10; ++i)
+				{
+					Collisions::AABB area = around(after, 20.0f);
+					Shapes::Sphere sphere{ area.center(), Tests::uniform(1.0f, 16.0f) };
+					std::vector<int> found, expected;
+
+					for (auto& item : stored)
+					{
+						if (sphere.intersects(item.second)) expected.push_back(item.first);
+					}
+
+					tree.query_shape(sphere, bounds, [&found](int& item) { found.push_back(item); return true; });
+					shaped = shaped && sorted(found) == expected;
+
+					//A ray through the area on the map, against every stored box
+					glm::vec2 origin(sphere.center.x - 30.0f, sphere.center.z - 20.0f);
+					glm::vec2 direction(Tests::uniform(0.2f, 1.0f), Tests::uniform(0.0f, 1.0f));
+					std::vector<std::pair<float, int>> hits, reference;
+
+					tree.raycast(origin, direction, 80.0f, bounds, [&hits](int& item, float distance) { hits.push_back({ distance, item }); return true; });
+
+					for (auto& item : stored)
+					{
+						std::array<glm::vec3, 2> region = item.second.bounding_region();
+						float enter = 0.0f, exit = 80.0f;
+
+						if (Raycast::clip_slab(origin.x, direction.x, region[0].x, region[1].x, enter, exit)
+							&& Raycast::clip_slab(origin.y, direction.y, region[0].z, region[1].z, enter, exit))
+						{
+							reference.push_back({ enter, item.first });
+						}
+					}
+
+					for (size_t h = 1; h < hits.size(); ++h)
+					{
+						cast = cast && hits[h - 1].first <= hits[h].first;
+					}
+
+					std::sort(hits.begin(), hits.end());
+					std::sort(reference.begin(), reference.end());
+					cast = cast && hits == reference;
+
+					//The nearest ones on the map, by their distances
+					glm::vec2 point(sphere.center.x, sphere.center.z);
+					std::vector<int> nearest;
+					std::vector<float> distances, reference_distances;
+					tree.nearest(point, 5, bounds, nearest);
+
+					auto distance = [&stored, &point](int item) {
+						std::array<glm::vec3, 2> region = stored.at(item).bounding_region();
+						glm::vec2 offset = glm::clamp(point, glm::vec2(region[0].x, region[0].z), glm::vec2(region[1].x, region[1].z)) - point;
+						return glm::dot(offset, offset);
+					};
+
+					for (int item : nearest) distances.push_back(distance(item));
+					for (auto& item : stored) reference_distances.push_back(distance(item.first));
+
+					std::sort(reference_distances.begin(), reference_distances.end());
+					reference_distances.resize(std::min<size_t>(5, reference_distances.size()));
+					near = near && distances == reference_distances;
+				}
+
+				if (step % 6 == 5)
+				{
+					std::vector<std::pair<int, int>> expected, visited;
+
+					for (auto first = stored.begin(); first != stored.end(); ++first)
+					{
+						for (auto second = std::next(first); second != stored.end(); ++second)
+						{
+							if (first->second.intersects2(second->second)) expected.push_back({ first->first, second->first });
+						}
+					}
+
+					tree.overlapping_pairs(bounds, [&visited](int& first, int& second) { visited.push_back({ first, second }); return true; });
+					paired = paired && ordered(visited) == ordered(expected);
+				}
+			}
+
+			CHECK(inside);
+			CHECK(shaped);
+			CHECK(cast);
+			CHECK(near);
+			CHECK(paired);
+
+			//The moved map goes into the snapshot, the loaded tree and the mapped file search the same place
+			std::string path = lazy ? "quadtree_shifted_lazy.snapshot" : "quadtree_shifted.snapshot";
+			CHECK(tree.save(path));
+
+			QuadTree<int> loaded;
+			CHECK(loaded.load(path));
+
+			Snapshot::View<int, NUMBER_OF_CHILDREN> view;
+			CHECK(view.open(path) && view.validate());
+
+			std::array<glm::vec3, 2> world = tree.aabb().bounding_region();
+			std::array<glm::vec3, 2> mapped_world = view.aabb().bounding_region();
+			CHECK(loaded.aabb().bounding_region() == world && mapped_world == world);
+
+			bool same = true;
+
+			for (int i = 0; i < 200; ++i)
+			{
+				Collisions::AABB area = around(world, 12.0f);
+				std::vector<int> expected, found, mapped;
+
+				tree.query(area, expected);
+				loaded.query(area, found);
+				view.query(area, mapped);
+
+				same = same && sorted(found) == sorted(expected) && sorted(mapped) == sorted(expected);
+			}
+
+			CHECK(same);
+
+			view.close();
+			std::remove(path.c_str());
+
+			//A move by the whole map or more keeps nothing, the tree is built at the new place
+			size_t removed = 0;
+			tree.shift(glm::ivec2(0, -(1 << MAX_DEPTH)), [&removed](int&) { removed++; });
+
+			CHECK(removed == stored.size() && tree.size() == 0);
+			CHECK(tree.aabb().bounding_region()[0] == world[0] - glm::vec3(0.0f, 0.0f, WORLD));
+		}
+
+		//A shift by one leaf empties only the slab of the cells leaving the map, and the few nodes lying across the seam
+		QuadTree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS);
+
+		for (int i = 0; i < 4000; ++i)
+		{
+			tree.insert(i, random_box(0.0f, WORLD - 1.0f, 0.5f));
+		}
+
+		size_t total = tree.size();
+		std::list<std::pair<int, Collisions::AABB>> returned_data;
+
+		tree.shift(glm::ivec2(1, 0), returned_data);
+		tree.shift(glm::ivec2(0, -1), returned_data);
+
+		size_t kept = tree.size();
+		CHECK(returned_data.size() < total / 4);
+
+		//The items the tree couldn't take back, together with the ones it kept, are all of the items
+		std::list<std::pair<int, Collisions::AABB>> more;
+		tree.shift(glm::ivec2(1, 0), more);
+		CHECK(tree.size() + more.size() == kept);
+	}
+
+
+	//The items lying across the edge where the shifted map wraps, every one of them fits in the map, so all of them are taken
+	void wrap_insertions()
+	{
+		for (bool lazy : { false, true })
+		{
+			QuadTree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(16.0f)), 4, 1, lazy);
+			QuadTree<int> bulk(Collisions::AABB(glm::vec3(0.0f), glm::vec3(16.0f)), 4, 1, lazy);
+			std::list<std::pair<int, Collisions::AABB>> returned;
+
+			tree.shift(glm::ivec2(1, 0), returned);
+			bulk.shift(glm::ivec2(1, 0), returned);
+			CHECK(returned.empty());
+
+			std::vector<std::pair<int, Collisions::AABB>> items;
+
+			for (int i = 0; i < 16; ++i)
+			{
+				glm::vec3 corner(15.6f, 4.0f, 0.5f + (float)i);
+				items.push_back({ i, Collisions::AABB(corner, corner + glm::vec3(0.8f, 0.8f, 0.4f)) });
+			}
+
+			size_t taken = 0;
+
+			for (auto& item : items)
+			{
+				taken += tree.insert(item.first, item.second).items_container ? 1 : 0;
+			}
+
+			std::vector<Trees::Location<int>> locations;
+			bulk.insert(items, locations);
+
+			CHECK(taken == items.size());
+			CHECK(tree.size() == items.size());
+			CHECK(bulk.size() == items.size());
+
+			//Moving back, all of them reach out of the map again
+			tree.shift(glm::ivec2(-1, 0), returned);
+			CHECK(returned.size() == items.size());
+			CHECK(tree.size() == 0);
+		}
+	}
+
+
+	//The container around the tree, the items it refuses aren't kept, and a resize keeps the ones still inside
+	void contained_tree()
+	{
+		ContainedQuadTree<int> tree(Collisions::AABB(glm::vec3(0.0f), glm::vec3(WORLD)), MAX_DEPTH, MINIMUM_DIMENSIONS);
+		std::vector<int> inside;
+
+		//A node holds a single item, so every item gets a cell of the deepest level to itself
+		int count = 0;
+		float cell = WORLD / (float)(1 << MAX_DEPTH);
+
+		for (int x = 0; x < (1 << MAX_DEPTH); ++x)
+		{
+			for (int z = 0; z < (1 << MAX_DEPTH); ++z, ++count)
+			{
+				glm::vec3 corner(x * cell + 1.0f, 1.0f, z * cell + 1.0f);
+				CHECK(tree.insert(count, Collisions::AABB(corner, corner + glm::vec3(1.0f))));
+
+				if (corner.x < WORLD * 0.5f && corner.z < WORLD * 0.5f) inside.push_back(count);
+			}
+		}
+
+		CHECK(!tree.insert(count, Collisions::AABB(glm::vec3(WORLD + 1.0f), glm::vec3(WORLD + 2.0f))));
+		CHECK(tree.size() == (size_t)count);
+		CHECK(tree.items().size() == (size_t)count);
+
+		Collisions::AABB half(glm::vec3(0.0f), glm::vec3(WORLD * 0.5f));
+		CHECK(tree.contains(half));
+
+		tree.resize(half);
+		CHECK(sorted(tree.items()) == inside);
+
+		auto first = tree.begin();
+		CHECK(tree.remove(first));
+		CHECK(tree.size() == inside.size() - 1);
+	}
+
+
+	void snapshots()
+	{
+		for (bool lazy : { false, true })
+		{
+			Fixture fixture(lazy, 800, 6.0f);
+			std::string path = lazy ? "quadtree_lazy.snapshot" : "quadtree.snapshot";
+
+			CHECK(fixture.tree.save(path));
+
+			QuadTree<int> loaded;
+			CHECK(loaded.load(path));
+			CHECK(loaded.size() == fixture.tree.size());
+
+			Snapshot::View<int, NUMBER_OF_CHILDREN> view;
+			CHECK(view.open(path));
+			CHECK(view.validate());
+
+			bool same = true;
+
+			for (int i = 0; i < 200; ++i)
+			{
+				Collisions::AABB area = random_box(-4.0f, WORLD, 12.0f);
+				std::vector<int> expected = fixture.model.query(area);
+				std::vector<int> found, mapped;
+
+				loaded.query(area, found);
+				view.query(area, mapped);
+
+				same = same && sorted(found) == expected && sorted(mapped) == expected;
+			}
+
+			CHECK(same);
+
+			view.close();
+			std::remove(path.c_str());
+		}
+
+		//A file with the levels not matching its subdivision depth is refused, and the tree keeps what it had
+		Fixture fixture(false, 800, 6.0f);
+		std::string path = "quadtree_damaged.snapshot";
+
+		CHECK(fixture.tree.save(path));
+
+		QuadTree<int> loaded;
+		CHECK(loaded.load(path));
+		size_t size = loaded.size();
+
+		{
+			std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+			uint64_t depth = 0;
+
+			file.seekg(offsetof(Snapshot::Header, subdivision_depth));
+			file.read(reinterpret_cast<char*>(&depth), sizeof(depth));
+			depth++;
+			file.seekp(offsetof(Snapshot::Header, subdivision_depth));
+			file.write(reinterpret_cast<const char*>(&depth), sizeof(depth));
+		}
+
+		CHECK(!loaded.load(path));
+		CHECK(loaded.size() == size);
+
+		std::remove(path.c_str());
+	}
+
+}
+
+
+int main()
+{
+	box_search();
+	bulk_insertion();
+	shapes();
+	pairs();
+	raycasts();
+	nearest_items();
+	shifts();
+	wrap_insertions();
+	contained_tree();
+	snapshots();
+
+	return Tests::failures();
+}